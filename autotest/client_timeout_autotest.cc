@@ -101,3 +101,52 @@ TEST_F(ClientTimeoutTest, Timeout) {
   EXPECT_TRUE(!r);
   EXPECT_TRUE(timeout);
 }
+
+// Fill the backlog of a listening socket which never accepts, so that the SYN
+// of the next connection will be dropped.
+TEST_F(ClientTimeoutTest, ConnectTimeout) {
+  using asio::ip::tcp;
+
+  const std::uint16_t port = kPort + 1;
+
+  asio::io_context io_context;
+
+  tcp::acceptor acceptor{ io_context };
+  tcp::endpoint endpoint{ asio::ip::make_address("127.0.0.1"), port };
+  acceptor.open(endpoint.protocol());
+  acceptor.bind(endpoint);
+  acceptor.listen(0);
+
+  // NOTE: The connect is initiated immediately although the io_context is not
+  // running.
+  std::vector<std::unique_ptr<tcp::socket>> fillers;
+  for (int i = 0; i < 4; ++i) {
+    fillers.emplace_back(new tcp::socket{ io_context });
+    fillers.back()->async_connect(endpoint, [](std::error_code) {});
+  }
+
+  webcc::ClientSession session;
+
+  // Change connect timeout to 1s.
+  session.set_connect_timeout(1);
+
+  webcc::ResponsePtr r;
+  bool timeout = false;
+
+  auto start = std::chrono::steady_clock::now();
+
+  try {
+    r = session.Send(webcc::RequestBuilder{}.
+                     Get("http://127.0.0.1/").Port(port)
+                     ());
+
+  } catch (const webcc::Error& error) {
+    timeout = error.timeout();
+  }
+
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  EXPECT_TRUE(!r);
+  EXPECT_TRUE(timeout);
+  EXPECT_LT(elapsed, std::chrono::seconds(3));
+}
@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+# Compare the results of webcc_server_bench of two runs, e.g., of two commits.
+#
+# Usage: compare.py <base.json> <new.json> [--threshold <percent>]
+#
+# Print the change of the requests/sec and the p99 latency of each scenario,
+# and exit with 1 if any of them regresses more than the threshold
+# (default 10%).
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    results = {}
+    for r in data["results"]:
+        key = "%s (%dx%d)" % (r["scenario"], r["workers"], r["loops"])
+        results[key] = r
+    return data.get("label", ""), results
+
+
+def change(base, new):
+    if base == 0:
+        return 0.0
+    return (new - base) * 100.0 / base
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("base")
+    parser.add_argument("new")
+    parser.add_argument("--threshold", type=float, default=10.0)
+    args = parser.parse_args()
+
+    base_label, base = load(args.base)
+    new_label, new = load(args.new)
+
+    print("%-32s %12s %12s %8s %10s %10s %8s" %
+          ("scenario", "rps " + base_label[:7], "rps " + new_label[:7], "diff",
+           "p99(us)", "p99(us)", "diff"))
+
+    regressed = False
+    for key in sorted(base):
+        if key not in new:
+            continue
+        b, n = base[key], new[key]
+        rps_change = change(b["rps"], n["rps"])
+        p99_change = change(b["latency_us"]["p99"], n["latency_us"]["p99"])
+        flag = ""
+        if rps_change < -args.threshold or p99_change > args.threshold:
+            flag = "  <- regressed"
+            regressed = True
+        print("%-32s %12.1f %12.1f %+7.1f%% %10d %10d %+7.1f%%%s" %
+              (key, b["rps"], n["rps"], rps_change, b["latency_us"]["p99"],
+               n["latency_us"]["p99"], p99_change, flag))
+
+    return 1 if regressed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,468 @@
+// Microbenchmarks of the components running on every request, e.g., the
+// parsers, the router and the URL.
+//
+// Each benchmark reports the bytes processed per second and the heap
+// allocations per operation ("allocs_per_op"), counted by replacing the
+// global operator new.
+//
+// Usage (see https://github.com/google/benchmark for more options):
+//   webcc_micro_bench [--benchmark_filter=<regex>]
+//                     [--benchmark_format=<console|json|csv>]
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "webcc/base64.h"
+#include "webcc/common.h"
+#include "webcc/request.h"
+#include "webcc/request_parser.h"
+#include "webcc/response.h"
+#include "webcc/response_builder.h"
+#include "webcc/response_parser.h"
+#include "webcc/router.h"
+#include "webcc/url.h"
+
+#if WEBCC_ENABLE_GZIP
+#include "webcc/gzip.h"
+#endif
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+std::atomic<std::size_t> g_allocs{ 0 };
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  g_allocs.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+// Report the allocations per iteration of the benchmark loop, which should be
+// the only thing in the scope of the counter.
+class AllocCounter {
+public:
+  explicit AllocCounter(benchmark::State& state)
+      : state_(state), start_(g_allocs.load(std::memory_order_relaxed)) {
+  }
+
+  ~AllocCounter() {
+    auto allocs = g_allocs.load(std::memory_order_relaxed) - start_;
+    state_.counters["allocs_per_op"] = benchmark::Counter(
+        static_cast<double>(allocs), benchmark::Counter::kAvgIterations);
+  }
+
+private:
+  benchmark::State& state_;
+  std::size_t start_;
+};
+
+void SetBytesProcessed(benchmark::State& state, std::size_t bytes) {
+  state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) *
+                          static_cast<std::int64_t>(bytes));
+}
+
+// Text (e.g., JSON) of the given size to compress.
+std::string MakeText(std::size_t size) {
+  std::string text;
+  text.reserve(size + 64);
+  for (std::size_t i = 0; text.size() < size; ++i) {
+    text += "{\"id\":" + std::to_string(i) +
+            ",\"name\":\"item" + std::to_string(i % 97) +
+            "\",\"tags\":[\"a\",\"b\"]},";
+  }
+  text.resize(size);
+  return text;
+}
+
+class EmptyView : public webcc::View {
+public:
+  webcc::ResponsePtr Handle(webcc::RequestPtr /*request*/) override {
+    return webcc::ResponseBuilder{}.OK()();
+  }
+};
+
+// -----------------------------------------------------------------------------
+// Captures of the requests and the responses.
+
+// Chrome.
+const char kGetRequest[] =
+    "GET /api/v1/books?page=2&sort=title HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"86\", \"Google Chrome\";v=\"86\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) "
+    "AppleWebKit/537.36 (KHTML, like Gecko) Chrome/86.0.4240.111 "
+    "Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,"
+    "image/avif,image/webp,image/apng,*/*;q=0.8\r\n"
+    "Sec-Fetch-Site: none\r\n"
+    "Sec-Fetch-Mode: navigate\r\n"
+    "Sec-Fetch-User: ?1\r\n"
+    "Sec-Fetch-Dest: document\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: en-US,en;q=0.9\r\n"
+    "\r\n";
+
+std::string MakePostRequest() {
+  std::string body = MakeText(1024);
+  return "POST /api/v1/books HTTP/1.1\r\n"
+         "Host: localhost:8080\r\n"
+         "User-Agent: Webcc/0.3.0\r\n"
+         "Accept-Encoding: gzip, deflate\r\n"
+         "Accept: application/json\r\n"
+         "Connection: Keep-Alive\r\n"
+         "Content-Type: application/json; charset=utf-8\r\n"
+         "Content-Length: " + std::to_string(body.size()) + "\r\n"
+         "\r\n" + body;
+}
+
+std::string MakeResponse() {
+  std::string body = MakeText(4096);
+  return "HTTP/1.1 200 OK\r\n"
+         "Server: nginx/1.18.0\r\n"
+         "Date: Sat, 24 Oct 2020 08:00:00 GMT\r\n"
+         "Content-Type: application/json; charset=utf-8\r\n"
+         "Content-Length: " + std::to_string(body.size()) + "\r\n"
+         "Connection: keep-alive\r\n"
+         "Cache-Control: no-cache\r\n"
+         "X-Request-Id: 4bf92f3577b34da6a3ce929d0e0e4736\r\n"
+         "\r\n" + body;
+}
+
+std::string MakeChunkedResponse() {
+  std::string body = MakeText(4096);
+  std::string response =
+      "HTTP/1.1 200 OK\r\n"
+      "Server: nginx/1.18.0\r\n"
+      "Date: Sat, 24 Oct 2020 08:00:00 GMT\r\n"
+      "Content-Type: application/json; charset=utf-8\r\n"
+      "Transfer-Encoding: chunked\r\n"
+      "Connection: keep-alive\r\n"
+      "\r\n";
+
+  const std::size_t kChunkSize = 1024;
+  char size_line[16];
+  for (std::size_t i = 0; i < body.size(); i += kChunkSize) {
+    std::string chunk = body.substr(i, kChunkSize);
+    std::snprintf(size_line, sizeof(size_line), "%zx\r\n", chunk.size());
+    response += size_line + chunk + "\r\n";
+  }
+  response += "0\r\n\r\n";
+  return response;
+}
+
+// -----------------------------------------------------------------------------
+
+void ParseRequest(benchmark::State& state, const std::string& payload) {
+  webcc::ViewMatcher view_matcher = [](const std::string&, std::string_view,
+                                       bool* stream) {
+    *stream = false;
+    return true;
+  };
+
+  webcc::Request request;
+  webcc::RequestParser parser;
+
+  {
+    AllocCounter alloc_counter{ state };
+    for (auto _ : state) {
+      request.Clear();
+      parser.Init(&request, &view_matcher);
+      if (!parser.Parse(payload.data(), payload.size()) ||
+          !parser.finished()) {
+        state.SkipWithError("Failed to parse the request");
+        break;
+      }
+    }
+  }
+
+  SetBytesProcessed(state, payload.size());
+}
+
+void BM_RequestParser_Get(benchmark::State& state) {
+  ParseRequest(state, kGetRequest);
+}
+BENCHMARK(BM_RequestParser_Get);
+
+void BM_RequestParser_Post(benchmark::State& state) {
+  ParseRequest(state, MakePostRequest());
+}
+BENCHMARK(BM_RequestParser_Post);
+
+void ParseResponse(benchmark::State& state, const std::string& payload) {
+  webcc::Response response;
+  webcc::ResponseParser parser;
+
+  {
+    AllocCounter alloc_counter{ state };
+    for (auto _ : state) {
+      response.Clear();
+      parser.Init(&response);
+      if (!parser.Parse(payload.data(), payload.size()) ||
+          !parser.finished()) {
+        state.SkipWithError("Failed to parse the response");
+        break;
+      }
+    }
+  }
+
+  SetBytesProcessed(state, payload.size());
+}
+
+void BM_ResponseParser(benchmark::State& state) {
+  ParseResponse(state, MakeResponse());
+}
+BENCHMARK(BM_ResponseParser);
+
+void BM_ResponseParser_Chunked(benchmark::State& state) {
+  ParseResponse(state, MakeChunkedResponse());
+}
+BENCHMARK(BM_ResponseParser_Chunked);
+
+// -----------------------------------------------------------------------------
+
+// Route half of the URLs as regular expressions, and find the view of the
+// last one, which is the worst case.
+void BM_Router_FindView(benchmark::State& state) {
+  const auto routes = static_cast<int>(state.range(0));
+
+  webcc::Router router;
+  auto view = std::make_shared<EmptyView>();
+
+  for (int i = 0; i < routes; ++i) {
+    std::string url = "/api/v1/resource" + std::to_string(i);
+    if (i % 2 == 0) {
+      router.Route(url, view, { "GET", "POST" });
+    } else {
+      router.Route(webcc::R(url + "/(\\d+)"), view, { "GET", "POST" });
+    }
+  }
+
+  std::string url = "/api/v1/resource" + std::to_string(routes - 1);
+  if ((routes - 1) % 2 != 0) {
+    url += "/12345";
+  }
+
+  webcc::UrlArgs args;
+
+  {
+    AllocCounter alloc_counter{ state };
+    for (auto _ : state) {
+      args.clear();
+      auto found = router.FindView("GET", url, &args);
+      benchmark::DoNotOptimize(found);
+    }
+  }
+
+  SetBytesProcessed(state, url.size());
+}
+BENCHMARK(BM_Router_FindView)->Arg(10)->Arg(500);
+
+// -----------------------------------------------------------------------------
+
+void BM_Url_Parse(benchmark::State& state) {
+  const std::string str =
+      "https://api.example.com:8443/api/v1/books/12345?page=2&sort=title";
+
+  {
+    AllocCounter alloc_counter{ state };
+    for (auto _ : state) {
+      webcc::Url url{ str };
+      benchmark::DoNotOptimize(url);
+    }
+  }
+
+  SetBytesProcessed(state, str.size());
+}
+BENCHMARK(BM_Url_Parse);
+
+// Query strings of 8 parameters, and of 16 to use the hash index of
+// UrlQueryView (more than kMaxLinearSearch). Both end with the looked up ones.
+const std::string kQuery =
+    "q=hello%20world&page=2&sort=desc&filter=a%2Cb%2Cc&lang=en-US&"
+    "from=2020-01-01&to=2020-12-31&name=%E4%BD%A0%E5%A5%BD";
+const std::string kLongQuery =
+    "a=1&b=2&c=3&d=4&e=5&f=6&g=7&h=8&" + kQuery;
+
+void BM_UrlQuery_Decode(benchmark::State& state, const std::string& str) {
+  {
+    AllocCounter alloc_counter{ state };
+    for (auto _ : state) {
+      webcc::UrlQuery query{ str };
+      benchmark::DoNotOptimize(query.Get("lang"));
+      benchmark::DoNotOptimize(query.Get("name"));
+    }
+  }
+
+  SetBytesProcessed(state, str.size());
+}
+BENCHMARK_CAPTURE(BM_UrlQuery_Decode, 8, kQuery);
+BENCHMARK_CAPTURE(BM_UrlQuery_Decode, 16, kLongQuery);
+
+void BM_UrlQueryView_Get(benchmark::State& state, const std::string& str) {
+  webcc::UrlQueryView query;
+
+  {
+    AllocCounter alloc_counter{ state };
+    for (auto _ : state) {
+      query.Parse(str);
+      benchmark::DoNotOptimize(query.Get("lang"));
+      benchmark::DoNotOptimize(query.Get("name"));
+    }
+  }
+
+  SetBytesProcessed(state, str.size());
+}
+BENCHMARK_CAPTURE(BM_UrlQueryView_Get, 8, kQuery);
+BENCHMARK_CAPTURE(BM_UrlQueryView_Get, 16, kLongQuery);
+
+// -----------------------------------------------------------------------------
+
+void BM_Base64Encode(benchmark::State& state) {
+  const std::string input = MakeText(static_cast<std::size_t>(state.range(0)));
+
+  {
+    AllocCounter alloc_counter{ state };
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(webcc::Base64Encode(input));
+    }
+  }
+
+  SetBytesProcessed(state, input.size());
+}
+BENCHMARK(BM_Base64Encode)->Arg(64)->Arg(1024)->Arg(64 * 1024);
+
+void BM_Base64Decode(benchmark::State& state) {
+  const std::string input = webcc::Base64Encode(
+      MakeText(static_cast<std::size_t>(state.range(0))));
+
+  {
+    AllocCounter alloc_counter{ state };
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(webcc::Base64Decode(input));
+    }
+  }
+
+  SetBytesProcessed(state, input.size());
+}
+BENCHMARK(BM_Base64Decode)->Arg(64)->Arg(1024)->Arg(64 * 1024);
+
+// -----------------------------------------------------------------------------
+
+// Look up a header of the request captured from Chrome, existing or not.
+void HeadersGet(benchmark::State& state, const std::string& key) {
+  webcc::Request request;
+  webcc::RequestParser parser;
+  webcc::ViewMatcher view_matcher = [](const std::string&, std::string_view,
+                                       bool*) { return true; };
+  parser.Init(&request, &view_matcher);
+  parser.Parse(kGetRequest, sizeof(kGetRequest) - 1);
+
+  webcc::Headers headers;
+  for (std::size_t i = 0; i < request.headers().size(); ++i) {
+    auto& header = request.headers().Get(i);
+    headers.Set(header.first, header.second);
+  }
+
+  {
+    AllocCounter alloc_counter{ state };
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(headers.Get(key));
+    }
+  }
+
+  SetBytesProcessed(state, key.size());
+}
+
+void BM_Headers_Get(benchmark::State& state) {
+  HeadersGet(state, "accept-language");
+}
+BENCHMARK(BM_Headers_Get);
+
+void BM_Headers_Get_Missing(benchmark::State& state) {
+  HeadersGet(state, "Content-Length");
+}
+BENCHMARK(BM_Headers_Get_Missing);
+
+// -----------------------------------------------------------------------------
+
+#if WEBCC_ENABLE_GZIP
+
+void BM_Gzip_Compress(benchmark::State& state) {
+  const std::string input = MakeText(static_cast<std::size_t>(state.range(0)));
+  std::string output;
+
+  {
+    AllocCounter alloc_counter{ state };
+    for (auto _ : state) {
+      output.clear();
+      webcc::gzip::Compress(input, &output);
+    }
+  }
+
+  SetBytesProcessed(state, input.size());
+}
+BENCHMARK(BM_Gzip_Compress)->Arg(1024)->Arg(16 * 1024)->Arg(256 * 1024);
+
+void BM_Gzip_Decompress(benchmark::State& state) {
+  std::string input;
+  webcc::gzip::Compress(MakeText(static_cast<std::size_t>(state.range(0))),
+                        &input);
+  std::string output;
+
+  {
+    AllocCounter alloc_counter{ state };
+    for (auto _ : state) {
+      output.clear();
+      webcc::gzip::Decompress(input, &output);
+    }
+  }
+
+  // The bytes of the decompressed data.
+  SetBytesProcessed(state, static_cast<std::size_t>(state.range(0)));
+}
+BENCHMARK(BM_Gzip_Decompress)->Arg(1024)->Arg(16 * 1024)->Arg(256 * 1024);
+
+#endif  // WEBCC_ENABLE_GZIP
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,513 @@
+// Throughput and latency benchmark of the server over loopback.
+//
+// A server is run in process for each workers/loops setting, and loaded by
+// a number of client connections (one thread each) for each scenario, e.g.,
+// small responses over keep-alive connections, large responses, static files
+// and multipart uploads. The results are printed as JSON, so that the runs of
+// different commits could be compared, e.g., by bench/compare.py.
+//
+// Usage:
+//   webcc_server_bench [--duration <seconds>] [--connections <n>]
+//                      [--settings <workers>x<loops>,...] [--filter <text>]
+//                      [--port <port>] [--label <text>] [--output <file>]
+// E.g.,
+//   webcc_server_bench --settings 1x1,4x2 --label $(git rev-parse --short HEAD)
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asio/connect.hpp"
+#include "asio/io_context.hpp"
+#include "asio/ip/tcp.hpp"
+#include "asio/read.hpp"
+#include "asio/write.hpp"
+
+#include "webcc/metrics.h"
+#include "webcc/response_builder.h"
+#include "webcc/server.h"
+
+using asio::ip::tcp;
+
+namespace sfs = std::filesystem;
+
+// -----------------------------------------------------------------------------
+
+const std::size_t kLargeSize = 64 * 1024;
+const std::size_t kUploadSize = 16 * 1024;
+
+const char kBoundary[] = "----WebccBenchBoundary";
+
+// Timeout (in seconds) of reading a response.
+const int kReadTimeout = 5;
+
+class SmallView : public webcc::View {
+public:
+  webcc::ResponsePtr Handle(webcc::RequestPtr request) override {
+    return webcc::ResponseBuilder{ request }.OK().Body("Hello, World!")();
+  }
+};
+
+class LargeView : public webcc::View {
+public:
+  webcc::ResponsePtr Handle(webcc::RequestPtr request) override {
+    return webcc::ResponseBuilder{ request }.OK().Body(
+        std::string(kLargeSize, 'x'))();
+  }
+};
+
+class UploadView : public webcc::View {
+public:
+  webcc::ResponsePtr Handle(webcc::RequestPtr request) override {
+    std::size_t size = 0;
+    for (auto& part : request->form_parts()) {
+      size += part->data().size();
+    }
+    return webcc::ResponseBuilder{ request }.Created().Body(
+        std::to_string(size))();
+  }
+};
+
+// -----------------------------------------------------------------------------
+
+struct Options {
+  int duration = 2;
+  int connections = 8;
+  std::vector<std::pair<std::size_t, std::size_t>> settings = {
+    { 1, 1 }, { 4, 1 }, { 4, 2 }
+  };
+  std::string filter;
+  std::uint16_t port = 28080;
+  std::string label;
+  std::string output;
+};
+
+struct Scenario {
+  const char* name;
+  std::string request;
+  bool keep_alive;
+};
+
+struct Result {
+  std::string scenario;
+  std::size_t workers;
+  std::size_t loops;
+  double seconds;
+  std::uint64_t requests;
+  std::uint64_t errors;
+  std::uint64_t bytes;
+  const webcc::Histogram* latency;
+};
+
+std::string MakeRequest(const std::string& method, const std::string& target,
+                        bool keep_alive, const std::string& content_type = "",
+                        const std::string& body = "") {
+  std::string request = method + " " + target + " HTTP/1.1\r\n";
+  request += "Host: localhost\r\n";
+  request += keep_alive ? "Connection: Keep-Alive\r\n"
+                        : "Connection: Close\r\n";
+  if (!content_type.empty()) {
+    request += "Content-Type: " + content_type + "\r\n";
+  }
+  if (!body.empty()) {
+    request += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+  }
+  request += "\r\n";
+  request += body;
+  return request;
+}
+
+std::string MakeUploadBody() {
+  std::string body = "--";
+  body += kBoundary;
+  body += "\r\nContent-Disposition: form-data; name=\"file\"; "
+          "filename=\"data.bin\"\r\n"
+          "Content-Type: application/octet-stream\r\n\r\n";
+  body += std::string(kUploadSize, 'u');
+  body += "\r\n--";
+  body += kBoundary;
+  body += "--\r\n";
+  return body;
+}
+
+std::vector<Scenario> MakeScenarios() {
+  std::vector<Scenario> scenarios;
+
+  for (bool keep_alive : { true, false }) {
+    scenarios.push_back({ "small", MakeRequest("GET", "/small", keep_alive),
+                          keep_alive });
+    scenarios.push_back({ "large", MakeRequest("GET", "/large", keep_alive),
+                          keep_alive });
+    scenarios.push_back({ "static",
+                          MakeRequest("GET", "/static.bin", keep_alive),
+                          keep_alive });
+    scenarios.push_back({ "upload",
+                          MakeRequest("POST", "/upload", keep_alive,
+                                      std::string("multipart/form-data; "
+                                                  "boundary=") + kBoundary,
+                                      MakeUploadBody()),
+                          keep_alive });
+  }
+
+  return scenarios;
+}
+
+std::string ScenarioName(const Scenario& scenario) {
+  return std::string(scenario.name) +
+         (scenario.keep_alive ? "_keepalive" : "_close");
+}
+
+// -----------------------------------------------------------------------------
+
+// Read a response with Content-Length into |buffer|.
+// Return the size of the response, or 0 on error (including a status other
+// than 2xx).
+std::size_t ReadResponse(tcp::socket& socket, std::string* buffer) {
+  buffer->clear();
+
+  char data[16 * 1024];
+  std::size_t header_size = 0;
+  std::size_t content_length = 0;
+
+  while (true) {
+    std::error_code ec;
+    std::size_t length = socket.read_some(asio::buffer(data), ec);
+    if (ec || length == 0) {
+      return 0;
+    }
+    buffer->append(data, length);
+
+    if (header_size == 0) {
+      std::size_t pos = buffer->find("\r\n\r\n");
+      if (pos == std::string::npos) {
+        continue;
+      }
+      header_size = pos + 4;
+
+      // E.g., "HTTP/1.1 200 OK"
+      if (buffer->compare(0, 9, "HTTP/1.1 ") != 0 || (*buffer)[9] != '2') {
+        return 0;
+      }
+
+      std::string headers = buffer->substr(0, header_size);
+      for (char& c : headers) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+      }
+
+      std::size_t p = headers.find("\r\ncontent-length:");
+      if (p == std::string::npos) {
+        return 0;
+      }
+      content_length = std::strtoul(headers.c_str() + p + 17, nullptr, 10);
+    }
+
+    if (buffer->size() >= header_size + content_length) {
+      return header_size + content_length;
+    }
+  }
+}
+
+// Set the timeout of the blocking reads, so that a connection never hangs
+// even if the server doesn't respond.
+void SetReadTimeout(tcp::socket& socket, int seconds) {
+#if (defined(_WIN32) || defined(_WIN64))
+  DWORD timeout = seconds * 1000;
+  setsockopt(socket.native_handle(), SOL_SOCKET, SO_RCVTIMEO,
+             reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+#else
+  timeval timeout{ seconds, 0 };
+  setsockopt(socket.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout,
+             sizeof(timeout));
+#endif  // defined(_WIN32) || defined(_WIN64)
+}
+
+// Send the requests of a scenario on a connection until |stop|.
+void RunConnection(const Scenario& scenario, std::uint16_t port,
+                   const std::atomic<bool>& stop, webcc::Histogram* latency,
+                   std::atomic<std::uint64_t>* errors,
+                   std::atomic<std::uint64_t>* bytes) {
+  asio::io_context io_context;
+  tcp::endpoint endpoint{ asio::ip::address_v4::loopback(), port };
+  tcp::socket socket{ io_context };
+
+  std::string buffer;
+  std::uint64_t local_bytes = 0;
+
+  while (!stop.load(std::memory_order_relaxed)) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::error_code ec;
+    if (!socket.is_open()) {
+      socket.connect(endpoint, ec);
+      if (ec) {
+        socket.close(ec);
+        errors->fetch_add(1);
+        continue;
+      }
+      socket.set_option(tcp::no_delay(true));
+      SetReadTimeout(socket, kReadTimeout);
+    }
+
+    asio::write(socket, asio::buffer(scenario.request), ec);
+
+    std::size_t size = ec ? 0 : ReadResponse(socket, &buffer);
+    if (size == 0) {
+      socket.close(ec);
+      errors->fetch_add(1);
+      continue;
+    }
+
+    latency->Record(std::chrono::steady_clock::now() - start);
+    local_bytes += size;
+
+    if (!scenario.keep_alive) {
+      socket.close(ec);
+    }
+  }
+
+  bytes->fetch_add(local_bytes);
+}
+
+// Wait until the server accepts connections.
+bool WaitServer(std::uint16_t port) {
+  asio::io_context io_context;
+  tcp::endpoint endpoint{ asio::ip::address_v4::loopback(), port };
+
+  for (int i = 0; i < 100; ++i) {
+    tcp::socket socket{ io_context };
+    std::error_code ec;
+    socket.connect(endpoint, ec);
+    if (!ec) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  return false;
+}
+
+Result RunScenario(const Scenario& scenario, const Options& options,
+                   webcc::Histogram* latency) {
+  std::atomic<bool> stop{ false };
+  std::atomic<std::uint64_t> errors{ 0 };
+  std::atomic<std::uint64_t> bytes{ 0 };
+
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < options.connections; ++i) {
+    threads.emplace_back(RunConnection, std::cref(scenario), options.port,
+                         std::cref(stop), latency, &errors, &bytes);
+  }
+
+  std::this_thread::sleep_for(std::chrono::seconds(options.duration));
+  stop = true;
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::chrono::duration<double> seconds =
+      std::chrono::steady_clock::now() - start;
+
+  Result result;
+  result.scenario = ScenarioName(scenario);
+  result.seconds = seconds.count();
+  result.requests = latency->Count();
+  result.errors = errors;
+  result.bytes = bytes;
+  result.latency = latency;
+  return result;
+}
+
+// -----------------------------------------------------------------------------
+
+std::string ToJson(const Options& options, const std::vector<Result>& results) {
+  std::string json = "{\n";
+
+  char buf[512];
+
+  std::snprintf(buf, sizeof(buf),
+                "  \"label\": \"%s\",\n"
+                "  \"timestamp\": %lld,\n"
+                "  \"hardware_concurrency\": %u,\n"
+                "  \"duration\": %d,\n"
+                "  \"connections\": %d,\n"
+                "  \"results\": [\n",
+                options.label.c_str(),
+                static_cast<long long>(std::time(nullptr)),
+                std::thread::hardware_concurrency(), options.duration,
+                options.connections);
+  json += buf;
+
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    const webcc::Histogram& h = *r.latency;
+
+    std::snprintf(
+        buf, sizeof(buf),
+        "    {\"scenario\": \"%s\", \"workers\": %zu, \"loops\": %zu, "
+        "\"requests\": %llu, \"errors\": %llu, \"rps\": %.1f, "
+        "\"mb_per_sec\": %.2f, \"latency_us\": {\"mean\": %.1f, "
+        "\"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"p999\": %llu, "
+        "\"max\": %llu}}%s\n",
+        r.scenario.c_str(), r.workers, r.loops,
+        static_cast<unsigned long long>(r.requests),
+        static_cast<unsigned long long>(r.errors), r.requests / r.seconds,
+        r.bytes / r.seconds / (1024 * 1024),
+        r.requests == 0 ? 0.0 : static_cast<double>(h.Sum()) / r.requests,
+        static_cast<unsigned long long>(h.Percentile(50)),
+        static_cast<unsigned long long>(h.Percentile(90)),
+        static_cast<unsigned long long>(h.Percentile(99)),
+        static_cast<unsigned long long>(h.Percentile(99.9)),
+        static_cast<unsigned long long>(h.Percentile(100)),
+        i + 1 < results.size() ? "," : "");
+    json += buf;
+  }
+
+  json += "  ]\n}\n";
+  return json;
+}
+
+bool ParseSettings(const std::string& str, Options* options) {
+  options->settings.clear();
+
+  std::size_t pos = 0;
+  while (pos < str.size()) {
+    std::size_t end = str.find(',', pos);
+    if (end == std::string::npos) {
+      end = str.size();
+    }
+
+    unsigned long workers = 0;
+    unsigned long loops = 0;
+    std::string setting = str.substr(pos, end - pos);
+    if (std::sscanf(setting.c_str(), "%lux%lu", &workers, &loops) != 2 ||
+        workers == 0 || loops == 0) {
+      return false;
+    }
+    options->settings.emplace_back(workers, loops);
+
+    pos = end + 1;
+  }
+
+  return !options->settings.empty();
+}
+
+bool ParseOptions(int argc, char* argv[], Options* options) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string name = argv[i];
+    std::string value = argv[i + 1];
+
+    if (name == "--duration") {
+      options->duration = std::atoi(value.c_str());
+    } else if (name == "--connections") {
+      options->connections = std::atoi(value.c_str());
+    } else if (name == "--settings") {
+      if (!ParseSettings(value, options)) {
+        return false;
+      }
+    } else if (name == "--filter") {
+      options->filter = value;
+    } else if (name == "--port") {
+      options->port = static_cast<std::uint16_t>(std::atoi(value.c_str()));
+    } else if (name == "--label") {
+      options->label = value;
+    } else if (name == "--output") {
+      options->output = value;
+    } else {
+      return false;
+    }
+  }
+
+  return argc % 2 == 1 && options->duration > 0 && options->connections > 0;
+}
+
+void Help() {
+  std::cout << "Usage: webcc_server_bench [--duration <seconds>] "
+               "[--connections <n>]" << std::endl
+            << "                          [--settings <workers>x<loops>,...] "
+               "[--filter <text>]" << std::endl
+            << "                          [--port <port>] [--label <text>] "
+               "[--output <file>]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    Help();
+    return 1;
+  }
+
+  // The static file to serve.
+  sfs::path doc_root = sfs::temp_directory_path() / "webcc_bench";
+  sfs::create_directories(doc_root);
+  {
+    std::ofstream ofs{ doc_root / "static.bin", std::ios::binary };
+    ofs << std::string(kLargeSize, 's');
+  }
+
+  std::vector<Scenario> scenarios = MakeScenarios();
+
+  // The histograms live as long as the results.
+  std::vector<std::unique_ptr<webcc::Histogram>> histograms;
+  std::vector<Result> results;
+
+  for (auto& setting : options.settings) {
+    webcc::Server server{ options.port, doc_root };
+    server.Route("/small", std::make_shared<SmallView>());
+    server.Route("/large", std::make_shared<LargeView>());
+    server.Route("/upload", std::make_shared<UploadView>(), { "POST" });
+
+    std::thread server_thread{ [&server, &setting]() {
+      server.Run(setting.first, setting.second);
+    } };
+
+    if (!WaitServer(options.port)) {
+      std::cerr << "Failed to start the server." << std::endl;
+      server.Stop();
+      server_thread.join();
+      return 1;
+    }
+
+    for (auto& scenario : scenarios) {
+      if (ScenarioName(scenario).find(options.filter) == std::string::npos) {
+        continue;
+      }
+
+      std::cerr << ScenarioName(scenario) << " (" << setting.first << "x"
+                << setting.second << ")..." << std::endl;
+
+      histograms.emplace_back(new webcc::Histogram);
+      Result result = RunScenario(scenario, options, histograms.back().get());
+      result.workers = setting.first;
+      result.loops = setting.second;
+      results.push_back(result);
+    }
+
+    server.Stop();
+    server_thread.join();
+  }
+
+  std::error_code ec;
+  sfs::remove_all(doc_root, ec);
+
+  std::string json = ToJson(options, results);
+
+  if (options.output.empty()) {
+    std::cout << json;
+  } else {
+    std::ofstream ofs{ options.output };
+    ofs << json;
+  }
+
+  return 0;
+}
@@ -0,0 +1,50 @@
+#include <iostream>
+
+#include "webcc/logger.h"
+#include "webcc/server.h"
+#include "webcc/websocket.h"
+
+// A chat room: every message received is broadcast to all the clients.
+class ChatView : public webcc::WebSocketView {
+protected:
+  void OnOpen(webcc::WebSocketConnectionPtr connection) override {
+    Broadcast(connection->request()->ip() + " joined");
+  }
+
+  void OnMessage(webcc::WebSocketConnectionPtr /*connection*/,
+                 std::string&& message, bool binary) override {
+    Broadcast(message, binary);
+  }
+
+  void OnClose(webcc::WebSocketConnectionPtr connection,
+               std::uint16_t /*code*/) override {
+    Broadcast(connection->request()->ip() + " left");
+  }
+};
+
+int main(int argc, const char* argv[]) {
+  if (argc < 2) {
+    std::cout << "usage: websocket_server <port>" << std::endl;
+    std::cout << "  E.g.," << std::endl;
+    std::cout << "    $ websocket_server 8080" << std::endl;
+    return 1;
+  }
+
+  WEBCC_LOG_INIT("", webcc::LOG_CONSOLE);
+
+  std::uint16_t port = static_cast<std::uint16_t>(std::atoi(argv[1]));
+
+  try {
+    webcc::Server server(port);
+
+    server.Route("/chat", std::make_shared<ChatView>());
+
+    server.Run();
+
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
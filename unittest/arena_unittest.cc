@@ -0,0 +1,63 @@
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+#include "webcc/arena.h"
+
+using namespace webcc;
+
+namespace {
+
+struct Object {
+  explicit Object(const std::string& data) : data(data) {
+  }
+
+  std::string data;
+};
+
+}  // namespace
+
+TEST(ArenaTest, MakeShared) {
+  auto arena = std::make_shared<Arena>();
+  std::weak_ptr<Arena> weak_arena = arena;
+
+  auto object1 = MakeShared<Object>(arena, "hello");
+  auto object2 = MakeShared<Object>(arena, "world");
+
+  EXPECT_EQ("hello", object1->data);
+  EXPECT_EQ("world", object2->data);
+
+  // Allocated from the inline buffer of the arena.
+  auto begin = reinterpret_cast<const char*>(arena.get());
+  auto end = begin + sizeof(Arena);
+  auto p = reinterpret_cast<const char*>(object2.get());
+  EXPECT_TRUE(p > begin && p < end);
+
+  // The arena lives as long as any object allocated from it.
+  arena.reset();
+  object1.reset();
+  EXPECT_FALSE(weak_arena.expired());
+
+  object2.reset();
+  EXPECT_TRUE(weak_arena.expired());
+}
+
+TEST(ArenaTest, Overflow) {
+  auto arena = std::make_shared<Arena>();
+
+  // Beyond the inline buffer.
+  std::vector<std::shared_ptr<Object>> objects;
+  for (std::size_t i = 0; i < kArenaSize / sizeof(Object) * 2; ++i) {
+    objects.push_back(MakeShared<Object>(arena, std::to_string(i)));
+  }
+
+  for (std::size_t i = 0; i < objects.size(); ++i) {
+    EXPECT_EQ(std::to_string(i), objects[i]->data);
+  }
+}
+
+TEST(ArenaTest, MakeShared_NoArena) {
+  auto object = MakeShared<Object>(ArenaPtr{}, "hello");
+  EXPECT_EQ("hello", object->data);
+}
@@ -0,0 +1,72 @@
+#include "gtest/gtest.h"
+
+#include <thread>
+
+#include "webcc/concurrency_limiter.h"
+
+using namespace webcc;
+using namespace std::chrono_literals;
+
+TEST(ConcurrencyLimiterTest, Unlimited) {
+  ConcurrencyLimiter limiter;
+  limiter.Reset(1, 0, 0ms);
+
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_TRUE(limiter.Acquire());
+  }
+  EXPECT_EQ(0, limiter.limit());
+  EXPECT_EQ(1000, limiter.in_flight());
+}
+
+TEST(ConcurrencyLimiterTest, FixedLimit) {
+  ConcurrencyLimiter limiter;
+  limiter.Reset(1, 3, 0ms);
+
+  EXPECT_TRUE(limiter.Acquire());
+  EXPECT_TRUE(limiter.Acquire());
+  EXPECT_TRUE(limiter.Acquire());
+  EXPECT_FALSE(limiter.Acquire());
+
+  // A fixed limit never changes no matter how long the requests wait.
+  limiter.Release(10s);
+  EXPECT_EQ(3, limiter.limit());
+  EXPECT_TRUE(limiter.Acquire());
+  EXPECT_FALSE(limiter.Acquire());
+}
+
+TEST(ConcurrencyLimiterTest, Adaptive) {
+  ConcurrencyLimiter limiter;
+  limiter.Reset(2, 20, 10ms);
+
+  EXPECT_EQ(20, limiter.limit());
+
+  // Decreased multiplicatively on a slow request, but at most once per target
+  // wait time.
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_TRUE(limiter.Acquire());
+  }
+  limiter.Release(50ms);
+  EXPECT_EQ(18, limiter.limit());
+  limiter.Release(50ms);
+  EXPECT_EQ(18, limiter.limit());
+
+  // Never below the min limit.
+  while (limiter.limit() > 2) {
+    std::this_thread::sleep_for(10ms);
+    limiter.Acquire();
+    limiter.Release(50ms);
+  }
+  EXPECT_EQ(2, limiter.limit());
+
+  // Increased additively when the requests are dequeued in time, up to the
+  // max limit.
+  while (limiter.in_flight() > 0) {
+    limiter.Release(0ms);
+  }
+  for (int i = 0; i < 1000; ++i) {
+    while (limiter.Acquire()) {
+    }
+    limiter.Release(1ms);
+  }
+  EXPECT_EQ(20, limiter.limit());
+}
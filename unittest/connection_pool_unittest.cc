@@ -0,0 +1,74 @@
+#include "gtest/gtest.h"
+
+#include "asio/io_context.hpp"
+
+#include "webcc/connection_pool.h"
+
+using namespace webcc;
+
+namespace {
+
+bool MatchNothing(const std::string& /*method*/, std::string_view /*url*/,
+                  bool* /*stream*/) {
+  return false;
+}
+
+}  // namespace
+
+TEST(ConnectionPoolTest, Recycle) {
+  asio::io_context io_context;
+  Queue<ConnectionPtr> queue;
+  ViewMatcher view_matcher = MatchNothing;
+
+  ConnectionPool pool;
+
+  auto c = pool.NewConnection(asio::ip::tcp::socket{ io_context }, &queue,
+                              &view_matcher);
+  Connection* p = c.get();
+  EXPECT_EQ(0, pool.GetFreeCount());
+
+  // Recycled once no one refers to it.
+  c.reset();
+  EXPECT_EQ(1, pool.GetFreeCount());
+
+  // Reused for the next socket.
+  c = pool.NewConnection(asio::ip::tcp::socket{ io_context }, &queue,
+                         &view_matcher);
+  EXPECT_EQ(p, c.get());
+  EXPECT_EQ(0, pool.GetFreeCount());
+  EXPECT_EQ(0, pool.Size());
+}
+
+TEST(ConnectionPoolTest, CloseUnregistered) {
+  asio::io_context io_context;
+  Queue<ConnectionPtr> queue;
+  ViewMatcher view_matcher = MatchNothing;
+
+  ConnectionPool pool;
+
+  auto c = pool.NewConnection(asio::ip::tcp::socket{ io_context }, &queue,
+                              &view_matcher);
+
+  // Not started, nothing to remove from the registry.
+  pool.Close(c);
+  EXPECT_EQ(0, pool.Size());
+}
+
+// The connections left in the free list are deleted with the pool, and the
+// ones still referred are deleted directly once released.
+TEST(ConnectionPoolTest, OutlivePool) {
+  asio::io_context io_context;
+  Queue<ConnectionPtr> queue;
+  ViewMatcher view_matcher = MatchNothing;
+
+  ConnectionPtr c;
+  {
+    ConnectionPool pool;
+    c = pool.NewConnection(asio::ip::tcp::socket{ io_context }, &queue,
+                           &view_matcher);
+    pool.NewConnection(asio::ip::tcp::socket{ io_context }, &queue,
+                       &view_matcher);
+    EXPECT_EQ(1, pool.GetFreeCount());
+  }
+  c.reset();
+}
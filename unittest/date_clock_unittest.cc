@@ -0,0 +1,53 @@
+#include "gtest/gtest.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "webcc/date_clock.h"
+
+using namespace webcc;
+
+TEST(DateClockTest, Format) {
+  char date[DateClock::kSize];
+
+  DateClock::Format(1445412480, date);
+  EXPECT_EQ("Wed, 21 Oct 2015 07:28:00 GMT",
+            std::string(date, DateClock::kSize));
+
+  DateClock::Format(0, date);
+  EXPECT_EQ("Thu, 01 Jan 1970 00:00:00 GMT",
+            std::string(date, DateClock::kSize));
+}
+
+TEST(DateClockTest, Now) {
+  std::string date = DateClock::Instance().Now();
+  EXPECT_EQ(DateClock::kSize, date.size());
+  EXPECT_EQ(" GMT", date.substr(DateClock::kSize - 4));
+}
+
+// The readers never see a torn date while the clock is being updated.
+TEST(DateClockTest, Threads) {
+  std::vector<std::thread> threads;
+  std::vector<int> errors(4, 0);
+
+  for (std::size_t i = 0; i < errors.size(); ++i) {
+    threads.emplace_back([&errors, i]() {
+      for (int n = 0; n < 10000; ++n) {
+        std::string date = DateClock::Instance().Now();
+        if (date.size() != DateClock::kSize || date[3] != ',' ||
+            date.substr(DateClock::kSize - 4) != " GMT") {
+          ++errors[i];
+        }
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (int error : errors) {
+    EXPECT_EQ(0, error);
+  }
+}
@@ -0,0 +1,157 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "webcc/event_stream.h"
+#include "webcc/response_builder.h"
+
+#include "loopback.h"
+
+using namespace webcc;
+using namespace std::chrono_literals;
+
+static std::string TakeData(StreamBody* body) {
+  std::string data;
+  for (auto& buffer : body->NextPayload()) {
+    data.append(static_cast<const char*>(buffer.data()), buffer.size());
+  }
+  return data;
+}
+
+TEST(EventStreamTest, Send) {
+  EventStream stream;
+
+  EXPECT_TRUE(stream.Send("hello"));
+  EXPECT_EQ("data: hello\n\n", TakeData(&stream));
+
+  EXPECT_TRUE(stream.Send("line1\nline2", "update", "42"));
+  EXPECT_EQ("event: update\nid: 42\ndata: line1\ndata: line2\n\n",
+            TakeData(&stream));
+
+  EXPECT_TRUE(stream.SendRetry(3000));
+  EXPECT_TRUE(stream.SendComment("ping"));
+  EXPECT_EQ("retry: 3000\n\n: ping\n\n", TakeData(&stream));
+
+  // Nothing more for now.
+  EXPECT_EQ("", TakeData(&stream));
+  EXPECT_FALSE(stream.ended());
+}
+
+TEST(EventStreamTest, Send_LineTerminators) {
+  EventStream stream;
+
+  EXPECT_TRUE(stream.Send("a\r\nb\rc\n\nd"));
+  EXPECT_EQ("data: a\ndata: b\ndata: c\ndata: \ndata: d\n\n",
+            TakeData(&stream));
+
+  EXPECT_TRUE(stream.Send("a\r"));
+  EXPECT_EQ("data: a\ndata: \n\n", TakeData(&stream));
+
+  // No extra fields or events injected.
+  EXPECT_TRUE(stream.Send("x", "update\n\ndata: evil", "42\r\nretry: 1"));
+  EXPECT_EQ("event: updatedata: evil\nid: 42retry: 1\ndata: x\n\n",
+            TakeData(&stream));
+
+  EXPECT_TRUE(stream.SendComment("ping\n\ndata: evil"));
+  EXPECT_EQ(": pingdata: evil\n\n", TakeData(&stream));
+}
+
+TEST(EventStreamTest, Close) {
+  EventStream stream;
+
+  int notified = 0;
+  stream.set_notifier([&notified]() { ++notified; });
+
+  EXPECT_TRUE(stream.Send("a"));
+  stream.Close();
+  EXPECT_EQ(2, notified);
+
+  // No more data after closed, but the data written is still available.
+  EXPECT_FALSE(stream.Send("b"));
+  EXPECT_TRUE(stream.closed());
+  EXPECT_FALSE(stream.ended());
+
+  EXPECT_EQ("data: a\n\n", TakeData(&stream));
+  EXPECT_TRUE(stream.ended());
+}
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+// Respond with an event stream of 1 second heartbeat, and hand it over to the
+// test for sending the events.
+class EventsView : public View {
+public:
+  ResponsePtr Handle(RequestPtr request) override {
+    auto stream = std::make_shared<EventStream>(1);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stream_ = stream;
+    }
+    cv_.notify_all();
+    return ResponseBuilder{ request }.OK().EventStream(stream)();
+  }
+
+  EventStreamPtr WaitStream() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait_for(lock, 5s, [this] { return stream_ != nullptr; });
+    return stream_;
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  EventStreamPtr stream_;
+};
+
+}  // namespace
+
+TEST(EventStreamTest, Loopback) {
+  auto view = std::make_shared<EventsView>();
+
+  loopback::TestServer server;
+  server.server().Route("/events", view);
+  ASSERT_TRUE(server.Start());
+
+  loopback::TestClient client;
+  ASSERT_TRUE(client.Connect(server.port()));
+  ASSERT_TRUE(client.Write("GET /events HTTP/1.1\r\n"
+                           "Host: localhost\r\n\r\n"));
+
+  auto stream = view->WaitStream();
+  ASSERT_TRUE(stream);
+
+  std::string data;
+  ASSERT_TRUE(client.ReadUntil("\r\n\r\n", 5s, &data));
+  EXPECT_EQ(0, data.compare(0, 12, "HTTP/1.1 200")) << data;
+  EXPECT_NE(std::string::npos, data.find("text/event-stream"));
+  EXPECT_NE(std::string::npos, data.find("Cache-Control: no-cache\r\n"));
+  data.erase(0, data.find("\r\n\r\n") + 4);
+
+  // Each event is received as soon as it's sent.
+  EXPECT_TRUE(stream->Send("hello", "greeting", "1"));
+  ASSERT_TRUE(client.ReadUntil("\n\n", 5s, &data));
+  EXPECT_EQ("event: greeting\nid: 1\ndata: hello\n\n", data);
+  data.clear();
+
+  EXPECT_TRUE(stream->Send("line1\nline2"));
+  ASSERT_TRUE(client.ReadUntil("\n\n", 5s, &data));
+  EXPECT_EQ("data: line1\ndata: line2\n\n", data);
+  data.clear();
+
+  // A heartbeat once idle for a second.
+  ASSERT_TRUE(client.ReadUntil("\n\n", 5s, &data));
+  EXPECT_EQ(":\n\n", data);
+  data.clear();
+
+  // The connection is closed at the end of the stream.
+  EXPECT_TRUE(stream->Send("bye"));
+  stream->Close();
+  EXPECT_TRUE(client.ReadUntilClosed(5s, &data));
+  EXPECT_EQ("data: bye\n\n", data);
+}
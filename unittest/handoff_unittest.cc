@@ -0,0 +1,120 @@
+#include "gtest/gtest.h"
+
+#if defined(__linux__)
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "webcc/handoff.h"
+
+#include "loopback.h"
+
+using namespace webcc;
+
+TEST(HandoffTest, SendReceiveFd) {
+  int sockets[2];
+  ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+
+  int pipe_fds[2];
+  ASSERT_EQ(0, ::pipe(pipe_fds));
+
+  // Pass the write end of the pipe.
+  EXPECT_TRUE(handoff::SendFd(sockets[0], pipe_fds[1]));
+
+  int fd = handoff::ReceiveFd(sockets[1]);
+  ASSERT_GE(fd, 0);
+  EXPECT_NE(pipe_fds[1], fd);
+
+  // The received fd refers to the same pipe.
+  EXPECT_EQ(5, ::write(fd, "hello", 5));
+
+  char buf[5];
+  EXPECT_EQ(5, ::read(pipe_fds[0], buf, 5));
+  EXPECT_EQ("hello", std::string(buf, 5));
+
+  ::close(fd);
+  ::close(pipe_fds[0]);
+  ::close(pipe_fds[1]);
+  ::close(sockets[0]);
+  ::close(sockets[1]);
+}
+
+TEST(HandoffTest, TakeOver_NoServer) {
+  EXPECT_EQ(-1, handoff::TakeOver("/tmp/webcc_handoff_unittest_none.sock"));
+}
+
+// A new server takes over the listening socket of the running one on the same
+// path. The requests sent in a loop meanwhile all succeed on the same port, and
+// the old server stops.
+TEST(HandoffTest, Server) {
+  std::string path = (std::filesystem::temp_directory_path() /
+                      "webcc_handoff_unittest.sock").string();
+  ::unlink(path.c_str());
+
+  loopback::TestServer old_server;
+  old_server.server().Route("/hello", std::make_shared<loopback::HelloView>());
+  old_server.server().set_handoff_path(path);
+  old_server.server().set_drain_timeout(5);
+  ASSERT_TRUE(old_server.Start());
+
+  std::uint16_t port = old_server.port();
+
+  std::atomic<bool> stop{ false };
+  std::atomic<int> succeeded{ 0 };
+  std::atomic<int> failed{ 0 };
+
+  std::thread client_thread{ [&] {
+    while (!stop) {
+      std::string response = loopback::Get(port, "/hello");
+      if (response.compare(0, 12, "HTTP/1.1 200") == 0 &&
+          response.find("Hello") != std::string::npos) {
+        ++succeeded;
+      } else {
+        ++failed;
+      }
+    }
+  } };
+
+  // Let some requests go to the old server.
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  loopback::TestServer new_server;
+  new_server.server().Route("/hello", std::make_shared<loopback::HelloView>());
+  new_server.server().set_handoff_path(path);
+  bool started = new_server.Start();
+
+  // The old server stops by itself once the socket has been handed off.
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (old_server.server().IsRunning() &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  bool old_stopped = !old_server.server().IsRunning();
+
+  int succeeded_before = succeeded;
+
+  // Requests keep going to the new server.
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  stop = true;
+  client_thread.join();
+
+  old_server.Stop();
+  new_server.Stop();
+
+  ASSERT_TRUE(started);
+  EXPECT_EQ(port, new_server.port());
+  EXPECT_TRUE(old_stopped);
+  EXPECT_EQ(0, failed);
+  EXPECT_GT(succeeded_before, 0);
+  EXPECT_GT(succeeded, succeeded_before);
+}
+
+#endif  // defined(__linux__)
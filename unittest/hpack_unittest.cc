@@ -0,0 +1,211 @@
+#include "gtest/gtest.h"
+
+#include "webcc/hpack.h"
+
+// Examples from RFC 7541 Appendix C.
+
+static std::string FromHex(const std::string& hex) {
+  std::string bytes;
+  for (std::size_t i = 0; i + 1 < hex.size(); i += 2) {
+    bytes.push_back(static_cast<char>(std::stoi(hex.substr(i, 2), 0, 16)));
+  }
+  return bytes;
+}
+
+// -----------------------------------------------------------------------------
+
+TEST(HpackTest, EncodeInteger) {
+  std::string output;
+
+  // C.1.1: Encoding 10 using a 5-bit prefix.
+  webcc::hpack::EncodeInteger(10, 5, 0, &output);
+  EXPECT_EQ(FromHex("0a"), output);
+
+  // C.1.2: Encoding 1337 using a 5-bit prefix.
+  output.clear();
+  webcc::hpack::EncodeInteger(1337, 5, 0, &output);
+  EXPECT_EQ(FromHex("1f9a0a"), output);
+
+  // C.1.3: Encoding 42 starting at an octet boundary.
+  output.clear();
+  webcc::hpack::EncodeInteger(42, 8, 0, &output);
+  EXPECT_EQ(FromHex("2a"), output);
+}
+
+TEST(HpackTest, DecodeInteger) {
+  std::string input = FromHex("1f9a0a");
+  auto p = reinterpret_cast<const std::uint8_t*>(input.data());
+  auto end = p + input.size();
+
+  std::size_t value = 0;
+  EXPECT_TRUE(webcc::hpack::DecodeInteger(&p, end, 5, &value));
+  EXPECT_EQ(1337, value);
+  EXPECT_EQ(end, p);
+
+  // Truncated.
+  input = FromHex("1f9a");
+  p = reinterpret_cast<const std::uint8_t*>(input.data());
+  end = p + input.size();
+  EXPECT_FALSE(webcc::hpack::DecodeInteger(&p, end, 5, &value));
+}
+
+TEST(HpackTest, Huffman) {
+  std::string encoded;
+  webcc::hpack::HuffmanEncode("www.example.com", &encoded);
+  EXPECT_EQ(FromHex("f1e3c2e5f23a6ba0ab90f4ff"), encoded);
+
+  std::string decoded;
+  EXPECT_TRUE(webcc::hpack::HuffmanDecode(
+      reinterpret_cast<const std::uint8_t*>(encoded.data()), encoded.size(),
+      &decoded));
+  EXPECT_EQ("www.example.com", decoded);
+}
+
+TEST(HpackTest, HuffmanAllSymbols) {
+  std::string str;
+  for (int i = 0; i < 256; ++i) {
+    str.push_back(static_cast<char>(i));
+  }
+
+  std::string encoded;
+  webcc::hpack::HuffmanEncode(str, &encoded);
+  EXPECT_EQ(webcc::hpack::HuffmanEncodedSize(str), encoded.size());
+
+  std::string decoded;
+  EXPECT_TRUE(webcc::hpack::HuffmanDecode(
+      reinterpret_cast<const std::uint8_t*>(encoded.data()), encoded.size(),
+      &decoded));
+  EXPECT_EQ(str, decoded);
+}
+
+TEST(HpackTest, HuffmanInvalidPadding) {
+  // "a" is 00011 (5 bits), padded with zeros instead of ones.
+  const std::uint8_t data[] = { 0x18 };
+
+  std::string decoded;
+  EXPECT_FALSE(webcc::hpack::HuffmanDecode(data, sizeof(data), &decoded));
+}
+
+// -----------------------------------------------------------------------------
+
+// C.4: Request Examples with Huffman Coding.
+TEST(HpackTest, EncodeRequests) {
+  webcc::HpackEncoder encoder;
+  std::string block;
+
+  encoder.Encode({
+    { ":method", "GET" },
+    { ":scheme", "http" },
+    { ":path", "/" },
+    { ":authority", "www.example.com" },
+  }, &block);
+  EXPECT_EQ(FromHex("828684418cf1e3c2e5f23a6ba0ab90f4ff"), block);
+
+  block.clear();
+  encoder.Encode({
+    { ":method", "GET" },
+    { ":scheme", "http" },
+    { ":path", "/" },
+    { ":authority", "www.example.com" },
+    { "cache-control", "no-cache" },
+  }, &block);
+  EXPECT_EQ(FromHex("828684be5886a8eb10649cbf"), block);
+
+  block.clear();
+  encoder.Encode({
+    { ":method", "GET" },
+    { ":scheme", "https" },
+    { ":path", "/index.html" },
+    { ":authority", "www.example.com" },
+    { "custom-key", "custom-value" },
+  }, &block);
+  EXPECT_EQ(FromHex("828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf"),
+            block);
+}
+
+TEST(HpackTest, DecodeRequests) {
+  webcc::HpackDecoder decoder;
+  webcc::HeaderList headers;
+
+  std::string block = FromHex("828684418cf1e3c2e5f23a6ba0ab90f4ff");
+  EXPECT_TRUE(decoder.Decode(block.data(), block.size(), &headers));
+  ASSERT_EQ(4, headers.size());
+  EXPECT_EQ(":method", headers[0].first);
+  EXPECT_EQ("GET", headers[0].second);
+  EXPECT_EQ(":authority", headers[3].first);
+  EXPECT_EQ("www.example.com", headers[3].second);
+
+  headers.clear();
+  block = FromHex("828684be5886a8eb10649cbf");
+  EXPECT_TRUE(decoder.Decode(block.data(), block.size(), &headers));
+  ASSERT_EQ(5, headers.size());
+  EXPECT_EQ("www.example.com", headers[3].second);
+  EXPECT_EQ("cache-control", headers[4].first);
+  EXPECT_EQ("no-cache", headers[4].second);
+
+  headers.clear();
+  block = FromHex("828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf");
+  EXPECT_TRUE(decoder.Decode(block.data(), block.size(), &headers));
+  ASSERT_EQ(5, headers.size());
+  EXPECT_EQ("/index.html", headers[2].second);
+  EXPECT_EQ("www.example.com", headers[3].second);
+  EXPECT_EQ("custom-key", headers[4].first);
+  EXPECT_EQ("custom-value", headers[4].second);
+
+  // Index out of range.
+  headers.clear();
+  block = FromHex("ff00");
+  EXPECT_FALSE(decoder.Decode(block.data(), block.size(), &headers));
+}
+
+TEST(HpackTest, Eviction) {
+  webcc::HpackTable table(256);
+
+  table.Add(":status", "302");
+  table.Add("cache-control", "private");
+  table.Add("date", "Mon, 21 Oct 2013 20:13:21 GMT");
+  table.Add("location", "https://www.example.com");
+  EXPECT_EQ(222, table.size());
+
+  // C.5.2: ":status: 307" evicts ":status: 302".
+  table.Add(":status", "307");
+  EXPECT_EQ(222, table.size());
+
+  EXPECT_EQ(":status", table.Get(62)->first);
+  EXPECT_EQ("307", table.Get(62)->second);
+  EXPECT_EQ("location", table.Get(63)->first);
+  EXPECT_EQ(nullptr, table.Get(66));
+}
+
+// A small block of indexed fields expands to a large header list.
+TEST(HpackTest, DecodeTooLarge) {
+  webcc::HpackDecoder decoder;
+  decoder.set_max_list_size(64 * 1024);
+
+  // Literal with incremental indexing of a 4000 bytes value, then 100
+  // indexed fields of it (index 62).
+  std::string block;
+  block.push_back('\x40');
+  webcc::hpack::EncodeString("x-bomb", &block);
+  webcc::hpack::EncodeString(std::string(4000, 'a'), &block);
+  block.append(100, '\xbe');
+
+  webcc::HeaderList headers;
+  bool too_large = false;
+  EXPECT_TRUE(decoder.Decode(block.data(), block.size(), &headers,
+                             &too_large));
+  EXPECT_TRUE(too_large);
+  EXPECT_TRUE(headers.empty());
+
+  // Failed without |too_large|.
+  EXPECT_FALSE(decoder.Decode(block.data(), block.size(), &headers));
+
+  // The dynamic table is still in sync.
+  too_large = false;
+  block = "\xbe";
+  EXPECT_TRUE(decoder.Decode(block.data(), block.size(), &headers,
+                             &too_large));
+  EXPECT_FALSE(too_large);
+  ASSERT_EQ(1, headers.size());
+  EXPECT_EQ("x-bomb", headers[0].first);
+}
@@ -0,0 +1,161 @@
+#include "gtest/gtest.h"
+
+#include "webcc/http2.h"
+
+// Exchange the data between the two sessions until both have nothing to send.
+static void Pump(webcc::Http2Session* client, webcc::Http2Session* server) {
+  std::string output;
+
+  for (bool busy = true; busy;) {
+    busy = false;
+
+    if (client->GetOutput(&output)) {
+      EXPECT_TRUE(server->Feed(output.data(), output.size()));
+      busy = true;
+    }
+
+    if (server->GetOutput(&output)) {
+      EXPECT_TRUE(client->Feed(output.data(), output.size()));
+      busy = true;
+    }
+  }
+}
+
+TEST(Http2SessionTest, RequestResponse) {
+  webcc::Http2Session client{ false };
+  webcc::Http2Session server{ true };
+
+  auto request = std::make_shared<webcc::Request>("POST");
+  request->set_url(webcc::Url{ "http://localhost:8080/books?page=2" });
+  request->SetHeader("Content-Type", "application/json");
+  request->SetBody(std::make_shared<webcc::StringBody>("{}", false), true);
+
+  std::uint32_t stream_id = client.SendRequest(request);
+  EXPECT_EQ(1, stream_id);
+
+  Pump(&client, &server);
+
+  std::uint32_t server_stream_id = 0;
+  webcc::RequestPtr received;
+  ASSERT_TRUE(server.PopRequest(&server_stream_id, &received));
+  EXPECT_EQ(stream_id, server_stream_id);
+
+  EXPECT_EQ("POST", received->method());
+  EXPECT_EQ("/books", received->url().path());
+  EXPECT_EQ("page=2", received->url().query());
+  EXPECT_EQ("localhost:8080", received->GetHeader("Host"));
+  EXPECT_EQ("application/json", received->GetHeader("Content-Type"));
+  EXPECT_EQ("{}", received->data());
+
+  auto response = std::make_shared<webcc::Response>(webcc::Status::kCreated);
+  response->SetHeader("Connection", "Keep-Alive");
+  response->SetBody(std::make_shared<webcc::StringBody>("created", false),
+                    true);
+
+  server.SendResponse(server_stream_id, response);
+
+  Pump(&client, &server);
+
+  webcc::ResponsePtr r;
+  ASSERT_TRUE(client.TakeResponse(stream_id, &r));
+  ASSERT_TRUE(r);
+
+  EXPECT_EQ(webcc::Status::kCreated, r->status());
+  EXPECT_EQ("created", r->data());
+  EXPECT_EQ(7, r->content_length());
+
+  // Connection-specific headers are removed.
+  EXPECT_FALSE(r->HasHeader("Connection"));
+
+  EXPECT_FALSE(client.closed());
+  EXPECT_FALSE(server.closed());
+}
+
+// The body is larger than the flow-control windows.
+TEST(Http2SessionTest, FlowControl) {
+  webcc::Http2Session client{ false };
+  webcc::Http2Session server{ true };
+
+  auto request = std::make_shared<webcc::Request>("GET");
+  request->set_url(webcc::Url{ "http://localhost/" });
+
+  std::uint32_t stream_id = client.SendRequest(request);
+
+  Pump(&client, &server);
+
+  std::uint32_t server_stream_id = 0;
+  webcc::RequestPtr received;
+  ASSERT_TRUE(server.PopRequest(&server_stream_id, &received));
+
+  std::string data(3 * 1024 * 1024, 'a');
+  auto response = std::make_shared<webcc::Response>(webcc::Status::kOK);
+  response->SetBody(std::make_shared<webcc::StringBody>(data, false), true);
+
+  server.SendResponse(server_stream_id, response);
+
+  Pump(&client, &server);
+
+  webcc::ResponsePtr r;
+  ASSERT_TRUE(client.TakeResponse(stream_id, &r));
+  ASSERT_TRUE(r);
+  EXPECT_EQ(data, r->data());
+}
+
+TEST(Http2SessionTest, InvalidPreface) {
+  webcc::Http2Session server{ true };
+
+  const std::string data = "GET / HTTP/1.1\r\n\r\n";
+  EXPECT_FALSE(server.Feed(data.data(), data.size()));
+  EXPECT_TRUE(server.closed());
+
+  // A GOAWAY frame is pending.
+  std::string output;
+  EXPECT_TRUE(server.GetOutput(&output));
+}
+
+// The header list is larger than SETTINGS_MAX_HEADER_LIST_SIZE.
+TEST(Http2SessionTest, HeadersTooLarge) {
+  webcc::Http2Session client{ false };
+  webcc::Http2Session server{ true };
+
+  auto request = std::make_shared<webcc::Request>("GET");
+  request->set_url(webcc::Url{ "http://localhost/" });
+  request->SetHeader("X-Large", std::string(70000, 'a'));
+
+  std::uint32_t stream_id = client.SendRequest(request);
+
+  Pump(&client, &server);
+
+  std::uint32_t server_stream_id = 0;
+  webcc::RequestPtr received;
+  EXPECT_FALSE(server.PopRequest(&server_stream_id, &received));
+
+  webcc::ResponsePtr r;
+  ASSERT_TRUE(client.TakeResponse(stream_id, &r));
+  ASSERT_TRUE(r);
+  EXPECT_EQ(webcc::Status::kRequestHeaderFieldsTooLarge, r->status());
+
+  EXPECT_FALSE(client.closed());
+  EXPECT_FALSE(server.closed());
+}
+
+// A header block continued endlessly.
+TEST(Http2SessionTest, ContinuationFlood) {
+  webcc::Http2Session client{ false };
+  webcc::Http2Session server{ true };
+
+  std::string data;
+  client.GetOutput(&data);
+
+  const std::string fragment(16 * 1024, '\0');
+
+  webcc::http2::AppendFrameHeader(0, webcc::http2::kHeaders, 0, 1, &data);
+  for (int i = 0; i < 8; ++i) {
+    webcc::http2::AppendFrameHeader(fragment.size(),
+                                    webcc::http2::kContinuation, 0, 1, &data);
+    data += fragment;
+  }
+
+  EXPECT_FALSE(server.Feed(data.data(), data.size()));
+  EXPECT_TRUE(server.closed());
+}
@@ -0,0 +1,144 @@
+#include "gtest/gtest.h"
+
+#include <filesystem>
+#include <fstream>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "webcc/logger.h"
+
+#if WEBCC_ENABLE_LOG
+
+namespace sfs = std::filesystem;
+
+TEST(LoggerTest, Async) {
+  sfs::path dir = sfs::temp_directory_path() / "webcc_logger_unittest";
+
+  webcc::LogInit(dir, webcc::LOG_FILE_OVERWRITE | webcc::LOG_ASYNC);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([i] {
+      for (int j = 0; j < 100; ++j) {
+        LOG_USER("thread %d, log %d", i, j);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  LOG_WARN("the last one");
+  webcc::LogFlush();
+
+  EXPECT_EQ(0, webcc::LogDropped());
+
+  std::ifstream ifs{ dir / WEBCC_LOG_FILE_NAME };
+  std::string line;
+  std::string last;
+  std::size_t count = 0;
+  while (std::getline(ifs, line)) {
+    ++count;
+    last = line;
+  }
+  EXPECT_EQ(401, count);
+
+  // The logs of the threads are written out in time order.
+  EXPECT_NE(std::string::npos, last.find("WARN"));
+  EXPECT_NE(std::string::npos, last.find("the last one"));
+
+  // Back to no logging.
+  webcc::LogInit({}, 0);
+
+  std::error_code ec;
+  sfs::remove_all(dir, ec);
+}
+
+TEST(LoggerTest, Rotation) {
+  sfs::path dir = sfs::temp_directory_path() / "webcc_logger_rotation";
+
+  std::error_code ec;
+  sfs::remove_all(dir, ec);
+
+  webcc::LogInit(dir, webcc::LOG_FILE_OVERWRITE);
+  webcc::LogSetRotation(1024, 0, 2);
+
+  for (int i = 0; i < 100; ++i) {
+    LOG_USER("log %d", i);
+  }
+
+  // Wait for the rotated files to be compressed and removed.
+  std::size_t rotated = 0;
+  std::size_t compressed = 0;
+  for (int i = 0; i < 100; ++i) {
+    rotated = 0;
+    compressed = 0;
+    for (auto& entry : sfs::directory_iterator(dir)) {
+      std::string name = entry.path().filename().string();
+      if (name != WEBCC_LOG_FILE_NAME) {
+        ++rotated;
+      }
+      if (entry.path().extension() == ".gz") {
+        ++compressed;
+      }
+    }
+#if WEBCC_ENABLE_GZIP
+    if (rotated == 2 && compressed == 2) {
+      break;
+    }
+#else
+    if (rotated == 2) {
+      break;
+    }
+#endif
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+
+  EXPECT_EQ(2, rotated);
+#if WEBCC_ENABLE_GZIP
+  EXPECT_EQ(2, compressed);
+#endif
+
+  EXPECT_LT(sfs::file_size(dir / WEBCC_LOG_FILE_NAME), 1024 + 128);
+
+  webcc::LogSetRotation(0, 0, 0);
+  webcc::LogInit({}, 0);
+
+  sfs::remove_all(dir, ec);
+}
+
+TEST(LoggerTest, RuntimeLevel) {
+  int evaluated = 0;
+  auto arg = [&evaluated] { return ++evaluated; };
+
+  // The arguments of a disabled log are not evaluated.
+  webcc::LogSetLevel(WEBCC_WARN);
+  LOG_USER("%d", arg());
+  EXPECT_EQ(0, evaluated);
+
+  webcc::LogSetLevel("logger_unittest", WEBCC_USER);
+  EXPECT_EQ(WEBCC_USER, webcc::LogGetLevel("logger_unittest.cc"));
+  EXPECT_EQ(WEBCC_WARN, webcc::LogGetLevel("connection"));
+  LOG_USER("%d", arg());
+  EXPECT_EQ(1, evaluated);
+
+  webcc::LogResetLevel("logger_unittest");
+  EXPECT_EQ(WEBCC_WARN, webcc::LogGetLevel("logger_unittest"));
+  LOG_USER("%d", arg());
+  EXPECT_EQ(1, evaluated);
+
+  webcc::LogSetLevel(WEBCC_LOG_DEFAULT_LEVEL);
+  LOG_USER("%d", arg());
+  EXPECT_EQ(2, evaluated);
+}
+
+TEST(LoggerTest, HashModule) {
+  EXPECT_EQ(webcc::LogHashModule("connection"),
+            webcc::LogHashModule("/path/to/webcc/connection.cc"));
+  EXPECT_EQ(webcc::LogHashModule("connection"),
+            webcc::LogHashModule("webcc\\connection.h"));
+}
+
+#endif  // WEBCC_ENABLE_LOG
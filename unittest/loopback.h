@@ -0,0 +1,229 @@
+#ifndef WEBCC_UNITTEST_LOOPBACK_H_
+#define WEBCC_UNITTEST_LOOPBACK_H_
+
+// Helpers for the tests against an in-process server on the loopback: the
+// server runs in its own thread on a port picked by the system, and the
+// client is a raw socket with a timeout on each read.
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include "asio/io_context.hpp"
+#include "asio/ip/tcp.hpp"
+#include "asio/write.hpp"
+
+#include "webcc/response_builder.h"
+#include "webcc/server.h"
+
+namespace loopback {
+
+// Respond "Hello".
+class HelloView : public webcc::View {
+public:
+  webcc::ResponsePtr Handle(webcc::RequestPtr request) override {
+    return webcc::ResponseBuilder{ request }.OK().Body("Hello")();
+  }
+};
+
+// -----------------------------------------------------------------------------
+
+// A server running in a thread, stopped on destruction.
+class TestServer {
+public:
+  TestServer() : server_(0) {
+  }
+
+  ~TestServer() {
+    Stop();
+  }
+
+  TestServer(const TestServer&) = delete;
+  TestServer& operator=(const TestServer&) = delete;
+
+  // Configure it (routes, timeouts, etc.) before Start().
+  webcc::Server& server() {
+    return server_;
+  }
+
+  std::uint16_t port() const {
+    return port_;
+  }
+
+  // Run the server and wait until it's listening.
+  bool Start(std::size_t workers = 1, std::size_t loops = 1) {
+    thread_ = std::thread([this, workers, loops] {
+      server_.Run(workers, loops);
+    });
+
+    for (int i = 0; i < 100; ++i) {
+      port_ = server_.local_port();
+      if (port_ != 0) {
+        return true;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    return false;
+  }
+
+  void Stop() {
+    if (thread_.joinable()) {
+      server_.Stop();
+      thread_.join();
+    }
+  }
+
+  // Wait for the thread running the server to exit, e.g., once the server
+  // has stopped by itself.
+  void Join() {
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+private:
+  webcc::Server server_;
+  std::uint16_t port_ = 0;
+  std::thread thread_;
+};
+
+// -----------------------------------------------------------------------------
+
+// A blocking client socket, each read gives up after the timeout.
+class TestClient {
+public:
+  TestClient() : socket_(io_context_) {
+  }
+
+  bool Connect(std::uint16_t port) {
+    asio::ip::tcp::endpoint endpoint{ asio::ip::address_v4::loopback(), port };
+    std::error_code ec;
+    socket_.connect(endpoint, ec);
+    if (!ec) {
+      socket_.set_option(asio::ip::tcp::no_delay(true), ec);
+    }
+    return !ec;
+  }
+
+  bool Write(const std::string& data) {
+    std::error_code ec;
+    asio::write(socket_, asio::buffer(data), ec);
+    return !ec;
+  }
+
+  // Read until |data| contains |delimiter|.
+  // Return false on error, on EOF or on timeout.
+  bool ReadUntil(const std::string& delimiter,
+                 std::chrono::milliseconds timeout, std::string* data) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    while (data->find(delimiter) == std::string::npos) {
+      auto now = std::chrono::steady_clock::now();
+      if (now >= deadline ||
+          !ReadSome(std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - now),
+                    data)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Read until the server closes the connection.
+  // Return false on timeout.
+  bool ReadUntilClosed(std::chrono::milliseconds timeout, std::string* data) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    for (;;) {
+      auto now = std::chrono::steady_clock::now();
+      if (now >= deadline) {
+        return false;
+      }
+
+      std::error_code ec;
+      ReadSome(std::chrono::duration_cast<std::chrono::milliseconds>(
+                   deadline - now),
+               data, &ec);
+      if (ec == std::errc::timed_out) {
+        return false;
+      }
+      if (ec) {
+        return true;  // EOF or reset
+      }
+    }
+  }
+
+  // Read what's available, waiting up to |timeout| for something.
+  // Return false on error, on EOF or on timeout (see |ec|).
+  bool ReadSome(std::chrono::milliseconds timeout, std::string* data,
+                std::error_code* ec = nullptr) {
+    char buffer[4096];
+    std::error_code read_ec = std::make_error_code(std::errc::timed_out);
+    std::size_t length = 0;
+    bool done = false;
+
+    socket_.async_read_some(
+        asio::buffer(buffer),
+        [&](std::error_code e, std::size_t n) {
+          read_ec = e;
+          length = n;
+          done = true;
+        });
+
+    io_context_.restart();
+    io_context_.run_for(timeout);
+
+    if (!done) {
+      // Cancel the read and let its handler run.
+      socket_.cancel();
+      io_context_.restart();
+      io_context_.run();
+      read_ec = std::make_error_code(std::errc::timed_out);
+    }
+
+    data->append(buffer, length);
+
+    if (ec != nullptr) {
+      *ec = read_ec;
+    }
+    return !read_ec;
+  }
+
+  void Close() {
+    std::error_code ec;
+    socket_.close(ec);
+  }
+
+private:
+  asio::io_context io_context_;
+  asio::ip::tcp::socket socket_;
+};
+
+// Send a GET request on a new connection and read the response until the
+// server closes it. Return the response, empty on error.
+inline std::string Get(std::uint16_t port, const std::string& target,
+                       std::chrono::milliseconds timeout =
+                           std::chrono::seconds(5)) {
+  TestClient client;
+  if (!client.Connect(port)) {
+    return "";
+  }
+
+  if (!client.Write("GET " + target + " HTTP/1.1\r\n"
+                    "Host: localhost\r\n"
+                    "Connection: Close\r\n\r\n")) {
+    return "";
+  }
+
+  std::string response;
+  if (!client.ReadUntilClosed(timeout, &response)) {
+    return "";
+  }
+  return response;
+}
+
+}  // namespace loopback
+
+#endif  // WEBCC_UNITTEST_LOOPBACK_H_
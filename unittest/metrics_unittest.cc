@@ -0,0 +1,130 @@
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+#include "webcc/globals.h"
+#include "webcc/metrics.h"
+
+using namespace webcc;
+
+TEST(MetricsTest, Counter) {
+  Counter counter;
+  counter.Add();
+  counter.Add(9);
+  EXPECT_EQ(10, counter.Value());
+}
+
+TEST(MetricsTest, Histogram) {
+  Histogram histogram;
+  EXPECT_EQ(0, histogram.Percentile(50));
+
+  // Small values are exact.
+  for (std::uint64_t us = 1; us <= 10; ++us) {
+    histogram.Record(us);
+  }
+  EXPECT_EQ(10, histogram.Count());
+  EXPECT_EQ(55, histogram.Sum());
+  EXPECT_EQ(5, histogram.Percentile(50));
+  EXPECT_EQ(10, histogram.Percentile(100));
+  EXPECT_EQ(3, histogram.CountBelow(3));
+}
+
+// Large values are recorded with a relative error below 1/16.
+TEST(MetricsTest, Histogram_LargeValues) {
+  const std::uint64_t values[] = { 17, 100, 1000, 123456, 10000000 };
+
+  for (std::uint64_t value : values) {
+    Histogram histogram;
+    histogram.Record(value);
+
+    std::uint64_t p = histogram.Percentile(99);
+    EXPECT_GE(p, value);
+    EXPECT_LT(p - value, value / 16 + 1);
+  }
+}
+
+TEST(MetricsTest, Export) {
+  MetricsRegistry registry;
+
+  Counter* counter = registry.GetCounter(
+      "test_requests_total", "Requests.", { { "path", "/a\"b" } });
+  counter->Add(3);
+
+  // The same metric for the same name and labels.
+  EXPECT_EQ(counter, registry.GetCounter("test_requests_total", "Requests.",
+                                         { { "path", "/a\"b" } }));
+
+  // Another type for the same name is not allowed.
+  EXPECT_EQ(nullptr, registry.GetGauge("test_requests_total", "Requests."));
+
+  registry.SetGaugeCallback("test_active", "Active.", [] { return 7; });
+
+  Histogram* histogram = registry.GetHistogram("test_seconds", "Latency.");
+  histogram->Record(std::chrono::milliseconds(3));
+
+  std::string output = registry.Export();
+
+  EXPECT_NE(std::string::npos,
+            output.find("# TYPE test_requests_total counter\n"
+                        "test_requests_total{path=\"/a\\\"b\"} 3\n"));
+  EXPECT_NE(std::string::npos, output.find("test_active 7\n"));
+  EXPECT_NE(std::string::npos,
+            output.find("test_seconds_bucket{le=\"0.0025\"} 0\n"));
+  EXPECT_NE(std::string::npos,
+            output.find("test_seconds_bucket{le=\"0.005\"} 1\n"));
+  EXPECT_NE(std::string::npos,
+            output.find("test_seconds_bucket{le=\"+Inf\"} 1\n"));
+  EXPECT_NE(std::string::npos, output.find("test_seconds_sum 0.003\n"));
+  EXPECT_NE(std::string::npos, output.find("test_seconds_count 1\n"));
+}
+
+TEST(MetricsTest, RouteMetrics) {
+  MetricsRegistry registry;
+  RouteMetrics route_metrics{ &registry, "/books" };
+
+  route_metrics.Record(200, std::chrono::milliseconds(1));
+  route_metrics.Record(200, std::chrono::milliseconds(1));
+  route_metrics.Record(404, std::chrono::milliseconds(1));
+
+  std::string output = registry.Export();
+  EXPECT_NE(std::string::npos,
+            output.find("webcc_requests_total{route=\"/books\","
+                        "code=\"200\"} 2"));
+  EXPECT_NE(std::string::npos,
+            output.find("webcc_requests_total{route=\"/books\","
+                        "code=\"404\"} 1"));
+  EXPECT_NE(std::string::npos,
+            output.find("webcc_route_handle_seconds_count{route=\"/books\"}"
+                        " 3"));
+}
+
+TEST(MetricsTest, HostMetrics) {
+  MetricsRegistry registry;
+  ClientMetrics client_metrics{ &registry };
+
+  HostMetrics* metrics = client_metrics.GetHost("example.com:443");
+  EXPECT_EQ(metrics, client_metrics.GetHost("example.com:443"));
+  EXPECT_EQ(std::vector<std::string>{ "example.com:443" },
+            client_metrics.GetHosts());
+
+  EXPECT_EQ(0.0, metrics->GetReuseRatio());
+  metrics->pool_misses->Add();
+  metrics->pool_hits->Add(3);
+  EXPECT_EQ(0.75, metrics->GetReuseRatio());
+
+  Error error{ Error::kSocketReadError, "Socket read error" };
+  error.set_timeout(true);
+  metrics->AddError(error);
+
+  std::string output = registry.Export();
+  EXPECT_NE(std::string::npos,
+            output.find("webcc_client_errors_total{host=\"example.com:443\","
+                        "error=\"read\"} 1"));
+  EXPECT_NE(std::string::npos,
+            output.find("webcc_client_timeouts_total{host=\"example.com:443\"}"
+                        " 1"));
+  EXPECT_NE(std::string::npos,
+            output.find("webcc_client_pool_hits_total{host=\"example.com:443\"}"
+                        " 3"));
+}
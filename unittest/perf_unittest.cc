@@ -0,0 +1,325 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+
+#include "asio/connect.hpp"
+#include "asio/io_context.hpp"
+#include "asio/ip/tcp.hpp"
+#include "asio/read_until.hpp"
+#include "asio/write.hpp"
+
+#include "webcc/metrics.h"
+#include "webcc/request.h"
+#include "webcc/request_parser.h"
+#include "webcc/response_builder.h"
+#include "webcc/router.h"
+#include "webcc/server.h"
+
+// Performance regression tests: the allocations of the hot paths are checked
+// against the budgets below, and the latency of a loopback server against
+// some generous bounds.
+//
+// If a change adds allocations on purpose, raise the budget in the same
+// change. If it saves some, lower the budget to keep the gain.
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+std::atomic<std::size_t> g_allocs{ 0 };
+
+}  // namespace
+
+// Count the allocations of the whole test program, it's cheap.
+void* operator new(std::size_t size) {
+  g_allocs.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+// Allocation budgets.
+// The strings short enough (15 characters for libstdc++ and MSVC) are not
+// allocated, except with the old ABI of libstdc++.
+#if defined(_GLIBCXX_USE_CXX11_ABI) && _GLIBCXX_USE_CXX11_ABI == 0
+const std::size_t kParseGetBudget = 75;
+const std::size_t kParsePostBudget = 52;
+const std::size_t kFindViewBudget = 28;
+const std::size_t kFindRegexViewBudget = 32;
+const std::size_t kSerializeResponseBudget = 18;
+#else
+const std::size_t kParseGetBudget = 24;
+const std::size_t kParsePostBudget = 17;
+const std::size_t kFindViewBudget = 27;
+const std::size_t kFindRegexViewBudget = 30;
+const std::size_t kSerializeResponseBudget = 14;
+#endif
+
+// Count the allocations of |func| once it has been run once, i.e., of the
+// steady state with the capacities of the reused objects reserved.
+template <typename Func>
+std::size_t CountAllocs(Func&& func) {
+  func();
+
+  std::size_t start = g_allocs.load(std::memory_order_relaxed);
+  func();
+  return g_allocs.load(std::memory_order_relaxed) - start;
+}
+
+// The debug runtime of MSVC allocates more, e.g., for the iterator debugging,
+// the budgets don't apply.
+void ExpectWithinBudget(std::size_t allocs, std::size_t budget) {
+#if !(defined(_MSC_VER) && defined(_DEBUG))
+  EXPECT_LE(allocs, budget);
+#endif
+}
+
+bool MatchAll(const std::string& /*method*/, std::string_view /*url*/,
+              bool* stream) {
+  *stream = false;
+  return true;
+}
+
+class EmptyView : public webcc::View {
+public:
+  webcc::ResponsePtr Handle(webcc::RequestPtr request) override {
+    return webcc::ResponseBuilder{ request }.OK().Body("ok")();
+  }
+};
+
+// Chrome.
+const char kGetRequest[] =
+    "GET /api/v1/books?page=2&sort=title HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"86\", \"Google Chrome\";v=\"86\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) "
+    "AppleWebKit/537.36 (KHTML, like Gecko) Chrome/86.0.4240.111 "
+    "Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,"
+    "image/avif,image/webp,image/apng,*/*;q=0.8\r\n"
+    "Sec-Fetch-Site: none\r\n"
+    "Sec-Fetch-Mode: navigate\r\n"
+    "Sec-Fetch-User: ?1\r\n"
+    "Sec-Fetch-Dest: document\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: en-US,en;q=0.9\r\n"
+    "\r\n";
+
+const char kPostRequest[] =
+    "POST /api/v1/books HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "User-Agent: Webcc/0.3.0\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Accept: application/json\r\n"
+    "Connection: Keep-Alive\r\n"
+    "Content-Type: application/json; charset=utf-8\r\n"
+    "Content-Length: 40\r\n"
+    "\r\n"
+    "{\"title\":\"1984\",\"author\":\"George Orwell\"}";
+
+std::size_t CountParseAllocs(const char* payload) {
+  webcc::ViewMatcher view_matcher = MatchAll;
+  webcc::Request request;
+  webcc::RequestParser parser;
+
+  bool ok = false;
+  std::size_t allocs = CountAllocs([&] {
+    request.Clear();
+    parser.Init(&request, &view_matcher);
+    ok = parser.Parse(payload, std::strlen(payload)) && parser.finished();
+  });
+
+  EXPECT_TRUE(ok);
+  return allocs;
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------------
+
+TEST(AllocBudgetTest, ParseGetRequest) {
+  ExpectWithinBudget(CountParseAllocs(kGetRequest), kParseGetBudget);
+}
+
+TEST(AllocBudgetTest, ParsePostRequest) {
+  ExpectWithinBudget(CountParseAllocs(kPostRequest), kParsePostBudget);
+}
+
+TEST(AllocBudgetTest, FindView) {
+  webcc::Router router;
+  auto view = std::make_shared<EmptyView>();
+
+  for (int i = 0; i < 10; ++i) {
+    router.Route("/api/v1/resource" + std::to_string(i), view);
+    router.Route(webcc::R("/api/v1/resource" + std::to_string(i) + "/(\\d+)"),
+                 view);
+  }
+
+  webcc::UrlArgs args;
+  webcc::ViewPtr found;
+
+  std::string url = "/api/v1/resource9";
+  std::size_t allocs = CountAllocs([&] {
+    args.clear();
+    found = router.FindView("GET", url, &args);
+  });
+  EXPECT_TRUE(!!found);
+  ExpectWithinBudget(allocs, kFindViewBudget);
+
+  url = "/api/v1/resource9/12345";
+  allocs = CountAllocs([&] {
+    args.clear();
+    found = router.FindView("GET", url, &args);
+  });
+  EXPECT_TRUE(!!found);
+  ExpectWithinBudget(allocs, kFindRegexViewBudget);
+}
+
+// Build a JSON response and render it for writing.
+TEST(AllocBudgetTest, SerializeResponse) {
+  const std::string json = "{\"title\":\"1984\",\"author\":\"George Orwell\"}";
+
+  std::size_t size = 0;
+  std::size_t allocs = CountAllocs([&] {
+    auto response = webcc::ResponseBuilder{}.OK().Json().Utf8().Body(json)();
+    response->Prepare();
+
+    size = 0;
+    for (auto& buffer : response->GetPayload()) {
+      size += buffer.size();
+    }
+
+    response->body()->InitPayload();
+    for (auto& buffer : response->body()->NextPayload()) {
+      size += buffer.size();
+    }
+  });
+
+  EXPECT_GT(size, json.size());
+  ExpectWithinBudget(allocs, kSerializeResponseBudget);
+}
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+// Wait until the server is listening, return the port or 0 on timeout.
+std::uint16_t WaitServer(const webcc::Server& server) {
+  for (int i = 0; i < 100; ++i) {
+    std::uint16_t port = server.local_port();
+    if (port != 0) {
+      return port;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  return 0;
+}
+
+// Send the requests over a keep-alive connection, one by one, and record the
+// latencies. Return false on any error.
+bool SendRequests(std::uint16_t port, int count, webcc::Histogram* latency) {
+  asio::io_context io_context;
+  asio::ip::tcp::endpoint endpoint{ asio::ip::address_v4::loopback(), port };
+  asio::ip::tcp::socket socket{ io_context };
+
+  std::error_code ec;
+  socket.connect(endpoint, ec);
+  if (ec) {
+    return false;
+  }
+  socket.set_option(asio::ip::tcp::no_delay(true));
+
+  const std::string request =
+      "GET /latency HTTP/1.1\r\n"
+      "Host: localhost\r\n"
+      "Connection: Keep-Alive\r\n"
+      "\r\n";
+
+  // The response is "ok" with a Content-Length of 2.
+  std::string buffer;
+
+  for (int i = 0; i < count; ++i) {
+    auto start = std::chrono::steady_clock::now();
+
+    asio::write(socket, asio::buffer(request), ec);
+    if (ec) {
+      return false;
+    }
+
+    std::size_t size = asio::read_until(socket, asio::dynamic_buffer(buffer),
+                                        "\r\n\r\nok", ec);
+    if (ec || buffer.compare(0, 12, "HTTP/1.1 200") != 0) {
+      return false;
+    }
+    buffer.erase(0, size);
+
+    latency->Record(std::chrono::steady_clock::now() - start);
+  }
+
+  return true;
+}
+
+}  // namespace
+
+// The bounds are far above the latency of an idle machine (tens of
+// microseconds), to catch a stall (e.g., Nagle's algorithm, a lost wakeup or
+// a timer) instead of some noise.
+TEST(LatencyTest, LoopbackServer) {
+  // Let the system pick a free port.
+  webcc::Server server{ 0 };
+  server.Route("/latency", std::make_shared<EmptyView>());
+
+  std::thread server_thread{ [&server] { server.Run(1, 1); } };
+
+  std::uint16_t port = WaitServer(server);
+
+  webcc::Histogram latency;
+  bool ok = port != 0 && SendRequests(port, 500, &latency);
+
+  // Join the server thread before any assertion could return.
+  server.Stop();
+  server_thread.join();
+
+  ASSERT_NE(0, port);
+  ASSERT_TRUE(ok);
+  EXPECT_EQ(500u, latency.Count());
+
+  // In microseconds.
+  EXPECT_LT(latency.Percentile(50), 5000u);
+  EXPECT_LT(latency.Percentile(99), 20000u);
+}
@@ -0,0 +1,63 @@
+#include "gtest/gtest.h"
+
+#include "webcc/globals.h"
+#include "webcc/read_buffer.h"
+
+using namespace webcc;
+
+TEST(BufferPoolTest, RoundUp) {
+  EXPECT_EQ(kBufferSize, BufferPool::RoundUp(1));
+  EXPECT_EQ(kBufferSize, BufferPool::RoundUp(kBufferSize));
+  EXPECT_EQ(kBufferSize * 2, BufferPool::RoundUp(kBufferSize + 1));
+  EXPECT_EQ(kMaxBufferSize, BufferPool::RoundUp(kMaxBufferSize));
+
+  // Not pooled.
+  EXPECT_EQ(kMaxBufferSize + 1, BufferPool::RoundUp(kMaxBufferSize + 1));
+}
+
+TEST(ReadBufferTest, GrowAndRelease) {
+  ReadBuffer buffer(kBufferSize);
+  EXPECT_TRUE(buffer.empty());
+
+  auto b = buffer.Prepare();
+  EXPECT_FALSE(buffer.empty());
+  EXPECT_EQ(kBufferSize, b.size());
+
+  // Not filled, no growth.
+  buffer.Commit(10);
+  EXPECT_EQ(kBufferSize, buffer.Prepare().size());
+
+  // Double on each fill, up to the max size.
+  std::size_t size = kBufferSize;
+  while (size < kMaxBufferSize) {
+    buffer.Commit(size);
+    EXPECT_TRUE(buffer.filled());
+    size *= 2;
+    EXPECT_EQ(size, buffer.Prepare().size());
+  }
+  buffer.Commit(size);
+  EXPECT_EQ(kMaxBufferSize, buffer.Prepare().size());
+
+  // Shrink to the min size once released.
+  buffer.Release();
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_EQ(kBufferSize, buffer.Prepare().size());
+}
+
+TEST(ReadBufferTest, Pooled) {
+  auto& pool = BufferPool::Instance();
+
+  const std::size_t size = kBufferSize * 4;
+
+  ReadBuffer buffer(size);
+  const char* data = static_cast<const char*>(buffer.Prepare().data());
+
+  std::size_t count = pool.GetFreeCount(size);
+  buffer.Release();
+  EXPECT_EQ(count + 1, pool.GetFreeCount(size));
+
+  // The buffer freed is reused.
+  ReadBuffer buffer2(size);
+  EXPECT_EQ(data, buffer2.Prepare().data());
+  EXPECT_EQ(count, pool.GetFreeCount(size));
+}
@@ -232,4 +232,107 @@ TEST_F(MultipartRequestParserTest, ParseByteWise) {
 
   CheckResult();
 }
-#endif  // 0
\ No newline at end of file
+#endif  // 0
+// -----------------------------------------------------------------------------
+
+// The parser is reused for the requests of a persistent connection.
+TEST(RequestParserTest, Multipart_Reuse) {
+  const std::string data =
+      "--xyz\r\n"
+      "Content-Disposition: form-data; name=\"file\"; filename=\"a.txt\"\r\n"
+      "\r\n"
+      "hello\r\n"
+      "--xyz--\r\n";
+
+  const std::string payload =
+      "POST /upload HTTP/1.1\r\n"
+      "Host: localhost:8080\r\n"
+      "Content-Type: multipart/form-data; boundary=xyz\r\n"
+      "Content-Length: " + std::to_string(data.size()) + "\r\n"
+      "\r\n" + data;
+
+  webcc::ViewMatcher view_matcher = [](const std::string&, std::string_view,
+                                       bool*) { return true; };
+
+  webcc::Request request;
+  webcc::RequestParser parser;
+
+  for (int i = 0; i < 2; ++i) {
+    request.Clear();
+    parser.Init(&request, &view_matcher);
+
+    EXPECT_TRUE(parser.Parse(payload.data(), payload.size()));
+    EXPECT_TRUE(parser.finished());
+
+    ASSERT_EQ(1, request.form_parts().size());
+    EXPECT_EQ("hello", request.form_parts()[0]->data());
+  }
+}
+
+TEST(RequestParserTest, StartLine) {
+  webcc::ViewMatcher view_matcher = [](const std::string&, std::string_view,
+                                       bool*) { return true; };
+
+  webcc::Request request;
+  webcc::RequestParser parser;
+
+  const std::string payload =
+      "GET /path/to?key=value HTTP/1.1\r\n"
+      "Host: localhost\r\n"
+      "\r\n";
+
+  parser.Init(&request, &view_matcher);
+  EXPECT_TRUE(parser.Parse(payload.data(), payload.size()));
+  EXPECT_TRUE(parser.finished());
+  EXPECT_EQ("GET", request.method());
+  EXPECT_EQ("/path/to", request.url().path());
+  EXPECT_EQ("key=value", request.url().query());
+
+  const std::string invalid =
+      "GET /path to HTTP/1.1\r\n"
+      "Host: localhost\r\n"
+      "\r\n";
+
+  request.Clear();
+  parser.Init(&request, &view_matcher);
+  EXPECT_FALSE(parser.Parse(invalid.data(), invalid.size()));
+}
+
+TEST(RequestParserTest, Query) {
+  webcc::ViewMatcher view_matcher = [](const std::string&, std::string_view,
+                                       bool*) { return true; };
+
+  webcc::Request request;
+  webcc::RequestParser parser;
+
+  const std::string payload =
+      "GET /books?page=2&sort=title%20asc HTTP/1.1\r\n"
+      "Host: localhost\r\n"
+      "\r\n";
+
+  parser.Init(&request, &view_matcher);
+  EXPECT_TRUE(parser.Parse(payload.data(), payload.size()));
+
+  // Parsed once the URL is set.
+  const webcc::UrlQueryView& query = request.query();
+  EXPECT_EQ(&query, &request.query());
+  EXPECT_EQ("2", query.Get("page"));
+  EXPECT_EQ("title asc", query.Get("sort"));
+
+  // A copy of the request views its own URL.
+  webcc::Request copy = request;
+  request.set_url("/books?page=3");
+  EXPECT_EQ("3", request.query().Get("page"));
+  EXPECT_FALSE(request.query().Has("sort"));
+  EXPECT_EQ("2", copy.query().Get("page"));
+  EXPECT_EQ("title asc", copy.query().Get("sort"));
+
+  webcc::Request assigned;
+  assigned = copy;
+  copy.Clear();
+  EXPECT_EQ("2", assigned.query().Get("page"));
+  EXPECT_EQ("title asc", assigned.query().Get("sort"));
+
+  request.Clear();
+  EXPECT_TRUE(request.query().Empty());
+}
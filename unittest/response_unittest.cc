@@ -0,0 +1,117 @@
+#include "gtest/gtest.h"
+
+#include <string>
+
+#include "webcc/date_clock.h"
+#include "webcc/response.h"
+#include "webcc/utility.h"
+
+using namespace webcc;
+
+namespace {
+
+std::string ToString(const Payload& payload) {
+  std::string str;
+  for (auto& buffer : payload) {
+    str.append(static_cast<const char*>(buffer.data()), buffer.size());
+  }
+  return str;
+}
+
+}  // namespace
+
+// The start line and the headers are rendered into one buffer.
+TEST(ResponseTest, GetPayload) {
+  Response response{ Status::kOK };
+  response.SetHeader(headers::kContentLength, "0");
+  response.Prepare();
+
+  auto payload = response.GetPayload();
+  EXPECT_EQ(1, payload.size());
+
+  std::string expected = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\nServer: " +
+                         utility::UserAgent() + "\r\n\r\n";
+  EXPECT_EQ(expected, ToString(payload));
+
+  // Render again.
+  EXPECT_EQ(expected, ToString(response.GetPayload()));
+}
+
+TEST(ResponseTest, GetPayload_ServerHeader) {
+  Response response{ Status::kNotFound };
+  response.SetHeader(headers::kServer, "Test");
+  response.Prepare();
+
+  EXPECT_EQ("HTTP/1.1 404 Not Found\r\nServer: Test\r\n\r\n",
+            ToString(response.GetPayload()));
+}
+
+TEST(ResponseTest, GetPayload_AutoDate) {
+  Response response{ Status::kOK };
+  response.set_auto_date(true);
+  response.Prepare();
+
+  std::string payload = ToString(response.GetPayload());
+
+  std::string prefix = "HTTP/1.1 200 OK\r\nServer: " + utility::UserAgent() +
+                       "\r\nDate: ";
+  ASSERT_EQ(prefix.size() + DateClock::kSize + 4, payload.size());
+  EXPECT_EQ(prefix, payload.substr(0, prefix.size()));
+  EXPECT_EQ(" GMT\r\n\r\n", payload.substr(payload.size() - 8));
+
+  // The Date header set explicitly is kept.
+  Response dated{ Status::kOK };
+  dated.set_auto_date(true);
+  dated.SetHeader(headers::kDate, "Wed, 21 Oct 2015 07:28:00 GMT");
+  dated.Prepare();
+  EXPECT_EQ("HTTP/1.1 200 OK\r\nDate: Wed, 21 Oct 2015 07:28:00 GMT\r\n"
+            "Server: " + utility::UserAgent() + "\r\n\r\n",
+            ToString(dated.GetPayload()));
+}
+
+// A response not prepared for sending, e.g., one parsed by the client, gets no
+// Server or Date header.
+TEST(ResponseTest, GetPayload_NotPrepared) {
+  Response response{ Status::kOK };
+  response.set_auto_date(true);
+  response.set_start_line("HTTP/1.1 200 OK");
+  response.SetHeader(headers::kContentLength, "0");
+
+  EXPECT_EQ("HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n",
+            ToString(response.GetPayload()));
+  EXPECT_EQ(std::string::npos, response.Dump().find("Server"));
+}
+
+// The headers dumped are the ones the response has, plus the ones rendered
+// for sending, as they were sent.
+TEST(ResponseTest, Dump) {
+  Response response{ Status::kOK };
+  response.set_auto_date(true);
+  response.Prepare();
+
+  std::string dump = response.Dump();
+  EXPECT_EQ(std::string::npos, dump.find("Server"));
+  EXPECT_EQ(std::string::npos, dump.find("Date"));
+
+  std::string payload = ToString(response.GetPayload());
+  std::size_t pos = payload.find("Date: ");
+  ASSERT_NE(std::string::npos, pos);
+  std::string date = payload.substr(pos, 6 + DateClock::kSize);
+
+  dump = response.Dump();
+  EXPECT_NE(std::string::npos,
+            dump.find("    > Server: " + utility::UserAgent() + "\n"));
+  EXPECT_NE(std::string::npos, dump.find("    > " + date + "\n"));
+}
+
+TEST(ResponseTest, Prepare_Reason) {
+  Response response{ Status::kOK };
+  response.set_reason("Fine");
+  response.Prepare();
+  EXPECT_EQ("HTTP/1.1 200 Fine", response.start_line());
+
+  Response unknown;
+  unknown.set_status(418);
+  unknown.Prepare();
+  EXPECT_EQ("HTTP/1.1 418 ", unknown.start_line());
+}
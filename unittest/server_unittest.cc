@@ -0,0 +1,250 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "webcc/response_builder.h"
+#include "webcc/server.h"
+
+#include "loopback.h"
+
+using namespace webcc;
+using namespace std::chrono_literals;
+
+namespace {
+
+// Block the worker until released, or for 5 seconds at most.
+class BlockingView : public View {
+public:
+  ResponsePtr Handle(RequestPtr request) override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++started_;
+    cv_.notify_all();
+    cv_.wait_for(lock, 5s, [this] { return released_; });
+    return ResponseBuilder{ request }.OK().Body("Done")();
+  }
+
+  // Wait until |count| requests have been started.
+  bool WaitStarted(int count = 1) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return cv_.wait_for(lock, 5s, [this, count] { return started_ >= count; });
+  }
+
+  void Release() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    released_ = true;
+    cv_.notify_all();
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  int started_ = 0;
+  bool released_ = false;
+};
+
+// Wait for the server to close the connection, and return how long it took.
+// Fail if it's not closed in 5 seconds.
+std::chrono::milliseconds WaitClosed(loopback::TestClient* client) {
+  auto start = std::chrono::steady_clock::now();
+
+  std::string data;
+  EXPECT_TRUE(client->ReadUntilClosed(5s, &data));
+  EXPECT_EQ("", data);
+
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------------
+
+// A connection without any request is closed after the idle timeout.
+TEST(ServerTest, IdleTimeout) {
+  loopback::TestServer server;
+  server.server().Route("/hello", std::make_shared<loopback::HelloView>());
+  server.server().set_idle_timeout(1);
+  server.server().set_header_timeout(10);
+  server.server().set_body_timeout(10);
+  ASSERT_TRUE(server.Start());
+
+  loopback::TestClient client;
+  ASSERT_TRUE(client.Connect(server.port()));
+
+  auto elapsed = WaitClosed(&client);
+  EXPECT_GE(elapsed, 900ms);
+  EXPECT_LT(elapsed, 3s);
+}
+
+// A request whose headers are received too slowly is closed after the header
+// timeout, counted from its first byte.
+TEST(ServerTest, HeaderTimeout) {
+  loopback::TestServer server;
+  server.server().Route("/hello", std::make_shared<loopback::HelloView>());
+  server.server().set_idle_timeout(10);
+  server.server().set_header_timeout(1);
+  server.server().set_body_timeout(10);
+  ASSERT_TRUE(server.Start());
+
+  loopback::TestClient client;
+  ASSERT_TRUE(client.Connect(server.port()));
+
+  ASSERT_TRUE(client.Write("GET /hello HTTP/1.1\r\n"));
+  std::this_thread::sleep_for(300ms);
+  ASSERT_TRUE(client.Write("Host: localhost\r\n"));
+
+  auto elapsed = WaitClosed(&client);
+  EXPECT_GE(elapsed, 600ms);
+  EXPECT_LT(elapsed, 3s);
+}
+
+// A request whose body stalls is closed after the body timeout.
+TEST(ServerTest, BodyTimeout) {
+  loopback::TestServer server;
+  server.server().Route("/hello", std::make_shared<loopback::HelloView>(),
+                        { "POST" });
+  server.server().set_idle_timeout(10);
+  server.server().set_header_timeout(10);
+  server.server().set_body_timeout(1);
+  ASSERT_TRUE(server.Start());
+
+  loopback::TestClient client;
+  ASSERT_TRUE(client.Connect(server.port()));
+
+  ASSERT_TRUE(client.Write("POST /hello HTTP/1.1\r\n"
+                           "Host: localhost\r\n"
+                           "Content-Length: 10\r\n\r\n"
+                           "abc"));
+
+  auto elapsed = WaitClosed(&client);
+  EXPECT_GE(elapsed, 900ms);
+  EXPECT_LT(elapsed, 3s);
+}
+
+// -----------------------------------------------------------------------------
+
+// The worker is busy with a request: a new connection beyond the max
+// connections, and a new request beyond the max queued, are replied with 503
+// and closed.
+TEST(ServerTest, ServiceUnavailable) {
+  auto view = std::make_shared<BlockingView>();
+
+  loopback::TestServer server;
+  server.server().Route("/block", view);
+  server.server().set_max_connections(2);
+  server.server().set_max_queued(1);
+  server.server().set_retry_after(7);
+  ASSERT_TRUE(server.Start(1));
+
+  const std::string request =
+      "GET /block HTTP/1.1\r\n"
+      "Host: localhost\r\n\r\n";
+
+  loopback::TestClient client1;
+  loopback::TestClient client2;
+  ASSERT_TRUE(client1.Connect(server.port()));
+  ASSERT_TRUE(client2.Connect(server.port()));
+
+  ASSERT_TRUE(client1.Write(request));
+  ASSERT_TRUE(view->WaitStarted());
+
+  // Beyond the max connections.
+  loopback::TestClient client3;
+  ASSERT_TRUE(client3.Connect(server.port()));
+  std::string response3;
+  EXPECT_TRUE(client3.ReadUntilClosed(5s, &response3));
+
+  // Beyond the max queued.
+  ASSERT_TRUE(client2.Write(request));
+  std::string response2;
+  EXPECT_TRUE(client2.ReadUntilClosed(5s, &response2));
+
+  view->Release();
+
+  std::string response1;
+  EXPECT_TRUE(client1.ReadUntil("Done", 5s, &response1));
+
+  for (const std::string* response : { &response2, &response3 }) {
+    EXPECT_EQ(0, response->compare(0, 12, "HTTP/1.1 503")) << *response;
+    EXPECT_NE(std::string::npos, response->find("Retry-After: 7\r\n"));
+    EXPECT_NE(std::string::npos, response->find("Connection: Close\r\n"));
+  }
+
+  EXPECT_EQ(0, response1.compare(0, 12, "HTTP/1.1 200")) << response1;
+}
+
+// -----------------------------------------------------------------------------
+
+// On Stop(), the request in progress is completed with "Connection: Close",
+// the connection idle between requests is closed, and a new connection is
+// served its first request.
+TEST(ServerTest, Drain) {
+  auto view = std::make_shared<BlockingView>();
+
+  loopback::TestServer server;
+  server.server().Route("/block", view);
+  server.server().Route("/hello", std::make_shared<loopback::HelloView>());
+  server.server().set_drain_timeout(3);
+  ASSERT_TRUE(server.Start(2));
+
+  // In progress.
+  loopback::TestClient client1;
+  ASSERT_TRUE(client1.Connect(server.port()));
+  ASSERT_TRUE(client1.Write("GET /block HTTP/1.1\r\n"
+                            "Host: localhost\r\n\r\n"));
+  ASSERT_TRUE(view->WaitStarted());
+
+  // Idle between requests.
+  loopback::TestClient client2;
+  ASSERT_TRUE(client2.Connect(server.port()));
+  ASSERT_TRUE(client2.Write("GET /hello HTTP/1.1\r\n"
+                            "Host: localhost\r\n\r\n"));
+  std::string response2;
+  ASSERT_TRUE(client2.ReadUntil("Hello", 5s, &response2));
+  EXPECT_NE(std::string::npos, response2.find("Connection: Keep-Alive\r\n"));
+
+  // New, accepted before the server stops.
+  loopback::TestClient client3;
+  ASSERT_TRUE(client3.Connect(server.port()));
+  std::this_thread::sleep_for(200ms);
+
+  auto start = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::duration stop_time{};
+  std::thread stop_thread{ [&] {
+    server.server().Stop();
+    stop_time = std::chrono::steady_clock::now() - start;
+  } };
+
+  response2.clear();
+  EXPECT_TRUE(client2.ReadUntilClosed(1s, &response2));
+  EXPECT_EQ("", response2);
+
+  ASSERT_TRUE(client3.Write("GET /hello HTTP/1.1\r\n"
+                            "Host: localhost\r\n\r\n"));
+  std::string response3;
+  EXPECT_TRUE(client3.ReadUntilClosed(5s, &response3));
+
+  std::this_thread::sleep_for(300ms);
+  view->Release();
+
+  std::string response1;
+  EXPECT_TRUE(client1.ReadUntilClosed(5s, &response1));
+
+  stop_thread.join();
+  server.Join();
+
+  EXPECT_LT(stop_time, 3s);
+
+  EXPECT_EQ(0, response1.compare(0, 12, "HTTP/1.1 200")) << response1;
+  EXPECT_NE(std::string::npos, response1.find("Connection: Close\r\n"));
+  EXPECT_EQ("Done", response1.substr(response1.size() - 4));
+
+  EXPECT_EQ(0, response3.compare(0, 12, "HTTP/1.1 200")) << response3;
+  EXPECT_NE(std::string::npos, response3.find("Connection: Close\r\n"));
+  EXPECT_EQ("Hello", response3.substr(response3.size() - 5));
+}
@@ -0,0 +1,78 @@
+#include "gtest/gtest.h"
+
+#include <string>
+
+#include "webcc/timer_wheel.h"
+
+using namespace webcc;
+using namespace std::chrono_literals;
+
+TEST(TimerWheelTest, Expire) {
+  asio::io_context io_context;
+  auto& wheel = asio::use_service<TimerWheel>(io_context);
+
+  std::string fired;
+
+  TimerWheel::Timer timer1;
+  TimerWheel::Timer timer2;
+  TimerWheel::Timer timer3;
+
+  wheel.Schedule(&timer2, 300ms, [&fired]() { fired += "2"; });
+  wheel.Schedule(&timer1, 100ms, [&fired]() { fired += "1"; });
+  wheel.Schedule(&timer3, 200ms, [&fired]() { fired += "3"; });
+
+  // The run() returns once no timer is pending.
+  auto start = std::chrono::steady_clock::now();
+  io_context.run();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  EXPECT_EQ("132", fired);
+  EXPECT_GE(elapsed, 300ms);
+}
+
+TEST(TimerWheelTest, Cancel) {
+  asio::io_context io_context;
+  auto& wheel = asio::use_service<TimerWheel>(io_context);
+
+  std::string fired;
+
+  TimerWheel::Timer timer1;
+  TimerWheel::Timer timer2;
+
+  wheel.Schedule(&timer1, 100ms, [&fired]() { fired += "1"; });
+  wheel.Schedule(&timer2, 200ms, [&fired]() { fired += "2"; });
+
+  wheel.Cancel(&timer1);
+
+  {
+    // Canceled on destruction.
+    TimerWheel::Timer timer3;
+    wheel.Schedule(&timer3, 100ms, [&fired]() { fired += "3"; });
+  }
+
+  io_context.run();
+
+  EXPECT_EQ("2", fired);
+}
+
+TEST(TimerWheelTest, Reschedule) {
+  asio::io_context io_context;
+  auto& wheel = asio::use_service<TimerWheel>(io_context);
+
+  std::string fired;
+
+  TimerWheel::Timer timer;
+
+  wheel.Schedule(&timer, 100ms, [&fired]() { fired += "a"; });
+
+  // Replace the pending one.
+  wheel.Schedule(&timer, 200ms, [&]() {
+    fired += "b";
+    // Schedule again in the handler.
+    wheel.Schedule(&timer, 100ms, [&fired]() { fired += "c"; });
+  });
+
+  io_context.run();
+
+  EXPECT_EQ("bc", fired);
+}
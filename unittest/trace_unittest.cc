@@ -0,0 +1,159 @@
+#include "gtest/gtest.h"
+
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "webcc/client_session.h"
+#include "webcc/request_builder.h"
+#include "webcc/trace.h"
+
+using namespace webcc;
+
+TEST(TraceTest, ParseTraceparent) {
+  TraceContext context;
+  EXPECT_TRUE(TraceContext::Parse(
+      "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01", &context));
+  EXPECT_EQ("4bf92f3577b34da6a3ce929d0e0e4736", context.trace_id);
+  EXPECT_EQ("00f067aa0ba902b7", context.span_id);
+  EXPECT_TRUE(context.sampled);
+  EXPECT_EQ("00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01",
+            context.ToTraceparent());
+
+  EXPECT_TRUE(TraceContext::Parse(
+      "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-00", &context));
+  EXPECT_FALSE(context.sampled);
+
+  // A future version could have more fields.
+  EXPECT_TRUE(TraceContext::Parse(
+      "01-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01-xyz",
+      &context));
+}
+
+TEST(TraceTest, ParseTraceparent_Invalid) {
+  const char* const kInvalid[] = {
+    "",
+    "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7",
+    "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01-",
+    "ff-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01",
+    "00-4BF92F3577B34DA6A3CE929D0E0E4736-00f067aa0ba902b7-01",
+    "00-00000000000000000000000000000000-00f067aa0ba902b7-01",
+    "00-4bf92f3577b34da6a3ce929d0e0e4736-0000000000000000-01",
+  };
+
+  for (const char* traceparent : kInvalid) {
+    TraceContext context;
+    EXPECT_FALSE(TraceContext::Parse(traceparent, &context)) << traceparent;
+    EXPECT_FALSE(context.valid());
+  }
+}
+
+TEST(TraceTest, Span) {
+  Span root{ "client" };
+  TraceContext context = root.context();
+  EXPECT_EQ(32, context.trace_id.size());
+  EXPECT_EQ(16, context.span_id.size());
+
+  // A child of the trace.
+  Span span{ "server", context };
+  EXPECT_EQ(context.trace_id, span.context().trace_id);
+  EXPECT_NE(context.span_id, span.context().span_id);
+
+  auto now = std::chrono::steady_clock::now();
+  span.AddEvent("accept", now - std::chrono::milliseconds(2));
+  span.AddEvent("first_byte", now);
+  span.SetAttribute("target", "/a\"b");
+
+  std::string json = span.ToJson();
+  EXPECT_NE(std::string::npos,
+            json.find("\"parent_id\":\"" + context.span_id + "\""));
+  EXPECT_NE(std::string::npos, json.find("\"attributes\":{\"target\":"
+                                         "\"/a\\\"b\"}"));
+  EXPECT_NE(std::string::npos,
+            json.find("\"events\":[{\"name\":\"accept\",\"us\":0},"
+                      "{\"name\":\"first_byte\",\"us\":2000}]"));
+}
+
+// The spans exported are all written out once the sink is destroyed.
+TEST(TraceTest, JsonLinesTraceSink) {
+  namespace sfs = std::filesystem;
+
+  sfs::path path = sfs::temp_directory_path() / "webcc_trace_unittest.json";
+  std::error_code ec;
+  sfs::remove(path, ec);
+
+  {
+    JsonLinesTraceSink sink{ path };
+    for (int i = 0; i < 3; ++i) {
+      Span span{ "server" };
+      span.AddEvent("accept");
+      sink.Export(span);
+    }
+  }
+
+  std::ifstream ifs{ path };
+  std::string line;
+  int count = 0;
+  while (std::getline(ifs, line)) {
+    EXPECT_EQ(0, line.find("{\"name\":\"server\""));
+    ++count;
+  }
+  EXPECT_EQ(3, count);
+
+  ifs.close();
+  sfs::remove(path, ec);
+}
+
+namespace {
+
+class RecordingTraceSink : public TraceSink {
+public:
+  void Export(const Span& span) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lines_.push_back(span.ToJson());
+  }
+
+  std::vector<std::string> lines() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lines_;
+  }
+
+private:
+  std::mutex mutex_;
+  std::vector<std::string> lines_;
+};
+
+}  // namespace
+
+// The `traceparent` injected is removed after sending, so that the span of the
+// same request sent again isn't a child of the previous one.
+TEST(TraceTest, ClientSession_Traceparent) {
+  auto sink = std::make_shared<RecordingTraceSink>();
+
+  ClientSession session;
+  session.set_trace_sink(sink);
+
+  // Nothing listens on the port, the sending fails.
+  auto request = RequestBuilder{}.Get("http://127.0.0.1:1/")();
+
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_THROW(session.Send(request), Error);
+    EXPECT_FALSE(request->HasHeader(headers::kTraceparent));
+  }
+
+  auto lines = sink->lines();
+  ASSERT_EQ(2, lines.size());
+  for (auto& line : lines) {
+    EXPECT_EQ(std::string::npos, line.find("parent_id"));
+  }
+
+  // The header of the caller is restored.
+  Span parent{ "server" };
+  std::string traceparent = parent.context().ToTraceparent();
+  request->SetHeader(headers::kTraceparent, traceparent);
+
+  EXPECT_THROW(session.Send(request), Error);
+  EXPECT_EQ(traceparent, request->GetHeader(headers::kTraceparent));
+}
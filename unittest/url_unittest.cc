@@ -81,3 +81,153 @@ TEST(UrlTest, Full) {
   EXPECT_EQ("/path/to", url.path());
   EXPECT_EQ("key=value", url.query());
 }
+
+TEST(UrlTest, Views) {
+  webcc::Url url("https://localhost:3000/path/to?key=value");
+
+  EXPECT_EQ("https", url.scheme_view());
+  EXPECT_EQ("localhost", url.host_view());
+  EXPECT_EQ("3000", url.port_view());
+  EXPECT_EQ("/path/to", url.path_view());
+  EXPECT_EQ("key=value", url.query_view());
+
+  // The views stay valid with a copy.
+  webcc::Url copy = url;
+  url.Clear();
+  EXPECT_EQ("localhost", copy.host_view());
+  EXPECT_EQ("key=value", copy.query_view());
+}
+
+TEST(UrlTest, IPv6) {
+  webcc::Url url("http://[::1]:8080/path");
+
+  EXPECT_EQ("[::1]", url.host());
+  EXPECT_EQ("8080", url.port());
+  EXPECT_EQ("/path", url.path());
+}
+
+// The "://" in the query is not a scheme.
+TEST(UrlTest, SchemeInQuery) {
+  webcc::Url url("/redirect?to=http://example.com");
+
+  EXPECT_EQ("", url.scheme());
+  EXPECT_EQ("", url.host());
+  EXPECT_EQ("/redirect", url.path());
+  EXPECT_EQ("to=http://example.com", url.query());
+}
+
+TEST(UrlTest, DecodedPath) {
+  webcc::Url url("/path/to%20file?key=a%20b");
+
+  EXPECT_EQ("/path/to%20file", url.path());
+  EXPECT_EQ("/path/to file", url.DecodedPath());
+  EXPECT_EQ("key=a%20b", url.query());
+
+  // Invalid encoding is kept as is.
+  EXPECT_EQ("/100%", webcc::Url::DecodePath("/100%"));
+}
+
+TEST(UrlTest, Parse_Reuse) {
+  webcc::Url url("https://localhost:3000/path/to?key=value");
+
+  url.Parse("/other");
+  EXPECT_EQ("", url.scheme());
+  EXPECT_EQ("", url.host());
+  EXPECT_EQ("", url.port());
+  EXPECT_EQ("/other", url.path());
+  EXPECT_EQ("", url.query());
+}
+
+TEST(UrlTest, Move) {
+  webcc::Url url("https://localhost:3000/path/to?key=value");
+
+  webcc::Url moved{ std::move(url) };
+  EXPECT_EQ("localhost", moved.host_view());
+  EXPECT_EQ("key=value", moved.query_view());
+
+  // The moved-from URL is empty.
+  EXPECT_EQ("", url.scheme_view());
+  EXPECT_EQ("", url.host_view());
+  EXPECT_EQ("", url.port_view());
+  EXPECT_EQ("", url.path_view());
+  EXPECT_EQ("", url.query_view());
+
+  url = std::move(moved);
+  EXPECT_EQ("/path/to", url.path_view());
+  EXPECT_EQ("", moved.host_view());
+  EXPECT_EQ("", moved.query_view());
+}
+
+TEST(UrlTest, Modify) {
+  webcc::Url url("http://example.com/path");
+
+  url.set_port("8080");
+  url.AppendPath("to");
+  url.AppendQuery("key", "value");
+
+  EXPECT_EQ("http", url.scheme());
+  EXPECT_EQ("example.com", url.host());
+  EXPECT_EQ("8080", url.port());
+  EXPECT_EQ("/path/to", url.path());
+  EXPECT_EQ("key=value", url.query());
+}
+
+// -----------------------------------------------------------------------------
+
+TEST(UrlQueryViewTest, Basic) {
+  webcc::UrlQueryView query("name=a%20b&page=2&flag&empty=");
+
+  EXPECT_EQ(3, query.Size());
+  EXPECT_TRUE(query.Has("name"));
+  EXPECT_TRUE(query.Has("empty"));
+  EXPECT_FALSE(query.Has("flag"));
+
+  EXPECT_EQ("a b", query.Get("name"));
+  EXPECT_EQ("a%20b", query.GetRaw("name"));
+  EXPECT_EQ("2", query.Get("page"));
+  EXPECT_EQ("", query.Get("empty"));
+  EXPECT_EQ("", query.Get("missing"));
+  EXPECT_EQ("", query.GetRaw("missing"));
+
+  auto parameter = query.Get(0);
+  EXPECT_EQ("name", parameter.first);
+  EXPECT_EQ("a b", parameter.second);
+}
+
+TEST(UrlQueryViewTest, EncodedKey) {
+  webcc::UrlQueryView query("first%20name=Adam&last=Chen");
+
+  EXPECT_EQ("Adam", query.Get("first name"));
+  EXPECT_FALSE(query.Has("first%20name"));
+  EXPECT_EQ("first name", query.Get(0).first);
+}
+
+TEST(UrlQueryViewTest, Duplicate) {
+  webcc::UrlQueryView query("key=1&key=2");
+
+  EXPECT_EQ(2, query.Size());
+  EXPECT_EQ("1", query.Get("key"));
+}
+
+// Enough parameters to be looked up through the hash index.
+TEST(UrlQueryViewTest, Index) {
+  std::string str;
+  for (int i = 0; i < 50; ++i) {
+    str += "key" + std::to_string(i) + "=" + std::to_string(i) + "&";
+  }
+  str += "key0=duplicate&x%2Cy=z";
+
+  webcc::UrlQueryView query(str);
+
+  EXPECT_EQ(52, query.Size());
+  for (int i = 0; i < 50; ++i) {
+    EXPECT_EQ(std::to_string(i), query.Get("key" + std::to_string(i)));
+  }
+  EXPECT_EQ("z", query.Get("x,y"));
+  EXPECT_FALSE(query.Has("key50"));
+
+  query.Parse("a=1");
+  EXPECT_EQ(1, query.Size());
+  EXPECT_EQ("1", query.Get("a"));
+  EXPECT_FALSE(query.Has("key0"));
+}
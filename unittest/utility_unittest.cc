@@ -0,0 +1,59 @@
+#include "gtest/gtest.h"
+
+#include <filesystem>
+
+#include "webcc/utility.h"
+
+namespace sfs = std::filesystem;
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+// Check if |path| is under |doc_root| lexically.
+bool IsUnder(const sfs::path& path, const sfs::path& doc_root) {
+  auto relative = path.lexically_normal().lexically_relative(doc_root);
+  return !relative.empty() && *relative.begin() != "..";
+}
+
+}  // namespace
+
+TEST(UtilityTest, GetStaticPath) {
+  const sfs::path doc_root{ "/var/www" };
+
+  EXPECT_EQ(doc_root / "index.html",
+            webcc::utility::GetStaticPath(doc_root, "/index.html"));
+  EXPECT_EQ(doc_root / "css" / "main.css",
+            webcc::utility::GetStaticPath(doc_root, "/css/main.css"));
+  EXPECT_EQ(doc_root / "a" / "b",
+            webcc::utility::GetStaticPath(doc_root, "/a/./b"));
+}
+
+TEST(UtilityTest, GetStaticPath_OutOfDocRoot) {
+  const sfs::path doc_root{ "/var/www" };
+
+  EXPECT_TRUE(webcc::utility::GetStaticPath(doc_root, "/../x").empty());
+  EXPECT_TRUE(webcc::utility::GetStaticPath(doc_root, "/a/../../x").empty());
+  EXPECT_TRUE(webcc::utility::GetStaticPath(doc_root, "/a/..").empty());
+  EXPECT_TRUE(webcc::utility::GetStaticPath(doc_root, "..").empty());
+}
+
+// An absolute path is mapped under the doc root instead of replacing it.
+TEST(UtilityTest, GetStaticPath_Absolute) {
+  const sfs::path doc_root{ "/var/www" };
+
+  for (const char* url : { "/etc/passwd", "//etc/passwd", "///etc/passwd",
+                           "etc/passwd" }) {
+    sfs::path path = webcc::utility::GetStaticPath(doc_root, url);
+    EXPECT_EQ(doc_root / "etc" / "passwd", path) << url;
+    EXPECT_TRUE(IsUnder(path, doc_root)) << url;
+  }
+
+#if (defined(_WIN32) || defined(_WIN64))
+  for (const char* url : { "C:/Windows/win.ini", "/C:/Windows/win.ini",
+                           "\\\\server\\share\\x" }) {
+    sfs::path path = webcc::utility::GetStaticPath(doc_root, url);
+    EXPECT_TRUE(path.empty() || IsUnder(path, doc_root)) << url;
+  }
+#endif  // defined(_WIN32) || defined(_WIN64)
+}
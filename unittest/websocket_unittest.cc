@@ -0,0 +1,272 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "webcc/websocket.h"
+
+#include "loopback.h"
+
+using namespace webcc;
+
+// The example in RFC 6455 1.3.
+TEST(WebSocketTest, ComputeAccept) {
+  EXPECT_EQ("s3pPLMBiTxaQ9kYGzzhZRbK+xOo=",
+            websocket::ComputeAccept("dGhlIHNhbXBsZSBub25jZQ=="));
+}
+
+TEST(WebSocketTest, ApplyMask) {
+  const std::uint8_t key[4] = { 0x37, 0xfa, 0x21, 0x3d };
+
+  std::string data;
+  for (int i = 0; i < 100; ++i) {
+    data += static_cast<char>(i * 7);
+  }
+
+  // Compare with a byte-by-byte implementation.
+  std::string expected = data;
+  for (std::size_t i = 0; i < expected.size(); ++i) {
+    expected[i] ^= key[i % 4];
+  }
+
+  std::string masked = data;
+  websocket::ApplyMask(&masked[0], masked.size(), key);
+  EXPECT_EQ(expected, masked);
+
+  // Mask piece by piece with unaligned offsets.
+  masked = data;
+  websocket::ApplyMask(&masked[0], 3, key, 0);
+  websocket::ApplyMask(&masked[3], 10, key, 3);
+  websocket::ApplyMask(&masked[13], 87, key, 13);
+  EXPECT_EQ(expected, masked);
+
+  // Unmask.
+  websocket::ApplyMask(&masked[0], masked.size(), key);
+  EXPECT_EQ(data, masked);
+}
+
+// The unmasked text message example in RFC 6455 5.7.
+TEST(WebSocketTest, AppendFrame) {
+  std::string frame;
+  websocket::AppendFrame(websocket::kText, "Hello", 5, true, &frame);
+  EXPECT_EQ(std::string("\x81\x05\x48\x65\x6c\x6c\x6f"), frame);
+
+  frame.clear();
+  websocket::AppendFrame(websocket::kText, "Hel", 3, false, &frame);
+  EXPECT_EQ(std::string("\x01\x03\x48\x65\x6c"), frame);
+
+  frame.clear();
+  std::string payload(256, 'a');
+  websocket::AppendFrame(websocket::kBinary, payload.data(), payload.size(),
+                         true, &frame);
+  EXPECT_EQ(std::string("\x82\x7e\x01\x00", 4), frame.substr(0, 4));
+  EXPECT_EQ(4 + payload.size(), frame.size());
+
+  frame.clear();
+  payload.assign(65536, 'a');
+  websocket::AppendFrame(websocket::kBinary, payload.data(), payload.size(),
+                         true, &frame);
+  EXPECT_EQ(std::string("\x82\x7f\x00\x00\x00\x00\x00\x01\x00\x00", 10),
+            frame.substr(0, 10));
+  EXPECT_EQ(10 + payload.size(), frame.size());
+}
+
+TEST(WebSocketTest, IsValidUtf8) {
+  auto valid = [](const std::string& s) {
+    return websocket::IsValidUtf8(s.data(), s.size());
+  };
+
+  EXPECT_TRUE(valid(""));
+  EXPECT_TRUE(valid("Hello"));
+  EXPECT_TRUE(valid("\xC2\xA9"));              // U+00A9
+  EXPECT_TRUE(valid("\xE4\xBD\xA0\xE5\xA5\xBD"));  // U+4F60 U+597D
+  EXPECT_TRUE(valid("\xED\x9F\xBF"));          // U+D7FF
+  EXPECT_TRUE(valid("\xF0\x9F\x98\x80"));      // U+1F600
+  EXPECT_TRUE(valid("\xF4\x8F\xBF\xBF"));      // U+10FFFF
+  EXPECT_TRUE(valid(std::string("a\0b", 3)));
+
+  EXPECT_FALSE(valid("\x80"));                 // Continuation byte
+  EXPECT_FALSE(valid("\xC0\xAF"));             // Overlong
+  EXPECT_FALSE(valid("\xE0\x80\xAF"));         // Overlong
+  EXPECT_FALSE(valid("\xF0\x80\x80\xAF"));     // Overlong
+  EXPECT_FALSE(valid("\xED\xA0\x80"));         // U+D800, surrogate
+  EXPECT_FALSE(valid("\xF4\x90\x80\x80"));     // Above U+10FFFF
+  EXPECT_FALSE(valid("\xF5\x80\x80\x80"));
+  EXPECT_FALSE(valid("\xE4\xBD"));             // Truncated
+  EXPECT_FALSE(valid("\xE4\x41\xA0"));
+  EXPECT_FALSE(valid("\xFF"));
+}
+
+TEST(WebSocketTest, IsValidCloseCode) {
+  EXPECT_TRUE(websocket::IsValidCloseCode(1000));
+  EXPECT_TRUE(websocket::IsValidCloseCode(1003));
+  EXPECT_TRUE(websocket::IsValidCloseCode(1007));
+  EXPECT_TRUE(websocket::IsValidCloseCode(1011));
+  EXPECT_TRUE(websocket::IsValidCloseCode(3000));
+  EXPECT_TRUE(websocket::IsValidCloseCode(4999));
+
+  EXPECT_FALSE(websocket::IsValidCloseCode(0));
+  EXPECT_FALSE(websocket::IsValidCloseCode(999));
+  EXPECT_FALSE(websocket::IsValidCloseCode(1004));
+  EXPECT_FALSE(websocket::IsValidCloseCode(1005));
+  EXPECT_FALSE(websocket::IsValidCloseCode(1006));
+  EXPECT_FALSE(websocket::IsValidCloseCode(1015));
+  EXPECT_FALSE(websocket::IsValidCloseCode(2999));
+  EXPECT_FALSE(websocket::IsValidCloseCode(5000));
+}
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+const std::chrono::seconds kTimeout{ 5 };
+
+// Echo the messages back.
+class EchoView : public WebSocketView {
+protected:
+  void OnMessage(WebSocketConnectionPtr connection, std::string&& message,
+                 bool binary) override {
+    connection->Send(message, binary);
+  }
+};
+
+// A frame as sent by a client, masked unless |masked| is false.
+std::string ClientFrame(websocket::Opcode opcode, const std::string& payload,
+                        bool fin = true, bool masked = true) {
+  std::string frame;
+  websocket::AppendFrame(opcode, payload.data(), payload.size(), fin, &frame);
+
+  if (masked) {
+    const std::uint8_t key[4] = { 0x37, 0xfa, 0x21, 0x3d };
+    std::size_t header_size = frame.size() - payload.size();
+    frame[1] = static_cast<char>(frame[1] | 0x80);
+    websocket::ApplyMask(&frame[header_size], payload.size(), key);
+    frame.insert(header_size, reinterpret_cast<const char*>(key), 4);
+  }
+  return frame;
+}
+
+// A Close frame payload: the status code followed by the reason.
+std::string ClosePayload(std::uint16_t code, const std::string& reason = "") {
+  std::string payload;
+  payload += static_cast<char>((code >> 8) & 0xff);
+  payload += static_cast<char>(code & 0xff);
+  return payload + reason;
+}
+
+// Send the opening handshake and read the 101 response.
+// The data received after the response is left in |input|.
+bool Handshake(loopback::TestClient* client, std::string* input) {
+  client->Write("GET /ws HTTP/1.1\r\n"
+                "Host: localhost\r\n"
+                "Upgrade: websocket\r\n"
+                "Connection: Upgrade\r\n"
+                "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                "Sec-WebSocket-Version: 13\r\n\r\n");
+
+  if (!client->ReadUntil("\r\n\r\n", kTimeout, input)) {
+    return false;
+  }
+
+  std::size_t end = input->find("\r\n\r\n") + 4;
+  std::string response = input->substr(0, end);
+  input->erase(0, end);
+
+  return response.compare(0, 12, "HTTP/1.1 101") == 0 &&
+         response.find("Sec-WebSocket-Accept: "
+                       "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") != std::string::npos;
+}
+
+// Read a frame sent by the server, whose payload is less than 126 bytes.
+// Return the first byte (FIN and opcode) and the payload.
+bool ReadFrame(loopback::TestClient* client, std::string* input,
+               std::uint8_t* first, std::string* payload) {
+  while (input->size() < 2 ||
+         input->size() < 2 + (static_cast<std::uint8_t>((*input)[1]) & 0x7f)) {
+    if (!client->ReadSome(kTimeout, input)) {
+      return false;
+    }
+  }
+
+  std::size_t length = static_cast<std::uint8_t>((*input)[1]) & 0x7f;
+  *first = static_cast<std::uint8_t>((*input)[0]);
+  payload->assign(*input, 2, length);
+  input->erase(0, 2 + length);
+  return true;
+}
+
+}  // namespace
+
+TEST(WebSocketTest, Loopback) {
+  loopback::TestServer server;
+  server.server().Route("/ws", std::make_shared<EchoView>());
+  ASSERT_TRUE(server.Start());
+
+  loopback::TestClient client;
+  ASSERT_TRUE(client.Connect(server.port()));
+
+  std::string input;
+  ASSERT_TRUE(Handshake(&client, &input));
+
+  std::uint8_t first = 0;
+  std::string payload;
+
+  // Masked text message.
+  client.Write(ClientFrame(websocket::kText, "Hello"));
+  ASSERT_TRUE(ReadFrame(&client, &input, &first, &payload));
+  EXPECT_EQ(0x81, first);
+  EXPECT_EQ("Hello", payload);
+
+  // Ping.
+  client.Write(ClientFrame(websocket::kPing, "ping"));
+  ASSERT_TRUE(ReadFrame(&client, &input, &first, &payload));
+  EXPECT_EQ(0x8a, first);
+  EXPECT_EQ("ping", payload);
+
+  // Fragmented message, with a ping between the fragments.
+  client.Write(ClientFrame(websocket::kText, "Hel", false) +
+               ClientFrame(websocket::kPing, "") +
+               ClientFrame(websocket::kContinuation, "lo, ", false) +
+               ClientFrame(websocket::kContinuation, "World", true));
+  ASSERT_TRUE(ReadFrame(&client, &input, &first, &payload));
+  EXPECT_EQ(0x8a, first);
+  EXPECT_EQ("", payload);
+  ASSERT_TRUE(ReadFrame(&client, &input, &first, &payload));
+  EXPECT_EQ(0x81, first);
+  EXPECT_EQ("Hello, World", payload);
+
+  // Closing handshake: the status code is echoed, then the socket closed.
+  client.Write(ClientFrame(websocket::kClose,
+                           ClosePayload(websocket::kGoingAway, "bye")));
+  ASSERT_TRUE(ReadFrame(&client, &input, &first, &payload));
+  EXPECT_EQ(0x88, first);
+  EXPECT_EQ(ClosePayload(websocket::kGoingAway), payload);
+
+  EXPECT_TRUE(client.ReadUntilClosed(kTimeout, &input));
+  EXPECT_EQ("", input);
+}
+
+// The frames from a client must be masked (RFC 6455 5.1).
+TEST(WebSocketTest, Loopback_Unmasked) {
+  loopback::TestServer server;
+  server.server().Route("/ws", std::make_shared<EchoView>());
+  ASSERT_TRUE(server.Start());
+
+  loopback::TestClient client;
+  ASSERT_TRUE(client.Connect(server.port()));
+
+  std::string input;
+  ASSERT_TRUE(Handshake(&client, &input));
+
+  client.Write(ClientFrame(websocket::kText, "Hello", true, false));
+
+  std::uint8_t first = 0;
+  std::string payload;
+  ASSERT_TRUE(ReadFrame(&client, &input, &first, &payload));
+  EXPECT_EQ(0x88, first);
+  EXPECT_EQ(ClosePayload(websocket::kProtocolError), payload);
+
+  EXPECT_TRUE(client.ReadUntilClosed(kTimeout, &input));
+}
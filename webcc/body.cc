@@ -228,4 +228,78 @@ bool FileBody::Move(const std::filesystem::path& new_path) {
   return true;
 }
 
+// -----------------------------------------------------------------------------
+
+bool StreamBody::Write(std::string&& data) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) {
+      return false;
+    }
+    pending_.push_back(std::move(data));
+  }
+
+  Notify();
+  return true;
+}
+
+void StreamBody::Close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) {
+      return;
+    }
+    closed_ = true;
+  }
+
+  Notify();
+}
+
+bool StreamBody::closed() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return closed_;
+}
+
+bool StreamBody::ended() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return closed_ && pending_.empty();
+}
+
+void StreamBody::set_notifier(Notifier notifier) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  notifier_ = std::move(notifier);
+}
+
+Payload StreamBody::NextPayload(bool /*free_previous*/) {
+  sending_.clear();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sending_.swap(pending_);
+  }
+
+  Payload payload;
+  payload.reserve(sending_.size());
+  for (auto& data : sending_) {
+    payload.push_back(asio::buffer(data));
+  }
+  return payload;
+}
+
+void StreamBody::Dump(std::ostream& os, const std::string& prefix) const {
+  os << prefix << "<stream>" << std::endl;
+}
+
+void StreamBody::Notify() {
+  Notifier notifier;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    notifier = notifier_;
+  }
+
+  if (notifier) {
+    notifier();
+  }
+}
+
 }  // namespace webcc
@@ -3,9 +3,12 @@
 
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "webcc/common.h"
 
@@ -200,6 +203,84 @@ private:
   std::string chunk_;
 };
 
+// -----------------------------------------------------------------------------
+
+// Body of a long-lived response whose data is written later, possibly from
+// other threads, until the stream is closed. See EventStream.
+// The response has no `Content-Length`, and the connection is closed once the
+// stream has been closed and all the data has been sent.
+// The connection doesn't occupy a worker thread while waiting for the data.
+class StreamBody : public Body {
+public:
+  // Called (in the writing thread) when new data has been written or the
+  // stream has been closed.
+  using Notifier = std::function<void()>;
+
+  StreamBody() = default;
+
+  // Write data to the stream.
+  // Return false if the stream has been closed, e.g., the client has gone.
+  // Could be called from any thread.
+  bool Write(std::string&& data);
+
+  bool Write(const std::string& data) {
+    return Write(std::string{ data });
+  }
+
+  // Close the stream. The data written will still be sent.
+  // Could be called from any thread.
+  void Close();
+
+  bool closed() const;
+
+  // The stream has been closed and all the data has been taken.
+  bool ended() const;
+
+  // Write |data| once the stream has been idle for |seconds|, to keep the
+  // connection alive through proxies and to detect gone clients earlier.
+  // 0 for no heartbeat. Set it before the response is returned.
+  void set_heartbeat(int seconds, const std::string& data) {
+    heartbeat_seconds_ = seconds;
+    heartbeat_data_ = data;
+  }
+
+  int heartbeat_seconds() const {
+    return heartbeat_seconds_;
+  }
+
+  const std::string& heartbeat_data() const {
+    return heartbeat_data_;
+  }
+
+  // Set by the connection sending the response.
+  void set_notifier(Notifier notifier);
+
+  // Take all the data written since last call.
+  // The payload is valid until next call.
+  // An empty payload means no data for now, check ended() for the end.
+  Payload NextPayload(bool free_previous = false) override;
+
+  void Dump(std::ostream& os, const std::string& prefix) const override;
+
+private:
+  // Notify the connection outside the lock.
+  void Notify();
+
+  std::vector<std::string> pending_;
+  std::vector<std::string> sending_;
+
+  bool closed_ = false;
+
+  Notifier notifier_;
+
+  int heartbeat_seconds_ = 0;
+  std::string heartbeat_data_;
+
+  mutable std::mutex mutex_;
+};
+
+using StreamBodyPtr = std::shared_ptr<StreamBody>;
+
 }  // namespace webcc
 
 #endif  // WEBCC_BODY_H_
@@ -7,26 +7,28 @@ using asio::ip::tcp;
 namespace webcc {
 
 Client::Client()
-    : timer_(io_context_),
+    : timer_wheel_(asio::use_service<TimerWheel>(io_context_)),
+      buffer_(kBufferSize),
       ssl_verify_(true),
       buffer_size_(kBufferSize),
       timeout_(kMaxReadSeconds),
+      connect_timeout_(kMaxConnectSeconds),
+      http2_(false),
       closed_(false),
-      timer_canceled_(false) {
+      metrics_(nullptr),
+      first_byte_pending_(false),
+      span_(nullptr) {
 }
 
 Error Client::Request(RequestPtr request, bool connect, bool stream) {
   closed_ = false;
-  timer_canceled_ = false;
   error_ = Error{};
+  span_ = request->span().get();
 
   response_.reset(new Response{});
   response_parser_.Init(response_.get(), stream);
 
-  if (buffer_.size() != buffer_size_) {
-    LOG_VERB("Resize buffer: %u -> %u.", buffer_.size(), buffer_size_);
-    buffer_.resize(buffer_size_);
-  }
+  buffer_.set_min_size(buffer_size_);
 
   // Response to HEAD could also have Content-Length.
   // Set this flag to skip the reading and parsing of the body.
@@ -53,6 +55,17 @@ Error Client::Request(RequestPtr request, bool connect, bool stream) {
     }
   }
 
+  first_byte_pending_ = true;
+  if (metrics_ != nullptr) {
+    request_start_ = std::chrono::steady_clock::now();
+  }
+
+  if (http2_session_) {
+    DoHttp2Request(request, stream);
+    buffer_.Release();
+    return error_;
+  }
+
   WriteRequest(request);
 
   if (error_) {
@@ -61,6 +74,9 @@ Error Client::Request(RequestPtr request, bool connect, bool stream) {
 
   ReadResponse();
 
+  // Don't hold the buffer while the connection is idle.
+  buffer_.Release();
+
   return error_;
 }
 
@@ -77,10 +93,17 @@ void Client::Close() {
 }
 
 void Client::Connect(RequestPtr request) {
-  if (request->url().scheme() == "https") {
+  http2_session_.reset();
+
+  if (request->url().scheme_view() == "https") {
 #if WEBCC_ENABLE_SSL
-    socket_.reset(new SslSocket{ io_context_, ssl_verify_ });
+    socket_.reset(new SslSocket{ io_context_, ssl_verify_, http2_ });
     DoConnect(request, "443");
+
+    if (!error_ && http2_ && socket_->GetAlpnProtocol() == "h2") {
+      LOG_INFO("HTTP/2 negotiated by ALPN.");
+      http2_session_.reset(new Http2Session{ false });
+    }
 #else
     LOG_ERRO("SSL/HTTPS support is not enabled.");
     error_.Set(Error::kSyntaxError, "SSL/HTTPS is not supported");
@@ -88,6 +111,10 @@ void Client::Connect(RequestPtr request) {
   } else {
     socket_.reset(new Socket{ io_context_ });
     DoConnect(request, "80");
+
+    if (!error_ && http2_) {
+      http2_session_.reset(new Http2Session{ false });
+    }
   }
 }
 
@@ -101,8 +128,19 @@ void Client::DoConnect(RequestPtr request, const std::string& default_port) {
 
   LOG_VERB("Resolve host (%s)...", request->host().c_str());
 
+  auto start = std::chrono::steady_clock::now();
+
+  // Resolve both IPv4 and IPv6 endpoints; they will be connected in parallel.
   std::error_code ec;
-  auto endpoints = resolver.resolve(tcp::v4(), request->host(), port, ec);
+  auto endpoints = resolver.resolve(request->host(), port, ec);
+
+  if (metrics_ != nullptr) {
+    auto now = std::chrono::steady_clock::now();
+    metrics_->resolve->Record(now - start);
+    start = now;
+  }
+
+  AddSpanEvent("resolved");
 
   if (ec) {
     LOG_ERRO("Host resolve error (%s): %s, %s.", ec.message().c_str(),
@@ -111,17 +149,39 @@ void Client::DoConnect(RequestPtr request, const std::string& default_port) {
     return;
   }
 
-  LOG_VERB("Connect to server...");
-
-  // Use sync API directly since we don't need timeout control.
+  LOG_VERB("Connect to server (timeout: %ds)...", connect_timeout_);
 
-  if (!socket_->Connect(request->host(), endpoints)) {
+  if (!socket_->Connect(endpoints, connect_timeout_, &ec)) {
     error_.Set(Error::kConnectError, "Endpoint connect error");
+    if (ec == asio::error::timed_out) {
+      error_.set_timeout(true);
+    }
     Close();
     return;
   }
 
+  if (metrics_ != nullptr) {
+    auto now = std::chrono::steady_clock::now();
+    metrics_->connect->Record(now - start);
+    start = now;
+  }
+
+  AddSpanEvent("connected");
+
   LOG_VERB("Socket connected.");
+
+  if (!socket_->Handshake(request->host(), &ec)) {
+    error_.Set(Error::kConnectError, "Handshake error");
+    Close();
+    return;
+  }
+
+  if (request->url().scheme_view() == "https") {
+    if (metrics_ != nullptr) {
+      metrics_->handshake->Record(std::chrono::steady_clock::now() - start);
+    }
+    AddSpanEvent("handshake_done");
+  }
 }
 
 void Client::WriteRequest(RequestPtr request) {
@@ -136,15 +196,24 @@ void Client::WriteRequest(RequestPtr request) {
 
   std::error_code ec;
 
-  if (socket_->Write(request->GetPayload(), &ec)) {
-    // Write request body.
-    auto body = request->body();
-    body->InitPayload();
+  // Write the headers together with the first payload of the body.
+  auto body = request->body();
+  body->InitPayload();
+
+  Payload payload = request->GetPayload();
+  Payload body_payload = body->NextPayload(true);
+  payload.insert(payload.end(), body_payload.begin(), body_payload.end());
+
+  if (socket_->Write(payload, &ec)) {
+    AddBytesOut(payload);
+
+    // Write the rest of the body.
     for (auto p = body->NextPayload(true); !p.empty();
          p = body->NextPayload(true)) {
       if (!socket_->Write(p, &ec)) {
         break;
       }
+      AddBytesOut(p);
     }
   }
 
@@ -152,8 +221,11 @@ void Client::WriteRequest(RequestPtr request) {
     LOG_ERRO("Socket write error (%s).", ec.message().c_str());
     Close();
     error_.Set(Error::kSocketWriteError, "Socket write error");
+    return;
   }
 
+  AddSpanEvent("request_written");
+
   LOG_INFO("Request sent.");
 }
 
@@ -168,43 +240,9 @@ void Client::ReadResponse() {
 }
 
 void Client::DoReadResponse() {
-  std::error_code ec = asio::error::would_block;
   std::size_t length = 0;
 
-  // The read handler.
-  auto handler = [&ec, &length](std::error_code inner_ec,
-                                std::size_t inner_length) {
-    ec = inner_ec;
-    length = inner_length;
-  };
-
-  while (true) {
-    ec = asio::error::would_block;
-    length = 0;
-
-    socket_->AsyncReadSome(std::move(handler), &buffer_);
-
-    // Start the timer.
-    DoWaitTimer();
-
-    // Block until the asynchronous operation has completed.
-    do {
-      io_context_.run_one();
-    } while (ec == asio::error::would_block);
-
-    // Stop the timer.
-    CancelTimer();
-
-    // The error normally is caused by timeout. See OnTimer().
-    if (ec || length == 0) {
-      Close();
-      error_.Set(Error::kSocketReadError, "Socket read error");
-      LOG_ERRO("Socket read error (%s).", ec.message().c_str());
-      break;
-    }
-
-    LOG_INFO("Read data, length: %u.", length);
-
+  while (ReadSome(&length)) {
     // Parse the piece of data just read.
     if (!response_parser_.Parse(buffer_.data(), length)) {
       Close();
@@ -231,48 +269,154 @@ void Client::DoReadResponse() {
   }
 }
 
-void Client::DoWaitTimer() {
-  LOG_VERB("Wait timer asynchronously.");
-  timer_.expires_after(std::chrono::seconds(timeout_));
-  timer_.async_wait(std::bind(&Client::OnTimer, this, std::placeholders::_1));
-}
+void Client::DoHttp2Request(RequestPtr request, bool stream) {
+  LOG_VERB("HTTP/2 request:\n%s", request->Dump().c_str());
 
-void Client::OnTimer(std::error_code ec) {
-  LOG_VERB("On timer.");
+  std::uint32_t stream_id = http2_session_->SendRequest(request, stream);
 
-  // timer_.cancel() was called.
-  if (ec == asio::error::operation_aborted) {
-    LOG_VERB("Timer canceled.");
-    return;
+  std::string output;
+  ResponsePtr response;
+
+  while (true) {
+    // Write the frames of the request, as well as the control frames, e.g.,
+    // SETTINGS ACK and WINDOW_UPDATE.
+    while (http2_session_->GetOutput(&output)) {
+      std::error_code ec;
+      if (!socket_->Write({ asio::buffer(output) }, &ec)) {
+        LOG_ERRO("Socket write error (%s).", ec.message().c_str());
+        Close();
+        error_.Set(Error::kSocketWriteError, "Socket write error");
+        return;
+      }
+
+      if (metrics_ != nullptr) {
+        metrics_->bytes_out->Add(output.size());
+      }
+    }
+
+    if (http2_session_->TakeResponse(stream_id, &response)) {
+      break;
+    }
+
+    if (http2_session_->closed()) {
+      Close();
+      error_.Set(Error::kSocketReadError, "HTTP/2 connection closed");
+      return;
+    }
+
+    std::size_t length = 0;
+    if (!ReadSome(&length)) {
+      return;
+    }
+
+    if (!http2_session_->Feed(buffer_.data(), length)) {
+      // Try to send GOAWAY before closing.
+      if (http2_session_->GetOutput(&output)) {
+        std::error_code ec;
+        socket_->Write({ asio::buffer(output) }, &ec);
+      }
+      Close();
+      error_.Set(Error::kParseError, "HTTP/2 protocol error");
+      return;
+    }
   }
 
-  if (closed_) {
-    LOG_VERB("Socket has been closed.");
+  if (!response) {
+    error_.Set(Error::kParseError, "HTTP/2 stream reset");
     return;
   }
 
-  if (timer_.expiry() <= asio::steady_timer::clock_type::now()) {
-    // The deadline has passed. The socket is closed so that any outstanding
-    // asynchronous operations are canceled.
-    LOG_WARN("HTTP client timed out.");
-    error_.set_timeout(true);
+  response_ = response;
+
+  LOG_VERB("HTTP/2 response:\n%s", response_->Dump().c_str());
+
+  if (http2_session_->closed()) {
     Close();
-    return;
   }
+}
+
+bool Client::ReadSome(std::size_t* length) {
+  std::error_code ec = asio::error::would_block;
+  *length = 0;
+
+  // The read handler.
+  auto handler = [&ec, length](std::error_code inner_ec,
+                               std::size_t inner_length) {
+    ec = inner_ec;
+    *length = inner_length;
+  };
 
-  // Put the actor back to sleep.
+  socket_->AsyncReadSome(std::move(handler), buffer_.Prepare());
+
+  // Start the timer.
   DoWaitTimer();
+
+  // Block until the asynchronous operation has completed.
+  do {
+    io_context_.run_one();
+  } while (ec == asio::error::would_block);
+
+  // Stop the timer.
+  CancelTimer();
+
+  // The error normally is caused by timeout. See OnTimer().
+  if (ec || *length == 0) {
+    Close();
+    error_.Set(Error::kSocketReadError, "Socket read error");
+    LOG_ERRO("Socket read error (%s).", ec.message().c_str());
+    return false;
+  }
+
+  LOG_INFO("Read data, length: %u.", *length);
+
+  buffer_.Commit(*length);
+
+  if (first_byte_pending_) {
+    first_byte_pending_ = false;
+    if (metrics_ != nullptr) {
+      metrics_->first_byte->Record(std::chrono::steady_clock::now() -
+                                   request_start_);
+    }
+    AddSpanEvent("first_byte");
+  }
+
+  if (metrics_ != nullptr) {
+    metrics_->bytes_in->Add(*length);
+  }
+
+  return true;
 }
 
-void Client::CancelTimer() {
-  if (timer_canceled_) {
+void Client::AddBytesOut(const Payload& payload) {
+  if (metrics_ != nullptr) {
+    metrics_->bytes_out->Add(asio::buffer_size(payload));
+  }
+}
+
+void Client::DoWaitTimer() {
+  LOG_VERB("Wait timer asynchronously.");
+  timer_wheel_.Schedule(&timer_, std::chrono::seconds(timeout_),
+                        std::bind(&Client::OnTimer, this));
+}
+
+void Client::OnTimer() {
+  LOG_VERB("On timer.");
+
+  if (closed_) {
+    LOG_VERB("Socket has been closed.");
     return;
   }
 
-  LOG_INFO("Cancel timer...");
-  timer_.cancel();
+  // The deadline has passed. The socket is closed so that any outstanding
+  // asynchronous operations are canceled.
+  LOG_WARN("HTTP client timed out.");
+  error_.set_timeout(true);
+  Close();
+}
 
-  timer_canceled_ = true;
+void Client::CancelTimer() {
+  LOG_VERB("Cancel timer...");
+  timer_wheel_.Cancel(&timer_);
 }
 
 }  // namespace webcc
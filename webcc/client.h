@@ -2,19 +2,23 @@
 #define WEBCC_CLIENT_H_
 
 #include <cassert>
+#include <chrono>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "asio/io_context.hpp"
 #include "asio/ip/tcp.hpp"
-#include "asio/steady_timer.hpp"
 
 #include "webcc/globals.h"
+#include "webcc/http2.h"
+#include "webcc/metrics.h"
+#include "webcc/read_buffer.h"
 #include "webcc/request.h"
 #include "webcc/response.h"
 #include "webcc/response_parser.h"
 #include "webcc/socket.h"
+#include "webcc/timer_wheel.h"
 
 namespace webcc {
 
@@ -48,6 +52,27 @@ public:
     }
   }
 
+  // Set the timeout (in seconds) for connecting to the server.
+  void set_connect_timeout(int connect_timeout) {
+    if (connect_timeout > 0) {
+      connect_timeout_ = connect_timeout;
+    }
+  }
+
+  // Use HTTP/2 if possible. For HTTPS, it's negotiated with the server by
+  // ALPN; for HTTP, the server must be known to support HTTP/2 since the
+  // connection starts with HTTP/2 directly (prior knowledge).
+  // The requests are sent one by one on the same connection, each in a new
+  // stream.
+  void set_http2(bool http2) {
+    http2_ = http2;
+  }
+
+  // Set the metrics of the host to update, null to disable.
+  void set_metrics(HostMetrics* metrics) {
+    metrics_ = metrics;
+  }
+
   // Connect to server, send request, wait until response is received.
   Error Request(RequestPtr request, bool connect = true, bool stream = false);
 
@@ -77,14 +102,31 @@ private:
 
   void WriteRequest(RequestPtr request);
 
+  // Count the bytes written for the metrics.
+  void AddBytesOut(const Payload& payload);
+
+  // Add an event to the span of the request, if any.
+  void AddSpanEvent(const char* name) {
+    if (span_ != nullptr) {
+      span_->AddEvent(name);
+    }
+  }
+
   void ReadResponse();
 
   void DoReadResponse();
 
+  // Send the request and read the response over HTTP/2.
+  void DoHttp2Request(RequestPtr request, bool stream);
+
+  // Read some data with timeout control.
+  // Return false (and close the socket) on error or timeout.
+  bool ReadSome(std::size_t* length);
+
   void DoWaitTimer();
-  void OnTimer(std::error_code ec);
+  void OnTimer();
 
-  // Cancel any async-operations waiting on the timer.
+  // Cancel the timer.
   void CancelTimer();
 
 private:
@@ -96,27 +138,44 @@ private:
   ResponsePtr response_;
   ResponseParser response_parser_;
 
-  // Timer for the timeout control.
-  asio::steady_timer timer_;
+  // Timer for the timeout control, driven by the timer wheel of the
+  // io_context.
+  TimerWheel& timer_wheel_;
+  TimerWheel::Timer timer_;
 
   // The buffer for reading response.
-  std::vector<char> buffer_;
+  ReadBuffer buffer_;
 
   // Verify the certificate of the peer or not (for HTTPS).
   bool ssl_verify_;
 
-  // The size of the buffer for reading response.
-  // 0 means default value will be used.
+  // The initial size of the buffer for reading response.
   std::size_t buffer_size_;
 
   // Timeout (seconds) for receiving response.
   int timeout_;
 
+  // Timeout (seconds) for connecting to the server.
+  int connect_timeout_;
+
+  // Use HTTP/2 if possible.
+  bool http2_;
+
+  // HTTP/2 session of the connection, null for HTTP/1.1.
+  std::unique_ptr<Http2Session> http2_session_;
+
   // Connection closed.
   bool closed_;
 
-  // Deadline timer canceled.
-  bool timer_canceled_;
+  HostMetrics* metrics_;
+
+  // When the request started to be written, and if the first byte of the
+  // response is still being waited for.
+  std::chrono::steady_clock::time_point request_start_;
+  bool first_byte_pending_;
+
+  // The span of the current request, null if not traced.
+  Span* span_;
 
   Error error_;
 };
@@ -9,7 +9,8 @@ namespace webcc {
 
 ClientSession::ClientSession(int timeout, bool ssl_verify,
                              std::size_t buffer_size)
-    : timeout_(timeout), ssl_verify_(ssl_verify), buffer_size_(buffer_size) {
+    : timeout_(timeout), connect_timeout_(0), ssl_verify_(ssl_verify),
+      http2_(false), buffer_size_(buffer_size), metrics_(nullptr) {
   InitHeaders();
 }
 
@@ -42,9 +43,23 @@ ResponsePtr ClientSession::Send(RequestPtr request, bool stream) {
     request->SetContentType(media_type_, charset_);
   }
 
+  std::string traceparent;
+  if (trace_sink_) {
+    traceparent = StartSpan(request.get());
+  }
+
   request->Prepare();
 
-  return DoSend(request, stream);
+  ResponsePtr response;
+  try {
+    response = DoSend(request, stream);
+  } catch (const Error& error) {
+    EndSpan(request.get(), traceparent, nullptr, &error);
+    throw;
+  }
+
+  EndSpan(request.get(), traceparent, response.get(), nullptr);
+  return response;
 }
 
 void ClientSession::InitHeaders() {
@@ -88,6 +103,9 @@ void ClientSession::InitHeaders() {
 ResponsePtr ClientSession::DoSend(RequestPtr request, bool stream) {
   const ClientPool::Key key{ request->url() };
 
+  auto start = std::chrono::steady_clock::now();
+  HostMetrics* metrics = GetHostMetrics(key);
+
   // Reuse a pooled connection.
   bool reuse = false;
 
@@ -100,9 +118,16 @@ ResponsePtr ClientSession::DoSend(RequestPtr request, bool stream) {
     reuse = true;
   }
 
+  if (metrics != nullptr) {
+    (reuse ? metrics->pool_hits : metrics->pool_misses)->Add();
+  }
+
+  client->set_metrics(metrics);
   client->set_ssl_verify(ssl_verify_);
+  client->set_http2(http2_);
   client->set_buffer_size(buffer_size_);
   client->set_timeout(timeout_);
+  client->set_connect_timeout(connect_timeout_);
  
   Error error = client->Request(request, !reuse, stream);
 
@@ -110,11 +135,18 @@ ResponsePtr ClientSession::DoSend(RequestPtr request, bool stream) {
     if (reuse && error.code() == Error::kSocketWriteError) {
       LOG_WARN("Cannot send request with the reused connection. "
                "The server must have closed it, reconnect and try again.");
+      if (metrics != nullptr) {
+        metrics->retries->Add();
+      }
       error = client->Request(request, true, stream);
     }
   }
 
   if (error) {
+    if (metrics != nullptr) {
+      metrics->AddError(error);
+    }
+
     // Remove the failed connection from pool.
     if (reuse) {
       pool_.Remove(key);
@@ -138,7 +170,76 @@ ResponsePtr ClientSession::DoSend(RequestPtr request, bool stream) {
   // The client object might be cached in the pool.
   // Reset to make sure it won't keep a reference to the response object.
   client->Reset();
+
+  if (metrics != nullptr) {
+    metrics->total->Record(std::chrono::steady_clock::now() - start);
+  }
+
   return response;
 }
 
+std::string ClientSession::StartSpan(Request* request) {
+  std::string traceparent = request->GetHeader(headers::kTraceparent);
+
+  // Join the trace of the request, if any.
+  TraceContext parent;
+  TraceContext::Parse(traceparent, &parent);
+
+  auto span = std::make_shared<Span>("client", parent);
+  span->AddEvent("start");
+  span->SetAttribute("method", request->method());
+  std::string url = request->url().scheme() + "://" + request->host();
+  if (!request->port().empty()) {
+    url += ":" + request->port();
+  }
+  span->SetAttribute("url", url + request->url().path());
+
+  request->SetHeader(headers::kTraceparent, span->context().ToTraceparent());
+  request->set_span(std::move(span));
+
+  return traceparent;
+}
+
+void ClientSession::EndSpan(Request* request, const std::string& traceparent,
+                            Response* response, const Error* error) {
+  SpanPtr span = request->span();
+  if (!span) {
+    return;
+  }
+
+  // The request might be sent again.
+  request->set_span({});
+  if (traceparent.empty()) {
+    request->RemoveHeader(headers::kTraceparent);
+  } else {
+    request->SetHeader(headers::kTraceparent, traceparent);
+  }
+
+  span->AddEvent("done");
+
+  if (response != nullptr) {
+    span->SetAttribute("status", std::to_string(response->status()));
+  }
+  if (error != nullptr) {
+    span->SetAttribute("error", error->message());
+  }
+
+  if (span->sampled()) {
+    trace_sink_->Export(*span);
+  }
+}
+
+HostMetrics* ClientSession::GetHostMetrics(const ClientPool::Key& key) {
+  if (metrics_ == nullptr) {
+    return nullptr;
+  }
+
+  std::string port = key.port;
+  if (port.empty()) {
+    port = key.scheme == "https" ? "443" : "80";
+  }
+
+  return metrics_->GetHost(key.host + ":" + port);
+}
+
 }  // namespace webcc
@@ -5,8 +5,10 @@
 #include <vector>
 
 #include "webcc/client_pool.h"
+#include "webcc/metrics.h"
 #include "webcc/request_builder.h"
 #include "webcc/response.h"
+#include "webcc/trace.h"
 
 namespace webcc {
 
@@ -26,14 +28,39 @@ public:
     }
   }
 
+  void set_connect_timeout(int connect_timeout) {
+    if (connect_timeout > 0) {
+      connect_timeout_ = connect_timeout;
+    }
+  }
+
   void set_ssl_verify(bool ssl_verify) {
     ssl_verify_ = ssl_verify;
   }
 
+  // Use HTTP/2 if possible. See Client::set_http2().
+  void set_http2(bool http2) {
+    http2_ = http2;
+  }
+
   void set_buffer_size(std::size_t buffer_size) {
     buffer_size_ = buffer_size;
   }
 
+  // Set the metrics to update, null to disable.
+  // The metrics could be shared by the sessions of different threads.
+  void set_metrics(ClientMetrics* metrics) {
+    metrics_ = metrics;
+  }
+
+  // Trace the phases of the requests into the sink. The `traceparent` header
+  // is injected into the requests, and if a request has one already, e.g.,
+  // from the span of a server request, the trace is joined.
+  // The sink could be shared by the sessions of different threads.
+  void set_trace_sink(TraceSinkPtr trace_sink) {
+    trace_sink_ = std::move(trace_sink);
+  }
+
   void SetHeader(const std::string& key, const std::string& value) {
     headers_.Set(key, value);
   }
@@ -68,6 +95,20 @@ private:
 
   ResponsePtr DoSend(RequestPtr request, bool stream);
 
+  // Start the span of the request, and inject the `traceparent` header.
+  // Return the `traceparent` header of the caller, empty if none.
+  std::string StartSpan(Request* request);
+
+  // Finish the span of the request and export it, if any.
+  // The `traceparent` header of the caller is restored (or removed if it's
+  // empty), so that the span of a request sent again isn't a child of this
+  // one.
+  void EndSpan(Request* request, const std::string& traceparent,
+               Response* response, const Error* error);
+
+  // Get the metrics of the host of the key, null if disabled.
+  HostMetrics* GetHostMetrics(const ClientPool::Key& key);
+
 private:
   // Default media type for `Content-Type` header.
   // E.g., "application/json".
@@ -83,15 +124,26 @@ private:
   // Timeout in seconds for receiving response.
   int timeout_;
 
+  // Timeout in seconds for connecting to the server.
+  // 0 means default value will be used.
+  int connect_timeout_;
+
   // Verify the certificate of the peer or not.
   bool ssl_verify_;
 
+  // Use HTTP/2 if possible.
+  bool http2_;
+
   // The size of the buffer for reading response.
   // 0 means default value will be used.
   std::size_t buffer_size_;
 
   // Pool for Keep-Alive client connections.
   ClientPool pool_;
+
+  ClientMetrics* metrics_;
+
+  TraceSinkPtr trace_sink_;
 };
 
 }  // namespace webcc
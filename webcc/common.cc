@@ -44,6 +44,13 @@ bool Headers::Has(const std::string& key) const {
   return const_cast<Headers*>(this)->Find(key) != headers_.end();
 }
 
+void Headers::Remove(const std::string& key) {
+  auto it = Find(key);
+  if (it != headers_.end()) {
+    headers_.erase(it);
+  }
+}
+
 const std::string& Headers::Get(const std::string& key, bool* existed) const {
   auto it = const_cast<Headers*>(this)->Find(key);
 
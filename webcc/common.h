@@ -35,6 +35,9 @@ public:
 
   bool Has(const std::string& key) const;
 
+  // Remove the header with the given key, if any.
+  void Remove(const std::string& key);
+
   // Get header by index.
   const Header& Get(std::size_t index) const {
     assert(index < size());
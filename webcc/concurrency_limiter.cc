@@ -0,0 +1,94 @@
+#include "webcc/concurrency_limiter.h"
+
+#include <algorithm>
+
+namespace webcc {
+
+namespace {
+
+// The initial adaptive limit if there's no max limit.
+const std::size_t kInitialLimit = 100;
+
+// The factor to decrease the adaptive limit.
+const double kBackoffRatio = 0.9;
+
+}  // namespace
+
+void ConcurrencyLimiter::Reset(std::size_t min_limit, std::size_t max_limit,
+                               std::chrono::milliseconds target_wait) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  min_limit_ = std::max<std::size_t>(min_limit, 1);
+  max_limit_ = max_limit;
+  if (max_limit_ > 0 && max_limit_ < min_limit_) {
+    min_limit_ = max_limit_;
+  }
+
+  target_wait_ = target_wait;
+
+  if (max_limit_ > 0) {
+    limit_ = static_cast<double>(max_limit_);
+  } else {
+    limit_ = static_cast<double>(std::max(kInitialLimit, min_limit_));
+  }
+
+  in_flight_ = 0;
+  last_decrease_ = {};
+}
+
+bool ConcurrencyLimiter::Acquire() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (max_limit_ > 0 || target_wait_.count() > 0) {
+    if (in_flight_ >= static_cast<std::size_t>(limit_)) {
+      return false;
+    }
+  }
+
+  ++in_flight_;
+  return true;
+}
+
+void ConcurrencyLimiter::Release(
+    std::chrono::steady_clock::duration queue_wait) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (in_flight_ > 0) {
+    --in_flight_;
+  }
+
+  if (target_wait_.count() <= 0) {
+    return;  // Fixed limit
+  }
+
+  if (queue_wait > target_wait_) {
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_decrease_ >= target_wait_) {
+      last_decrease_ = now;
+      limit_ = std::max(limit_ * kBackoffRatio,
+                        static_cast<double>(min_limit_));
+    }
+  } else if (in_flight_ * 2 >= static_cast<std::size_t>(limit_)) {
+    // Only grow the limit when it's really in use.
+    limit_ += 1.0 / limit_;
+    if (max_limit_ > 0) {
+      limit_ = std::min(limit_, static_cast<double>(max_limit_));
+    }
+  }
+}
+
+std::size_t ConcurrencyLimiter::limit() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (max_limit_ == 0 && target_wait_.count() <= 0) {
+    return 0;
+  }
+  return static_cast<std::size_t>(limit_);
+}
+
+std::size_t ConcurrencyLimiter::in_flight() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return in_flight_;
+}
+
+}  // namespace webcc
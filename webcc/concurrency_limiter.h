@@ -0,0 +1,63 @@
+#ifndef WEBCC_CONCURRENCY_LIMITER_H_
+#define WEBCC_CONCURRENCY_LIMITER_H_
+
+#include <chrono>
+#include <mutex>
+
+namespace webcc {
+
+// Limit the number of requests queued or being handled by the workers.
+// The limit is fixed (|max_limit|) by default. With a target of the queue
+// wait time, the limit becomes adaptive (AIMD): it's increased by one every
+// "limit" requests when the requests are dequeued in time, and decreased by
+// 10% when some request has waited longer than the target. So the server
+// sheds the load before the queue wait blows up the latency.
+class ConcurrencyLimiter {
+public:
+  ConcurrencyLimiter() = default;
+
+  ConcurrencyLimiter(const ConcurrencyLimiter&) = delete;
+  ConcurrencyLimiter& operator=(const ConcurrencyLimiter&) = delete;
+
+  // Reset the limits and the number of requests in flight.
+  // |min_limit|: the adaptive limit is never below it, usually the number of
+  //   workers so that no worker is idle.
+  // |max_limit|: the max number of requests in flight, 0 for unlimited.
+  // |target_wait|: the target of the queue wait time, 0 for a fixed limit.
+  void Reset(std::size_t min_limit, std::size_t max_limit,
+             std::chrono::milliseconds target_wait);
+
+  // Try to admit a request.
+  // Return false if the limit has been reached.
+  bool Acquire();
+
+  // The request has been handled, |queue_wait| is how long it waited in the
+  // queue before some worker took it.
+  void Release(std::chrono::steady_clock::duration queue_wait);
+
+  // The current limit, 0 for unlimited.
+  std::size_t limit() const;
+
+  std::size_t in_flight() const;
+
+private:
+  std::size_t min_limit_ = 1;
+  std::size_t max_limit_ = 0;
+
+  std::chrono::milliseconds target_wait_{ 0 };
+
+  // The adaptive limit.
+  double limit_ = 0.0;
+
+  std::size_t in_flight_ = 0;
+
+  // The limit is decreased at most once per target wait time, since the
+  // requests already queued don't benefit from the decrease.
+  std::chrono::steady_clock::time_point last_decrease_;
+
+  mutable std::mutex mutex_;
+};
+
+}  // namespace webcc
+
+#endif  // WEBCC_CONCURRENCY_LIMITER_H_
@@ -1,24 +1,132 @@
 #include "webcc/connection.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <utility>
 
+#include "asio/bind_executor.hpp"
+#include "asio/dispatch.hpp"
+#include "asio/post.hpp"
 #include "asio/write.hpp"
 
+#include "webcc/base64.h"
 #include "webcc/connection_pool.h"
 #include "webcc/logger.h"
+#include "webcc/string.h"
+#include "webcc/websocket.h"
 
 using asio::ip::tcp;
 
 namespace webcc {
 
+namespace {
+
+// Decode the base64url encoded HTTP2-Settings header.
+std::string Base64UrlDecode(std::string input) {
+  std::replace(input.begin(), input.end(), '-', '+');
+  std::replace(input.begin(), input.end(), '_', '/');
+  input.append((4 - input.size() % 4) % 4, '=');
+  return Base64Decode(input);
+}
+
+// Is the object owned by |ptr| only?
+// The fence makes the accesses of the owners released in other threads
+// visible before the object is reused.
+template <typename T>
+bool IsUnique(const std::shared_ptr<T>& ptr) {
+  if (ptr.use_count() != 1) {
+    return false;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return true;
+}
+
+}  // namespace
+
 Connection::Connection(tcp::socket socket, ConnectionPool* pool,
-                       Queue<ConnectionPtr>* queue, ViewMatcher&& view_matcher)
+                       Queue<ConnectionPtr>* queue,
+                       const ViewMatcher* view_matcher)
     : socket_(std::move(socket)), pool_(pool), queue_(queue),
-      view_matcher_(std::move(view_matcher)), buffer_(kBufferSize) {
+      view_matcher_(view_matcher), buffer_(kBufferSize),
+      idle_timeout_(kIdleTimeout), header_timeout_(kHeaderTimeout),
+      body_timeout_(kBodyTimeout), limiter_(nullptr),
+      retry_after_(kRetryAfter), metrics_(nullptr),
+      parse_time_(0), trace_sink_(nullptr),
+      accept_time_(std::chrono::steady_clock::now()), first_request_(true),
+      request_started_(false), served_(false), keep_alive_(false),
+      timer_wheel_(&TimerWheel::Get(socket_.get_executor())),
+      read_timer_seq_(0), stream_started_(false), stream_writing_(false),
+      stream_active_(false),
+      preface_matched_(0), preface_checked_(false), strand_(socket_.get_executor()),
+      http2_writing_(false), shard_(0), prev_(nullptr), next_(nullptr) {
+}
+
+void Connection::Recycle() {
+  SetReadTimeout(0);
+  timer_wheel_->Cancel(&heartbeat_timer_);
+
+  std::error_code ec;
+  socket_.close(ec);
+
+  // Keep the request (and the capacities of its strings) for reuse unless
+  // it's still referred, e.g., by a WebSocket connection.
+  if (request_ && IsUnique(request_)) {
+    request_->Clear();
+  } else {
+    request_.reset();
+  }
+
+  response_.reset();
+  span_.reset();
+  stream_body_.reset();
+  websocket_view_.reset();
+  http2_session_.reset();
+  http2_output_.clear();
+  http2_requests_.clear();
+  buffer_.Release();
+}
+
+void Connection::Reset(tcp::socket socket) {
+  socket_ = std::move(socket);
+
+  accept_time_ = std::chrono::steady_clock::now();
+  first_request_ = true;
+
+  request_started_ = false;
+  served_ = false;
+  stream_started_ = false;
+  stream_writing_ = false;
+  stream_active_ = false;
+  preface_matched_ = 0;
+  preface_checked_ = false;
+  http2_writing_ = false;
 }
 
 void Connection::Start() {
-  request_.reset(new Request{});
+  // Start in the strand, which might be draining the connection.
+  asio::dispatch(strand_, std::bind(&Connection::DoStart, shared_from_this()));
+}
+
+void Connection::DoStart() {
+  response_.reset();
+  span_.reset();
+
+  if (request_ && IsUnique(request_)) {
+    // Reuse the last request, which no one else refers to.
+    // The request was allocated from an arena of its own, reset the one for
+    // the responses if nothing is allocated from it any more.
+    request_->Clear();
+    if (IsUnique(request_->arena())) {
+      request_->arena()->Reset();
+    } else {
+      request_->set_arena(std::make_shared<Arena>());
+    }
+  } else {
+    auto arena = std::make_shared<Arena>();
+    request_ = MakeShared<Request>(arena);
+    request_->set_arena(std::move(arena));
+  }
 
   std::error_code ec;
   auto endpoint = socket_.remote_endpoint(ec);
@@ -27,10 +135,25 @@ void Connection::Start() {
   }
 
   request_parser_.Init(request_.get(), view_matcher_);
-  DoRead();
+
+  request_started_ = false;
+  SetReadTimeout(idle_timeout_);
+
+  // Wait for the next request without holding a buffer.
+  buffer_.Release();
+  DoWaitRead();
 }
 
 void Connection::Close() {
+  SetReadTimeout(0);
+
+  if (stream_body_) {
+    // Let the writer know that the client has gone.
+    stream_body_->set_notifier({});
+    stream_body_->Close();
+    timer_wheel_->Cancel(&heartbeat_timer_);
+  }
+
   LOG_INFO("Shutdown socket...");
 
   // Initiate graceful connection closure.
@@ -54,13 +177,61 @@ void Connection::Close() {
   }
 }
 
+void Connection::Drain() {
+  auto self = shared_from_this();
+
+  asio::post(strand_, [self]() {
+    if (!self->socket_.is_open()) {
+      return;
+    }
+
+    if (self->http2_session_) {
+      self->http2_session_->Shutdown();
+      self->DoWriteHttp2();
+    } else if (self->stream_started_) {
+      // End the stream, the connection is closed once the data left is sent.
+      self->stream_body_->Close();
+    } else if (!self->request_started_ && self->served_) {
+      // A new connection is kept for its first request, which might be on
+      // the way, e.g., accepted just before the socket is handed off.
+      LOG_INFO("Close the idle connection.");
+      self->pool_->Close(self);
+    }
+  });
+}
+
 void Connection::SendResponse(ResponsePtr response, bool no_keep_alive) {
   assert(response);
 
-  response_ = response;
+  // Write in the strand, which might be closing the socket, e.g., Drain().
+  // The read handlers calling this are already in the strand.
+  asio::dispatch(strand_, std::bind(&Connection::DoSendResponse,
+                                    shared_from_this(), std::move(response),
+                                    no_keep_alive));
+}
+
+void Connection::DoSendResponse(ResponsePtr response, bool no_keep_alive) {
+  if (!socket_.is_open()) {
+    return;
+  }
+
+  response_ = std::move(response);
+  served_ = true;
+
+  // The end of a stream is indicated by closing the connection.
+  stream_body_ = std::dynamic_pointer_cast<StreamBody>(response_->body());
+  if (stream_body_) {
+    no_keep_alive = true;
+  }
+
+  keep_alive_ = false;
 
-  if (!no_keep_alive && request_->IsConnectionKeepAlive()) {
+  if (response_->status() == Status::kSwitchingProtocols) {
+    // Keep "Connection: Upgrade".
+  } else if (!no_keep_alive && request_->IsConnectionKeepAlive() &&
+             !pool_->draining()) {
     response_->SetHeader(headers::kConnection, "Keep-Alive");
+    keep_alive_ = true;
   } else {
     response_->SetHeader(headers::kConnection, "Close");
   }
@@ -78,14 +249,61 @@ void Connection::SendResponse(Status status, bool no_keep_alive) {
   // is empty.
   response->SetBody(std::make_shared<Body>(), true);
 
-  SendResponse(response, no_keep_alive);
+  SendResponse(std::move(response), no_keep_alive);
+}
+
+RequestPtr Connection::PopHttp2Request(std::uint32_t* stream_id) {
+  std::lock_guard<std::mutex> lock(http2_mutex_);
+
+  if (http2_requests_.empty()) {
+    return {};
+  }
+
+  *stream_id = http2_requests_.front().first;
+  RequestPtr request = std::move(http2_requests_.front().second);
+  http2_requests_.pop_front();
+
+  return request;
+}
+
+void Connection::SendHttp2Response(std::uint32_t stream_id,
+                                   ResponsePtr response) {
+  assert(response);
+
+  auto self = shared_from_this();
+
+  asio::post(strand_, [self, stream_id, response]() {
+    if (self->socket_.is_open()) {
+      self->http2_session_->SendResponse(stream_id, response);
+      self->DoWriteHttp2();
+    }
+  });
+}
+
+void Connection::DoWaitRead() {
+  socket_.async_wait(
+      tcp::socket::wait_read,
+      asio::bind_executor(strand_, std::bind(&Connection::OnWaitRead,
+                                             shared_from_this(),
+                                             std::placeholders::_1)));
+}
+
+void Connection::OnWaitRead(std::error_code ec) {
+  if (ec) {
+    OnRead(ec, 0);
+  } else {
+    DoRead();
+  }
 }
 
 void Connection::DoRead() {
-  socket_.async_read_some(asio::buffer(buffer_),
-                          std::bind(&Connection::OnRead, shared_from_this(),
-                                    std::placeholders::_1,
-                                    std::placeholders::_2));
+  // Serialized with the read timeout in the strand.
+  socket_.async_read_some(
+      buffer_.Prepare(),
+      asio::bind_executor(strand_, std::bind(&Connection::OnRead,
+                                             shared_from_this(),
+                                             std::placeholders::_1,
+                                             std::placeholders::_2)));
 }
 
 void Connection::OnRead(std::error_code ec, std::size_t length) {
@@ -109,45 +327,403 @@ void Connection::OnRead(std::error_code ec, std::size_t length) {
     return;
   }
 
-  if (!request_parser_.Parse(buffer_.data(), length)) {
+  buffer_.Commit(length);
+
+  if (metrics_ != nullptr) {
+    metrics_->bytes_in->Add(length);
+  }
+
+  if (!request_started_) {
+    // The header timeout counts from the first byte of the request.
+    request_started_ = true;
+    SetReadTimeout(header_timeout_);
+
+    if (metrics_ != nullptr) {
+      read_start_ = std::chrono::steady_clock::now();
+      parse_time_ = {};
+    }
+
+    if (trace_sink_ != nullptr) {
+      StartSpan();
+    }
+  }
+
+  if (!preface_checked_) {
+    // Check if the connection starts with the HTTP/2 connection preface, i.e.,
+    // the client has prior knowledge of the HTTP/2 support.
+    std::size_t matched = preface_matched_;
+    std::size_t count = std::min(length, http2::kPrefaceSize - matched);
+
+    if (std::memcmp(buffer_.data(), http2::kPreface + matched, count) == 0) {
+      preface_matched_ += count;
+
+      if (preface_matched_ < http2::kPrefaceSize) {
+        DoRead();
+      } else {
+        preface_checked_ = true;
+        SetReadTimeout(0);
+        StartHttp2(count, length - count);
+      }
+      return;
+    }
+
+    preface_checked_ = true;
+
+    // Not HTTP/2, parse the data held back.
+    if (matched > 0 && !Parse(http2::kPreface, matched)) {
+      LOG_ERRO("Failed to parse HTTP request.");
+      if (metrics_ != nullptr) {
+        metrics_->requests_invalid->Add();
+      }
+      // The connection is closed once the response is sent.
+      SendResponse(Status::kBadRequest, true);
+      return;
+    }
+  }
+
+  if (!Parse(buffer_.data(), length)) {
     LOG_ERRO("Failed to parse HTTP request.");
+    if (metrics_ != nullptr) {
+      metrics_->requests_invalid->Add();
+    }
     // Send Bad Request (400) to the client and no Keep-Alive.
+    // The connection is closed once the response is sent. Don't close it now,
+    // or it would race with the completion of the write in another thread.
     SendResponse(Status::kBadRequest, true);
-    // Close the socket connection.
-    pool_->Close(shared_from_this());
     return;
   }
 
   if (!request_parser_.finished()) {
+    if (request_parser_.header_ended()) {
+      // Restart the body timeout on each progress.
+      SetReadTimeout(body_timeout_);
+    }
+
     // Continue to read the request.
     DoRead();
     return;
   }
 
+  SetReadTimeout(0);
+
+  if (metrics_ != nullptr) {
+    metrics_->request_read->Record(std::chrono::steady_clock::now() -
+                                   read_start_);
+    metrics_->request_parse->Record(parse_time_);
+  }
+
+  request_->set_span(span_);
+
+  // Don't hold the buffer while the request is being handled.
+  buffer_.Release();
+
   LOG_VERB("HTTP request:\n%s", request_->Dump().c_str());
 
+  if (IsHttp2Upgrade()) {
+    UpgradeHttp2();
+    return;
+  }
+
+  if (!Admit(request_.get())) {
+    LOG_WARN("Too many requests, reply with 503 (Service Unavailable).");
+    SendResponse(NewServiceUnavailable(), true);
+    return;
+  }
+
   // Enqueue this connection once the request has been read.
   // Some worker thread will handle the request later.
   queue_->Push(shared_from_this());
 }
 
+bool Connection::Parse(const char* data, std::size_t length) {
+  bool header_ended = request_parser_.header_ended();
+
+  bool ok = false;
+  if (metrics_ == nullptr) {
+    ok = request_parser_.Parse(data, length);
+  } else {
+    auto start = std::chrono::steady_clock::now();
+    ok = request_parser_.Parse(data, length);
+    parse_time_ += std::chrono::steady_clock::now() - start;
+  }
+
+  if (span_ && !header_ended && request_parser_.header_ended()) {
+    span_->AddEvent("headers_parsed");
+
+    // Join the trace of the client.
+    TraceContext parent;
+    if (TraceContext::Parse(request_->GetHeader(headers::kTraceparent),
+                            &parent)) {
+      span_->SetParent(parent);
+    }
+
+    span_->SetAttribute("method", request_->method());
+    span_->SetAttribute("target", request_->url().path());
+  }
+
+  return ok;
+}
+
+void Connection::StartSpan() {
+  span_ = std::make_shared<Span>("server");
+
+  if (first_request_) {
+    span_->AddEvent("accept", accept_time_);
+    first_request_ = false;
+  }
+
+  span_->AddEvent("first_byte");
+}
+
+bool Connection::Admit(Request* request) {
+  if (limiter_ != nullptr && !limiter_->Acquire()) {
+    if (metrics_ != nullptr) {
+      metrics_->requests_rejected->Add();
+    }
+    return false;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  request->set_queued_time(now);
+
+  if (request->span()) {
+    request->span()->AddEvent("enqueued", now);
+  }
+  return true;
+}
+
+ResponsePtr Connection::NewServiceUnavailable() const {
+  auto response = std::make_shared<Response>(Status::kServiceUnavailable);
+  response->SetHeader(headers::kRetryAfter, std::to_string(retry_after_));
+  response->SetBody(std::make_shared<Body>(), true);
+  return response;
+}
+
+void Connection::SetReadTimeout(int seconds) {
+  std::size_t seq = ++read_timer_seq_;
+
+  if (seconds <= 0) {
+    timer_wheel_->Cancel(&read_timer_);
+    return;
+  }
+
+  std::weak_ptr<Connection> weak_self = shared_from_this();
+
+  timer_wheel_->Schedule(
+      &read_timer_, std::chrono::seconds(seconds), [weak_self, seq]() {
+        if (auto self = weak_self.lock()) {
+          asio::post(self->strand_,
+                     std::bind(&Connection::OnReadTimeout, self, seq));
+        }
+      });
+}
+
+void Connection::OnReadTimeout(std::size_t seq) {
+  if (seq != read_timer_seq_ || !socket_.is_open()) {
+    return;  // Stale
+  }
+
+  LOG_WARN("Timed out reading the request, close the connection.");
+  pool_->Close(shared_from_this());
+}
+
+bool Connection::IsHttp2Upgrade() const {
+  return iequals(request_->GetHeader("Upgrade"), "h2c") &&
+         request_->HasHeader("HTTP2-Settings");
+}
+
+void Connection::StartHttp2(std::size_t offset, std::size_t length) {
+  LOG_INFO("Start HTTP/2 with prior knowledge.");
+
+  http2_session_.reset(new Http2Session{ true, *view_matcher_ });
+
+  auto self = shared_from_this();
+
+  asio::post(strand_, [self, offset, length]() {
+    self->http2_session_->Feed(http2::kPreface, http2::kPrefaceSize);
+    self->OnHttp2Data(self->buffer_.data() + offset, length);
+  });
+}
+
+void Connection::UpgradeHttp2() {
+  LOG_INFO("Upgrade to HTTP/2 (h2c).");
+
+  http2_session_.reset(new Http2Session{ true, *view_matcher_ });
+
+  std::string settings = Base64UrlDecode(request_->GetHeader("HTTP2-Settings"));
+
+  auto self = shared_from_this();
+
+  asio::post(strand_, [self, settings]() {
+    // The 101 response must precede the frames of the server.
+    self->http2_output_ =
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Connection: Upgrade\r\n"
+        "Upgrade: h2c\r\n\r\n";
+
+    // The upgrade request becomes stream 1.
+    self->http2_session_->Upgrade(settings, self->request_);
+
+    self->OnHttp2Data("", 0);
+  });
+}
+
+void Connection::OnHttp2Data(const char* data, std::size_t length) {
+  bool ok = http2_session_->Feed(data, length);
+
+  std::uint32_t stream_id = 0;
+  RequestPtr request;
+
+  while (http2_session_->PopRequest(&stream_id, &request)) {
+    request->set_ip(request_->ip());
+
+    LOG_VERB("HTTP/2 request (stream %u):\n%s", stream_id,
+             request->Dump().c_str());
+
+    if (!Admit(request.get())) {
+      LOG_WARN("Too many requests, reply with 503 (Service Unavailable).");
+      http2_session_->SendResponse(stream_id, NewServiceUnavailable());
+      continue;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(http2_mutex_);
+      http2_requests_.emplace_back(stream_id, std::move(request));
+    }
+
+    // The connection is enqueued for each request.
+    queue_->Push(shared_from_this());
+  }
+
+  DoWriteHttp2();
+
+  if (ok && !http2_session_->closed()) {
+    DoReadHttp2();
+  }
+}
+
+void Connection::DoReadHttp2() {
+  socket_.async_read_some(
+      buffer_.Prepare(),
+      asio::bind_executor(strand_, std::bind(&Connection::OnReadHttp2,
+                                             shared_from_this(),
+                                             std::placeholders::_1,
+                                             std::placeholders::_2)));
+}
+
+void Connection::OnReadHttp2(std::error_code ec, std::size_t length) {
+  if (!socket_.is_open()) {
+    return;  // Already closed
+  }
+
+  if (ec) {
+    if (ec == asio::error::eof) {
+      LOG_INFO("Socket read EOF (%s).", ec.message().c_str());
+    } else if (ec != asio::error::operation_aborted) {
+      LOG_ERRO("Socket read error (%s).", ec.message().c_str());
+    }
+
+    if (ec != asio::error::operation_aborted) {
+      pool_->Close(shared_from_this());
+    }
+    return;
+  }
+
+  buffer_.Commit(length);
+
+  if (metrics_ != nullptr) {
+    metrics_->bytes_in->Add(length);
+  }
+
+  OnHttp2Data(buffer_.data(), length);
+}
+
+void Connection::DoWriteHttp2() {
+  if (http2_writing_ || !socket_.is_open()) {
+    return;
+  }
+
+  if (http2_output_.empty()) {
+    http2_session_->GetOutput(&http2_output_);
+  }
+
+  if (http2_output_.empty()) {
+    if (http2_session_->closed()) {
+      LOG_INFO("HTTP/2 session closed.");
+      pool_->Close(shared_from_this());
+    }
+    return;
+  }
+
+  http2_writing_ = true;
+
+  asio::async_write(
+      socket_, asio::buffer(http2_output_),
+      asio::bind_executor(strand_, std::bind(&Connection::OnWriteHttp2,
+                                             shared_from_this(),
+                                             std::placeholders::_1,
+                                             std::placeholders::_2)));
+}
+
+void Connection::OnWriteHttp2(std::error_code ec, std::size_t length) {
+  http2_writing_ = false;
+
+  if (metrics_ != nullptr) {
+    metrics_->bytes_out->Add(length);
+  }
+
+  if (ec) {
+    OnWriteError(ec);
+    return;
+  }
+
+  http2_output_.clear();
+
+  DoWriteHttp2();
+}
+
 void Connection::DoWrite() {
+  if (metrics_ != nullptr) {
+    write_start_ = std::chrono::steady_clock::now();
+  }
+
+  // Firstly, write the headers, together with the first payload of the body
+  // in one gathered write.
+  Payload payload = response_->GetPayload();
+
+  // Dumped once rendered, with the headers added on rendering.
   LOG_VERB("HTTP response:\n%s", response_->Dump().c_str());
 
-  // Firstly, write the headers.
-  asio::async_write(socket_, response_->GetPayload(),
-                           std::bind(&Connection::OnWriteHeaders,
-                                     shared_from_this(), std::placeholders::_1,
-                                     std::placeholders::_2));
+  if (!stream_body_) {
+    response_->body()->InitPayload();
+    Payload body_payload = response_->body()->NextPayload();
+    payload.insert(payload.end(), body_payload.begin(), body_payload.end());
+  }
+
+  asio::async_write(socket_, payload,
+                    asio::bind_executor(
+                        strand_, std::bind(&Connection::OnWriteHeaders,
+                                           shared_from_this(),
+                                           std::placeholders::_1,
+                                           std::placeholders::_2)));
 }
 
 void Connection::OnWriteHeaders(std::error_code ec,
                                 std::size_t length) {
+  if (metrics_ != nullptr) {
+    metrics_->bytes_out->Add(length);
+  }
+
+  if (!ec) {
+    AddSpanEvent("headers_written");
+  }
+
   if (ec) {
     OnWriteError(ec);
+  } else if (stream_body_) {
+    StartStream();
   } else {
-    // Write the body payload by payload.
-    response_->body()->InitPayload();
+    // Write the rest of the body payload by payload.
     DoWriteBody();
   }
 }
@@ -157,10 +733,11 @@ void Connection::DoWriteBody() {
 
   if (!payload.empty()) {
     asio::async_write(socket_, payload,
-                             std::bind(&Connection::OnWriteBody,
-                                       shared_from_this(),
-                                       std::placeholders::_1,
-                                       std::placeholders::_2));
+                      asio::bind_executor(
+                          strand_, std::bind(&Connection::OnWriteBody,
+                                             shared_from_this(),
+                                             std::placeholders::_1,
+                                             std::placeholders::_2)));
   } else {
     // No more body payload left, we're done.
     OnWriteOK();
@@ -168,6 +745,10 @@ void Connection::DoWriteBody() {
 }
 
 void Connection::OnWriteBody(std::error_code ec, std::size_t length) {
+  if (metrics_ != nullptr) {
+    metrics_->bytes_out->Add(length);
+  }
+
   if (ec) {
     OnWriteError(ec);
   } else {
@@ -178,15 +759,161 @@ void Connection::OnWriteBody(std::error_code ec, std::size_t length) {
 void Connection::OnWriteOK() {
   LOG_INFO("Response has been sent back.");
 
-  if (request_->IsConnectionKeepAlive()) {
+  if (metrics_ != nullptr) {
+    metrics_->response_write->Record(std::chrono::steady_clock::now() -
+                                     write_start_);
+  }
+
+  if (span_) {
+    span_->AddEvent("body_done");
+    if (span_->sampled()) {
+      trace_sink_->Export(*span_);
+    }
+    span_.reset();
+  }
+
+  if (websocket_view_ &&
+      response_->status() == Status::kSwitchingProtocols) {
+    UpgradeWebSocket();
+    return;
+  }
+
+  if (keep_alive_ && !pool_->draining()) {
     LOG_INFO("The client asked for a keep-alive connection.");
     LOG_INFO("Continue to read the next request...");
-    Start();
+    DoStart();
   } else {
     pool_->Close(shared_from_this());
   }
 }
 
+void Connection::StartStream() {
+  LOG_INFO("Start streaming the response.");
+
+  stream_started_ = true;
+
+  // Continue writing in the strand whenever new data comes.
+  std::weak_ptr<Connection> weak_self = shared_from_this();
+  stream_body_->set_notifier([weak_self]() {
+    if (auto self = weak_self.lock()) {
+      asio::post(self->strand_, std::bind(&Connection::DoWriteStream, self));
+    }
+  });
+
+  // Read to detect the closing of the client.
+  DoReadStream();
+
+  if (stream_body_->heartbeat_seconds() > 0) {
+    DoWaitHeartbeat();
+  }
+
+  DoWriteStream();
+}
+
+void Connection::DoWriteStream() {
+  if (stream_writing_ || !socket_.is_open()) {
+    return;
+  }
+
+  auto payload = stream_body_->NextPayload();
+
+  if (payload.empty()) {
+    if (stream_body_->ended()) {
+      LOG_INFO("The stream has been closed.");
+      timer_wheel_->Cancel(&heartbeat_timer_);
+      pool_->Close(shared_from_this());
+    }
+    return;
+  }
+
+  stream_writing_ = true;
+  stream_active_ = true;
+
+  asio::async_write(
+      socket_, payload,
+      asio::bind_executor(strand_, std::bind(&Connection::OnWriteStream,
+                                             shared_from_this(),
+                                             std::placeholders::_1,
+                                             std::placeholders::_2)));
+}
+
+void Connection::OnWriteStream(std::error_code ec, std::size_t length) {
+  stream_writing_ = false;
+
+  if (metrics_ != nullptr) {
+    metrics_->bytes_out->Add(length);
+  }
+
+  if (ec) {
+    OnWriteError(ec);
+    return;
+  }
+
+  DoWriteStream();
+}
+
+void Connection::DoReadStream() {
+  socket_.async_read_some(
+      buffer_.Prepare(),
+      asio::bind_executor(strand_, std::bind(&Connection::OnReadStream,
+                                             shared_from_this(),
+                                             std::placeholders::_1,
+                                             std::placeholders::_2)));
+}
+
+void Connection::OnReadStream(std::error_code ec,
+                              std::size_t /*length*/) {
+  if (!socket_.is_open()) {
+    return;  // Already closed
+  }
+
+  if (ec) {
+    if (ec != asio::error::operation_aborted) {
+      LOG_INFO("The client has closed the stream (%s).", ec.message().c_str());
+      pool_->Close(shared_from_this());
+    }
+    return;
+  }
+
+  // Ignore any data from the client.
+  DoReadStream();
+}
+
+void Connection::DoWaitHeartbeat() {
+  std::weak_ptr<Connection> weak_self = shared_from_this();
+
+  timer_wheel_->Schedule(
+      &heartbeat_timer_,
+      std::chrono::seconds(stream_body_->heartbeat_seconds()), [weak_self]() {
+        if (auto self = weak_self.lock()) {
+          asio::post(self->strand_, std::bind(&Connection::OnHeartbeat, self));
+        }
+      });
+}
+
+void Connection::OnHeartbeat() {
+  if (!socket_.is_open()) {
+    return;
+  }
+
+  if (!stream_active_) {
+    LOG_VERB("Stream heartbeat.");
+    stream_body_->Write(stream_body_->heartbeat_data());
+  }
+  stream_active_ = false;
+
+  DoWaitHeartbeat();
+}
+
+void Connection::UpgradeWebSocket() {
+  LOG_INFO("Switch to WebSocket.");
+
+  auto ws = std::make_shared<WebSocketConnection>(
+      std::move(socket_), pool_, std::move(websocket_view_), request_);
+
+  pool_->Upgrade(shared_from_this(), ws);
+}
+
 void Connection::OnWriteError(std::error_code ec) {
   LOG_ERRO("Socket write error (%s).", ec.message().c_str());
 
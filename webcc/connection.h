@@ -1,49 +1,104 @@
 #ifndef WEBCC_CONNECTION_H_
 #define WEBCC_CONNECTION_H_
 
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "asio/executor.hpp"
 #include "asio/ip/tcp.hpp"
+#include "asio/strand.hpp"
 
+#include "webcc/concurrency_limiter.h"
 #include "webcc/globals.h"
+#include "webcc/http2.h"
+#include "webcc/metrics.h"
+#include "webcc/read_buffer.h"
+#include "webcc/trace.h"
 #include "webcc/queue.h"
 #include "webcc/request.h"
 #include "webcc/request_parser.h"
 #include "webcc/response.h"
+#include "webcc/timer_wheel.h"
 
 namespace webcc {
 
 class Connection;
 class ConnectionPool;
 class Server;
+class WebSocketView;
 
 using ConnectionPtr = std::shared_ptr<Connection>;
 
 class Connection : public std::enable_shared_from_this<Connection> {
 public:
+  // |view_matcher| is not copied, it must outlive the connection.
   Connection(asio::ip::tcp::socket socket, ConnectionPool* pool,
-             Queue<ConnectionPtr>* queue, ViewMatcher&& view_matcher);
+             Queue<ConnectionPtr>* queue, const ViewMatcher* view_matcher);
 
   ~Connection() = default;
 
   Connection(const Connection&) = delete;
   Connection& operator=(const Connection&) = delete;
 
+  // Release the resources held for the last socket so that the connection
+  // could be kept for reuse.
+  // Called by ConnectionPool when no one refers to the connection any more.
+  void Recycle();
+
+  // Reuse the recycled connection for a newly accepted socket.
+  void Reset(asio::ip::tcp::socket socket);
+
   RequestPtr request() const {
     return request_;
   }
 
+  // Set the timeouts (in seconds) for reading the requests, 0 to disable.
+  // See Server::set_idle_timeout(), etc.
+  void set_timeouts(int idle_timeout, int header_timeout, int body_timeout) {
+    idle_timeout_ = idle_timeout;
+    header_timeout_ = header_timeout;
+    body_timeout_ = body_timeout;
+  }
+
+  // Set the limiter admitting the requests into the queue, and the seconds of
+  // Retry-After to reply with 503 (Service Unavailable) when it's full.
+  void set_limiter(ConcurrencyLimiter* limiter, int retry_after) {
+    limiter_ = limiter;
+    retry_after_ = retry_after;
+  }
+
+  // Set the metrics to update, null to disable.
+  void set_metrics(ServerMetrics* metrics) {
+    metrics_ = metrics;
+  }
+
+  // Set the sink of the spans tracing the requests, null to disable.
+  void set_trace_sink(TraceSink* trace_sink) {
+    trace_sink_ = trace_sink;
+  }
+
   // Start to read and process the client request.
+  // Thread-safe, it's started in the strand.
   void Start();
 
   // Close the socket.
   void Close();
 
+  // Finish the current request and then close, or close right now if it's
+  // waiting for a new request.
+  // Called when the server is going to stop gracefully.
+  void Drain();
+
   // Send a response to the client.
   // `Connection` header will be set to "Close" if |no_keep_alive| is true no
   // matter whether the client asked for Keep-Alive or not.
+  // Thread-safe, e.g., called by the workers, it's sent in the strand.
   void SendResponse(ResponsePtr response, bool no_keep_alive = false);
 
   // Send a response with the given status and an empty body to the client.
@@ -51,15 +106,101 @@ public:
   // matter whether the client asked for Keep-Alive or not.
   void SendResponse(Status status, bool no_keep_alive = false);
 
+  // The view accepting the WebSocket handshake of the current request.
+  // Once the 101 response has been sent, the socket is taken over by a
+  // WebSocketConnection of this view.
+  void set_websocket_view(std::shared_ptr<WebSocketView> view) {
+    websocket_view_ = view;
+  }
+
+  // Has the connection been switched to HTTP/2?
+  // An HTTP/2 connection is put into the queue once per request (stream), use
+  // PopHttp2Request() and SendHttp2Response() instead of request() and
+  // SendResponse() to handle it.
+  bool IsHttp2() const {
+    return !!http2_session_;
+  }
+
+  // Pop a request which is ready to be handled, and the ID of its stream.
+  // Could be called from any thread.
+  RequestPtr PopHttp2Request(std::uint32_t* stream_id);
+
+  // Send a response on the given stream.
+  // Could be called from any thread.
+  void SendHttp2Response(std::uint32_t stream_id, ResponsePtr response);
+
 private:
+  // The following handlers are called in the strand, except those of the
+  // WebSocket upgrade.
+  void DoStart();
+
+  // Wait until the socket is readable, i.e., the next request is coming.
+  void DoWaitRead();
+  void OnWaitRead(std::error_code ec);
+
   void DoRead();
   void OnRead(std::error_code ec, std::size_t length);
 
+  // Parse the request data, timed for the metrics and traced.
+  bool Parse(const char* data, std::size_t length);
+
+  // Start the span of a new request on its first byte.
+  void StartSpan();
+
+  // Add an event to the span of the request, if any.
+  void AddSpanEvent(const char* name) {
+    if (span_) {
+      span_->AddEvent(name);
+    }
+  }
+
+  // (Re)start the timer for reading the request, 0 to cancel it.
+  void SetReadTimeout(int seconds);
+
+  // Called in the strand.
+  void OnReadTimeout(std::size_t seq);
+
+  // Try to admit the request into the queue.
+  bool Admit(Request* request);
+
+  // The response for the requests not admitted.
+  ResponsePtr NewServiceUnavailable() const;
+
+  // Check if the request asks for upgrading to HTTP/2 over cleartext TCP.
+  bool IsHttp2Upgrade() const;
+
+  // Switch to HTTP/2 with the preface (and possibly more data) received.
+  // |offset| and |length| specify the data after the preface in the buffer.
+  void StartHttp2(std::size_t offset, std::size_t length);
+
+  // Switch to HTTP/2 by the upgrade request.
+  void UpgradeHttp2();
+
+  // The following HTTP/2 handlers are all called in the strand.
+  void OnHttp2Data(const char* data, std::size_t length);
+  void DoReadHttp2();
+  void OnReadHttp2(std::error_code ec, std::size_t length);
+  void DoWriteHttp2();
+  void OnWriteHttp2(std::error_code ec, std::size_t length);
+
+  void DoSendResponse(ResponsePtr response, bool no_keep_alive);
   void DoWrite();
   void OnWriteHeaders(std::error_code ec, std::size_t length);
   void DoWriteBody();
   void OnWriteBody(std::error_code ec, std::size_t length);
   void OnWriteOK();
+
+  // The following stream handlers are all called in the strand.
+  void StartStream();
+  void DoWriteStream();
+  void OnWriteStream(std::error_code ec, std::size_t length);
+  void DoReadStream();
+  void OnReadStream(std::error_code ec, std::size_t length);
+  void DoWaitHeartbeat();
+  void OnHeartbeat();
+
+  // Hand over the socket to a WebSocketConnection.
+  void UpgradeWebSocket();
   void OnWriteError(std::error_code ec);
 
   // The socket for the connection.
@@ -73,10 +214,10 @@ private:
 
   // A function for matching view once the headers of a request has been
   // received.
-  ViewMatcher view_matcher_;
+  const ViewMatcher* view_matcher_;
 
-  // The buffer for incoming data.
-  std::vector<char> buffer_;
+  // The buffer for incoming data, released when the connection is idle.
+  ReadBuffer buffer_;
 
   // The incoming request.
   RequestPtr request_;
@@ -86,6 +227,89 @@ private:
 
   // The response to be sent back to the client.
   ResponsePtr response_;
+
+  // Timeouts (seconds) of waiting for a new request, receiving the headers
+  // and receiving more body data.
+  int idle_timeout_;
+  int header_timeout_;
+  int body_timeout_;
+
+  ConcurrencyLimiter* limiter_;
+  int retry_after_;
+
+  ServerMetrics* metrics_;
+
+  // When the first byte of the request was received, the time spent in
+  // parsing it, and when the response started to be written.
+  std::chrono::steady_clock::time_point read_start_;
+  std::chrono::steady_clock::duration parse_time_;
+  std::chrono::steady_clock::time_point write_start_;
+
+  TraceSink* trace_sink_;
+
+  // The span of the current request, and when the connection was accepted,
+  // which is traced with the first request only.
+  SpanPtr span_;
+  std::chrono::steady_clock::time_point accept_time_;
+  bool first_request_;
+
+  // Any data of the request has been received?
+  std::atomic<bool> request_started_;
+
+  // Any response has been sent?
+  bool served_;
+
+  // Keep the connection alive once the response is sent?
+  bool keep_alive_;
+
+  TimerWheel* timer_wheel_;
+  TimerWheel::Timer read_timer_;
+
+  // Increased on each (re)start of the timer to ignore the stale timeouts.
+  std::atomic<std::size_t> read_timer_seq_;
+
+  // The body of the response if it's a stream, e.g., Server-Sent Events.
+  StreamBodyPtr stream_body_;
+  bool stream_started_;
+  bool stream_writing_;
+
+  // Any data written since last heartbeat?
+  bool stream_active_;
+
+  TimerWheel::Timer heartbeat_timer_;
+
+  // The WebSocket view if the response is a WebSocket handshake.
+  std::shared_ptr<WebSocketView> websocket_view_;
+
+  // Bytes of the HTTP/2 connection preface matched at the beginning of the
+  // connection.
+  std::size_t preface_matched_;
+  bool preface_checked_;
+
+  // HTTP/2 session, null for HTTP/1.1.
+  std::unique_ptr<Http2Session> http2_session_;
+
+  // Serialize the handlers of HTTP/2 since the reading, writing and the
+  // responses from the workers all access the session.
+  asio::strand<asio::executor> strand_;
+
+  // The data being written.
+  std::string http2_output_;
+  bool http2_writing_;
+
+  // The HTTP/2 requests waiting for the workers to handle.
+  std::deque<std::pair<std::uint32_t, RequestPtr>> http2_requests_;
+  std::mutex http2_mutex_;
+
+  // The registry of the ConnectionPool links the connections into the lists
+  // of the shards, guarded by the mutex of the shard.
+  friend class ConnectionPool;
+  std::size_t shard_;
+  Connection* prev_;
+  Connection* next_;
+
+  // Keep the connection alive while it's in the registry.
+  ConnectionPtr self_;
 };
 
 }  // namespace webcc
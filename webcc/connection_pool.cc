@@ -1,43 +1,283 @@
 #include "webcc/connection_pool.h"
 
+#include <utility>
+
 #include "webcc/logger.h"
 
+using asio::ip::tcp;
+
 namespace webcc {
 
+class ConnectionPool::FreeList {
+public:
+  FreeList() = default;
+
+  ~FreeList() {
+    for (Connection* c : connections_) {
+      delete c;
+    }
+  }
+
+  FreeList(const FreeList&) = delete;
+  FreeList& operator=(const FreeList&) = delete;
+
+  Connection* Pop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (connections_.empty()) {
+      return nullptr;
+    }
+    Connection* c = connections_.back();
+    connections_.pop_back();
+    return c;
+  }
+
+  // Return false if the list is full.
+  bool Push(Connection* c) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (connections_.size() >= kMaxFreeConnections) {
+      return false;
+    }
+    connections_.push_back(c);
+    return true;
+  }
+
+  std::size_t Size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return connections_.size();
+  }
+
+private:
+  std::vector<Connection*> connections_;
+  std::mutex mutex_;
+};
+
+// -----------------------------------------------------------------------------
+
+class ConnectionPool::Recycler {
+public:
+  explicit Recycler(std::weak_ptr<FreeList> free_list)
+      : free_list_(std::move(free_list)) {
+  }
+
+  void operator()(Connection* c) const {
+    if (auto free_list = free_list_.lock()) {
+      c->Recycle();
+      if (free_list->Push(c)) {
+        return;
+      }
+    }
+    delete c;
+  }
+
+private:
+  std::weak_ptr<FreeList> free_list_;
+};
+
+// -----------------------------------------------------------------------------
+
+ConnectionPool::ConnectionPool() : free_list_(std::make_shared<FreeList>()) {
+}
+
+ConnectionPool::~ConnectionPool() {
+  // Release the references of the registry, the sockets are closed when the
+  // connections are recycled.
+  std::vector<ConnectionPtr> connections;
+  for (auto& shard : shards_) {
+    UnlinkAll(shard, &connections);
+  }
+}
+
+ConnectionPtr ConnectionPool::NewConnection(tcp::socket socket,
+                                            Queue<ConnectionPtr>* queue,
+                                            const ViewMatcher* view_matcher) {
+  Connection* c = free_list_->Pop();
+  if (c != nullptr) {
+    c->Reset(std::move(socket));
+  } else {
+    c = new Connection(std::move(socket), this, queue, view_matcher);
+  }
+
+  return ConnectionPtr(c, Recycler(free_list_));
+}
+
 void ConnectionPool::Start(ConnectionPtr c) {
   LOG_VERB("Starting connection...");
 
+  Connection* p = c.get();
+  Link(std::move(c));
+  p->Start();
+}
+
+void ConnectionPool::Close(ConnectionPtr c) {
+  LOG_VERB("Closing connection...");
+
+  Unlink(c.get());
+
+  c->Close();
+}
+
+void ConnectionPool::Upgrade(ConnectionPtr c, WebSocketConnectionPtr ws) {
+  LOG_VERB("Upgrading connection to WebSocket...");
+
   {
-    // Lock the container only.
     std::lock_guard<std::mutex> lock(mutex_);
-    connections_.insert(c);
+    if (websockets_.insert(ws).second) {
+      ++size_;
+    }
   }
 
-  c->Start();
+  Unlink(c.get());
+
+  ws->Start();
 }
 
-void ConnectionPool::Close(ConnectionPtr c) {
-  LOG_VERB("Closing connection...");
+void ConnectionPool::Close(WebSocketConnectionPtr ws) {
+  LOG_VERB("Closing WebSocket connection...");
 
+  bool erased = false;
   {
-    // Lock the container only.
     std::lock_guard<std::mutex> lock(mutex_);
-    connections_.erase(c);
+    erased = websockets_.erase(ws) > 0;
   }
 
-  c->Close();
+  if (erased) {
+    OnRemoved();
+  }
+
+  ws->Stop();
 }
 
-void ConnectionPool::Clear() {
-  // Lock all since we are going to stop anyway.
+std::size_t ConnectionPool::GetFreeCount() const {
+  return free_list_->Size();
+}
+
+void ConnectionPool::Drain() {
+  LOG_VERB("Draining connections...");
+
+  draining_ = true;
+
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (Connection* c = shard.head; c != nullptr; c = c->next_) {
+      c->Drain();
+    }
+  }
+
   std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& ws : websockets_) {
+    ws->Close(websocket::kGoingAway);
+  }
+}
+
+bool ConnectionPool::WaitEmpty(std::chrono::steady_clock::time_point deadline) {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  return empty_cv_.wait_until(lock, deadline, [this] { return size_ == 0; });
+}
 
-  if (!connections_.empty()) {
-    LOG_VERB("Closing all (%u) connections...", connections_.size());
-    for (auto& c : connections_) {
+void ConnectionPool::Clear() {
+  std::vector<ConnectionPtr> connections;
+  for (auto& shard : shards_) {
+    UnlinkAll(shard, &connections);
+  }
+
+  if (!connections.empty()) {
+    LOG_VERB("Closing all (%u) connections...", connections.size());
+    for (auto& c : connections) {
       c->Close();
     }
-    connections_.clear();
+  }
+
+  std::set<WebSocketConnectionPtr> websockets;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    websockets.swap(websockets_);
+  }
+
+  if (!websockets.empty()) {
+    LOG_VERB("Closing all (%u) WebSocket connections...", websockets.size());
+    for (auto& ws : websockets) {
+      ws->Stop();
+      OnRemoved();
+    }
+  }
+
+  draining_ = false;
+}
+
+void ConnectionPool::Link(ConnectionPtr c) {
+  std::size_t index = next_shard_++ % kConnectionShards;
+  Shard& shard = shards_[index];
+
+  Connection* p = c.get();
+  p->shard_ = index;
+
+  ++size_;
+
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  p->self_ = std::move(c);
+  p->prev_ = nullptr;
+  p->next_ = shard.head;
+  if (shard.head != nullptr) {
+    shard.head->prev_ = p;
+  }
+  shard.head = p;
+}
+
+ConnectionPtr ConnectionPool::Unlink(Connection* c) {
+  Shard& shard = shards_[c->shard_];
+
+  ConnectionPtr self;
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!c->self_) {
+      return self;
+    }
+
+    if (c->prev_ != nullptr) {
+      c->prev_->next_ = c->next_;
+    } else {
+      shard.head = c->next_;
+    }
+    if (c->next_ != nullptr) {
+      c->next_->prev_ = c->prev_;
+    }
+    c->prev_ = nullptr;
+    c->next_ = nullptr;
+
+    self = std::move(c->self_);
+  }
+
+  OnRemoved();
+  return self;
+}
+
+void ConnectionPool::UnlinkAll(Shard& shard,
+                               std::vector<ConnectionPtr>* connections) {
+  std::size_t count = 0;
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (Connection* c = shard.head; c != nullptr;) {
+      Connection* next = c->next_;
+      c->prev_ = nullptr;
+      c->next_ = nullptr;
+      connections->push_back(std::move(c->self_));
+      c = next;
+      ++count;
+    }
+    shard.head = nullptr;
+  }
+
+  for (; count > 0; --count) {
+    OnRemoved();
+  }
+}
+
+void ConnectionPool::OnRemoved() {
+  if (--size_ == 0) {
+    // Lock to not miss the waiter which is checking the size.
+    std::lock_guard<std::mutex> lock(mutex_);
+    empty_cv_.notify_all();
   }
 }
 
@@ -1,20 +1,39 @@
 #ifndef WEBCC_CONNECTION_POOL_H_
 #define WEBCC_CONNECTION_POOL_H_
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <set>
+#include <vector>
 
 #include "webcc/connection.h"
+#include "webcc/websocket.h"
 
 namespace webcc {
 
+// The registry of the live connections of a server.
+// The connections are linked into the intrusive lists of a few shards, each
+// with its own lock, so that the accepting and closing on the loop threads
+// rarely contend. The connections closed are recycled for the new sockets.
 class ConnectionPool {
 public:
-  ConnectionPool() = default;
+  ConnectionPool();
+
+  ~ConnectionPool();
 
   ConnectionPool(const ConnectionPool&) = delete;
   ConnectionPool& operator=(const ConnectionPool&) = delete;
 
+  // Create a connection for the accepted socket, reusing a recycled one if
+  // any. |view_matcher| must outlive the pool.
+  ConnectionPtr NewConnection(asio::ip::tcp::socket socket,
+                              Queue<ConnectionPtr>* queue,
+                              const ViewMatcher* view_matcher);
+
   // Add the connection and start to read the request from it.
   // Called when a new connection has just been accepted.
   void Start(ConnectionPtr c);
@@ -23,15 +42,82 @@ public:
   // Called when the response of the connection has been sent back.
   void Close(ConnectionPtr c);
 
+  // Replace the connection with the WebSocket connection which has taken over
+  // its socket, and start it.
+  // Called when the response of the WebSocket handshake has been sent back.
+  void Upgrade(ConnectionPtr c, WebSocketConnectionPtr ws);
+
+  // Close the WebSocket connection.
+  void Close(WebSocketConnectionPtr ws);
+
+  // Number of the live connections, including the WebSocket ones.
+  std::size_t Size() const {
+    return size_;
+  }
+
+  // Number of the connections kept for reuse.
+  std::size_t GetFreeCount() const;
+
+  // Close the idle connections and let the others close once the current
+  // requests are done. No connection is kept alive any more.
+  // Called when the server is going to stop gracefully.
+  void Drain();
+
+  bool draining() const {
+    return draining_;
+  }
+
+  // Wait until all the connections have been closed or the deadline expires.
+  // Return false on timeout.
+  bool WaitEmpty(std::chrono::steady_clock::time_point deadline);
+
   // Close all pending connections.
   // Called when the server is about to stop.
   void Clear();
 
 private:
-  std::set<ConnectionPtr> connections_;
+  // A shard of the registry, a doubly linked list of the connections.
+  struct Shard {
+    std::mutex mutex;
+    Connection* head = nullptr;
+  };
+
+  class FreeList;
+
+  // The deleter of the connections, which puts them back to the free list.
+  // The free list might have gone with the pool.
+  class Recycler;
+
+  void Link(ConnectionPtr c);
+
+  // Return the reference held by the registry, null if the connection is not
+  // in it.
+  ConnectionPtr Unlink(Connection* c);
+
+  // Collect and unlink all the connections of the shard.
+  void UnlinkAll(Shard& shard, std::vector<ConnectionPtr>* connections);
+
+  // Called when a connection or WebSocket connection is removed.
+  void OnRemoved();
+
+  std::array<Shard, kConnectionShards> shards_;
+
+  // For assigning the connections to the shards in turn.
+  std::atomic<std::size_t> next_shard_{ 0 };
+
+  std::shared_ptr<FreeList> free_list_;
+
+  std::set<WebSocketConnectionPtr> websockets_;
+
+  // Number of the connections and the WebSocket connections.
+  std::atomic<std::size_t> size_{ 0 };
+
+  std::atomic<bool> draining_{ false };
+
+  // Notified when the last connection is closed.
+  std::condition_variable empty_cv_;
 
-  // Mutex is necessary if the loop is running in multiple threads.
-  // See Server::Run().
+  // Guard the WebSocket connections and the notification of empty.
   std::mutex mutex_;
 };
 
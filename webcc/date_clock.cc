@@ -0,0 +1,120 @@
+#include "webcc/date_clock.h"
+
+#include <cstring>
+
+namespace webcc {
+
+namespace {
+
+const char* const kWeekdays[] = {
+  "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat",
+};
+
+const char* const kMonths[] = {
+  "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+  "Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
+};
+
+void PutTwoDigits(int value, char* p) {
+  p[0] = static_cast<char>('0' + value / 10 % 10);
+  p[1] = static_cast<char>('0' + value % 10);
+}
+
+}  // namespace
+
+DateClock& DateClock::Instance() {
+  static DateClock clock;
+  return clock;
+}
+
+DateClock::DateClock() : second_(0), seq_(0) {
+  for (auto& word : words_) {
+    word = 0;
+  }
+  Update(std::time(nullptr));
+}
+
+std::string DateClock::Now() {
+  char date[kSize];
+  Now(date);
+  return std::string(date, kSize);
+}
+
+void DateClock::Now(char* date) {
+  std::time_t now = std::time(nullptr);
+  if (now != second_.load(std::memory_order_acquire)) {
+    Update(now);
+  }
+
+  char words[kWords * 8];
+
+  std::uint32_t seq = 0;
+  do {
+    seq = seq_.load(std::memory_order_acquire);
+    if (seq % 2 != 0) {
+      continue;  // Being written
+    }
+
+    for (std::size_t i = 0; i < kWords; ++i) {
+      std::uint64_t word = words_[i].load(std::memory_order_relaxed);
+      std::memcpy(words + i * 8, &word, 8);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while (seq % 2 != 0 || seq != seq_.load(std::memory_order_relaxed));
+
+  std::memcpy(date, words, kSize);
+}
+
+void DateClock::Format(std::time_t time, char* date) {
+  std::tm tm{};
+#if (defined(_WIN32) || defined(_WIN64))
+  gmtime_s(&tm, &time);
+#else
+  gmtime_r(&time, &tm);
+#endif
+
+  // "Wed, 21 Oct 2015 07:28:00 GMT"
+  // Not strftime() which depends on the locale.
+  std::memcpy(date, kWeekdays[tm.tm_wday], 3);
+  std::memcpy(date + 3, ", ", 2);
+  PutTwoDigits(tm.tm_mday, date + 5);
+  date[7] = ' ';
+  std::memcpy(date + 8, kMonths[tm.tm_mon], 3);
+  date[11] = ' ';
+  int year = tm.tm_year + 1900;
+  PutTwoDigits(year / 100, date + 12);
+  PutTwoDigits(year % 100, date + 14);
+  date[16] = ' ';
+  PutTwoDigits(tm.tm_hour, date + 17);
+  date[19] = ':';
+  PutTwoDigits(tm.tm_min, date + 20);
+  date[22] = ':';
+  PutTwoDigits(tm.tm_sec, date + 23);
+  std::memcpy(date + 25, " GMT", 4);
+}
+
+void DateClock::Update(std::time_t now) {
+  std::unique_lock<std::mutex> lock(update_mutex_, std::try_to_lock);
+  if (!lock.owns_lock() || second_.load(std::memory_order_relaxed) == now) {
+    return;
+  }
+
+  char date[kWords * 8] = { 0 };
+  Format(now, date);
+
+  seq_.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  for (std::size_t i = 0; i < kWords; ++i) {
+    std::uint64_t word = 0;
+    std::memcpy(&word, date + i * 8, 8);
+    words_[i].store(word, std::memory_order_relaxed);
+  }
+
+  seq_.fetch_add(1, std::memory_order_release);
+
+  second_.store(now, std::memory_order_release);
+}
+
+}  // namespace webcc
@@ -0,0 +1,59 @@
+#ifndef WEBCC_DATE_CLOCK_H_
+#define WEBCC_DATE_CLOCK_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <string>
+
+namespace webcc {
+
+// The clock for the HTTP Date header, which renders the date (RFC 7231), e.g.,
+// "Wed, 21 Oct 2015 07:28:00 GMT", at most once per second.
+// The date is published in atomic words guarded by a sequence number
+// (seqlock), so that the readers in any thread neither lock nor format.
+class DateClock {
+public:
+  // Length of the date.
+  static constexpr std::size_t kSize = 29;
+
+  static DateClock& Instance();
+
+  DateClock(const DateClock&) = delete;
+  DateClock& operator=(const DateClock&) = delete;
+
+  // Get the date of the current second.
+  std::string Now();
+
+  // Copy the date of the current second to |date| without allocating.
+  // |date| must have space for kSize characters.
+  void Now(char* date);
+
+  // Render the date of the given time, e.g., for testing.
+  // |date| must have space for kSize characters.
+  static void Format(std::time_t time, char* date);
+
+private:
+  DateClock();
+
+  // Render and publish the date of the given second.
+  // Skipped if another thread is doing it.
+  void Update(std::time_t now);
+
+  // The second rendered.
+  std::atomic<std::time_t> second_;
+
+  // Odd while the words are being written.
+  std::atomic<std::uint32_t> seq_;
+
+  static constexpr std::size_t kWords = (kSize + 7) / 8;
+  std::atomic<std::uint64_t> words_[kWords];
+
+  std::mutex update_mutex_;
+};
+
+}  // namespace webcc
+
+#endif  // WEBCC_DATE_CLOCK_H_
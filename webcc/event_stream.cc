@@ -0,0 +1,77 @@
+#include "webcc/event_stream.h"
+
+namespace webcc {
+
+namespace {
+
+// Append a field with the line terminators in |value| stripped, so that it
+// can't end the line and inject other fields or events.
+void AppendField(const char* name, const std::string& value,
+                 std::string* message) {
+  *message += name;
+  for (char c : value) {
+    if (c != '\r' && c != '\n') {
+      *message += c;
+    }
+  }
+  *message += "\n";
+}
+
+}  // namespace
+
+EventStream::EventStream(int heartbeat_seconds) {
+  set_heartbeat(heartbeat_seconds, ":\n\n");
+}
+
+bool EventStream::Send(const std::string& data, const std::string& event,
+                       const std::string& id) {
+  std::string message;
+  message.reserve(data.size() + event.size() + id.size() + 32);
+
+  if (!event.empty()) {
+    AppendField("event: ", event, &message);
+  }
+
+  if (!id.empty()) {
+    AppendField("id: ", id, &message);
+  }
+
+  // A line ends with "\r\n", '\n' or '\r'.
+  std::size_t begin = 0;
+  for (;;) {
+    std::size_t end = data.find_first_of("\r\n", begin);
+    message += "data: ";
+    message.append(data, begin,
+                   end == std::string::npos ? std::string::npos : end - begin);
+    message += "\n";
+
+    if (end == std::string::npos) {
+      break;
+    }
+
+    begin = end + 1;
+    if (data[end] == '\r' && begin < data.size() && data[begin] == '\n') {
+      ++begin;
+    }
+  }
+
+  message += "\n";
+
+  return Write(std::move(message));
+}
+
+bool EventStream::SendRetry(int milliseconds) {
+  return Write("retry: " + std::to_string(milliseconds) + "\n\n");
+}
+
+bool EventStream::SendComment(const std::string& comment) {
+  std::string message;
+  message.reserve(comment.size() + 4);
+
+  AppendField(": ", comment, &message);
+  message += "\n";
+
+  return Write(std::move(message));
+}
+
+}  // namespace webcc
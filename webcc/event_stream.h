@@ -0,0 +1,55 @@
+#ifndef WEBCC_EVENT_STREAM_H_
+#define WEBCC_EVENT_STREAM_H_
+
+// Server-Sent Events.
+// See https://html.spec.whatwg.org/multipage/server-sent-events.html
+
+#include <memory>
+#include <string>
+
+#include "webcc/body.h"
+
+namespace webcc {
+
+// Seconds of idle before a heartbeat (comment) is sent.
+const int kEventStreamHeartbeat = 15;
+
+// The writer handle of an SSE response.
+// Usage:
+//   class EventsView : public webcc::View {
+//   public:
+//     webcc::ResponsePtr Handle(webcc::RequestPtr request) override {
+//       auto stream = std::make_shared<webcc::EventStream>();
+//       // Keep the stream, and send events from any thread later.
+//       AddStream(stream);
+//       return webcc::ResponseBuilder{}.OK().EventStream(stream)();
+//     }
+//   };
+//   ...
+//   if (!stream->Send("Hello")) {
+//     // The client has gone, drop the stream.
+//   }
+class EventStream : public StreamBody {
+public:
+  explicit EventStream(int heartbeat_seconds = kEventStreamHeartbeat);
+
+  // Send an event. A multi-line |data| is sent as multiple data fields, the
+  // lines could end with "\r\n", '\n' or '\r'.
+  // |event| is the event type and |id| is the last event ID, both optional,
+  // with CR and LF stripped.
+  // Return false if the stream has been closed.
+  bool Send(const std::string& data, const std::string& event = "",
+            const std::string& id = "");
+
+  // Tell the client how long to wait before reconnecting.
+  bool SendRetry(int milliseconds);
+
+  // Send a comment which is ignored by the client, with CR and LF stripped.
+  bool SendComment(const std::string& comment);
+};
+
+using EventStreamPtr = std::shared_ptr<EventStream>;
+
+}  // namespace webcc
+
+#endif  // WEBCC_EVENT_STREAM_H_
@@ -32,6 +32,33 @@ const std::size_t kInvalidLength = std::string::npos;
 // Default timeout for reading response.
 const int kMaxReadSeconds = 30;
 
+// Default timeout for connecting to the server.
+const int kMaxConnectSeconds = 10;
+
+// Default timeout for a server connection waiting for the next request.
+const int kIdleTimeout = 60;
+
+// Default timeout for receiving the headers of a request, counted from its
+// first byte.
+const int kHeaderTimeout = 30;
+
+// Default timeout for receiving more body data of a request.
+const int kBodyTimeout = 30;
+
+// Default seconds of the Retry-After header when the server is overloaded.
+const int kRetryAfter = 1;
+
+// The tick (milliseconds), the number of levels and the number of slots per
+// level of the timer wheel. The wheel covers 64^4 ticks, i.e., about 19 days,
+// longer timeouts are clamped.
+const int kTimerWheelTick = 100;
+const std::size_t kTimerWheelLevels = 4;
+const std::size_t kTimerWheelSlots = 64;
+
+// Delay (milliseconds) before starting the next connection attempt if the
+// host has several endpoints. The value is recommended by RFC 8305.
+const int kConnectAttemptDelay = 250;
+
 // Max size of the HTTP body to dump/log.
 // If the HTTP, e.g., response, has a very large content, it will be truncated
 // when dumped/logged.
@@ -40,6 +67,22 @@ const std::size_t kMaxDumpSize = 2048;
 // Default buffer size for socket reading.
 const std::size_t kBufferSize = 1024;
 
+// The read buffer grows up to this size when the reads keep filling it.
+const std::size_t kMaxBufferSize = 64 * 1024;
+
+// Max bytes of the free buffers kept by the pool for each size class.
+const std::size_t kMaxPooledBytes = 1024 * 1024;
+
+// Size of the inline buffer of the arena for the objects of a request.
+// Enough for a Request, a Response and a small body.
+const std::size_t kArenaSize = 2048;
+
+// Max number of the closed connections kept by the server for reuse.
+const std::size_t kMaxFreeConnections = 256;
+
+// Number of the shards of the connection registry, each with its own lock.
+const std::size_t kConnectionShards = 8;
+
 // Why 1400? See the following page:
 // https://www.itworld.com/article/2693941/why-it-doesn-t-make-sense-to-
 // gzip-all-content-from-your-web-server.html
@@ -82,6 +125,7 @@ const char* const kPatch = "PATCH";
 // The full list is available here:
 //   https://en.wikipedia.org/wiki/List_of_HTTP_status_codes
 enum Status {
+  kSwitchingProtocols = 101,
   kOK = 200,
   kCreated = 201,
   kAccepted = 202,
@@ -89,6 +133,7 @@ enum Status {
   kNotModified = 304,
   kBadRequest = 400,
   kNotFound = 404,
+  kRequestHeaderFieldsTooLarge = 431,
   kInternalServerError = 500,
   kNotImplemented = 501,
   kServiceUnavailable = 503,
@@ -112,6 +157,8 @@ const char* const kAccept = "Accept";
 const char* const kAcceptEncoding = "Accept-Encoding";
 const char* const kUserAgent = "User-Agent";
 const char* const kServer = "Server";
+const char* const kRetryAfter = "Retry-After";
+const char* const kTraceparent = "traceparent";
 
 }  // namespace headers
 
@@ -122,6 +169,7 @@ namespace media_types {
 
 const char* const kApplicationJson = "application/json";
 const char* const kApplicationSoapXml = "application/soap+xml";
+const char* const kTextEventStream = "text/event-stream";
 const char* const kTextPlain = "text/plain";
 const char* const kTextXml = "text/xml";
 
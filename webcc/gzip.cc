@@ -1,6 +1,7 @@
 #include "webcc/gzip.h"
 
 #include <cassert>
+#include <fstream>
 #include <utility>  // std::move
 
 #include "zlib.h"
@@ -127,5 +128,68 @@ bool Decompress(const std::string& input, std::string* output) {
   return true;
 }
 
+bool CompressFile(const std::filesystem::path& input,
+                  const std::filesystem::path& output) {
+  std::ifstream ifs{ input, std::ios::binary };
+  if (!ifs) {
+    return false;
+  }
+
+  std::ofstream ofs{ output, std::ios::binary | std::ios::trunc };
+  if (!ofs) {
+    return false;
+  }
+
+  z_stream stream;
+  stream.zalloc = Z_NULL;
+  stream.zfree = Z_NULL;
+  stream.opaque = Z_NULL;
+
+  int ret = deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                         MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY);
+  if (ret != Z_OK) {
+    return false;
+  }
+
+  const std::size_t kChunkSize = 64 * 1024;
+  std::string in_buf(kChunkSize, '\0');
+  std::string out_buf(kChunkSize, '\0');
+
+  int flush = Z_NO_FLUSH;
+
+  do {
+    ifs.read(&in_buf[0], in_buf.size());
+    if (ifs.bad()) {
+      deflateEnd(&stream);
+      return false;
+    }
+
+    stream.next_in = (Bytef*)in_buf.data();
+    stream.avail_in = (uInt)ifs.gcount();
+
+    flush = ifs.eof() ? Z_FINISH : Z_NO_FLUSH;
+
+    // Run deflate() on the chunk until output buffer is not full.
+    do {
+      stream.next_out = (Bytef*)&out_buf[0];
+      stream.avail_out = (uInt)out_buf.size();
+
+      int err = deflate(&stream, flush);
+      if (err == Z_STREAM_ERROR) {
+        deflateEnd(&stream);
+        return false;
+      }
+
+      ofs.write(out_buf.data(), out_buf.size() - stream.avail_out);
+    } while (stream.avail_out == 0);
+
+  } while (flush != Z_FINISH);
+
+  deflateEnd(&stream);
+
+  ofs.close();
+  return !ofs.fail();
+}
+
 }  // namespace gzip
 }  // namespace webcc
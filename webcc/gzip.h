@@ -1,6 +1,7 @@
 #ifndef WEBCC_GZIP_H_
 #define WEBCC_GZIP_H_
 
+#include <filesystem>
 #include <string>
 
 namespace webcc {
@@ -13,6 +14,10 @@ bool Compress(const std::string& input, std::string* output);
 // formats.
 bool Decompress(const std::string& input, std::string* output);
 
+// Compress the input file to a gzip file, chunk by chunk.
+bool CompressFile(const std::filesystem::path& input,
+                  const std::filesystem::path& output);
+
 }  // namespace gzip
 }  // namespace webcc
 
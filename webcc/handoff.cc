@@ -0,0 +1,118 @@
+#include "webcc/handoff.h"
+
+#if defined(__linux__)
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "webcc/logger.h"
+
+namespace webcc {
+
+namespace handoff {
+
+bool SendFd(int socket, int fd) {
+  // At least one byte of normal data is needed to carry the ancillary data.
+  char data = 'F';
+  iovec iov{ &data, 1 };
+
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+  std::memset(control, 0, sizeof(control));
+
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+  ssize_t size = 0;
+  do {
+    size = ::sendmsg(socket, &msg, MSG_NOSIGNAL);
+  } while (size < 0 && errno == EINTR);
+
+  if (size != 1) {
+    LOG_ERRO("Failed to send the fd (%s).", std::strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+int ReceiveFd(int socket) {
+  char data = 0;
+  iovec iov{ &data, 1 };
+
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t size = 0;
+  do {
+    size = ::recvmsg(socket, &msg, MSG_CMSG_CLOEXEC);
+  } while (size < 0 && errno == EINTR);
+
+  if (size != 1) {
+    LOG_ERRO("Failed to receive the fd (%s).",
+             size < 0 ? std::strerror(errno) : "no data");
+    return -1;
+  }
+
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET ||
+      cmsg->cmsg_type != SCM_RIGHTS ||
+      cmsg->cmsg_len != CMSG_LEN(sizeof(int))) {
+    LOG_ERRO("No fd received.");
+    return -1;
+  }
+
+  int fd = -1;
+  std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+  return fd;
+}
+
+int TakeOver(const std::string& path) {
+  sockaddr_un addr{};
+  if (path.size() >= sizeof(addr.sun_path)) {
+    LOG_ERRO("The handoff path is too long: %s", path.c_str());
+    return -1;
+  }
+
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, path.c_str(), path.size());
+
+  int socket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (socket < 0) {
+    return -1;
+  }
+
+  int fd = -1;
+  if (::connect(socket, reinterpret_cast<sockaddr*>(&addr),
+                sizeof(addr)) == 0) {
+    fd = ReceiveFd(socket);
+  } else {
+    // Normal if it's the first process.
+    LOG_INFO("No server to take over (%s).", std::strerror(errno));
+  }
+
+  ::close(socket);
+  return fd;
+}
+
+}  // namespace handoff
+
+}  // namespace webcc
+
+#endif  // defined(__linux__)
@@ -0,0 +1,38 @@
+#ifndef WEBCC_HANDOFF_H_
+#define WEBCC_HANDOFF_H_
+
+// Hand off the listening socket between processes for hot restart (Linux).
+// The running server listens on a Unix domain socket, a new server process
+// connects to it and receives the file descriptor of the listening socket
+// (SCM_RIGHTS). The new server starts to accept on the socket while the old
+// one stops accepting and drains its connections. The socket is never closed,
+// so the port never refuses connections.
+// See Server::set_handoff_path().
+
+#if defined(__linux__)
+
+#include <string>
+
+namespace webcc {
+
+namespace handoff {
+
+// Send the file descriptor over the connected Unix domain socket.
+bool SendFd(int socket, int fd);
+
+// Receive a file descriptor from the connected Unix domain socket.
+// Return -1 on error.
+int ReceiveFd(int socket);
+
+// Connect to the Unix domain socket at |path| and receive the listening socket
+// from the server listening there.
+// Return -1 if no server is listening or on error.
+int TakeOver(const std::string& path);
+
+}  // namespace handoff
+
+}  // namespace webcc
+
+#endif  // defined(__linux__)
+
+#endif  // WEBCC_HANDOFF_H_
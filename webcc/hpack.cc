@@ -0,0 +1,820 @@
+#include "webcc/hpack.h"
+
+#include <algorithm>
+
+#include "webcc/logger.h"
+
+namespace webcc {
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+// The static table (RFC 7541 Appendix A).
+const Header kStaticTable[] = {
+  { ":authority", "" },
+  { ":method", "GET" },
+  { ":method", "POST" },
+  { ":path", "/" },
+  { ":path", "/index.html" },
+  { ":scheme", "http" },
+  { ":scheme", "https" },
+  { ":status", "200" },
+  { ":status", "204" },
+  { ":status", "206" },
+  { ":status", "304" },
+  { ":status", "400" },
+  { ":status", "404" },
+  { ":status", "500" },
+  { "accept-charset", "" },
+  { "accept-encoding", "gzip, deflate" },
+  { "accept-language", "" },
+  { "accept-ranges", "" },
+  { "accept", "" },
+  { "access-control-allow-origin", "" },
+  { "age", "" },
+  { "allow", "" },
+  { "authorization", "" },
+  { "cache-control", "" },
+  { "content-disposition", "" },
+  { "content-encoding", "" },
+  { "content-language", "" },
+  { "content-length", "" },
+  { "content-location", "" },
+  { "content-range", "" },
+  { "content-type", "" },
+  { "cookie", "" },
+  { "date", "" },
+  { "etag", "" },
+  { "expect", "" },
+  { "expires", "" },
+  { "from", "" },
+  { "host", "" },
+  { "if-match", "" },
+  { "if-modified-since", "" },
+  { "if-none-match", "" },
+  { "if-range", "" },
+  { "if-unmodified-since", "" },
+  { "last-modified", "" },
+  { "link", "" },
+  { "location", "" },
+  { "max-forwards", "" },
+  { "proxy-authenticate", "" },
+  { "proxy-authorization", "" },
+  { "range", "" },
+  { "referer", "" },
+  { "refresh", "" },
+  { "retry-after", "" },
+  { "server", "" },
+  { "set-cookie", "" },
+  { "strict-transport-security", "" },
+  { "transfer-encoding", "" },
+  { "user-agent", "" },
+  { "vary", "" },
+  { "via", "" },
+  { "www-authenticate", "" },
+};
+
+const std::size_t kStaticTableSize =
+    sizeof(kStaticTable) / sizeof(kStaticTable[0]);
+
+// Each entry is the code (right-aligned) and its length in bits.
+struct HuffmanCode {
+  std::uint32_t code;
+  int length;
+};
+
+// The Huffman code table (RFC 7541 Appendix B), indexed by symbol.
+// The last one is EOS.
+const HuffmanCode kHuffmanCodes[257] = {
+  { 0x00001ff8, 13 },  // 0
+  { 0x007fffd8, 23 },  // 1
+  { 0x0fffffe2, 28 },  // 2
+  { 0x0fffffe3, 28 },  // 3
+  { 0x0fffffe4, 28 },  // 4
+  { 0x0fffffe5, 28 },  // 5
+  { 0x0fffffe6, 28 },  // 6
+  { 0x0fffffe7, 28 },  // 7
+  { 0x0fffffe8, 28 },  // 8
+  { 0x00ffffea, 24 },  // 9
+  { 0x3ffffffc, 30 },  // 10
+  { 0x0fffffe9, 28 },  // 11
+  { 0x0fffffea, 28 },  // 12
+  { 0x3ffffffd, 30 },  // 13
+  { 0x0fffffeb, 28 },  // 14
+  { 0x0fffffec, 28 },  // 15
+  { 0x0fffffed, 28 },  // 16
+  { 0x0fffffee, 28 },  // 17
+  { 0x0fffffef, 28 },  // 18
+  { 0x0ffffff0, 28 },  // 19
+  { 0x0ffffff1, 28 },  // 20
+  { 0x0ffffff2, 28 },  // 21
+  { 0x3ffffffe, 30 },  // 22
+  { 0x0ffffff3, 28 },  // 23
+  { 0x0ffffff4, 28 },  // 24
+  { 0x0ffffff5, 28 },  // 25
+  { 0x0ffffff6, 28 },  // 26
+  { 0x0ffffff7, 28 },  // 27
+  { 0x0ffffff8, 28 },  // 28
+  { 0x0ffffff9, 28 },  // 29
+  { 0x0ffffffa, 28 },  // 30
+  { 0x0ffffffb, 28 },  // 31
+  { 0x00000014,  6 },  // ' '
+  { 0x000003f8, 10 },  // '!'
+  { 0x000003f9, 10 },  // '"'
+  { 0x00000ffa, 12 },  // '#'
+  { 0x00001ff9, 13 },  // '$'
+  { 0x00000015,  6 },  // '%'
+  { 0x000000f8,  8 },  // '&'
+  { 0x000007fa, 11 },  // "'"
+  { 0x000003fa, 10 },  // '('
+  { 0x000003fb, 10 },  // ')'
+  { 0x000000f9,  8 },  // '*'
+  { 0x000007fb, 11 },  // '+'
+  { 0x000000fa,  8 },  // ','
+  { 0x00000016,  6 },  // '-'
+  { 0x00000017,  6 },  // '.'
+  { 0x00000018,  6 },  // '/'
+  { 0x00000000,  5 },  // '0'
+  { 0x00000001,  5 },  // '1'
+  { 0x00000002,  5 },  // '2'
+  { 0x00000019,  6 },  // '3'
+  { 0x0000001a,  6 },  // '4'
+  { 0x0000001b,  6 },  // '5'
+  { 0x0000001c,  6 },  // '6'
+  { 0x0000001d,  6 },  // '7'
+  { 0x0000001e,  6 },  // '8'
+  { 0x0000001f,  6 },  // '9'
+  { 0x0000005c,  7 },  // ':'
+  { 0x000000fb,  8 },  // ';'
+  { 0x00007ffc, 15 },  // '<'
+  { 0x00000020,  6 },  // '='
+  { 0x00000ffb, 12 },  // '>'
+  { 0x000003fc, 10 },  // '?'
+  { 0x00001ffa, 13 },  // '@'
+  { 0x00000021,  6 },  // 'A'
+  { 0x0000005d,  7 },  // 'B'
+  { 0x0000005e,  7 },  // 'C'
+  { 0x0000005f,  7 },  // 'D'
+  { 0x00000060,  7 },  // 'E'
+  { 0x00000061,  7 },  // 'F'
+  { 0x00000062,  7 },  // 'G'
+  { 0x00000063,  7 },  // 'H'
+  { 0x00000064,  7 },  // 'I'
+  { 0x00000065,  7 },  // 'J'
+  { 0x00000066,  7 },  // 'K'
+  { 0x00000067,  7 },  // 'L'
+  { 0x00000068,  7 },  // 'M'
+  { 0x00000069,  7 },  // 'N'
+  { 0x0000006a,  7 },  // 'O'
+  { 0x0000006b,  7 },  // 'P'
+  { 0x0000006c,  7 },  // 'Q'
+  { 0x0000006d,  7 },  // 'R'
+  { 0x0000006e,  7 },  // 'S'
+  { 0x0000006f,  7 },  // 'T'
+  { 0x00000070,  7 },  // 'U'
+  { 0x00000071,  7 },  // 'V'
+  { 0x00000072,  7 },  // 'W'
+  { 0x000000fc,  8 },  // 'X'
+  { 0x00000073,  7 },  // 'Y'
+  { 0x000000fd,  8 },  // 'Z'
+  { 0x00001ffb, 13 },  // '['
+  { 0x0007fff0, 19 },  // '\\'
+  { 0x00001ffc, 13 },  // ']'
+  { 0x00003ffc, 14 },  // '^'
+  { 0x00000022,  6 },  // '_'
+  { 0x00007ffd, 15 },  // '`'
+  { 0x00000003,  5 },  // 'a'
+  { 0x00000023,  6 },  // 'b'
+  { 0x00000004,  5 },  // 'c'
+  { 0x00000024,  6 },  // 'd'
+  { 0x00000005,  5 },  // 'e'
+  { 0x00000025,  6 },  // 'f'
+  { 0x00000026,  6 },  // 'g'
+  { 0x00000027,  6 },  // 'h'
+  { 0x00000006,  5 },  // 'i'
+  { 0x00000074,  7 },  // 'j'
+  { 0x00000075,  7 },  // 'k'
+  { 0x00000028,  6 },  // 'l'
+  { 0x00000029,  6 },  // 'm'
+  { 0x0000002a,  6 },  // 'n'
+  { 0x00000007,  5 },  // 'o'
+  { 0x0000002b,  6 },  // 'p'
+  { 0x00000076,  7 },  // 'q'
+  { 0x0000002c,  6 },  // 'r'
+  { 0x00000008,  5 },  // 's'
+  { 0x00000009,  5 },  // 't'
+  { 0x0000002d,  6 },  // 'u'
+  { 0x00000077,  7 },  // 'v'
+  { 0x00000078,  7 },  // 'w'
+  { 0x00000079,  7 },  // 'x'
+  { 0x0000007a,  7 },  // 'y'
+  { 0x0000007b,  7 },  // 'z'
+  { 0x00007ffe, 15 },  // '{'
+  { 0x000007fc, 11 },  // '|'
+  { 0x00003ffd, 14 },  // '}'
+  { 0x00001ffd, 13 },  // '~'
+  { 0x0ffffffc, 28 },  // 127
+  { 0x000fffe6, 20 },  // 128
+  { 0x003fffd2, 22 },  // 129
+  { 0x000fffe7, 20 },  // 130
+  { 0x000fffe8, 20 },  // 131
+  { 0x003fffd3, 22 },  // 132
+  { 0x003fffd4, 22 },  // 133
+  { 0x003fffd5, 22 },  // 134
+  { 0x007fffd9, 23 },  // 135
+  { 0x003fffd6, 22 },  // 136
+  { 0x007fffda, 23 },  // 137
+  { 0x007fffdb, 23 },  // 138
+  { 0x007fffdc, 23 },  // 139
+  { 0x007fffdd, 23 },  // 140
+  { 0x007fffde, 23 },  // 141
+  { 0x00ffffeb, 24 },  // 142
+  { 0x007fffdf, 23 },  // 143
+  { 0x00ffffec, 24 },  // 144
+  { 0x00ffffed, 24 },  // 145
+  { 0x003fffd7, 22 },  // 146
+  { 0x007fffe0, 23 },  // 147
+  { 0x00ffffee, 24 },  // 148
+  { 0x007fffe1, 23 },  // 149
+  { 0x007fffe2, 23 },  // 150
+  { 0x007fffe3, 23 },  // 151
+  { 0x007fffe4, 23 },  // 152
+  { 0x001fffdc, 21 },  // 153
+  { 0x003fffd8, 22 },  // 154
+  { 0x007fffe5, 23 },  // 155
+  { 0x003fffd9, 22 },  // 156
+  { 0x007fffe6, 23 },  // 157
+  { 0x007fffe7, 23 },  // 158
+  { 0x00ffffef, 24 },  // 159
+  { 0x003fffda, 22 },  // 160
+  { 0x001fffdd, 21 },  // 161
+  { 0x000fffe9, 20 },  // 162
+  { 0x003fffdb, 22 },  // 163
+  { 0x003fffdc, 22 },  // 164
+  { 0x007fffe8, 23 },  // 165
+  { 0x007fffe9, 23 },  // 166
+  { 0x001fffde, 21 },  // 167
+  { 0x007fffea, 23 },  // 168
+  { 0x003fffdd, 22 },  // 169
+  { 0x003fffde, 22 },  // 170
+  { 0x00fffff0, 24 },  // 171
+  { 0x001fffdf, 21 },  // 172
+  { 0x003fffdf, 22 },  // 173
+  { 0x007fffeb, 23 },  // 174
+  { 0x007fffec, 23 },  // 175
+  { 0x001fffe0, 21 },  // 176
+  { 0x001fffe1, 21 },  // 177
+  { 0x003fffe0, 22 },  // 178
+  { 0x001fffe2, 21 },  // 179
+  { 0x007fffed, 23 },  // 180
+  { 0x003fffe1, 22 },  // 181
+  { 0x007fffee, 23 },  // 182
+  { 0x007fffef, 23 },  // 183
+  { 0x000fffea, 20 },  // 184
+  { 0x003fffe2, 22 },  // 185
+  { 0x003fffe3, 22 },  // 186
+  { 0x003fffe4, 22 },  // 187
+  { 0x007ffff0, 23 },  // 188
+  { 0x003fffe5, 22 },  // 189
+  { 0x003fffe6, 22 },  // 190
+  { 0x007ffff1, 23 },  // 191
+  { 0x03ffffe0, 26 },  // 192
+  { 0x03ffffe1, 26 },  // 193
+  { 0x000fffeb, 20 },  // 194
+  { 0x0007fff1, 19 },  // 195
+  { 0x003fffe7, 22 },  // 196
+  { 0x007ffff2, 23 },  // 197
+  { 0x003fffe8, 22 },  // 198
+  { 0x01ffffec, 25 },  // 199
+  { 0x03ffffe2, 26 },  // 200
+  { 0x03ffffe3, 26 },  // 201
+  { 0x03ffffe4, 26 },  // 202
+  { 0x07ffffde, 27 },  // 203
+  { 0x07ffffdf, 27 },  // 204
+  { 0x03ffffe5, 26 },  // 205
+  { 0x00fffff1, 24 },  // 206
+  { 0x01ffffed, 25 },  // 207
+  { 0x0007fff2, 19 },  // 208
+  { 0x001fffe3, 21 },  // 209
+  { 0x03ffffe6, 26 },  // 210
+  { 0x07ffffe0, 27 },  // 211
+  { 0x07ffffe1, 27 },  // 212
+  { 0x03ffffe7, 26 },  // 213
+  { 0x07ffffe2, 27 },  // 214
+  { 0x00fffff2, 24 },  // 215
+  { 0x001fffe4, 21 },  // 216
+  { 0x001fffe5, 21 },  // 217
+  { 0x03ffffe8, 26 },  // 218
+  { 0x03ffffe9, 26 },  // 219
+  { 0x0ffffffd, 28 },  // 220
+  { 0x07ffffe3, 27 },  // 221
+  { 0x07ffffe4, 27 },  // 222
+  { 0x07ffffe5, 27 },  // 223
+  { 0x000fffec, 20 },  // 224
+  { 0x00fffff3, 24 },  // 225
+  { 0x000fffed, 20 },  // 226
+  { 0x001fffe6, 21 },  // 227
+  { 0x003fffe9, 22 },  // 228
+  { 0x001fffe7, 21 },  // 229
+  { 0x001fffe8, 21 },  // 230
+  { 0x007ffff3, 23 },  // 231
+  { 0x003fffea, 22 },  // 232
+  { 0x003fffeb, 22 },  // 233
+  { 0x01ffffee, 25 },  // 234
+  { 0x01ffffef, 25 },  // 235
+  { 0x00fffff4, 24 },  // 236
+  { 0x00fffff5, 24 },  // 237
+  { 0x03ffffea, 26 },  // 238
+  { 0x007ffff4, 23 },  // 239
+  { 0x03ffffeb, 26 },  // 240
+  { 0x07ffffe6, 27 },  // 241
+  { 0x03ffffec, 26 },  // 242
+  { 0x03ffffed, 26 },  // 243
+  { 0x07ffffe7, 27 },  // 244
+  { 0x07ffffe8, 27 },  // 245
+  { 0x07ffffe9, 27 },  // 246
+  { 0x07ffffea, 27 },  // 247
+  { 0x07ffffeb, 27 },  // 248
+  { 0x0ffffffe, 28 },  // 249
+  { 0x07ffffec, 27 },  // 250
+  { 0x07ffffed, 27 },  // 251
+  { 0x07ffffee, 27 },  // 252
+  { 0x07ffffef, 27 },  // 253
+  { 0x07fffff0, 27 },  // 254
+  { 0x03ffffee, 26 },  // 255
+  { 0x3fffffff, 30 },  // 256
+};
+
+const std::size_t kEos = 256;
+
+const int kMaxHuffmanCodeLength = 30;
+
+// The Huffman code of HPACK is canonical, i.e., the codes of the same length
+// are consecutive integers ordered by symbol, and the codes of length N + 1
+// start from (the last code of length N + 1) << 1. So it can be decoded bit
+// by bit with a few small tables instead of a tree.
+struct HuffmanDecodeTable {
+  HuffmanDecodeTable() {
+    std::uint16_t sorted_count = 0;
+
+    for (int length = 1; length <= kMaxHuffmanCodeLength; ++length) {
+      first_code[length] = 0;
+      count[length] = 0;
+      offset[length] = sorted_count;
+
+      for (std::size_t symbol = 0; symbol <= kEos; ++symbol) {
+        if (kHuffmanCodes[symbol].length == length) {
+          if (count[length] == 0) {
+            first_code[length] = kHuffmanCodes[symbol].code;
+          }
+          ++count[length];
+          symbols[sorted_count++] = static_cast<std::uint16_t>(symbol);
+        }
+      }
+    }
+  }
+
+  std::uint32_t first_code[kMaxHuffmanCodeLength + 1];
+  std::uint32_t count[kMaxHuffmanCodeLength + 1];
+  std::uint16_t offset[kMaxHuffmanCodeLength + 1];
+
+  // Symbols sorted by code.
+  std::uint16_t symbols[kEos + 1];
+};
+
+const HuffmanDecodeTable& GetHuffmanDecodeTable() {
+  static const HuffmanDecodeTable s_table;
+  return s_table;
+}
+
+// The overhead of each entry in the dynamic table (RFC 7541 4.1).
+const std::size_t kEntryOverhead = 32;
+
+inline std::size_t EntrySize(const std::string& name,
+                             const std::string& value) {
+  return name.size() + value.size() + kEntryOverhead;
+}
+
+// Headers which shouldn't be added to the dynamic table because they are
+// either sensitive or change too often.
+bool NeverIndex(const std::string& name) {
+  return name == "authorization" || name == "cookie" ||
+         name == "set-cookie" || name == "proxy-authorization";
+}
+
+bool NoIndex(const std::string& name) {
+  return name == ":path" || name == "content-length" || name == "date" ||
+         name == "etag" || name == "if-modified-since" ||
+         name == "if-none-match" || name == "last-modified" ||
+         name == "location";
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------------
+
+namespace hpack {
+
+void EncodeInteger(std::size_t value, int prefix_bits, std::uint8_t flags,
+                   std::string* output) {
+  const std::size_t max_prefix = (1u << prefix_bits) - 1;
+
+  if (value < max_prefix) {
+    output->push_back(static_cast<char>(flags | value));
+    return;
+  }
+
+  output->push_back(static_cast<char>(flags | max_prefix));
+  value -= max_prefix;
+
+  while (value >= 128) {
+    output->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+
+  output->push_back(static_cast<char>(value));
+}
+
+bool DecodeInteger(const std::uint8_t** p, const std::uint8_t* end,
+                   int prefix_bits, std::size_t* value) {
+  if (*p >= end) {
+    return false;
+  }
+
+  const std::size_t max_prefix = (1u << prefix_bits) - 1;
+
+  *value = **p & max_prefix;
+  ++(*p);
+
+  if (*value < max_prefix) {
+    return true;
+  }
+
+  for (int shift = 0; *p < end; shift += 7) {
+    // Limit the integer to 28 bits, which is enough for any sane header.
+    if (shift > 21) {
+      return false;
+    }
+
+    std::uint8_t byte = **p;
+    ++(*p);
+
+    *value += static_cast<std::size_t>(byte & 0x7f) << shift;
+
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+
+  return false;  // Truncated
+}
+
+void EncodeString(const std::string& str, std::string* output) {
+  std::size_t huffman_size = HuffmanEncodedSize(str);
+
+  if (huffman_size < str.size()) {
+    EncodeInteger(huffman_size, 7, 0x80, output);
+    HuffmanEncode(str, output);
+  } else {
+    EncodeInteger(str.size(), 7, 0, output);
+    output->append(str);
+  }
+}
+
+bool DecodeString(const std::uint8_t** p, const std::uint8_t* end,
+                  std::string* str) {
+  if (*p >= end) {
+    return false;
+  }
+
+  bool huffman = (**p & 0x80) != 0;
+
+  std::size_t length = 0;
+  if (!DecodeInteger(p, end, 7, &length)) {
+    return false;
+  }
+
+  if (length > static_cast<std::size_t>(end - *p)) {
+    return false;
+  }
+
+  str->clear();
+
+  if (huffman) {
+    if (!HuffmanDecode(*p, length, str)) {
+      return false;
+    }
+  } else {
+    str->assign(reinterpret_cast<const char*>(*p), length);
+  }
+
+  *p += length;
+  return true;
+}
+
+std::size_t HuffmanEncodedSize(const std::string& str) {
+  std::size_t bits = 0;
+  for (unsigned char c : str) {
+    bits += kHuffmanCodes[c].length;
+  }
+  return (bits + 7) / 8;
+}
+
+void HuffmanEncode(const std::string& str, std::string* output) {
+  std::uint64_t buffer = 0;
+  int bits = 0;
+
+  for (unsigned char c : str) {
+    const HuffmanCode& code = kHuffmanCodes[c];
+
+    buffer = (buffer << code.length) | code.code;
+    bits += code.length;
+
+    while (bits >= 8) {
+      bits -= 8;
+      output->push_back(static_cast<char>(buffer >> bits));
+    }
+  }
+
+  if (bits > 0) {
+    // Pad with the most significant bits of EOS (all 1s).
+    buffer = (buffer << (8 - bits)) | (0xff >> bits);
+    output->push_back(static_cast<char>(buffer));
+  }
+}
+
+bool HuffmanDecode(const std::uint8_t* data, std::size_t length,
+                   std::string* output) {
+  const HuffmanDecodeTable& table = GetHuffmanDecodeTable();
+
+  std::uint32_t code = 0;
+  int code_length = 0;
+
+  for (std::size_t i = 0; i < length; ++i) {
+    for (int bit = 7; bit >= 0; --bit) {
+      code = (code << 1) | ((data[i] >> bit) & 1);
+      ++code_length;
+
+      if (code >= table.first_code[code_length] &&
+          code - table.first_code[code_length] < table.count[code_length]) {
+        std::uint16_t symbol = table.symbols[table.offset[code_length] + code -
+                                             table.first_code[code_length]];
+        if (symbol == kEos) {
+          return false;  // EOS in the string is an error.
+        }
+
+        output->push_back(static_cast<char>(symbol));
+        code = 0;
+        code_length = 0;
+
+      } else if (code_length == kMaxHuffmanCodeLength) {
+        return false;
+      }
+    }
+  }
+
+  // The padding must be shorter than 8 bits and consist of the most
+  // significant bits of EOS.
+  if (code_length > 7) {
+    return false;
+  }
+
+  return code == (1u << code_length) - 1;
+}
+
+}  // namespace hpack
+
+// -----------------------------------------------------------------------------
+
+HpackTable::HpackTable(std::size_t max_size) : size_(0), max_size_(max_size) {
+}
+
+const Header* HpackTable::Get(std::size_t index) const {
+  if (index == 0) {
+    return nullptr;
+  }
+
+  if (index <= kStaticTableSize) {
+    return &kStaticTable[index - 1];
+  }
+
+  index -= kStaticTableSize + 1;
+
+  if (index < entries_.size()) {
+    return &entries_[index];
+  }
+
+  return nullptr;
+}
+
+std::size_t HpackTable::Find(const std::string& name, const std::string& value,
+                             bool* value_matched) const {
+  std::size_t name_index = 0;
+
+  for (std::size_t i = 0; i < kStaticTableSize; ++i) {
+    if (kStaticTable[i].first == name) {
+      if (kStaticTable[i].second == value) {
+        *value_matched = true;
+        return i + 1;
+      }
+      if (name_index == 0) {
+        name_index = i + 1;
+      }
+    }
+  }
+
+  for (std::size_t i = 0; i < entries_.size(); ++i) {
+    if (entries_[i].first == name) {
+      if (entries_[i].second == value) {
+        *value_matched = true;
+        return kStaticTableSize + i + 1;
+      }
+      if (name_index == 0) {
+        name_index = kStaticTableSize + i + 1;
+      }
+    }
+  }
+
+  *value_matched = false;
+  return name_index;
+}
+
+void HpackTable::Add(const std::string& name, const std::string& value) {
+  std::size_t entry_size = EntrySize(name, value);
+
+  if (entry_size > max_size_) {
+    // An entry larger than the max size empties the table (RFC 7541 4.4).
+    Evict(0);
+    return;
+  }
+
+  Evict(max_size_ - entry_size);
+
+  entries_.push_front({ name, value });
+  size_ += entry_size;
+}
+
+void HpackTable::set_max_size(std::size_t max_size) {
+  max_size_ = max_size;
+  Evict(max_size_);
+}
+
+void HpackTable::Evict(std::size_t max_size) {
+  while (size_ > max_size && !entries_.empty()) {
+    size_ -= EntrySize(entries_.back().first, entries_.back().second);
+    entries_.pop_back();
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+void HpackEncoder::Encode(const HeaderList& headers, std::string* block) {
+  if (table_size_changed_) {
+    // Dynamic Table Size Update.
+    hpack::EncodeInteger(table_.max_size(), 5, 0x20, block);
+    table_size_changed_ = false;
+  }
+
+  for (const Header& h : headers) {
+    bool value_matched = false;
+    std::size_t index = table_.Find(h.first, h.second, &value_matched);
+
+    if (value_matched) {
+      // Indexed Header Field.
+      hpack::EncodeInteger(index, 7, 0x80, block);
+      continue;
+    }
+
+    if (NeverIndex(h.first)) {
+      // Literal Header Field Never Indexed.
+      hpack::EncodeInteger(index, 4, 0x10, block);
+    } else if (NoIndex(h.first)) {
+      // Literal Header Field without Indexing.
+      hpack::EncodeInteger(index, 4, 0x00, block);
+    } else {
+      // Literal Header Field with Incremental Indexing.
+      hpack::EncodeInteger(index, 6, 0x40, block);
+      table_.Add(h.first, h.second);
+    }
+
+    if (index == 0) {
+      hpack::EncodeString(h.first, block);
+    }
+    hpack::EncodeString(h.second, block);
+  }
+}
+
+void HpackEncoder::SetMaxTableSize(std::size_t max_size) {
+  // Never use a table larger than the default size.
+  max_size = std::min<std::size_t>(max_size, 4096);
+
+  if (max_size != table_.max_size()) {
+    table_.set_max_size(max_size);
+    table_size_changed_ = true;
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+bool HpackDecoder::Decode(const char* data, std::size_t length,
+                          HeaderList* headers, bool* too_large) {
+  auto p = reinterpret_cast<const std::uint8_t*>(data);
+  auto end = p + length;
+
+  // A small block might expand a lot with the indexed fields (e.g., a byte
+  // for a 4KB entry), so the size is checked before a field is added.
+  std::size_t list_size = 0;
+  bool exceeded = false;
+
+  auto add_header = [&](const Header& header) {
+    list_size += header.first.size() + header.second.size() + 32;
+    if (list_size > max_list_size_) {
+      exceeded = true;
+      headers->clear();
+    }
+    return !exceeded;
+  };
+
+  while (p < end) {
+    std::uint8_t byte = *p;
+
+    if ((byte & 0x80) != 0) {
+      // Indexed Header Field.
+      std::size_t index = 0;
+      if (!hpack::DecodeInteger(&p, end, 7, &index)) {
+        return false;
+      }
+
+      const Header* header = table_.Get(index);
+      if (header == nullptr) {
+        LOG_ERRO("Invalid HPACK index: %d.", static_cast<int>(index));
+        return false;
+      }
+
+      if (add_header(*header)) {
+        headers->push_back(*header);
+      }
+      continue;
+    }
+
+    if ((byte & 0xe0) == 0x20) {
+      // Dynamic Table Size Update.
+      std::size_t max_size = 0;
+      if (!hpack::DecodeInteger(&p, end, 5, &max_size) || max_size > 4096) {
+        return false;
+      }
+      table_.set_max_size(max_size);
+      continue;
+    }
+
+    // Literal Header Field, with (6-bit prefix) or without (4-bit prefix)
+    // incremental indexing.
+    bool indexing = (byte & 0xc0) == 0x40;
+
+    std::size_t index = 0;
+    if (!hpack::DecodeInteger(&p, end, indexing ? 6 : 4, &index)) {
+      return false;
+    }
+
+    Header header;
+
+    if (index == 0) {
+      if (!hpack::DecodeString(&p, end, &header.first)) {
+        return false;
+      }
+    } else {
+      const Header* indexed = table_.Get(index);
+      if (indexed == nullptr) {
+        LOG_ERRO("Invalid HPACK index: %d.", static_cast<int>(index));
+        return false;
+      }
+      header.first = indexed->first;
+    }
+
+    if (!hpack::DecodeString(&p, end, &header.second)) {
+      return false;
+    }
+
+    if (indexing) {
+      table_.Add(header.first, header.second);
+    }
+
+    if (add_header(header)) {
+      headers->push_back(std::move(header));
+    }
+  }
+
+  if (exceeded) {
+    LOG_WARN("HPACK header list too large (%u bytes).",
+             static_cast<unsigned>(list_size));
+    if (too_large == nullptr) {
+      return false;
+    }
+    *too_large = true;
+  }
+
+  return true;
+}
+
+}  // namespace webcc
@@ -0,0 +1,144 @@
+#ifndef WEBCC_HPACK_H_
+#define WEBCC_HPACK_H_
+
+// HPACK: Header Compression for HTTP/2.
+// See RFC 7541: https://tools.ietf.org/html/rfc7541
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "webcc/common.h"
+
+namespace webcc {
+
+using HeaderList = std::vector<Header>;
+
+// -----------------------------------------------------------------------------
+
+// The header table, i.e., the static table followed by the dynamic table.
+class HpackTable {
+public:
+  explicit HpackTable(std::size_t max_size = 4096);
+
+  std::size_t size() const {
+    return size_;
+  }
+
+  std::size_t max_size() const {
+    return max_size_;
+  }
+
+  // Get the header field by index (1-based).
+  // Return null if the index is out of range.
+  const Header* Get(std::size_t index) const;
+
+  // Find the index of the header field.
+  // If only the name is matched, |value_matched| will be set to false.
+  // Return 0 if not found.
+  std::size_t Find(const std::string& name, const std::string& value,
+                   bool* value_matched) const;
+
+  // Insert a header field into the dynamic table.
+  // Old entries will be evicted if necessary.
+  void Add(const std::string& name, const std::string& value);
+
+  // Change the max size of the dynamic table.
+  void set_max_size(std::size_t max_size);
+
+private:
+  void Evict(std::size_t max_size);
+
+  // The dynamic table, the newest entry first.
+  std::deque<Header> entries_;
+
+  // The size of the dynamic table, counted as defined in RFC 7541 4.1.
+  std::size_t size_;
+
+  std::size_t max_size_;
+};
+
+// -----------------------------------------------------------------------------
+
+class HpackEncoder {
+public:
+  HpackEncoder() = default;
+
+  HpackEncoder(const HpackEncoder&) = delete;
+  HpackEncoder& operator=(const HpackEncoder&) = delete;
+
+  // Encode a list of header fields and append the header block to |block|.
+  // The names of the header fields must be in lower case.
+  void Encode(const HeaderList& headers, std::string* block);
+
+  // Called when SETTINGS_HEADER_TABLE_SIZE is received from the peer.
+  void SetMaxTableSize(std::size_t max_size);
+
+private:
+  HpackTable table_;
+
+  // A dynamic table size update is pending to be signaled.
+  bool table_size_changed_ = false;
+};
+
+// -----------------------------------------------------------------------------
+
+class HpackDecoder {
+public:
+  HpackDecoder() = default;
+
+  HpackDecoder(const HpackDecoder&) = delete;
+  HpackDecoder& operator=(const HpackDecoder&) = delete;
+
+  // Decode a complete header block.
+  // Return false on compression error.
+  // If the header list is larger than the max size, the block is still
+  // decoded to keep the dynamic table in sync, but the header fields are
+  // dropped and |too_large| is set (or false is returned if it's null).
+  bool Decode(const char* data, std::size_t length, HeaderList* headers,
+              bool* too_large = nullptr);
+
+  // The max size of the decoded header list, i.e., the sum of the sizes of
+  // the header fields (name + value + 32).
+  void set_max_list_size(std::size_t max_list_size) {
+    max_list_size_ = max_list_size;
+  }
+
+private:
+  HpackTable table_;
+
+  std::size_t max_list_size_ = static_cast<std::size_t>(-1);
+};
+
+// -----------------------------------------------------------------------------
+
+namespace hpack {
+
+// Primitive type representations (RFC 7541 5).
+
+void EncodeInteger(std::size_t value, int prefix_bits, std::uint8_t flags,
+                   std::string* output);
+
+bool DecodeInteger(const std::uint8_t** p, const std::uint8_t* end,
+                   int prefix_bits, std::size_t* value);
+
+void EncodeString(const std::string& str, std::string* output);
+
+bool DecodeString(const std::uint8_t** p, const std::uint8_t* end,
+                  std::string* str);
+
+// Huffman code (RFC 7541 Appendix B).
+
+std::size_t HuffmanEncodedSize(const std::string& str);
+
+void HuffmanEncode(const std::string& str, std::string* output);
+
+bool HuffmanDecode(const std::uint8_t* data, std::size_t length,
+                   std::string* output);
+
+}  // namespace hpack
+
+}  // namespace webcc
+
+#endif  // WEBCC_HPACK_H_
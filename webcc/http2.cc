@@ -0,0 +1,1189 @@
+#include "webcc/http2.h"
+
+#include <algorithm>
+
+#include "webcc/date_clock.h"
+#include "webcc/logger.h"
+#include "webcc/string.h"
+#include "webcc/utility.h"
+
+namespace webcc {
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+// Max size of the output returned by GetOutput() each time.
+const std::size_t kMaxOutputSize = 64 * 1024;
+
+inline std::uint32_t ReadUint32(const char* p) {
+  auto u = reinterpret_cast<const std::uint8_t*>(p);
+  return (static_cast<std::uint32_t>(u[0]) << 24) |
+         (static_cast<std::uint32_t>(u[1]) << 16) |
+         (static_cast<std::uint32_t>(u[2]) << 8) |
+         static_cast<std::uint32_t>(u[3]);
+}
+
+inline std::uint16_t ReadUint16(const char* p) {
+  auto u = reinterpret_cast<const std::uint8_t*>(p);
+  return static_cast<std::uint16_t>((u[0] << 8) | u[1]);
+}
+
+inline void AppendUint32(std::uint32_t value, std::string* output) {
+  output->push_back(static_cast<char>(value >> 24));
+  output->push_back(static_cast<char>(value >> 16));
+  output->push_back(static_cast<char>(value >> 8));
+  output->push_back(static_cast<char>(value));
+}
+
+inline void AppendSetting(http2::SettingsId id, std::uint32_t value,
+                          std::string* output) {
+  output->push_back(static_cast<char>(id >> 8));
+  output->push_back(static_cast<char>(id));
+  AppendUint32(value, output);
+}
+
+// Connection-specific header fields are not allowed in HTTP/2.
+// See RFC 7540 8.1.2.2.
+bool IsConnectionHeader(const std::string& name) {
+  return name == "connection" || name == "keep-alive" ||
+         name == "proxy-connection" || name == "transfer-encoding" ||
+         name == "upgrade" || name == "http2-settings";
+}
+
+std::unique_ptr<BodyHandler> NewBodyHandler(Message* message, bool stream) {
+  if (stream) {
+    std::unique_ptr<FileBodyHandler> file_body_handler{
+      new FileBodyHandler{ message }
+    };
+    if (!file_body_handler->OpenFile()) {
+      return {};
+    }
+    return file_body_handler;
+  }
+
+  return std::unique_ptr<BodyHandler>{ new StringBodyHandler{ message } };
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------------
+
+namespace http2 {
+
+void AppendFrameHeader(std::size_t length, FrameType type, std::uint8_t flags,
+                       std::uint32_t stream_id, std::string* output) {
+  output->push_back(static_cast<char>(length >> 16));
+  output->push_back(static_cast<char>(length >> 8));
+  output->push_back(static_cast<char>(length));
+  output->push_back(static_cast<char>(type));
+  output->push_back(static_cast<char>(flags));
+  AppendUint32(stream_id & 0x7fffffff, output);
+}
+
+}  // namespace http2
+
+// -----------------------------------------------------------------------------
+
+using namespace http2;
+
+Http2Session::Http2Session(bool server, ViewMatcher view_matcher)
+    : server_(server), view_matcher_(std::move(view_matcher)) {
+  decoder_.set_max_list_size(kMaxHeaderListSizeValue);
+
+  if (!server_) {
+    control_.append(kPreface, kPrefaceSize);
+  }
+
+  SendSettings();
+
+  // The initial window size of the connection can only be changed by
+  // WINDOW_UPDATE.
+  SendWindowUpdate(0, static_cast<std::uint32_t>(kLocalWindowSize -
+                                                 kDefaultWindowSize));
+}
+
+bool Http2Session::Upgrade(const std::string& settings, RequestPtr request) {
+  assert(server_);
+
+  if (settings.size() % 6 != 0) {
+    return GoAway(kFrameSizeError);
+  }
+
+  // The settings in HTTP2-Settings are acknowledged implicitly by the 101
+  // response.
+  if (!ApplySettings(settings.data(), settings.size())) {
+    return false;
+  }
+
+  last_stream_id_ = 1;
+
+  Stream* stream = NewStream(1);
+  stream->remote_closed = true;
+  stream->method = request->method();
+
+  requests_.emplace_back(1, request);
+
+  return true;
+}
+
+bool Http2Session::Feed(const char* data, std::size_t length) {
+  if (error_) {
+    return false;
+  }
+
+  input_.append(data, length);
+
+  std::size_t off = 0;
+
+  if (server_ && preface_received_ < kPrefaceSize) {
+    std::size_t count = std::min(kPrefaceSize - preface_received_,
+                                 input_.size());
+
+    if (input_.compare(0, count, kPreface + preface_received_, count) != 0) {
+      LOG_ERRO("Invalid HTTP/2 connection preface.");
+      return GoAway(kProtocolError);
+    }
+
+    preface_received_ += count;
+    off = count;
+  }
+
+  while (input_.size() - off >= kFrameHeaderSize) {
+    const char* p = input_.data() + off;
+
+    std::size_t frame_length = (static_cast<std::uint8_t>(p[0]) << 16) |
+                               (static_cast<std::uint8_t>(p[1]) << 8) |
+                               static_cast<std::uint8_t>(p[2]);
+
+    // SETTINGS_MAX_FRAME_SIZE is never changed for the local side.
+    if (frame_length > kDefaultMaxFrameSize) {
+      LOG_ERRO("HTTP/2 frame is too large: %u.", frame_length);
+      return GoAway(kFrameSizeError);
+    }
+
+    if (input_.size() - off - kFrameHeaderSize < frame_length) {
+      break;  // Wait for the rest of the frame
+    }
+
+    auto type = static_cast<FrameType>(p[3]);
+    auto flags = static_cast<std::uint8_t>(p[4]);
+    std::uint32_t stream_id = ReadUint32(p + 5) & 0x7fffffff;
+
+    if (!OnFrame(type, flags, stream_id, p + kFrameHeaderSize,
+                 frame_length)) {
+      return false;
+    }
+
+    off += kFrameHeaderSize + frame_length;
+  }
+
+  input_.erase(0, off);
+
+  return true;
+}
+
+bool Http2Session::GetOutput(std::string* output) {
+  output->clear();
+  output->swap(control_);
+
+  if (!error_) {
+    ScheduleData(output);
+  }
+
+  return !output->empty();
+}
+
+void Http2Session::Shutdown() {
+  if (!goaway_) {
+    AppendFrameHeader(8, kGoAway, 0, 0, &control_);
+    AppendUint32(last_stream_id_, &control_);
+    AppendUint32(kNoError, &control_);
+
+    goaway_ = true;
+  }
+}
+
+bool Http2Session::closed() const {
+  return error_ || (goaway_ && streams_.empty());
+}
+
+bool Http2Session::PopRequest(std::uint32_t* stream_id, RequestPtr* request) {
+  if (requests_.empty()) {
+    return false;
+  }
+
+  *stream_id = requests_.front().first;
+  *request = std::move(requests_.front().second);
+  requests_.pop_front();
+
+  return true;
+}
+
+void Http2Session::SendResponse(std::uint32_t stream_id,
+                                ResponsePtr response) {
+  assert(server_);
+
+  Stream* stream = FindStream(stream_id);
+  if (stream == nullptr || stream->body || stream->local_closed) {
+    LOG_WARN("HTTP/2 stream (%u) has been closed.", stream_id);
+    return;
+  }
+
+  response->Prepare();
+
+  HeaderList headers;
+  headers.emplace_back(":status", std::to_string(response->status()));
+
+  for (const Header& h : response->headers().data()) {
+    std::string name = tolower(h.first);
+    if (!IsConnectionHeader(name)) {
+      headers.emplace_back(std::move(name), h.second);
+    }
+  }
+
+  if (!response->HasHeader(headers::kServer)) {
+    headers.emplace_back("server", utility::UserAgent());
+  }
+
+  if (response->auto_date() && !response->HasHeader(headers::kDate)) {
+    headers.emplace_back("date", DateClock::Instance().Now());
+  }
+
+  BodyPtr body = response->body();
+  if (stream->method == methods::kHead) {
+    body = std::make_shared<Body>();
+  }
+
+  SendMessage(stream, headers, body);
+}
+
+std::uint32_t Http2Session::SendRequest(RequestPtr request, bool stream) {
+  assert(!server_);
+
+  std::uint32_t stream_id = last_stream_id_ == 0 ? 1 : last_stream_id_ + 2;
+  last_stream_id_ = stream_id;
+
+  Stream* s = NewStream(stream_id);
+  s->stream = stream;
+  s->method = request->method();
+
+  const Url& url = request->url();
+
+  std::string path = url.path().empty() ? "/" : url.path();
+  if (!url.query().empty()) {
+    path += "?";
+    path += url.query();
+  }
+
+  std::string authority = url.host();
+  if (!url.port().empty()) {
+    authority += ":";
+    authority += url.port();
+  }
+
+  HeaderList headers{
+    { ":method", request->method() },
+    { ":scheme", url.scheme().empty() ? "http" : url.scheme() },
+    { ":authority", authority },
+    { ":path", path },
+  };
+
+  for (const Header& h : request->headers().data()) {
+    std::string name = tolower(h.first);
+    if (name != "host" && !IsConnectionHeader(name)) {
+      headers.emplace_back(std::move(name), h.second);
+    }
+  }
+
+  SendMessage(s, headers, request->body());
+
+  return stream_id;
+}
+
+bool Http2Session::TakeResponse(std::uint32_t stream_id,
+                                ResponsePtr* response) {
+  auto it = responses_.find(stream_id);
+  if (it == responses_.end()) {
+    return false;
+  }
+
+  *response = std::move(it->second);
+  responses_.erase(it);
+
+  return true;
+}
+
+bool Http2Session::OnFrame(FrameType type, std::uint8_t flags,
+                           std::uint32_t stream_id, const char* payload,
+                           std::size_t length) {
+  // A header block must be contiguous.
+  if (continuation_stream_id_ != 0 &&
+      (type != kContinuation || stream_id != continuation_stream_id_)) {
+    return GoAway(kProtocolError);
+  }
+
+  switch (type) {
+    case kData:
+      return OnData(flags, stream_id, payload, length);
+    case kHeaders:
+      return OnHeaders(flags, stream_id, payload, length);
+    case kPriority:
+      return OnPriority(stream_id, payload, length);
+    case kRstStream:
+      return OnRstStream(stream_id, payload, length);
+    case kSettings:
+      return OnSettings(flags, stream_id, payload, length);
+    case kPushPromise:
+      // Server push is disabled by the client.
+      return GoAway(kProtocolError);
+    case kPing:
+      return OnPing(flags, stream_id, payload, length);
+    case kGoAway:
+      return OnGoAway(stream_id, payload, length);
+    case kWindowUpdate:
+      return OnWindowUpdate(stream_id, payload, length);
+    case kContinuation:
+      return OnContinuation(flags, stream_id, payload, length);
+    default:
+      // Unknown frame types must be ignored.
+      return true;
+  }
+}
+
+bool Http2Session::OnData(std::uint8_t flags, std::uint32_t stream_id,
+                          const char* payload, std::size_t length) {
+  if (stream_id == 0) {
+    return GoAway(kProtocolError);
+  }
+
+  // The entire frame payload, padding included, is flow controlled.
+  std::int64_t frame_length = static_cast<std::int64_t>(length);
+
+  recv_window_ -= frame_length;
+  if (recv_window_ < 0) {
+    return GoAway(kFlowControlError);
+  }
+
+  if (recv_window_ < kLocalWindowSize / 2) {
+    SendWindowUpdate(0, static_cast<std::uint32_t>(kLocalWindowSize -
+                                                   recv_window_));
+    recv_window_ = kLocalWindowSize;
+  }
+
+  if ((flags & flags::kPadded) != 0) {
+    if (length < 1) {
+      return GoAway(kProtocolError);
+    }
+
+    std::size_t padding = static_cast<std::uint8_t>(payload[0]);
+    ++payload;
+    --length;
+
+    if (padding > length) {
+      return GoAway(kProtocolError);
+    }
+    length -= padding;
+  }
+
+  Stream* stream = FindStream(stream_id);
+
+  if (stream == nullptr) {
+    if (server_ && stream_id > last_stream_id_) {
+      // The stream is idle.
+      return GoAway(kProtocolError);
+    }
+    // The stream has been closed or reset, just discard the data.
+    return true;
+  }
+
+  if (stream->remote_closed) {
+    ResetStream(stream_id, kStreamClosed);
+    return true;
+  }
+
+  if (!stream->body_handler) {
+    // DATA before HEADERS.
+    ResetStream(stream_id, kProtocolError);
+    return true;
+  }
+
+  stream->recv_window -= frame_length;
+  if (stream->recv_window < 0) {
+    ResetStream(stream_id, kFlowControlError);
+    return true;
+  }
+
+  stream->body_handler->AddContent(payload, length);
+
+  if ((flags & flags::kEndStream) != 0) {
+    return OnStreamEnd(stream);
+  }
+
+  if (stream->recv_window < kLocalWindowSize / 2) {
+    SendWindowUpdate(stream_id, static_cast<std::uint32_t>(
+                                    kLocalWindowSize - stream->recv_window));
+    stream->recv_window = kLocalWindowSize;
+  }
+
+  return true;
+}
+
+bool Http2Session::OnHeaders(std::uint8_t flags, std::uint32_t stream_id,
+                             const char* payload, std::size_t length) {
+  if (stream_id == 0) {
+    return GoAway(kProtocolError);
+  }
+
+  std::size_t padding = 0;
+
+  if ((flags & flags::kPadded) != 0) {
+    if (length < 1) {
+      return GoAway(kProtocolError);
+    }
+    padding = static_cast<std::uint8_t>(payload[0]);
+    ++payload;
+    --length;
+  }
+
+  int weight = kDefaultWeight;
+
+  if ((flags & flags::kPriority) != 0) {
+    if (length < 5) {
+      return GoAway(kProtocolError);
+    }
+    weight = static_cast<std::uint8_t>(payload[4]) + 1;
+    payload += 5;
+    length -= 5;
+  }
+
+  if (padding > length) {
+    return GoAway(kProtocolError);
+  }
+
+  Stream* stream = FindStream(stream_id);
+
+  if (stream == nullptr && server_) {
+    // A new stream initiated by the client.
+    if (stream_id % 2 == 0) {
+      return GoAway(kProtocolError);
+    }
+    if (stream_id <= last_stream_id_) {
+      return GoAway(kStreamClosed);
+    }
+
+    last_stream_id_ = stream_id;
+
+    if (goaway_) {
+      // No new streams after GOAWAY; the header block is still decoded below
+      // to keep the HPACK state in sync.
+    } else if (streams_.size() >= kMaxConcurrentStreamsValue) {
+      SendRstStream(stream_id, kRefusedStream);
+    } else {
+      stream = NewStream(stream_id);
+    }
+  }
+
+  if (stream != nullptr) {
+    stream->weight = weight;
+  }
+
+  if (length - padding > kMaxHeaderListSizeValue) {
+    LOG_ERRO("HTTP/2 header block is too large.");
+    return GoAway(kEnhanceYourCalm);
+  }
+
+  header_block_.assign(payload, length - padding);
+
+  bool end_stream = (flags & flags::kEndStream) != 0;
+
+  if ((flags & flags::kEndHeaders) == 0) {
+    continuation_stream_id_ = stream_id;
+    continuation_end_stream_ = end_stream;
+    return true;
+  }
+
+  return OnHeaderBlock(stream_id, end_stream);
+}
+
+bool Http2Session::OnContinuation(std::uint8_t flags, std::uint32_t stream_id,
+                                  const char* payload, std::size_t length) {
+  if (continuation_stream_id_ == 0 || stream_id != continuation_stream_id_) {
+    return GoAway(kProtocolError);
+  }
+
+  // The CONTINUATION frames might be endless.
+  if (header_block_.size() + length > kMaxHeaderListSizeValue) {
+    LOG_ERRO("HTTP/2 header block is too large.");
+    return GoAway(kEnhanceYourCalm);
+  }
+
+  header_block_.append(payload, length);
+
+  if ((flags & flags::kEndHeaders) == 0) {
+    return true;
+  }
+
+  continuation_stream_id_ = 0;
+
+  return OnHeaderBlock(stream_id, continuation_end_stream_);
+}
+
+bool Http2Session::OnPriority(std::uint32_t stream_id, const char* payload,
+                              std::size_t length) {
+  if (stream_id == 0) {
+    return GoAway(kProtocolError);
+  }
+
+  if (length != 5) {
+    ResetStream(stream_id, kFrameSizeError);
+    return true;
+  }
+
+  // The dependencies are not supported, only the weight is respected.
+  std::uint32_t dependency = ReadUint32(payload) & 0x7fffffff;
+  if (dependency == stream_id) {
+    ResetStream(stream_id, kProtocolError);
+    return true;
+  }
+
+  Stream* stream = FindStream(stream_id);
+  if (stream != nullptr) {
+    stream->weight = static_cast<std::uint8_t>(payload[4]) + 1;
+  }
+
+  return true;
+}
+
+bool Http2Session::OnRstStream(std::uint32_t stream_id, const char* payload,
+                               std::size_t length) {
+  if (stream_id == 0 || (server_ && stream_id > last_stream_id_)) {
+    return GoAway(kProtocolError);
+  }
+
+  if (length != 4) {
+    return GoAway(kFrameSizeError);
+  }
+
+  LOG_INFO("HTTP/2 stream (%u) reset by peer, error: %u.", stream_id,
+           ReadUint32(payload));
+
+  if (streams_.erase(stream_id) > 0 && !server_) {
+    responses_[stream_id] = nullptr;
+  }
+
+  return true;
+}
+
+bool Http2Session::OnSettings(std::uint8_t flags, std::uint32_t stream_id,
+                              const char* payload, std::size_t length) {
+  if (stream_id != 0) {
+    return GoAway(kProtocolError);
+  }
+
+  if ((flags & flags::kAck) != 0) {
+    if (length != 0) {
+      return GoAway(kFrameSizeError);
+    }
+    return true;
+  }
+
+  if (length % 6 != 0) {
+    return GoAway(kFrameSizeError);
+  }
+
+  if (!ApplySettings(payload, length)) {
+    return false;
+  }
+
+  AppendFrameHeader(0, kSettings, flags::kAck, 0, &control_);
+
+  return true;
+}
+
+bool Http2Session::OnPing(std::uint8_t flags, std::uint32_t stream_id,
+                          const char* payload, std::size_t length) {
+  if (stream_id != 0) {
+    return GoAway(kProtocolError);
+  }
+
+  if (length != 8) {
+    return GoAway(kFrameSizeError);
+  }
+
+  if ((flags & flags::kAck) == 0) {
+    AppendFrameHeader(8, kPing, flags::kAck, 0, &control_);
+    control_.append(payload, 8);
+  }
+
+  return true;
+}
+
+bool Http2Session::OnGoAway(std::uint32_t stream_id, const char* payload,
+                            std::size_t length) {
+  if (stream_id != 0) {
+    return GoAway(kProtocolError);
+  }
+
+  if (length < 8) {
+    return GoAway(kFrameSizeError);
+  }
+
+  std::uint32_t last_stream_id = ReadUint32(payload) & 0x7fffffff;
+
+  LOG_INFO("HTTP/2 GOAWAY received, last stream: %u, error: %u.",
+           last_stream_id, ReadUint32(payload + 4));
+
+  goaway_ = true;
+
+  if (!server_) {
+    // The streams after the last stream were not processed by the server.
+    for (auto it = streams_.begin(); it != streams_.end();) {
+      if (it->first > last_stream_id) {
+        responses_[it->first] = nullptr;
+        it = streams_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  return true;
+}
+
+bool Http2Session::OnWindowUpdate(std::uint32_t stream_id, const char* payload,
+                                  std::size_t length) {
+  if (length != 4) {
+    return GoAway(kFrameSizeError);
+  }
+
+  std::uint32_t increment = ReadUint32(payload) & 0x7fffffff;
+
+  if (stream_id == 0) {
+    if (increment == 0) {
+      return GoAway(kProtocolError);
+    }
+
+    send_window_ += increment;
+    if (send_window_ > kMaxWindowSize) {
+      return GoAway(kFlowControlError);
+    }
+
+    return true;
+  }
+
+  Stream* stream = FindStream(stream_id);
+  if (stream == nullptr) {
+    return true;
+  }
+
+  if (increment == 0) {
+    ResetStream(stream_id, kProtocolError);
+    return true;
+  }
+
+  stream->send_window += increment;
+  if (stream->send_window > kMaxWindowSize) {
+    ResetStream(stream_id, kFlowControlError);
+  }
+
+  return true;
+}
+
+bool Http2Session::OnHeaderBlock(std::uint32_t stream_id, bool end_stream) {
+  HeaderList headers;
+  bool too_large = false;
+
+  // The header block must always be decoded to keep the HPACK state in sync,
+  // even if the stream has been closed.
+  if (!decoder_.Decode(header_block_.data(), header_block_.size(), &headers,
+                       &too_large)) {
+    LOG_ERRO("HPACK decoding error.");
+    return GoAway(kCompressionError);
+  }
+
+  header_block_.clear();
+
+  Stream* stream = FindStream(stream_id);
+  if (stream == nullptr) {
+    return true;
+  }
+
+  if (too_large) {
+    OnHeadersTooLarge(stream);
+    return true;
+  }
+
+  if (stream->remote_closed) {
+    ResetStream(stream_id, kStreamClosed);
+    return true;
+  }
+
+  if (stream->body_handler) {
+    // Trailers, which are simply ignored.
+    if (!end_stream) {
+      ResetStream(stream_id, kProtocolError);
+      return true;
+    }
+    return OnStreamEnd(stream);
+  }
+
+  bool ok = server_ ? OnRequestHeaders(stream, std::move(headers)) :
+                      OnResponseHeaders(stream, std::move(headers));
+  if (!ok) {
+    LOG_ERRO("Malformed HTTP/2 message on stream %u.", stream_id);
+    ResetStream(stream_id, kProtocolError);
+    return true;
+  }
+
+  if (!stream->body_handler) {
+    // Interim (1xx) response.
+    return true;
+  }
+
+  if (end_stream) {
+    return OnStreamEnd(stream);
+  }
+
+  return true;
+}
+
+void Http2Session::OnHeadersTooLarge(Stream* stream) {
+  std::uint32_t stream_id = stream->id;
+
+  LOG_WARN("HTTP/2 header list of stream %u is too large.", stream_id);
+
+  if (!server_ || stream->message || stream->local_closed) {
+    ResetStream(stream_id, kEnhanceYourCalm);
+    return;
+  }
+
+  // Respond with 431 and tell the client to stop sending the request with
+  // RST_STREAM (NO_ERROR) (RFC 7540 8.1).
+  HeaderList headers;
+  headers.emplace_back(":status",
+                       std::to_string(Status::kRequestHeaderFieldsTooLarge));
+  SendMessage(stream, headers, std::make_shared<Body>());
+
+  if (streams_.erase(stream_id) > 0) {
+    SendRstStream(stream_id, kNoError);
+  }
+}
+
+bool Http2Session::OnRequestHeaders(Stream* stream, HeaderList&& headers) {
+  auto request = std::make_shared<Request>();
+
+  std::string path;
+  std::string authority;
+
+  for (Header& h : headers) {
+    if (h.first.empty()) {
+      return false;
+    }
+
+    if (h.first[0] == ':') {
+      if (h.first == ":method") {
+        request->set_method(h.second);
+      } else if (h.first == ":path") {
+        path = std::move(h.second);
+      } else if (h.first == ":authority") {
+        authority = std::move(h.second);
+      } else if (h.first != ":scheme") {
+        return false;
+      }
+    } else if (h.first == "cookie" && request->HasHeader(h.first)) {
+      // The cookie header might be split into several header fields.
+      request->SetHeader(h.first,
+                         request->GetHeader(h.first) + "; " + h.second);
+    } else {
+      request->SetHeader(std::move(h));
+    }
+  }
+
+  if (request->method().empty() || path.empty()) {
+    return false;
+  }
+
+  if (!authority.empty() && !request->HasHeader(headers::kHost)) {
+    request->SetHeader(headers::kHost, authority);
+  }
+
+  request->set_start_line(request->method() + " " + path + " HTTP/2");
+  request->set_url(Url(path));
+
+  stream->method = request->method();
+
+  // If no view matches, the request will still be handled by the server,
+  // e.g., with a 404 response.
+  if (view_matcher_) {
+    view_matcher_(request->method(), request->url().path_view(),
+                  &stream->stream);
+  }
+
+  stream->body_handler = NewBodyHandler(request.get(), stream->stream);
+  if (!stream->body_handler) {
+    return false;
+  }
+
+  stream->message = request;
+
+  return true;
+}
+
+bool Http2Session::OnResponseHeaders(Stream* stream, HeaderList&& headers) {
+  auto response = std::make_shared<Response>();
+
+  std::size_t status = 0;
+
+  for (Header& h : headers) {
+    if (h.first.empty()) {
+      return false;
+    }
+
+    if (h.first == ":status") {
+      if (!to_size_t(h.second, 10, &status)) {
+        return false;
+      }
+    } else if (h.first[0] == ':') {
+      return false;
+    } else {
+      response->SetHeader(std::move(h));
+    }
+  }
+
+  if (status == 0) {
+    return false;
+  }
+
+  if (status / 100 == 1) {
+    // Wait for the final response.
+    return true;
+  }
+
+  response->set_status(static_cast<int>(status));
+  response->set_start_line("HTTP/2 " + std::to_string(status));
+
+  stream->body_handler = NewBodyHandler(response.get(), stream->stream);
+  if (!stream->body_handler) {
+    return false;
+  }
+
+  stream->message = response;
+
+  return true;
+}
+
+bool Http2Session::OnStreamEnd(Stream* stream) {
+  stream->remote_closed = true;
+
+  std::shared_ptr<Message> message = std::move(stream->message);
+
+  bool existed = false;
+  const std::string& content_length =
+      message->GetHeader(headers::kContentLength, &existed);
+
+  std::size_t length = kInvalidLength;
+  if (existed && to_size_t(content_length, 10, &length)) {
+    message->set_content_length(length);
+  }
+
+  bool finished = stream->body_handler->Finish();
+  stream->body_handler.reset();
+
+  if (!finished) {
+    ResetStream(stream->id, kInternalError);
+    return true;
+  }
+
+  if (server_) {
+    requests_.emplace_back(stream->id,
+                           std::static_pointer_cast<Request>(message));
+  } else {
+    responses_[stream->id] = std::static_pointer_cast<Response>(message);
+  }
+
+  CloseStreamIfDone(stream->id);
+
+  return true;
+}
+
+bool Http2Session::ApplySettings(const char* payload, std::size_t length) {
+  for (std::size_t i = 0; i + 6 <= length; i += 6) {
+    std::uint16_t id = ReadUint16(payload + i);
+    std::uint32_t value = ReadUint32(payload + i + 2);
+
+    switch (id) {
+      case kHeaderTableSize:
+        encoder_.SetMaxTableSize(value);
+        break;
+
+      case kEnablePush:
+        if (value > 1) {
+          return GoAway(kProtocolError);
+        }
+        break;
+
+      case kInitialWindowSize: {
+        if (value > kMaxWindowSize) {
+          return GoAway(kFlowControlError);
+        }
+
+        // Adjust the windows of all the streams by the difference.
+        std::int64_t delta = value - peer_initial_window_;
+        for (auto& pair : streams_) {
+          pair.second->send_window += delta;
+          if (pair.second->send_window > kMaxWindowSize) {
+            return GoAway(kFlowControlError);
+          }
+        }
+
+        peer_initial_window_ = value;
+        break;
+      }
+
+      case kMaxFrameSize:
+        if (value < kDefaultMaxFrameSize || value > kMaxMaxFrameSize) {
+          return GoAway(kProtocolError);
+        }
+        peer_max_frame_size_ = value;
+        break;
+
+      default:
+        // Other settings are not used, unknown ones must be ignored.
+        break;
+    }
+  }
+
+  return true;
+}
+
+void Http2Session::SendMessage(Stream* stream, const HeaderList& headers,
+                               BodyPtr body) {
+  std::string block;
+  encoder_.Encode(headers, &block);
+
+  bool end_stream = body->IsEmpty();
+
+  // Split the header block into HEADERS and CONTINUATION frames.
+  FrameType type = kHeaders;
+  std::size_t off = 0;
+
+  do {
+    std::size_t size = std::min(block.size() - off, peer_max_frame_size_);
+
+    std::uint8_t flags = 0;
+    if (type == kHeaders && end_stream) {
+      flags |= flags::kEndStream;
+    }
+    if (off + size == block.size()) {
+      flags |= flags::kEndHeaders;
+    }
+
+    AppendFrameHeader(size, type, flags, stream->id, &control_);
+    control_.append(block, off, size);
+
+    off += size;
+    type = kContinuation;
+  } while (off < block.size());
+
+  if (end_stream) {
+    stream->local_closed = true;
+    CloseStreamIfDone(stream->id);
+    return;
+  }
+
+  stream->body = body;
+  stream->body->InitPayload();
+
+  // Start from the current virtual time so that the new stream doesn't
+  // starve the others.
+  stream->pass = std::max(stream->pass, pass_);
+}
+
+void Http2Session::ScheduleData(std::string* output) {
+  while (output->size() < kMaxOutputSize) {
+    Stream* next = nullptr;
+
+    for (auto& pair : streams_) {
+      Stream* stream = pair.second.get();
+
+      if (!stream->body || stream->local_closed) {
+        continue;
+      }
+
+      // An empty DATA frame with END_STREAM is not blocked by flow control.
+      bool end_only = stream->body_ended && stream->payload_size == 0;
+
+      if (!end_only && (stream->send_window <= 0 || send_window_ <= 0)) {
+        continue;
+      }
+
+      // Pick the stream with the smallest pass (stride scheduling).
+      if (next == nullptr || stream->pass < next->pass) {
+        next = stream;
+      }
+    }
+
+    if (next == nullptr) {
+      break;
+    }
+
+    pass_ = next->pass;
+
+    SendData(next, output);
+  }
+}
+
+void Http2Session::SendData(Stream* stream, std::string* output) {
+  std::int64_t window = std::min(stream->send_window, send_window_);
+
+  std::size_t max_size = 0;
+  if (window > 0) {
+    max_size = std::min(static_cast<std::size_t>(window),
+                        peer_max_frame_size_);
+  }
+
+  if (stream->payload_size == 0) {
+    LoadData(stream);
+  }
+
+  std::size_t size = std::min(stream->payload_size, max_size);
+
+  // Reserve the space of the frame header.
+  std::size_t header_off = output->size();
+  output->append(kFrameHeaderSize, '\0');
+
+  for (std::size_t copied = 0; copied < size;) {
+    asio::const_buffer& buffer = stream->payload[stream->payload_index];
+
+    std::size_t count = std::min(buffer.size(), size - copied);
+    output->append(static_cast<const char*>(buffer.data()), count);
+
+    buffer += count;
+    copied += count;
+
+    if (buffer.size() == 0) {
+      ++stream->payload_index;
+    }
+  }
+
+  stream->payload_size -= size;
+
+  // Peek the next payload to put END_STREAM in this frame if possible.
+  if (stream->payload_size == 0) {
+    LoadData(stream);
+  }
+
+  bool end_stream = stream->body_ended && stream->payload_size == 0;
+
+  std::string frame_header;
+  AppendFrameHeader(size, kData, end_stream ? flags::kEndStream : 0,
+                    stream->id, &frame_header);
+  output->replace(header_off, kFrameHeaderSize, frame_header);
+
+  stream->send_window -= size;
+  send_window_ -= size;
+
+  // The larger the weight, the slower the pass grows.
+  stream->pass += (size + kFrameHeaderSize) * 256 / stream->weight;
+
+  if (end_stream) {
+    stream->local_closed = true;
+    stream->body.reset();
+    CloseStreamIfDone(stream->id);
+  }
+}
+
+void Http2Session::LoadData(Stream* stream) {
+  while (!stream->body_ended) {
+    Payload payload = stream->body->NextPayload(true);
+
+    if (payload.empty()) {
+      stream->body_ended = true;
+      break;
+    }
+
+    std::size_t size = asio::buffer_size(payload);
+    if (size > 0) {
+      stream->payload = std::move(payload);
+      stream->payload_index = 0;
+      stream->payload_size = size;
+      break;
+    }
+  }
+}
+
+void Http2Session::SendSettings() {
+  std::string payload;
+
+  if (server_) {
+    AppendSetting(kMaxConcurrentStreams, kMaxConcurrentStreamsValue, &payload);
+  } else {
+    AppendSetting(kEnablePush, 0, &payload);
+  }
+
+  AppendSetting(kInitialWindowSize,
+                static_cast<std::uint32_t>(kLocalWindowSize), &payload);
+
+  AppendSetting(kMaxHeaderListSize, kMaxHeaderListSizeValue, &payload);
+
+  AppendFrameHeader(payload.size(), kSettings, 0, 0, &control_);
+  control_.append(payload);
+}
+
+void Http2Session::SendWindowUpdate(std::uint32_t stream_id,
+                                    std::uint32_t increment) {
+  AppendFrameHeader(4, kWindowUpdate, 0, stream_id, &control_);
+  AppendUint32(increment, &control_);
+}
+
+void Http2Session::SendRstStream(std::uint32_t stream_id, ErrorCode error) {
+  AppendFrameHeader(4, kRstStream, 0, stream_id, &control_);
+  AppendUint32(error, &control_);
+}
+
+bool Http2Session::GoAway(ErrorCode error) {
+  if (!error_) {
+    LOG_ERRO("HTTP/2 connection error: %u.", error);
+
+    AppendFrameHeader(8, kGoAway, 0, 0, &control_);
+    AppendUint32(server_ ? last_stream_id_ : 0, &control_);
+    AppendUint32(error, &control_);
+
+    goaway_ = true;
+    error_ = true;
+  }
+
+  return false;
+}
+
+void Http2Session::ResetStream(std::uint32_t stream_id, ErrorCode error) {
+  LOG_WARN("HTTP/2 stream (%u) error: %u.", stream_id, error);
+
+  SendRstStream(stream_id, error);
+
+  if (streams_.erase(stream_id) > 0 && !server_) {
+    responses_[stream_id] = nullptr;
+  }
+}
+
+void Http2Session::CloseStreamIfDone(std::uint32_t stream_id) {
+  auto it = streams_.find(stream_id);
+  if (it != streams_.end() && it->second->remote_closed &&
+      it->second->local_closed) {
+    streams_.erase(it);
+  }
+}
+
+Http2Session::Stream* Http2Session::FindStream(std::uint32_t stream_id) {
+  auto it = streams_.find(stream_id);
+  return it == streams_.end() ? nullptr : it->second.get();
+}
+
+Http2Session::Stream* Http2Session::NewStream(std::uint32_t stream_id) {
+  StreamPtr& stream = streams_[stream_id];
+  stream.reset(new Stream{ stream_id, peer_initial_window_ });
+  return stream.get();
+}
+
+}  // namespace webcc
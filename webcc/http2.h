@@ -0,0 +1,337 @@
+#ifndef WEBCC_HTTP2_H_
+#define WEBCC_HTTP2_H_
+
+// HTTP/2 framing layer.
+// See RFC 7540: https://tools.ietf.org/html/rfc7540
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "webcc/hpack.h"
+#include "webcc/parser.h"
+#include "webcc/request.h"
+#include "webcc/request_parser.h"
+#include "webcc/response.h"
+
+namespace webcc {
+
+namespace http2 {
+
+// The client connection preface.
+const char* const kPreface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+const std::size_t kPrefaceSize = 24;
+
+const std::size_t kFrameHeaderSize = 9;
+
+enum FrameType : std::uint8_t {
+  kData = 0x0,
+  kHeaders = 0x1,
+  kPriority = 0x2,
+  kRstStream = 0x3,
+  kSettings = 0x4,
+  kPushPromise = 0x5,
+  kPing = 0x6,
+  kGoAway = 0x7,
+  kWindowUpdate = 0x8,
+  kContinuation = 0x9,
+};
+
+namespace flags {
+
+const std::uint8_t kEndStream = 0x1;
+const std::uint8_t kAck = 0x1;
+const std::uint8_t kEndHeaders = 0x4;
+const std::uint8_t kPadded = 0x8;
+const std::uint8_t kPriority = 0x20;
+
+}  // namespace flags
+
+enum SettingsId : std::uint16_t {
+  kHeaderTableSize = 0x1,
+  kEnablePush = 0x2,
+  kMaxConcurrentStreams = 0x3,
+  kInitialWindowSize = 0x4,
+  kMaxFrameSize = 0x5,
+  kMaxHeaderListSize = 0x6,
+};
+
+enum ErrorCode : std::uint32_t {
+  kNoError = 0x0,
+  kProtocolError = 0x1,
+  kInternalError = 0x2,
+  kFlowControlError = 0x3,
+  kSettingsTimeout = 0x4,
+  kStreamClosed = 0x5,
+  kFrameSizeError = 0x6,
+  kRefusedStream = 0x7,
+  kCancel = 0x8,
+  kCompressionError = 0x9,
+  kConnectError = 0xa,
+  kEnhanceYourCalm = 0xb,
+  kInadequateSecurity = 0xc,
+  kHttp11Required = 0xd,
+};
+
+const std::int64_t kDefaultWindowSize = 65535;
+const std::int64_t kMaxWindowSize = 0x7fffffff;
+
+const std::size_t kDefaultMaxFrameSize = 16384;
+const std::size_t kMaxMaxFrameSize = 16777215;
+
+// Stream weight (1 ~ 256) of the priority scheme.
+const int kDefaultWeight = 16;
+
+// The flow-control window advertised to the peer, for both the connection
+// and the streams. Larger than the default for better upload throughput.
+const std::int64_t kLocalWindowSize = 1024 * 1024;
+
+const std::uint32_t kMaxConcurrentStreamsValue = 100;
+
+// The max size of the header list advertised to the peer (name + value + 32
+// of each header field), which also limits the size of a header block.
+const std::uint32_t kMaxHeaderListSizeValue = 64 * 1024;
+
+// Append a frame header to |output|.
+void AppendFrameHeader(std::size_t length, FrameType type, std::uint8_t flags,
+                       std::uint32_t stream_id, std::string* output);
+
+}  // namespace http2
+
+// -----------------------------------------------------------------------------
+
+// The state of an HTTP/2 connection, for either the server side or the client
+// side.
+// The session doesn't do any I/O by itself. The owner feeds the data read from
+// the socket with Feed(), and writes the data got from GetOutput() back to the
+// socket.
+// Requests and responses are still represented by `Request` and `Response`,
+// which are mapped to/from the HEADERS and DATA frames of the streams.
+// NOTE: The session is not thread-safe.
+class Http2Session {
+public:
+  // For server session, |view_matcher| is used to determine if a request
+  // should be streamed to a temp file.
+  Http2Session(bool server, ViewMatcher view_matcher = {});
+
+  ~Http2Session() = default;
+
+  Http2Session(const Http2Session&) = delete;
+  Http2Session& operator=(const Http2Session&) = delete;
+
+  // Server only.
+  // Switch from HTTP/1.1 (h2c upgrade). |settings| is the decoded payload of
+  // the HTTP2-Settings header, |request| is the upgrade request which becomes
+  // stream 1 (half-closed remote).
+  bool Upgrade(const std::string& settings, RequestPtr request);
+
+  // Process the data received from the peer.
+  // Return false on connection error, a GOAWAY frame will be pending in the
+  // output and the connection should be closed after it's sent.
+  bool Feed(const char* data, std::size_t length);
+
+  // Get the data to send to the peer.
+  // Control frames are sent first, DATA frames of the streams are then
+  // scheduled by the stream weights and the flow-control windows.
+  // Return false if there's nothing to send.
+  bool GetOutput(std::string* output);
+
+  // Server only.
+  // Send GOAWAY (NO_ERROR) to refuse new streams, the existing streams are
+  // still processed. The session is closed once they are all done.
+  void Shutdown();
+
+  // No more frames will be received or sent. The connection should be closed.
+  bool closed() const;
+
+  // Server only.
+  // Pop a request which has been fully received.
+  bool PopRequest(std::uint32_t* stream_id, RequestPtr* request);
+
+  // Server only.
+  // Send a response on the given stream.
+  // Ignored if the stream has been reset by the peer.
+  void SendResponse(std::uint32_t stream_id, ResponsePtr response);
+
+  // Client only.
+  // Send a request on a new stream and return the stream ID.
+  // If |stream| is true, the response body will be streamed to a temp file.
+  std::uint32_t SendRequest(RequestPtr request, bool stream = false);
+
+  // Client only.
+  // Check if the response of the given stream has been received.
+  // |response| will be null if the stream was reset.
+  bool TakeResponse(std::uint32_t stream_id, ResponsePtr* response);
+
+private:
+  struct Stream {
+    explicit Stream(std::uint32_t id, std::int64_t send_window)
+        : id(id), send_window(send_window) {
+    }
+
+    std::uint32_t id;
+
+    // The request (server) or response (client) being received.
+    std::shared_ptr<Message> message;
+    std::unique_ptr<BodyHandler> body_handler;
+
+    // The content to receive is streamed to a temp file or not.
+    bool stream = false;
+
+    // The END_STREAM flag has been received.
+    bool remote_closed = false;
+
+    // The request method (for HEAD).
+    std::string method;
+
+    // The body to send, null if not started yet.
+    BodyPtr body;
+
+    // The payload of the body which has been loaded but not sent.
+    Payload payload;
+    std::size_t payload_index = 0;
+    std::size_t payload_size = 0;
+
+    // The body has no more payload.
+    bool body_ended = false;
+
+    // The END_STREAM flag has been sent.
+    bool local_closed = false;
+
+    std::int64_t send_window;
+    std::int64_t recv_window = http2::kLocalWindowSize;
+
+    // Weight and virtual time for the weighted fair scheduling of DATA.
+    int weight = http2::kDefaultWeight;
+    std::uint64_t pass = 0;
+  };
+
+  using StreamPtr = std::unique_ptr<Stream>;
+
+  // Frame handlers.
+  // Return false on connection error.
+  bool OnFrame(http2::FrameType type, std::uint8_t flags,
+               std::uint32_t stream_id, const char* payload,
+               std::size_t length);
+  bool OnData(std::uint8_t flags, std::uint32_t stream_id, const char* payload,
+              std::size_t length);
+  bool OnHeaders(std::uint8_t flags, std::uint32_t stream_id,
+                 const char* payload, std::size_t length);
+  bool OnContinuation(std::uint8_t flags, std::uint32_t stream_id,
+                      const char* payload, std::size_t length);
+  bool OnPriority(std::uint32_t stream_id, const char* payload,
+                  std::size_t length);
+  bool OnRstStream(std::uint32_t stream_id, const char* payload,
+                   std::size_t length);
+  bool OnSettings(std::uint8_t flags, std::uint32_t stream_id,
+                  const char* payload, std::size_t length);
+  bool OnPing(std::uint8_t flags, std::uint32_t stream_id,
+              const char* payload, std::size_t length);
+  bool OnGoAway(std::uint32_t stream_id, const char* payload,
+                std::size_t length);
+  bool OnWindowUpdate(std::uint32_t stream_id, const char* payload,
+                      std::size_t length);
+
+  // Called when a complete header block has been received.
+  bool OnHeaderBlock(std::uint32_t stream_id, bool end_stream);
+
+  // The decoded header list is larger than kMaxHeaderListSizeValue.
+  void OnHeadersTooLarge(Stream* stream);
+
+  // Map the decoded header fields to the request (server) or the response
+  // (client) of the stream.
+  // Return false on malformed message.
+  bool OnRequestHeaders(Stream* stream, HeaderList&& headers);
+  bool OnResponseHeaders(Stream* stream, HeaderList&& headers);
+
+  // All the data of the stream has been received.
+  bool OnStreamEnd(Stream* stream);
+
+  bool ApplySettings(const char* payload, std::size_t length);
+
+  // Send the header fields and the body of a message on the stream.
+  void SendMessage(Stream* stream, const HeaderList& headers, BodyPtr body);
+
+  // Append the DATA frames scheduled to |output|.
+  void ScheduleData(std::string* output);
+
+  // Send a DATA frame of the stream as large as the flow control allows.
+  void SendData(Stream* stream, std::string* output);
+
+  // Load the next non-empty payload of the body.
+  void LoadData(Stream* stream);
+
+  void SendSettings();
+  void SendWindowUpdate(std::uint32_t stream_id, std::uint32_t increment);
+  void SendRstStream(std::uint32_t stream_id, http2::ErrorCode error);
+
+  // Connection error, send GOAWAY and stop processing.
+  bool GoAway(http2::ErrorCode error);
+
+  // Reset the stream with a stream error.
+  void ResetStream(std::uint32_t stream_id, http2::ErrorCode error);
+
+  // Close the stream if both sides have sent END_STREAM.
+  void CloseStreamIfDone(std::uint32_t stream_id);
+
+  Stream* FindStream(std::uint32_t stream_id);
+
+  Stream* NewStream(std::uint32_t stream_id);
+
+private:
+  bool server_;
+
+  ViewMatcher view_matcher_;
+
+  HpackEncoder encoder_;
+  HpackDecoder decoder_;
+
+  // Data received but not processed.
+  std::string input_;
+
+  // Bytes of the connection preface received (server only).
+  std::size_t preface_received_ = 0;
+
+  // Pending control frames, HEADERS frames included.
+  std::string control_;
+
+  std::map<std::uint32_t, StreamPtr> streams_;
+
+  // The largest stream ID initiated by the peer (server) or by us (client).
+  std::uint32_t last_stream_id_ = 0;
+
+  // The header block being received with CONTINUATION frames.
+  std::uint32_t continuation_stream_id_ = 0;
+  bool continuation_end_stream_ = false;
+  std::string header_block_;
+
+  // Settings of the peer.
+  std::int64_t peer_initial_window_ = http2::kDefaultWindowSize;
+  std::size_t peer_max_frame_size_ = http2::kDefaultMaxFrameSize;
+
+  // Connection-level flow-control windows.
+  std::int64_t send_window_ = http2::kDefaultWindowSize;
+  std::int64_t recv_window_ = http2::kLocalWindowSize;
+
+  // The pass of the stream scheduled last.
+  std::uint64_t pass_ = 0;
+
+  // Server: requests fully received.
+  std::deque<std::pair<std::uint32_t, RequestPtr>> requests_;
+
+  // Client: responses fully received, null if the stream was reset.
+  std::map<std::uint32_t, ResponsePtr> responses_;
+
+  // A GOAWAY frame has been received or sent.
+  bool goaway_ = false;
+
+  // A connection error occurred.
+  bool error_ = false;
+};
+
+}  // namespace webcc
+
+#endif  // WEBCC_HTTP2_H_
@@ -2,16 +2,31 @@
 
 #if WEBCC_ENABLE_LOG
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <condition_variable>
 #include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <filesystem>
-#include <iomanip>  // for put_time
+#include <map>
+#include <memory>
 #include <mutex>
-#include <sstream>
+#include <new>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <vector>
+
+#include "webcc/queue.h"
+
+#if WEBCC_ENABLE_GZIP
+#include "webcc/gzip.h"
+#endif
 
 #if (defined(_WIN32) || defined(_WIN64))
 #include <Windows.h>
@@ -19,21 +34,367 @@
 // For getting thread ID.
 #include <sys/syscall.h>
 #include <sys/types.h>
+#include <unistd.h>
 #endif
 
 namespace webcc {
 
 // -----------------------------------------------------------------------------
 
-static std::string g_main_thread_id;
+static std::atomic<std::int64_t> g_main_thread_id{ 0 };
 
 static const char* kLevelNames[] = {
   "VERB", "INFO", "USER", "WARN", "ERRO"
 };
 
+// Size of the ring buffer of each thread for the async logging.
+static const std::size_t kRingSize = 64 * 1024;
+
+// Max size of a log message, longer ones are truncated.
+static const std::size_t kMaxMessageSize = 4096;
+
+// Size of the prefix of a log, i.e., timestamp, level, thread, file and line.
+static const std::size_t kPrefixSize = 128;
+
+// Interval of the background thread to write the logs out.
+static const std::chrono::milliseconds kWriteInterval{ 50 };
+
+// Size of the time part of a rotated log file name, e.g.,
+// "20200101-120000-000" of "webcc-20200101-120000-000.log".
+static const std::size_t kRotatedTimeSize = 19;
+
+// -----------------------------------------------------------------------------
+
+// std::this_thread::get_id() returns a very long ID (same as pthread_self())
+// on Linux, e.g., 140219133990656. syscall(SYS_gettid) is much prefered because
+// it's shorter and the same as `ps -T -p <pid>` output.
+static std::int64_t DoGetThreadID() {
+#if (defined(_WIN32) || defined(_WIN64))
+  return static_cast<std::int64_t>(GetCurrentThreadId());
+#else
+  return static_cast<std::int64_t>(syscall(SYS_gettid));
+#endif
+}
+
+// Cached to save the system call.
+static std::int64_t GetThreadID() {
+  thread_local std::int64_t t_thread_id = DoGetThreadID();
+  return t_thread_id;
+}
+
+// Microseconds since epoch.
+static std::int64_t GetTime() {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(
+      system_clock::now().time_since_epoch()).count();
+}
+
+static void LocalTime(std::time_t second, std::tm* tm) {
+#if (defined(_WIN32) || defined(_WIN64))
+  localtime_s(tm, &second);
+#else
+  localtime_r(&second, tm);
+#endif
+}
+
+// Seconds of the local time ahead of UTC at the given time, e.g., 28800 for
+// UTC+8, so that the rotation could be aligned to the local time as the names
+// of the rotated files are.
+static std::int64_t UtcOffset(std::time_t second) {
+  std::tm tm{};
+  LocalTime(second, &tm);
+
+  // Days since epoch of the local date (the civil calendar algorithm by
+  // Howard Hinnant).
+  std::int64_t y = tm.tm_year + 1900;
+  std::int64_t m = tm.tm_mon + 1;
+  y -= m <= 2 ? 1 : 0;
+  std::int64_t era = (y >= 0 ? y : y - 399) / 400;
+  std::int64_t yoe = y - era * 400;
+  std::int64_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + tm.tm_mday - 1;
+  std::int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  std::int64_t days = era * 146097 + doe - 719468;
+
+  std::int64_t local = days * 86400 + tm.tm_hour * 3600 + tm.tm_min * 60 +
+                       tm.tm_sec;
+  return local - static_cast<std::int64_t>(second);
+}
+
+// Format the prefix of a log, e.g.,
+//   "2020-01-01 12:00:00.123, INFO,    main,        server.cc,   60, "
+// The date and time are cached for the same second.
+static void FormatPrefix(char* prefix, int level, const char* file, int line,
+                         std::int64_t time, std::int64_t thread_id) {
+  thread_local std::time_t t_second = -1;
+  thread_local char t_datetime[32];
+
+  std::time_t second = static_cast<std::time_t>(time / 1000000);
+  if (second != t_second) {
+    std::tm tm{};
+    LocalTime(second, &tm);
+    std::strftime(t_datetime, sizeof(t_datetime), "%Y-%m-%d %H:%M:%S", &tm);
+    t_second = second;
+  }
+
+  char thread[24];
+  if (thread_id == g_main_thread_id) {
+    std::snprintf(thread, sizeof(thread), "main");
+  } else {
+    std::snprintf(thread, sizeof(thread), "%lld",
+                  static_cast<long long>(thread_id));
+  }
+
+  std::snprintf(prefix, kPrefixSize, "%s.%03d, %s, %7s, %20s, %4d, ",
+                t_datetime, static_cast<int>(time / 1000 % 1000),
+                kLevelNames[level], thread, file, line);
+}
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+// The header of a log in the ring, followed by the message.
+struct Record {
+  // Size of the record in the ring, message included and aligned.
+  // 0 marks the padding up to the end of the ring.
+  std::uint32_t size;
+
+  std::int32_t level;
+  std::int32_t line;
+  std::uint32_t length;  // Of the message
+  const char* file;
+  std::int64_t time;
+  std::int64_t thread_id;
+
+  const char* message() const {
+    return reinterpret_cast<const char*>(this + 1);
+  }
+};
+
+std::size_t AlignRecord(std::size_t size) {
+  return (size + alignof(Record) - 1) & ~(alignof(Record) - 1);
+}
+
+// A single producer, single consumer ring buffer of the logs.
+// The producer is the thread owning it, the consumer is the background thread.
+class Ring {
+public:
+  Ring() = default;
+
+  Ring(const Ring&) = delete;
+  Ring& operator=(const Ring&) = delete;
+
+  // Called by the producer.
+  // Return false, and count it as dropped, if there's no enough space.
+  // |half_full| is set if the ring has just become half full, the consumer
+  // should be woken up instead of waiting for the next interval.
+  bool Push(int level, const char* file, int line, std::int64_t time,
+            std::int64_t thread_id, const char* message, std::size_t length,
+            bool* half_full) {
+    std::size_t need = AlignRecord(sizeof(Record) + length);
+
+    std::uint64_t tail = tail_.load(std::memory_order_relaxed);
+    std::uint64_t head = head_.load(std::memory_order_acquire);
+
+    std::size_t offset = static_cast<std::size_t>(tail % kRingSize);
+    std::size_t contiguous = kRingSize - offset;
+
+    // Skip the space left at the end if it's not enough.
+    std::size_t padding = contiguous < need ? contiguous : 0;
+
+    if (kRingSize - (tail - head) < padding + need) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    if (padding > 0) {
+      std::uint32_t marker = 0;
+      std::memcpy(data_ + offset, &marker, sizeof(marker));
+      tail += padding;
+      offset = 0;
+    }
+
+    Record* record = new (data_ + offset) Record;
+    record->size = static_cast<std::uint32_t>(need);
+    record->level = level;
+    record->line = line;
+    record->length = static_cast<std::uint32_t>(length);
+    record->file = file;
+    record->time = time;
+    record->thread_id = thread_id;
+    std::memcpy(record + 1, message, length);
+
+    tail_.store(tail + need, std::memory_order_release);
+
+    *half_full = (tail - head) < kRingSize / 2 &&
+                 (tail + need - head) >= kRingSize / 2;
+    return true;
+  }
+
+  // Called by the consumer.
+  // Collect the records available, which are valid until Release().
+  // Return the position to release up to.
+  std::uint64_t Collect(std::vector<const Record*>* records) const {
+    std::uint64_t head = head_.load(std::memory_order_relaxed);
+    std::uint64_t tail = tail_.load(std::memory_order_acquire);
+
+    while (head < tail) {
+      std::size_t offset = static_cast<std::size_t>(head % kRingSize);
+
+      std::uint32_t size = 0;
+      std::memcpy(&size, data_ + offset, sizeof(size));
+      if (size == 0) {
+        head += kRingSize - offset;
+        continue;
+      }
+
+      records->push_back(reinterpret_cast<const Record*>(data_ + offset));
+      head += size;
+    }
+
+    return tail;
+  }
+
+  // Called by the consumer.
+  void Release(std::uint64_t position) {
+    head_.store(position, std::memory_order_release);
+  }
+
+  bool Empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+  // The producer thread has exited.
+  void Close() {
+    closed_.store(true, std::memory_order_release);
+  }
+
+  bool closed() const {
+    return closed_.load(std::memory_order_acquire);
+  }
+
+  std::uint64_t dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+private:
+  // Read and write positions, increasing only.
+  std::atomic<std::uint64_t> head_{ 0 };
+  std::atomic<std::uint64_t> tail_{ 0 };
+
+  std::atomic<bool> closed_{ false };
+
+  std::atomic<std::uint64_t> dropped_{ 0 };
+
+  alignas(Record) char data_[kRingSize];
+};
+
 // -----------------------------------------------------------------------------
 
-static FILE* FOpen(const std::filesystem::path& path, bool overwrite) {
+// A rotated log file to archive.
+struct ArchiveJob {
+  std::filesystem::path path;
+
+  // Max number of the rotated files to keep, 0 for no limit.
+  int max_files = 0;
+};
+
+// Compress the rotated log files and remove the old ones in a background
+// thread, started on the first rotation.
+class Archiver {
+public:
+  Archiver() = default;
+
+  Archiver(const Archiver&) = delete;
+  Archiver& operator=(const Archiver&) = delete;
+
+  ~Archiver() {
+    if (thread_.joinable()) {
+      // An empty path stops the thread after the jobs left.
+      queue_.Push(ArchiveJob{});
+      thread_.join();
+    }
+  }
+
+  void Push(ArchiveJob job) {
+    if (!thread_.joinable()) {
+      thread_ = std::thread(&Archiver::Run, this);
+    }
+    queue_.Push(std::move(job));
+  }
+
+private:
+  void Run() {
+    while (true) {
+      ArchiveJob job = queue_.PopOrWait();
+      if (job.path.empty()) {
+        break;
+      }
+
+#if WEBCC_ENABLE_GZIP
+      Compress(job.path);
+#endif
+      Remove(job.path, job.max_files);
+    }
+  }
+
+#if WEBCC_ENABLE_GZIP
+  static void Compress(const std::filesystem::path& path) {
+    std::filesystem::path gz_path = path;
+    gz_path += ".gz";
+
+    std::error_code ec;
+    if (gzip::CompressFile(path, gz_path)) {
+      std::filesystem::remove(path, ec);
+    } else {
+      std::filesystem::remove(gz_path, ec);
+    }
+  }
+#endif  // WEBCC_ENABLE_GZIP
+
+  // Remove the oldest rotated files beyond |max_files|.
+  static void Remove(const std::filesystem::path& path, int max_files) {
+    if (max_files <= 0) {
+      return;
+    }
+
+    // E.g., "webcc-20200101-120000-000.log" -> "webcc-", ".log".
+    std::string name = path.filename().string();
+    std::string ext = path.extension().string();
+    std::string prefix = name.substr(0, name.size() - ext.size() -
+                                            kRotatedTimeSize);
+
+    std::vector<std::string> names;
+
+    std::error_code ec;
+    for (auto& entry :
+         std::filesystem::directory_iterator(path.parent_path(), ec)) {
+      std::string n = entry.path().filename().string();
+      if (n.size() >= name.size() && n.compare(0, prefix.size(), prefix) == 0 &&
+          n.compare(prefix.size() + kRotatedTimeSize, ext.size(), ext) ==
+              0) {
+        names.push_back(std::move(n));
+      }
+    }
+
+    if (names.size() <= static_cast<std::size_t>(max_files)) {
+      return;
+    }
+
+    // The time parts are of the same length, sorted by time.
+    std::sort(names.begin(), names.end());
+
+    for (std::size_t i = 0; i < names.size() - max_files; ++i) {
+      std::filesystem::remove(path.parent_path() / names[i], ec);
+    }
+  }
+
+  std::thread thread_;
+  Queue<ArchiveJob> queue_;
+};
+
+FILE* FOpen(const std::filesystem::path& path, bool overwrite) {
 #if (defined(_WIN32) || defined(_WIN64))
   return _wfopen(path.wstring().c_str(), overwrite ? L"w+" : L"a+");
 #else
@@ -45,28 +406,174 @@ struct Logger {
   Logger() : file(nullptr), modes(0) {
   }
 
-  void Init(const std::filesystem::path& path, int _modes) {
+  void Init(const std::filesystem::path& _path, int _modes) {
+    Stop();
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (file != nullptr) {
+      fclose(file);
+      file = nullptr;
+    }
+
     modes = _modes;
+    path = _path;
+    size = 0;
 
     // Create log file only if necessary.
     if ((modes & LOG_FILE) != 0 && !path.empty()) {
       file = FOpen(path, (modes & LOG_OVERWRITE) != 0);
+
+      if ((modes & LOG_OVERWRITE) == 0) {
+        std::error_code ec;
+        size = std::filesystem::file_size(path, ec);
+        if (ec) {
+          size = 0;
+        }
+      }
+    }
+
+    UpdateNextRotation(GetTime());
+
+    if ((modes & LOG_ASYNC) != 0) {
+      Start();
     }
   }
 
   ~Logger() {
+    Stop();
+
     if (file != nullptr) {
       fclose(file);
     }
   }
 
+  void SetRotation(std::uint64_t _max_size, int _interval, int _max_files) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    max_size = _max_size;
+    interval = _interval;
+    max_files = _max_files;
+
+    UpdateNextRotation(GetTime());
+  }
+
+  // Align the rotation to the local time, e.g., at midnight for a daily
+  // interval.
+  void UpdateNextRotation(std::int64_t time) {
+    if (interval > 0) {
+      std::int64_t second = time / 1000000;
+      std::int64_t offset = UtcOffset(static_cast<std::time_t>(second));
+      next_rotation = ((second + offset) / interval + 1) * interval - offset;
+    }
+  }
+
+  // Rotate the log file before writing to it if necessary.
+  // The mutex must be held. Don't log from here!
+  void RotateIfNeeded(std::int64_t time) {
+    if ((max_size > 0 && size >= max_size) ||
+        (interval > 0 && time / 1000000 >= next_rotation)) {
+      Rotate(time);
+    }
+  }
+
+  void Rotate(std::int64_t time);
+
+  // Start the background thread.
+  void Start();
+
+  // Stop the background thread after writing the logs left.
+  void Stop();
+
+  void AddRing(std::shared_ptr<Ring> ring);
+
+  void Flush();
+
+  std::uint64_t GetDropped();
+
+  // The routine of the background thread.
+  void Run();
+
+  // Write out the logs in the rings.
+  void Drain();
+
   FILE* file;
   int modes;
   std::mutex mutex;
+
+  // Rotation.
+  std::filesystem::path path;
+  std::uint64_t size = 0;  // Of the current file
+  std::uint64_t max_size = 0;
+  int interval = 0;  // In seconds
+  int max_files = 0;
+  std::int64_t next_rotation = 0;  // In seconds since epoch
+  Archiver archiver;
+
+  // Async logging.
+  std::atomic<bool> async{ false };
+  std::thread thread;
+
+  std::vector<std::shared_ptr<Ring>> rings;
+  std::mutex rings_mutex;
+
+  // Dropped by the rings removed.
+  std::uint64_t removed_dropped = 0;
+
+  // Dropped and reported so far.
+  std::uint64_t reported_dropped = 0;
+
+  bool stopped = false;
+  std::uint64_t flush_requested = 0;
+  std::uint64_t flushed = 0;
+  std::atomic<bool> woken{ false };  // By a ring half full
+  std::condition_variable cv;
+  std::condition_variable flushed_cv;
+  std::mutex cv_mutex;
+
+  // Reused by the background thread.
+  std::vector<const Record*> records;
+  std::string file_batch;
+  std::string console_batch;
 };
 
 // Global logger.
-static Logger g_logger;
+Logger g_logger;
+
+// -----------------------------------------------------------------------------
+
+// Set once the ring holder of the thread has gone, the logs at the exit of the
+// thread are then written directly.
+thread_local bool t_ring_gone = false;
+
+// The ring buffer of the thread, closed on the exit of the thread.
+struct RingHolder {
+  ~RingHolder() {
+    if (ring) {
+      ring->Close();
+    }
+    t_ring_gone = true;
+  }
+
+  std::shared_ptr<Ring> ring;
+};
+
+thread_local RingHolder t_ring_holder;
+
+}  // namespace
+
+static Ring* GetRing() {
+  if (t_ring_gone) {
+    return nullptr;
+  }
+
+  if (!t_ring_holder.ring) {
+    t_ring_holder.ring = std::make_shared<Ring>();
+    g_logger.AddRing(t_ring_holder.ring);
+  }
+
+  return t_ring_holder.ring.get();
+}
 
 // -----------------------------------------------------------------------------
 
@@ -131,28 +638,410 @@ static const bool g_terminal_has_color = []() {
 
 // -----------------------------------------------------------------------------
 
-// std::this_thread::get_id() returns a very long ID (same as pthread_self())
-// on Linux, e.g., 140219133990656. syscall(SYS_gettid) is much prefered because
-// it's shorter and the same as `ps -T -p <pid>` output.
-static std::string DoGetThreadID() {
+// Append a log to the batch to write.
+static void AppendLog(std::string* batch, bool console, int level,
+                      const char* prefix, const char* message,
+                      std::size_t length) {
+  if (console && g_terminal_has_color) {
+    batch->append(TERM_RESET);
+    if (level == WEBCC_WARN) {
+      batch->append(TERM_YELLOW);
+    } else if (level > WEBCC_WARN) {
+      batch->append(TERM_RED);
+    }
+  }
+
+  batch->append(prefix);
+  batch->append(message, length);
+
+  if (console && g_terminal_has_color) {
+    batch->append(TERM_RESET);
+  }
+  batch->push_back('\n');
+}
+
+void Logger::Rotate(std::int64_t time) {
+  UpdateNextRotation(time);
+
+  // Reset the size anyway, not to retry on each log if it fails.
+  size = 0;
+
+  if (file == nullptr) {
+    return;
+  }
+
+  // E.g., "webcc.log" -> "webcc-20200101-120000-000.log".
+  std::tm tm{};
+  LocalTime(static_cast<std::time_t>(time / 1000000), &tm);
+  char datetime[16];
+  std::strftime(datetime, sizeof(datetime), "%Y%m%d-%H%M%S", &tm);
+
+  std::filesystem::path rotated;
+  std::error_code ec;
+
+  for (int i = 0; i < 1000; ++i) {
+    char rotated_time[kRotatedTimeSize + 1];
+    std::snprintf(rotated_time, sizeof(rotated_time), "%s-%03d", datetime, i);
+
+    auto candidate = path.parent_path() / (path.stem().string() + "-" +
+                                           rotated_time +
+                                           path.extension().string());
+    auto gz_candidate = candidate;
+    gz_candidate += ".gz";
+
+    if (!std::filesystem::exists(candidate, ec) &&
+        !std::filesystem::exists(gz_candidate, ec)) {
+      rotated = std::move(candidate);
+      break;
+    }
+  }
+
+  if (rotated.empty()) {
+    return;
+  }
+
 #if (defined(_WIN32) || defined(_WIN64))
-  auto thread_id = std::this_thread::get_id();
-  std::stringstream ss;
-  ss << thread_id;
-  return ss.str();
-#else
-  return std::to_string(syscall(SYS_gettid));
+  // Close before renaming, required on Windows.
+  fclose(file);
+  file = nullptr;
 #endif
+
+  std::filesystem::rename(path, rotated, ec);
+  bool renamed = !ec;
+
+  FILE* new_file = FOpen(path, renamed);
+
+  if (new_file == nullptr) {
+    // Keep logging to the old file instead of dropping all the logs.
+    std::fprintf(stderr, "Failed to open the log file after rotating: %s\n",
+                 path.string().c_str());
+#if (defined(_WIN32) || defined(_WIN64))
+    file = FOpen(renamed ? rotated : path, false);
+#endif
+    return;
+  }
+
+  if (file != nullptr) {
+    fclose(file);
+  }
+  file = new_file;
+
+  if (renamed) {
+    archiver.Push(ArchiveJob{ rotated, max_files });
+  }
 }
 
-static std::string GetThreadID() {
-  std::string thread_id = DoGetThreadID();
-  if (thread_id == g_main_thread_id) {
-    return "main";
+void Logger::Start() {
+  {
+    std::lock_guard<std::mutex> lock(cv_mutex);
+    stopped = false;
+  }
+
+  async = true;
+  thread = std::thread(&Logger::Run, this);
+}
+
+void Logger::Stop() {
+  if (!thread.joinable()) {
+    return;
+  }
+
+  // The logs from now on are written directly.
+  async = false;
+
+  {
+    std::lock_guard<std::mutex> lock(cv_mutex);
+    stopped = true;
+  }
+  cv.notify_all();
+
+  thread.join();
+}
+
+void Logger::AddRing(std::shared_ptr<Ring> ring) {
+  std::lock_guard<std::mutex> lock(rings_mutex);
+  rings.push_back(std::move(ring));
+}
+
+void Logger::Flush() {
+  if (!async) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (file != nullptr) {
+      fflush(file);
+    }
+    fflush(stderr);
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(cv_mutex);
+  if (stopped) {
+    return;
+  }
+
+  std::uint64_t ticket = ++flush_requested;
+  cv.notify_all();
+
+  flushed_cv.wait(lock, [this, ticket] {
+    return flushed >= ticket || stopped;
+  });
+}
+
+std::uint64_t Logger::GetDropped() {
+  std::lock_guard<std::mutex> lock(rings_mutex);
+
+  std::uint64_t dropped = removed_dropped;
+  for (auto& ring : rings) {
+    dropped += ring->dropped();
+  }
+  return dropped;
+}
+
+void Logger::Run() {
+  std::unique_lock<std::mutex> lock(cv_mutex);
+
+  while (true) {
+    cv.wait_for(lock, kWriteInterval, [this] {
+      return stopped || flush_requested > flushed || woken;
+    });
+
+    woken = false;
+
+    bool stop = stopped;
+    std::uint64_t requested = flush_requested;
+
+    lock.unlock();
+    Drain();
+    lock.lock();
+
+    if (requested > flushed) {
+      flushed = requested;
+      flushed_cv.notify_all();
+    }
+
+    if (stop) {
+      break;
+    }
+  }
+}
+
+void Logger::Drain() {
+  std::vector<std::shared_ptr<Ring>> snapshot;
+  {
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    snapshot = rings;
+  }
+
+  // Check if closed before collecting, so that a closed ring is known to be
+  // empty once released.
+  std::vector<bool> closed;
+  std::vector<std::uint64_t> positions;
+
+  records.clear();
+  for (auto& ring : snapshot) {
+    closed.push_back(ring->closed());
+    positions.push_back(ring->Collect(&records));
+  }
+
+  // Merge the logs of the threads in time order.
+  std::stable_sort(records.begin(), records.end(),
+                   [](const Record* lhs, const Record* rhs) {
+                     return lhs->time < rhs->time;
+                   });
+
+  bool to_file = (modes & LOG_FILE) != 0 && !path.empty();
+  bool to_console = (modes & LOG_CONSOLE) != 0;
+
+  file_batch.clear();
+  console_batch.clear();
+
+  char prefix[kPrefixSize];
+
+  for (const Record* r : records) {
+    FormatPrefix(prefix, r->level, r->file, r->line, r->time, r->thread_id);
+    if (to_file) {
+      AppendLog(&file_batch, false, r->level, prefix, r->message(), r->length);
+    }
+    if (to_console) {
+      AppendLog(&console_batch, true, r->level, prefix, r->message(),
+                r->length);
+    }
+  }
+
+  std::uint64_t dropped = GetDropped();
+  if (dropped > reported_dropped) {
+    char message[64];
+    int length = std::snprintf(message, sizeof(message),
+                               "%llu log(s) dropped, the buffer was full.",
+                               static_cast<unsigned long long>(
+                                   dropped - reported_dropped));
+    FormatPrefix(prefix, WEBCC_WARN, __FILENAME__, __LINE__, GetTime(),
+                 GetThreadID());
+    if (to_file) {
+      AppendLog(&file_batch, false, WEBCC_WARN, prefix, message, length);
+    }
+    if (to_console) {
+      AppendLog(&console_batch, true, WEBCC_WARN, prefix, message, length);
+    }
+    reported_dropped = dropped;
+  }
+
+  if (!file_batch.empty() || !console_batch.empty()) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!file_batch.empty()) {
+      RotateIfNeeded(GetTime());
+    }
+    if (!file_batch.empty() && file != nullptr) {
+      fwrite(file_batch.data(), 1, file_batch.size(), file);
+      fflush(file);
+      size += file_batch.size();
+    }
+    if (!console_batch.empty()) {
+      fwrite(console_batch.data(), 1, console_batch.size(), stderr);
+      fflush(stderr);
+    }
+  }
+
+  for (std::size_t i = 0; i < snapshot.size(); ++i) {
+    snapshot[i]->Release(positions[i]);
+  }
+
+  // Remove the rings of the threads exited.
+  std::lock_guard<std::mutex> lock(rings_mutex);
+  for (std::size_t i = 0; i < snapshot.size(); ++i) {
+    if (closed[i]) {
+      removed_dropped += snapshot[i]->dropped();
+      rings.erase(std::find(rings.begin(), rings.end(), snapshot[i]));
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+LogSlot g_log_slots[kLogSlots];
+
+namespace {
+
+// The module levels published to the logging threads, immutable once
+// published.
+struct LogLevelTable {
+  // The level of all the modules except those in |modules|.
+  int level = WEBCC_LOG_DEFAULT_LEVEL;
+
+  std::map<std::string, int, std::less<>> modules;
+
+  int Get(std::string_view module) const {
+    auto it = modules.find(module);
+    return it != modules.end() ? it->second : level;
+  }
+};
+
+// The runtime log levels, updated rarely.
+struct LogLevels {
+  std::mutex mutex;
+
+  LogLevelTable table;
+
+  // The tables published, never freed since a logging thread might still be
+  // reading an old one without any lock. The levels are changed rarely.
+  std::vector<std::unique_ptr<LogLevelTable>> published;
+
+  // Update the slots according to the levels, and publish a copy of the
+  // table if any module has its own level.
+  void Update();
+};
+
+LogLevels& GetLogLevels() {
+  static LogLevels levels;
+  return levels;
+}
+
+// The level of all the modules, and the table of the module levels, null if
+// no module has its own level. The exact level is checked against them once
+// the slot has passed.
+std::atomic<int> g_log_level{ WEBCC_LOG_DEFAULT_LEVEL };
+std::atomic<const LogLevelTable*> g_log_level_table{ nullptr };
+
+void LogLevels::Update() {
+  int slots[kLogSlots];
+  std::fill(std::begin(slots), std::end(slots), table.level);
+
+  for (auto& pair : table.modules) {
+    int& slot = slots[LogHashModule(pair.first.c_str())];
+    slot = std::min(slot, pair.second);
+  }
+
+  const LogLevelTable* copy = nullptr;
+  if (!table.modules.empty()) {
+    published.push_back(std::make_unique<LogLevelTable>(table));
+    copy = published.back().get();
+  }
+
+  // Publish the table before lowering the levels of the slots.
+  g_log_level.store(table.level, std::memory_order_relaxed);
+  g_log_level_table.store(copy, std::memory_order_release);
+
+  for (std::size_t i = 0; i < kLogSlots; ++i) {
+    g_log_slots[i].level.store(slots[i], std::memory_order_relaxed);
+  }
+}
+
+// Get the module of a source file, e.g., "connection" of "webcc/connection.cc".
+std::string_view GetModule(std::string_view file) {
+  std::size_t pos = file.find_last_of("/\\");
+  if (pos != std::string_view::npos) {
+    file.remove_prefix(pos + 1);
   }
-  return thread_id;
+  return file.substr(0, file.find('.'));
 }
 
+// Lock free, on the logging path.
+bool CheckLevel(int level, const char* file) {
+  auto table = g_log_level_table.load(std::memory_order_acquire);
+  if (table == nullptr) {
+    return level >= g_log_level.load(std::memory_order_relaxed);
+  }
+  return level >= table->Get(GetModule(file));
+}
+
+}  // namespace
+
+void LogSetLevel(int level) {
+  auto& levels = GetLogLevels();
+  std::lock_guard<std::mutex> lock(levels.mutex);
+
+  levels.table.level = level;
+  levels.Update();
+}
+
+void LogSetLevel(const std::string& module, int level) {
+  auto& levels = GetLogLevels();
+  std::lock_guard<std::mutex> lock(levels.mutex);
+
+  levels.table.modules[std::string{ GetModule(module) }] = level;
+  levels.Update();
+}
+
+void LogResetLevel(const std::string& module) {
+  auto& levels = GetLogLevels();
+  std::lock_guard<std::mutex> lock(levels.mutex);
+
+  auto it = levels.table.modules.find(GetModule(module));
+  if (it != levels.table.modules.end()) {
+    levels.table.modules.erase(it);
+  }
+  levels.Update();
+}
+
+int LogGetLevel(const std::string& module) {
+  auto& levels = GetLogLevels();
+  std::lock_guard<std::mutex> lock(levels.mutex);
+
+  return levels.table.Get(GetModule(module));
+}
+
+// -----------------------------------------------------------------------------
+
 static std::filesystem::path InitLogPath(const std::filesystem::path& dir) {
   if (dir.empty()) {
     return std::filesystem::current_path() / WEBCC_LOG_FILE_NAME;
@@ -170,7 +1059,7 @@ static std::filesystem::path InitLogPath(const std::filesystem::path& dir) {
 
 void LogInit(const std::filesystem::path& dir, int modes) {
   // Suppose this is called from the main thread.
-  g_main_thread_id = DoGetThreadID();
+  g_main_thread_id = GetThreadID();
 
   if ((modes & LOG_FILE) != 0) {
     g_logger.Init(InitLogPath(dir), modes);
@@ -179,53 +1068,85 @@ void LogInit(const std::filesystem::path& dir, int modes) {
   }
 }
 
-static std::string GetTimestamp() {
-  using system_clock = std::chrono::system_clock;
-  using milliseconds = std::chrono::milliseconds;
+void LogSetRotation(std::uint64_t max_size, int interval, int max_files) {
+  g_logger.SetRotation(max_size, interval, max_files);
+}
+
+void LogFlush() {
+  g_logger.Flush();
+}
 
-  auto now = system_clock::now();
-  std::time_t t = system_clock::to_time_t(now);
+std::uint64_t LogDropped() {
+  return g_logger.GetDropped();
+}
 
-  std::stringstream ss;
-  ss << std::put_time(std::localtime(&t), "%Y-%m-%d %H:%M:%S");
+void Log(int level, const char* file, int line, const char* format, ...) {
+  assert(format != nullptr);
 
-  milliseconds milli_seconds =
-      std::chrono::duration_cast<milliseconds>(now.time_since_epoch());
-  std::string micro_seconds_str = std::to_string(milli_seconds.count() % 1000);
-  while (micro_seconds_str.size() < 3) {
-    micro_seconds_str = "0" + micro_seconds_str;
+  if (!CheckLevel(level, file)) {
+    return;
   }
 
-  ss << "." << micro_seconds_str;
+  std::int64_t time = GetTime();
+  std::int64_t thread_id = GetThreadID();
 
-  return ss.str();
-}
+  if (g_logger.async) {
+    Ring* ring = GetRing();
+    if (ring != nullptr) {
+      thread_local char t_message[kMaxMessageSize];
 
-void Log(int level, const char* file, int line, const char* format, ...) {
-  assert(format != nullptr);
+      va_list args;
+      va_start(args, format);
+      int size = std::vsnprintf(t_message, sizeof(t_message), format, args);
+      va_end(args);
+
+      std::size_t length = 0;
+      if (size > 0) {
+        length = std::min(static_cast<std::size_t>(size),
+                          sizeof(t_message) - 1);
+      }
+
+      bool half_full = false;
+      ring->Push(level, file, line, time, thread_id, t_message, length,
+                 &half_full);
+      if (half_full) {
+        // A wake-up might be missed without the lock, no more than an
+        // interval is delayed then.
+        g_logger.woken = true;
+        g_logger.cv.notify_one();
+      }
+      return;
+    }
+  }
 
-  std::string timestamp = GetTimestamp();
-  std::string thread_id = GetThreadID();
+  char prefix[kPrefixSize];
+  FormatPrefix(prefix, level, file, line, time, thread_id);
 
-  if ((g_logger.modes & LOG_FILE) != 0 && g_logger.file != nullptr) {
+  if ((g_logger.modes & LOG_FILE) != 0) {
     std::lock_guard<std::mutex> lock(g_logger.mutex);
 
-    va_list args;
-    va_start(args, format);
+    g_logger.RotateIfNeeded(time);
 
-    fprintf(g_logger.file, "%s, %s, %7s, %20s, %4d, ",
-            timestamp.c_str(), kLevelNames[level], thread_id.c_str(),
-            file, line);
+    if (g_logger.file != nullptr) {
+      va_list args;
+      va_start(args, format);
 
-    vfprintf(g_logger.file, format, args);
+      int size = fprintf(g_logger.file, "%s", prefix);
 
-    fprintf(g_logger.file, "\n");
+      size += vfprintf(g_logger.file, format, args);
 
-    if ((g_logger.modes & LOG_FLUSH) != 0) {
-      fflush(g_logger.file);
-    }
+      size += fprintf(g_logger.file, "\n");
 
-    va_end(args);
+      if ((g_logger.modes & LOG_FLUSH) != 0) {
+        fflush(g_logger.file);
+      }
+
+      va_end(args);
+
+      if (size > 0) {
+        g_logger.size += size;
+      }
+    }
   }
 
   if ((g_logger.modes & LOG_CONSOLE) != 0) {
@@ -236,25 +1157,17 @@ void Log(int level, const char* file, int line, const char* format, ...) {
 
     if (g_terminal_has_color) {
       if (level < WEBCC_WARN) {
-        fprintf(stderr, "%s%s, %s, %7s, %20s, %4d, ",
-                TERM_RESET,
-                timestamp.c_str(), kLevelNames[level], thread_id.c_str(),
-                file, line);
+        fprintf(stderr, "%s%s", TERM_RESET, prefix);
       } else {
-        fprintf(stderr, "%s%s%s, %s, %7s, %20s, %4d, ",
-                TERM_RESET,
-                level == WEBCC_WARN ? TERM_YELLOW : TERM_RED,
-                timestamp.c_str(), kLevelNames[level], thread_id.c_str(),
-                file, line);
+        fprintf(stderr, "%s%s%s", TERM_RESET,
+                level == WEBCC_WARN ? TERM_YELLOW : TERM_RED, prefix);
       }
 
       vfprintf(stderr, format, args);
 
       fprintf(stderr, "%s\n", TERM_RESET);
     } else {
-      fprintf(stderr, "%s, %s, %7s, %20s, %4d, ",
-              timestamp.c_str(), kLevelNames[level], thread_id.c_str(),
-              file, line);
+      fputs(prefix, stderr);
 
       vfprintf(stderr, format, args);
 
@@ -6,8 +6,12 @@
 
 #if WEBCC_ENABLE_LOG
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>  // for strrchr()
 #include <string>
+#include <type_traits>
 
 // Avoid include <filesystem> in the header.
 namespace std {
@@ -26,11 +30,24 @@ class path;
 #define WEBCC_WARN 3
 #define WEBCC_ERRO 4
 
-// Default log level.
+// The logs below the min level are compiled out. All are compiled in by
+// default, so that they can be enabled at runtime without rebuilding.
+#ifndef WEBCC_LOG_MIN_LEVEL
+#define WEBCC_LOG_MIN_LEVEL WEBCC_VERB
+#endif
+
+// The default runtime log level, see LogSetLevel().
 #ifndef WEBCC_LOG_LEVEL
 #define WEBCC_LOG_LEVEL WEBCC_USER
 #endif
 
+// The runtime log level can't be lower than the min level.
+#if WEBCC_LOG_LEVEL < WEBCC_LOG_MIN_LEVEL
+#define WEBCC_LOG_DEFAULT_LEVEL WEBCC_LOG_MIN_LEVEL
+#else
+#define WEBCC_LOG_DEFAULT_LEVEL WEBCC_LOG_LEVEL
+#endif
+
 #define WEBCC_LOG_FILE_NAME "webcc.log"
 
 namespace webcc {
@@ -40,6 +57,7 @@ enum LogMode {
   LOG_CONSOLE     = 2,  // Log to console.
   LOG_FLUSH       = 4,  // Flush on each log.
   LOG_OVERWRITE   = 8,  // Overwrite any existing log file.
+  LOG_ASYNC       = 16, // Write from a background thread.
 };
 
 // Commonly used modes.
@@ -49,10 +67,77 @@ const int LOG_FILE_OVERWRITE = LOG_FILE | LOG_OVERWRITE;
 
 // Initialize logger.
 // If |dir| is empty, log file will be generated in current directory.
+// With LOG_ASYNC, each thread puts its logs into a lock-free ring buffer of
+// its own, and a background thread writes them out in batches. The logs are
+// dropped if the ring buffer is full, see LogDropped().
 void LogInit(const std::filesystem::path& dir, int modes);
 
+// Rotate the log file once it exceeds |max_size| bytes, and/or every
+// |interval| seconds (aligned to the local time, e.g., 86400 for daily at
+// midnight).
+// 0 disables either. The rotated files are renamed with the time, e.g.,
+// "webcc-20200101-120000-000.log", compressed by a background thread (if
+// WEBCC_ENABLE_GZIP), and only the last |max_files| are kept (0 for all).
+void LogSetRotation(std::uint64_t max_size, int interval, int max_files);
+
+// Wait until the logs so far have been written out.
+void LogFlush();
+
+// Number of the logs dropped because the ring buffer was full (LOG_ASYNC).
+std::uint64_t LogDropped();
+
+// Set the runtime log level of all the modules except those set separately.
+// Initially WEBCC_LOG_LEVEL. The logs below WEBCC_LOG_MIN_LEVEL have been
+// compiled out and can't be enabled.
+void LogSetLevel(int level);
+
+// Set the runtime log level of a module, i.e., the name of a source file
+// without the extension, e.g., "connection" for "connection.cc".
+void LogSetLevel(const std::string& module, int level);
+
+// Let the module follow the runtime log level of all the modules again.
+void LogResetLevel(const std::string& module);
+
+// Get the runtime log level of a module.
+int LogGetLevel(const std::string& module);
+
 void Log(int level, const char* file, int line, const char* format, ...);
 
+// -----------------------------------------------------------------------------
+
+// The modules are hashed into the slots. The level of a slot is the lowest
+// level of the modules hashed to it, so that a log site checks it with one
+// relaxed load, and Log() checks the level of the exact module if necessary.
+
+const std::size_t kLogSlots = 256;
+
+struct LogSlot {
+  std::atomic<int> level{ WEBCC_LOG_DEFAULT_LEVEL };
+};
+
+extern LogSlot g_log_slots[kLogSlots];
+
+// Hash the module of a source file (FNV-1a), e.g., "webcc/connection.cc" and
+// "connection" are hashed to the same slot.
+constexpr std::size_t LogHashModule(const char* file) {
+  const char* name = file;
+  for (const char* p = file; *p != '\0'; ++p) {
+    if (*p == '/' || *p == '\\') {
+      name = p + 1;
+    }
+  }
+
+  std::uint32_t hash = 2166136261u;
+  for (const char* p = name; *p != '\0' && *p != '.'; ++p) {
+    hash = (hash ^ static_cast<unsigned char>(*p)) * 16777619u;
+  }
+  return hash % kLogSlots;
+}
+
+inline bool LogEnabled(int level, std::size_t slot) {
+  return level >= g_log_slots[slot].level.load(std::memory_order_relaxed);
+}
+
 }  // namespace webcc
 
 // Initialize the logger with a level.
@@ -74,37 +159,43 @@ void Log(int level, const char* file, int line, const char* format, ...);
 
 #endif  // defined(_WIN32) || defined(_WIN64)
 
-#if WEBCC_LOG_LEVEL <= WEBCC_VERB
-#define LOG_VERB(format, ...) \
-  webcc::Log(WEBCC_VERB, __FILENAME__, __LINE__, format, ##__VA_ARGS__);
+// The slot of the current source file, computed at compile time.
+#define WEBCC_LOG_SLOT \
+  std::integral_constant<std::size_t, webcc::LogHashModule(__FILE__)>::value
+
+// The arguments are not evaluated if the level is disabled at runtime.
+// The empty if-branch avoids the dangling else.
+#define WEBCC_LOG(level, format, ...)                                 \
+  if (!webcc::LogEnabled(level, WEBCC_LOG_SLOT)) {                    \
+  } else                                                              \
+    webcc::Log(level, __FILENAME__, __LINE__, format, ##__VA_ARGS__);
+
+#if WEBCC_LOG_MIN_LEVEL <= WEBCC_VERB
+#define LOG_VERB(format, ...) WEBCC_LOG(WEBCC_VERB, format, ##__VA_ARGS__)
 #else
 #define LOG_VERB(format, ...)
 #endif
 
-#if WEBCC_LOG_LEVEL <= WEBCC_INFO
-#define LOG_INFO(format, ...) \
-  webcc::Log(WEBCC_INFO, __FILENAME__, __LINE__, format, ##__VA_ARGS__);
+#if WEBCC_LOG_MIN_LEVEL <= WEBCC_INFO
+#define LOG_INFO(format, ...) WEBCC_LOG(WEBCC_INFO, format, ##__VA_ARGS__)
 #else
 #define LOG_INFO(format, ...)
 #endif
 
-#if WEBCC_LOG_LEVEL <= WEBCC_USER
-#define LOG_USER(format, ...) \
-  webcc::Log(WEBCC_USER, __FILENAME__, __LINE__, format, ##__VA_ARGS__);
+#if WEBCC_LOG_MIN_LEVEL <= WEBCC_USER
+#define LOG_USER(format, ...) WEBCC_LOG(WEBCC_USER, format, ##__VA_ARGS__)
 #else
-#define LOG_INFO(format, ...)
+#define LOG_USER(format, ...)
 #endif
 
-#if WEBCC_LOG_LEVEL <= WEBCC_WARN
-#define LOG_WARN(format, ...) \
-  webcc::Log(WEBCC_WARN, __FILENAME__, __LINE__, format, ##__VA_ARGS__);
+#if WEBCC_LOG_MIN_LEVEL <= WEBCC_WARN
+#define LOG_WARN(format, ...) WEBCC_LOG(WEBCC_WARN, format, ##__VA_ARGS__)
 #else
 #define LOG_WARN(format, ...)
 #endif
 
-#if WEBCC_LOG_LEVEL <= WEBCC_ERRO
-#define LOG_ERRO(format, ...) \
-  webcc::Log(WEBCC_ERRO, __FILENAME__, __LINE__, format, ##__VA_ARGS__);
+#if WEBCC_LOG_MIN_LEVEL <= WEBCC_ERRO
+#define LOG_ERRO(format, ...) WEBCC_LOG(WEBCC_ERRO, format, ##__VA_ARGS__)
 #else
 #define LOG_ERRO(format, ...)
 #endif
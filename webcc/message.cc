@@ -11,6 +11,16 @@ namespace webcc {
 Message::Message() : body_(new Body{}), content_length_(kInvalidLength) {
 }
 
+void Message::Clear() {
+  body_.reset(new Body{});
+  headers_.Clear();
+  start_line_.clear();
+  content_length_ = kInvalidLength;
+  header_block_.clear();
+  extra_headers_pos_ = 0;
+  extra_headers_size_ = 0;
+}
+
 void Message::SetBody(BodyPtr body, bool set_length) {
   if (body == body_) {
     return;
@@ -94,24 +104,32 @@ void Message::SetContentType(const std::string& media_type,
   }
 }
 
-Payload Message::GetPayload() const {
-  using asio::buffer;
+Payload Message::GetPayload() {
+  std::size_t size = start_line_.size() + 4 + GetExtraHeadersSize();
+  for (const Header& h : headers_.data()) {
+    size += h.first.size() + h.second.size() + 4;
+  }
 
-  Payload payload;
+  header_block_.clear();
+  header_block_.reserve(size);
 
-  payload.push_back(buffer(start_line_));
-  payload.push_back(buffer(literal_buffers::CRLF));
+  header_block_ += start_line_;
+  header_block_ += kCRLF;
 
   for (const Header& h : headers_.data()) {
-    payload.push_back(buffer(h.first));
-    payload.push_back(buffer(literal_buffers::HEADER_SEPARATOR));
-    payload.push_back(buffer(h.second));
-    payload.push_back(buffer(literal_buffers::CRLF));
+    header_block_ += h.first;
+    header_block_ += ": ";
+    header_block_ += h.second;
+    header_block_ += kCRLF;
   }
 
-  payload.push_back(buffer(literal_buffers::CRLF));
+  extra_headers_pos_ = header_block_.size();
+  AppendExtraHeaders(&header_block_);
+  extra_headers_size_ = header_block_.size() - extra_headers_pos_;
 
-  return payload;
+  header_block_ += kCRLF;
+
+  return Payload{ asio::buffer(header_block_) };
 }
 
 void Message::Dump(std::ostream& os) const {
@@ -123,6 +141,15 @@ void Message::Dump(std::ostream& os) const {
     os << prefix << h.first << ": " << h.second << std::endl;
   }
 
+  // The extra headers as they have been rendered for sending, if any.
+  std::size_t begin = extra_headers_pos_;
+  std::size_t end = extra_headers_pos_ + extra_headers_size_;
+  while (begin < end) {
+    std::size_t eol = header_block_.find(kCRLF, begin);
+    os << prefix << header_block_.substr(begin, eol - begin) << std::endl;
+    begin = eol + 2;
+  }
+
   os << prefix << std::endl;
 
   body_->Dump(os, prefix);
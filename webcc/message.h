@@ -18,6 +18,9 @@ public:
 
   virtual ~Message() = default;
 
+  // Clear the message for reuse, the capacities of the strings are kept.
+  virtual void Clear();
+
   // ---------------------------------------------------------------------------
 
   void SetBody(BodyPtr body, bool set_length);
@@ -53,6 +56,14 @@ public:
     return headers_.Has(key);
   }
 
+  void RemoveHeader(const std::string& key) {
+    headers_.Remove(key);
+  }
+
+  const Headers& headers() const {
+    return headers_;
+  }
+
   // ---------------------------------------------------------------------------
 
   const std::string& start_line() const {
@@ -99,9 +110,10 @@ public:
   // Make the message complete in order to be sent.
   virtual void Prepare() = 0;
 
-  // Get the payload for the socket to write.
+  // Get the payload for the socket to write, i.e., the start line and the
+  // headers rendered into one buffer owned by the message.
   // This doesn't include the payload(s) of the body!
-  Payload GetPayload() const;
+  Payload GetPayload();
 
   // ---------------------------------------------------------------------------
 
@@ -112,6 +124,18 @@ public:
   std::string Dump() const;
 
 protected:
+  // The headers not kept in |headers_| but rendered into the header block on
+  // sending, e.g., the constant "Server: Webcc/0.3.0\r\n".
+
+  // The size of the lines appended by AppendExtraHeaders().
+  virtual std::size_t GetExtraHeadersSize() const {
+    return 0;
+  }
+
+  // Append the lines of the headers to |output|.
+  virtual void AppendExtraHeaders(std::string* /*output*/) const {
+  }
+
   BodyPtr body_;
 
   Headers headers_;
@@ -119,6 +143,14 @@ protected:
   std::string start_line_;
 
   std::size_t content_length_;
+
+  // The start line and the headers rendered for writing.
+  std::string header_block_;
+
+  // The range of the extra headers in |header_block_|, for dumping what has
+  // been sent.
+  std::size_t extra_headers_pos_ = 0;
+  std::size_t extra_headers_size_ = 0;
 };
 
 }  // namespace webcc
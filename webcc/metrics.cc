@@ -0,0 +1,467 @@
+#include "webcc/metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "webcc/globals.h"
+
+namespace webcc {
+
+namespace {
+
+// The upper bounds (in seconds) of the histogram buckets exported.
+const double kExportBuckets[] = {
+  0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25,
+  0.5, 1, 2.5, 5, 10
+};
+
+// Index of the most significant bit.
+int GetMsb(std::uint64_t value) {
+  int msb = 0;
+  for (int shift = 32; shift > 0; shift /= 2) {
+    if (value >> shift) {
+      value >>= shift;
+      msb += shift;
+    }
+  }
+  return msb;
+}
+
+// Escape a label value: backslash, double-quote and line feed.
+void AppendLabelValue(const std::string& value, std::string* output) {
+  for (char c : value) {
+    if (c == '\\' || c == '"') {
+      output->push_back('\\');
+      output->push_back(c);
+    } else if (c == '\n') {
+      output->append("\\n");
+    } else {
+      output->push_back(c);
+    }
+  }
+}
+
+std::string RenderLabels(const MetricLabels& labels) {
+  std::string output;
+  for (auto& label : labels) {
+    if (!output.empty()) {
+      output.push_back(',');
+    }
+    output.append(label.first);
+    output.append("=\"");
+    AppendLabelValue(label.second, &output);
+    output.push_back('"');
+  }
+  return output;
+}
+
+// Append a sample, e.g., `name{labels} value`.
+// |extra| is an extra label rendered, e.g., `le="0.1"`.
+void AppendSample(const std::string& name, const std::string& labels,
+                  const std::string& extra, const std::string& value,
+                  std::string* output) {
+  output->append(name);
+  if (!labels.empty() || !extra.empty()) {
+    output->push_back('{');
+    output->append(labels);
+    if (!labels.empty() && !extra.empty()) {
+      output->push_back(',');
+    }
+    output->append(extra);
+    output->push_back('}');
+  }
+  output->push_back(' ');
+  output->append(value);
+  output->push_back('\n');
+}
+
+std::string FormatDouble(double value) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%.6g", value);
+  return buf;
+}
+
+// The label values of the error codes, indexed by Error::Code + 1.
+// No counter for kOK.
+const char* const kErrorNames[] = {
+  "unknown", nullptr, "syntax", "resolve", "connect", "read", "write", "parse",
+  "file", "data"
+};
+
+static_assert(sizeof(kErrorNames) / sizeof(kErrorNames[0]) ==
+                  HostMetrics::kErrorCodes,
+              "error names mismatch");
+
+}  // namespace
+
+// -----------------------------------------------------------------------------
+
+std::uint64_t Counter::Value() const {
+  std::uint64_t value = 0;
+  for (auto& shard : shards_) {
+    value += shard.value.load(std::memory_order_relaxed);
+  }
+  return value;
+}
+
+std::size_t Counter::GetShard() {
+  static std::atomic<std::size_t> s_next{ 0 };
+  thread_local std::size_t t_shard =
+      s_next.fetch_add(1, std::memory_order_relaxed) % kShards;
+  return t_shard;
+}
+
+// -----------------------------------------------------------------------------
+
+void Histogram::Record(std::uint64_t us) {
+  buckets_[GetIndex(us)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(us, std::memory_order_relaxed);
+}
+
+std::uint64_t Histogram::Percentile(double percentile) const {
+  std::uint64_t count = Count();
+  if (count == 0) {
+    return 0;
+  }
+
+  auto rank = static_cast<std::uint64_t>(percentile / 100.0 * count + 0.5);
+  if (rank == 0) {
+    rank = 1;
+  }
+
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < kBuckets; ++i) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      return GetUpperBound(i);
+    }
+  }
+
+  // Recorded since the count was loaded.
+  return GetUpperBound(kBuckets - 1);
+}
+
+std::uint64_t Histogram::CountBelow(std::uint64_t us) const {
+  std::uint64_t count = 0;
+  for (std::size_t i = 0; i < kBuckets && GetUpperBound(i) <= us; ++i) {
+    count += buckets_[i].load(std::memory_order_relaxed);
+  }
+  return count;
+}
+
+std::size_t Histogram::GetIndex(std::uint64_t us) {
+  if (us < kSubBuckets) {
+    return static_cast<std::size_t>(us);
+  }
+
+  // E.g., with 4 sub-bucket bits, 16..31 are in buckets 16..31, 32..63 in
+  // buckets 32..47 (two values per bucket), and so on.
+  int msb = GetMsb(us);
+  int shift = msb - kSubBucketBits;
+  std::size_t sub = static_cast<std::size_t>(us >> shift) - kSubBuckets;
+  std::size_t index = (shift + 1) * kSubBuckets + sub;
+
+  return index < kBuckets ? index : kBuckets - 1;
+}
+
+std::uint64_t Histogram::GetUpperBound(std::size_t index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+
+  if (index == kBuckets - 1) {
+    return UINT64_MAX;
+  }
+
+  int shift = static_cast<int>(index / kSubBuckets) - 1;
+  std::uint64_t sub = index % kSubBuckets;
+  std::uint64_t lower = (kSubBuckets + sub) << shift;
+  return lower + (std::uint64_t(1) << shift) - 1;
+}
+
+// -----------------------------------------------------------------------------
+
+MetricsRegistry::Family* MetricsRegistry::GetFamily(const std::string& name,
+                                                    const std::string& help,
+                                                    Type type) {
+  auto it = families_.find(name);
+  if (it == families_.end()) {
+    it = families_.emplace(name, Family{}).first;
+    it->second.help = help;
+    it->second.type = type;
+  }
+
+  // A name is only for one type of metrics.
+  return it->second.type == type ? &it->second : nullptr;
+}
+
+Counter* MetricsRegistry::GetCounter(const std::string& name,
+                                     const std::string& help,
+                                     const MetricLabels& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  Family* family = GetFamily(name, help, Type::kCounter);
+  if (family == nullptr) {
+    return nullptr;
+  }
+
+  auto& counter = family->counters[RenderLabels(labels)];
+  if (!counter) {
+    counter.reset(new Counter);
+  }
+  return counter.get();
+}
+
+Gauge* MetricsRegistry::GetGauge(const std::string& name,
+                                 const std::string& help,
+                                 const MetricLabels& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  Family* family = GetFamily(name, help, Type::kGauge);
+  if (family == nullptr) {
+    return nullptr;
+  }
+
+  auto& gauge = family->gauges[RenderLabels(labels)];
+  if (!gauge) {
+    gauge.reset(new Gauge);
+  }
+  return gauge.get();
+}
+
+Histogram* MetricsRegistry::GetHistogram(const std::string& name,
+                                         const std::string& help,
+                                         const MetricLabels& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  Family* family = GetFamily(name, help, Type::kHistogram);
+  if (family == nullptr) {
+    return nullptr;
+  }
+
+  auto& histogram = family->histograms[RenderLabels(labels)];
+  if (!histogram) {
+    histogram.reset(new Histogram);
+  }
+  return histogram.get();
+}
+
+void MetricsRegistry::SetGaugeCallback(const std::string& name,
+                                       const std::string& help,
+                                       std::function<std::int64_t()> callback,
+                                       const MetricLabels& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  Family* family = GetFamily(name, help, Type::kGauge);
+  if (family != nullptr) {
+    family->callbacks[RenderLabels(labels)] = std::move(callback);
+  }
+}
+
+std::string MetricsRegistry::Export() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  std::string output;
+
+  for (auto& pair : families_) {
+    const std::string& name = pair.first;
+    const Family& family = pair.second;
+
+    output.append("# HELP " + name + " " + family.help + "\n");
+
+    if (family.type == Type::kCounter) {
+      output.append("# TYPE " + name + " counter\n");
+      for (auto& c : family.counters) {
+        AppendSample(name, c.first, "", std::to_string(c.second->Value()),
+                     &output);
+      }
+    } else if (family.type == Type::kGauge) {
+      output.append("# TYPE " + name + " gauge\n");
+      for (auto& g : family.gauges) {
+        AppendSample(name, g.first, "", std::to_string(g.second->Value()),
+                     &output);
+      }
+      for (auto& c : family.callbacks) {
+        AppendSample(name, c.first, "", std::to_string(c.second()), &output);
+      }
+    } else {
+      output.append("# TYPE " + name + " histogram\n");
+      for (auto& h : family.histograms) {
+        const Histogram& histogram = *h.second;
+
+        // The buckets might be ahead of the count when being recorded.
+        std::uint64_t count = histogram.Count();
+
+        for (double le : kExportBuckets) {
+          auto us = static_cast<std::uint64_t>(le * 1000000 + 0.5);
+          std::uint64_t below = std::min(histogram.CountBelow(us), count);
+          AppendSample(name + "_bucket", h.first,
+                       "le=\"" + FormatDouble(le) + "\"",
+                       std::to_string(below), &output);
+        }
+
+        AppendSample(name + "_bucket", h.first, "le=\"+Inf\"",
+                     std::to_string(count), &output);
+        AppendSample(name + "_sum", h.first, "",
+                     FormatDouble(histogram.Sum() / 1000000.0), &output);
+        AppendSample(name + "_count", h.first, "", std::to_string(count),
+                     &output);
+      }
+    }
+  }
+
+  return output;
+}
+
+// -----------------------------------------------------------------------------
+
+RouteMetrics::RouteMetrics(MetricsRegistry* registry, const std::string& route)
+    : registry_(registry), route_(route) {
+  latency_ = registry_->GetHistogram(
+      "webcc_route_handle_seconds",
+      "Time spent in handling the requests, by route.",
+      { { "route", route_ } });
+}
+
+void RouteMetrics::Record(int status,
+                          std::chrono::steady_clock::duration duration) {
+  latency_->Record(duration);
+
+  if (status < 0 || status >= kMaxStatus) {
+    status = 0;
+  }
+
+  Counter* counter = counters_[status].load(std::memory_order_acquire);
+  if (counter == nullptr) {
+    // The registry returns the same counter if registered concurrently.
+    counter = registry_->GetCounter(
+        "webcc_requests_total", "Requests handled, by route and status code.",
+        { { "route", route_ }, { "code", std::to_string(status) } });
+    counters_[status].store(counter, std::memory_order_release);
+  }
+
+  counter->Add();
+}
+
+// -----------------------------------------------------------------------------
+
+ServerMetrics::ServerMetrics(MetricsRegistry* registry) {
+  connections_total = registry->GetCounter(
+      "webcc_connections_total", "Connections accepted.");
+  connections_rejected = registry->GetCounter(
+      "webcc_connections_rejected_total",
+      "Connections rejected for the connection limit.");
+  requests_rejected = registry->GetCounter(
+      "webcc_requests_rejected_total",
+      "Requests rejected for the concurrency limit.");
+  requests_invalid = registry->GetCounter(
+      "webcc_requests_invalid_total",
+      "Requests failed to parse or matching no view.");
+  queue_wait = registry->GetHistogram(
+      "webcc_queue_wait_seconds",
+      "Time the requests waited in the queue for the workers.");
+  request_read = registry->GetHistogram(
+      "webcc_request_read_seconds",
+      "Time from the first byte of a request to its end.");
+  request_parse = registry->GetHistogram(
+      "webcc_request_parse_seconds", "Time spent in parsing the requests.");
+  response_write = registry->GetHistogram(
+      "webcc_response_write_seconds", "Time spent in writing the responses.");
+  bytes_in = registry->GetCounter("webcc_received_bytes_total",
+                                  "Bytes received.");
+  bytes_out = registry->GetCounter("webcc_sent_bytes_total", "Bytes sent.");
+}
+
+// -----------------------------------------------------------------------------
+
+HostMetrics::HostMetrics(MetricsRegistry* registry, const std::string& host) {
+  const MetricLabels labels{ { "host", host } };
+
+  resolve = registry->GetHistogram(
+      "webcc_client_resolve_seconds", "Time spent in resolving the host.",
+      labels);
+  connect = registry->GetHistogram(
+      "webcc_client_connect_seconds", "Time spent in connecting to the host.",
+      labels);
+  handshake = registry->GetHistogram(
+      "webcc_client_handshake_seconds", "Time spent in the SSL handshake.",
+      labels);
+  first_byte = registry->GetHistogram(
+      "webcc_client_first_byte_seconds",
+      "Time from sending a request to the first byte of the response.",
+      labels);
+  total = registry->GetHistogram(
+      "webcc_client_request_seconds", "Time of the requests succeeded.",
+      labels);
+  pool_hits = registry->GetCounter(
+      "webcc_client_pool_hits_total",
+      "Requests sent with a pooled connection.", labels);
+  pool_misses = registry->GetCounter(
+      "webcc_client_pool_misses_total",
+      "Requests sent with a new connection.", labels);
+  retries = registry->GetCounter(
+      "webcc_client_retries_total",
+      "Requests sent again once the pooled connection was found closed.",
+      labels);
+  timeouts = registry->GetCounter(
+      "webcc_client_timeouts_total", "Requests timed out.", labels);
+  bytes_in = registry->GetCounter(
+      "webcc_client_received_bytes_total", "Bytes received.", labels);
+  bytes_out = registry->GetCounter(
+      "webcc_client_sent_bytes_total", "Bytes sent.", labels);
+
+  for (std::size_t i = 0; i < kErrorCodes; ++i) {
+    errors[i] = nullptr;
+    if (kErrorNames[i] != nullptr) {
+      errors[i] = registry->GetCounter(
+          "webcc_client_errors_total", "Requests failed, by error.",
+          { { "host", host }, { "error", kErrorNames[i] } });
+    }
+  }
+}
+
+void HostMetrics::AddError(const Error& error) {
+  std::size_t index = static_cast<std::size_t>(error.code() + 1);
+  if (index < kErrorCodes && errors[index] != nullptr) {
+    errors[index]->Add();
+  }
+
+  if (error.timeout()) {
+    timeouts->Add();
+  }
+}
+
+double HostMetrics::GetReuseRatio() const {
+  std::uint64_t hits = pool_hits->Value();
+  std::uint64_t count = hits + pool_misses->Value();
+  return count == 0 ? 0.0 : static_cast<double>(hits) / count;
+}
+
+// -----------------------------------------------------------------------------
+
+ClientMetrics::ClientMetrics(MetricsRegistry* registry)
+    : registry_(registry) {
+}
+
+HostMetrics* ClientMetrics::GetHost(const std::string& host) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto& metrics = hosts_[host];
+  if (!metrics) {
+    metrics.reset(new HostMetrics{ registry_, host });
+  }
+  return metrics.get();
+}
+
+std::vector<std::string> ClientMetrics::GetHosts() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  std::vector<std::string> hosts;
+  for (auto& pair : hosts_) {
+    hosts.push_back(pair.first);
+  }
+  return hosts;
+}
+
+}  // namespace webcc
@@ -0,0 +1,322 @@
+#ifndef WEBCC_METRICS_H_
+#define WEBCC_METRICS_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace webcc {
+
+class Error;
+
+// Metrics for monitoring, exported in the Prometheus text format (see
+// MetricsView). Updating a metric is lock-free, while registering one takes
+// a lock, so register the metrics beforehand and keep the pointers.
+
+// The labels of a metric, e.g., { { "route", "/books" }, { "code", "200" } }.
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+// A counter sharded by threads, so that the threads updating it don't contend
+// for the same cache line.
+class Counter {
+public:
+  Counter() = default;
+
+  Counter(const Counter&) = delete;
+  Counter& operator=(const Counter&) = delete;
+
+  void Add(std::uint64_t n = 1) {
+    shards_[GetShard()].value.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  std::uint64_t Value() const;
+
+private:
+  static const std::size_t kShards = 16;
+
+  // The shard of the current thread.
+  static std::size_t GetShard();
+
+  struct alignas(64) Shard {
+    std::atomic<std::uint64_t> value{ 0 };
+  };
+
+  std::array<Shard, kShards> shards_;
+};
+
+// A value which goes up and down, e.g., the number of active connections.
+class Gauge {
+public:
+  Gauge() = default;
+
+  Gauge(const Gauge&) = delete;
+  Gauge& operator=(const Gauge&) = delete;
+
+  void Add(std::int64_t n = 1) {
+    value_.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  void Sub(std::int64_t n = 1) {
+    value_.fetch_sub(n, std::memory_order_relaxed);
+  }
+
+  void Set(std::int64_t value) {
+    value_.store(value, std::memory_order_relaxed);
+  }
+
+  std::int64_t Value() const {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<std::int64_t> value_{ 0 };
+};
+
+// A histogram of durations in microseconds, with log-linear buckets like
+// HdrHistogram: each power of two is divided into kSubBuckets buckets, so a
+// value is recorded with a relative error below 1/kSubBuckets (~6%), from
+// 1 microsecond up to days, in a fixed array of counters.
+class Histogram {
+public:
+  Histogram() = default;
+
+  Histogram(const Histogram&) = delete;
+  Histogram& operator=(const Histogram&) = delete;
+
+  void Record(std::uint64_t us);
+
+  void Record(std::chrono::steady_clock::duration duration) {
+    auto us =
+        std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    Record(static_cast<std::uint64_t>(us < 0 ? 0 : us));
+  }
+
+  std::uint64_t Count() const {
+    return count_.load(std::memory_order_relaxed);
+  }
+
+  // Sum of the values recorded, in microseconds.
+  std::uint64_t Sum() const {
+    return sum_.load(std::memory_order_relaxed);
+  }
+
+  // The value (in microseconds) at the given percentile, e.g., 99.9.
+  // It's the upper bound of the bucket, i.e., never under-estimated.
+  std::uint64_t Percentile(double percentile) const;
+
+  // The count of the values not greater than |us|, as far as the buckets
+  // could tell, i.e., the buckets whose upper bound is not greater than it.
+  std::uint64_t CountBelow(std::uint64_t us) const;
+
+private:
+  static const int kSubBucketBits = 4;
+  static const std::size_t kSubBuckets = 1 << kSubBucketBits;
+
+  // Enough for 2^40 microseconds (~12 days), larger values are put into the
+  // last bucket.
+  static const std::size_t kBuckets = (40 - kSubBucketBits + 1) * kSubBuckets;
+
+  static std::size_t GetIndex(std::uint64_t us);
+
+  // The largest value of the bucket.
+  static std::uint64_t GetUpperBound(std::size_t index);
+
+  std::array<std::atomic<std::uint64_t>, kBuckets> buckets_{};
+  std::atomic<std::uint64_t> count_{ 0 };
+  std::atomic<std::uint64_t> sum_{ 0 };
+};
+
+// -----------------------------------------------------------------------------
+
+class MetricsRegistry {
+public:
+  MetricsRegistry() = default;
+
+  MetricsRegistry(const MetricsRegistry&) = delete;
+  MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+  // Get or register a metric by name and labels.
+  // The name should follow the Prometheus conventions, e.g.,
+  // "webcc_requests_total" for a counter, "webcc_request_seconds" for a
+  // histogram. The returned metric lives as long as the registry.
+  Counter* GetCounter(const std::string& name, const std::string& help,
+                      const MetricLabels& labels = {});
+
+  Gauge* GetGauge(const std::string& name, const std::string& help,
+                  const MetricLabels& labels = {});
+
+  Histogram* GetHistogram(const std::string& name, const std::string& help,
+                          const MetricLabels& labels = {});
+
+  // Register a gauge whose value is got from |callback| on export, e.g., the
+  // size of a container which is known anyway.
+  // The callback is called with the lock of the registry held.
+  void SetGaugeCallback(const std::string& name, const std::string& help,
+                        std::function<std::int64_t()> callback,
+                        const MetricLabels& labels = {});
+
+  // Export all the metrics in the Prometheus text format (version 0.0.4).
+  // The histograms are exported in seconds.
+  std::string Export() const;
+
+private:
+  enum class Type { kCounter, kGauge, kHistogram };
+
+  struct Family {
+    std::string help;
+    Type type;
+
+    // Rendered labels, e.g., `route="/books",code="200"`, and the metric.
+    std::map<std::string, std::unique_ptr<Counter>> counters;
+    std::map<std::string, std::unique_ptr<Gauge>> gauges;
+    std::map<std::string, std::function<std::int64_t()>> callbacks;
+    std::map<std::string, std::unique_ptr<Histogram>> histograms;
+  };
+
+  Family* GetFamily(const std::string& name, const std::string& help,
+                    Type type);
+
+  std::map<std::string, Family> families_;
+
+  mutable std::mutex mutex_;
+};
+
+// -----------------------------------------------------------------------------
+
+// The metrics of the requests matching a route, i.e., the count by status
+// code and the latency of the handling.
+class RouteMetrics {
+public:
+  RouteMetrics(MetricsRegistry* registry, const std::string& route);
+
+  RouteMetrics(const RouteMetrics&) = delete;
+  RouteMetrics& operator=(const RouteMetrics&) = delete;
+
+  void Record(int status, std::chrono::steady_clock::duration duration);
+
+private:
+  MetricsRegistry* registry_;
+  std::string route_;
+
+  Histogram* latency_;
+
+  // The counters by status code, registered on the first request of a code.
+  static const int kMaxStatus = 600;
+  std::array<std::atomic<Counter*>, kMaxStatus> counters_{};
+};
+
+using RouteMetricsPtr = std::shared_ptr<RouteMetrics>;
+
+// -----------------------------------------------------------------------------
+
+// The metrics of a server updated on the way of the requests.
+// The active connections and the queue depth are got from the server on
+// export, see Server::metrics().
+struct ServerMetrics {
+  explicit ServerMetrics(MetricsRegistry* registry);
+
+  Counter* connections_total;
+  Counter* connections_rejected;
+
+  // The requests rejected by the concurrency limiter.
+  Counter* requests_rejected;
+
+  // The requests failed to parse, or matching no view, i.e., answered with
+  // Bad Request before being queued.
+  Counter* requests_invalid;
+
+  // How long the requests waited in the queue.
+  Histogram* queue_wait;
+
+  // From the first byte to the end of a request.
+  Histogram* request_read;
+
+  // The time spent in parsing a request.
+  Histogram* request_parse;
+
+  // From the start of writing a response to the end.
+  Histogram* response_write;
+
+  Counter* bytes_in;
+  Counter* bytes_out;
+};
+
+// -----------------------------------------------------------------------------
+
+// The metrics of the requests from the client sessions to a host.
+// The histograms and counters could also be read in process, e.g., to find
+// out the slow backend.
+struct HostMetrics {
+  HostMetrics(MetricsRegistry* registry, const std::string& host);
+
+  // Count an error by its code, and the timeout.
+  void AddError(const Error& error);
+
+  // The ratio of the requests sent with a pooled (keep-alive) connection.
+  double GetReuseRatio() const;
+
+  // The time to resolve the host, to connect to an endpoint, and of the SSL
+  // handshake, for new connections.
+  Histogram* resolve;
+  Histogram* connect;
+  Histogram* handshake;
+
+  // From the start of writing a request to the first byte of the response.
+  Histogram* first_byte;
+
+  // The whole time of the requests succeeded, including the retry.
+  Histogram* total;
+
+  Counter* pool_hits;
+  Counter* pool_misses;
+
+  // The requests sent again with a new connection, once the reused one was
+  // found closed by the server.
+  Counter* retries;
+
+  Counter* timeouts;
+
+  Counter* bytes_in;
+  Counter* bytes_out;
+
+  // The requests failed, by the code of the error (Error::Code + 1).
+  static const std::size_t kErrorCodes = 10;
+  std::array<Counter*, kErrorCodes> errors;
+};
+
+// The metrics of the client sessions, by host. Share one among the sessions
+// of the threads (see ClientSession::set_metrics()), and export them with
+// the registry, e.g., by a MetricsView.
+class ClientMetrics {
+public:
+  explicit ClientMetrics(MetricsRegistry* registry);
+
+  ClientMetrics(const ClientMetrics&) = delete;
+  ClientMetrics& operator=(const ClientMetrics&) = delete;
+
+  // Get the metrics of a host, e.g., "example.com:443", registered on the
+  // first call.
+  HostMetrics* GetHost(const std::string& host);
+
+  // The hosts requested so far.
+  std::vector<std::string> GetHosts() const;
+
+private:
+  MetricsRegistry* registry_;
+
+  std::map<std::string, std::unique_ptr<HostMetrics>> hosts_;
+
+  mutable std::mutex mutex_;
+};
+
+}  // namespace webcc
+
+#endif  // WEBCC_METRICS_H_
@@ -0,0 +1,22 @@
+#include "webcc/metrics_view.h"
+
+#include "webcc/response_builder.h"
+
+namespace webcc {
+
+ResponsePtr MetricsView::Handle(RequestPtr request) {
+  ResponseBuilder builder{ request };
+
+  builder.OK()
+      .Body(registry_->Export())
+      .MediaType("text/plain; version=0.0.4")
+      .Utf8();
+
+#if WEBCC_ENABLE_GZIP
+  builder.Gzip();
+#endif
+
+  return builder();
+}
+
+}  // namespace webcc
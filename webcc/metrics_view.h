@@ -0,0 +1,26 @@
+#ifndef WEBCC_METRICS_VIEW_H_
+#define WEBCC_METRICS_VIEW_H_
+
+#include "webcc/metrics.h"
+#include "webcc/view.h"
+
+namespace webcc {
+
+// A view exporting the metrics in the Prometheus text format. E.g.,
+//   server.Route("/metrics",
+//                std::make_shared<MetricsView>(&server.metrics()));
+class MetricsView : public View {
+public:
+  // |registry| is not copied, it must outlive the view.
+  explicit MetricsView(const MetricsRegistry* registry) : registry_(registry) {
+  }
+
+  ResponsePtr Handle(RequestPtr request) override;
+
+private:
+  const MetricsRegistry* registry_;
+};
+
+}  // namespace webcc
+
+#endif  // WEBCC_METRICS_VIEW_H_
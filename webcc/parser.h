@@ -103,6 +103,10 @@ public:
     return finished_;
   }
 
+  bool header_ended() const {
+    return header_ended_;
+  }
+
   bool Parse(const char* data, std::size_t length);
 
 protected:
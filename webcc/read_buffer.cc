@@ -0,0 +1,135 @@
+#include "webcc/read_buffer.h"
+
+#include "webcc/globals.h"
+
+namespace webcc {
+
+BufferPool& BufferPool::Instance() {
+  // Never destroyed, the buffers might be released on the exit.
+  static BufferPool* pool = new BufferPool;
+  return *pool;
+}
+
+BufferPool::BufferPool() {
+  std::size_t count = 0;
+  for (std::size_t size = kBufferSize; size <= kMaxBufferSize; size *= 2) {
+    ++count;
+  }
+  free_lists_.resize(count);
+}
+
+std::size_t BufferPool::RoundUp(std::size_t size) {
+  if (size > kMaxBufferSize) {
+    return size;
+  }
+
+  std::size_t rounded = kBufferSize;
+  while (rounded < size) {
+    rounded *= 2;
+  }
+  return rounded;
+}
+
+int BufferPool::GetIndex(std::size_t size) {
+  int index = 0;
+  for (std::size_t s = kBufferSize; s <= kMaxBufferSize; s *= 2, ++index) {
+    if (s == size) {
+      return index;
+    }
+  }
+  return -1;
+}
+
+char* BufferPool::Allocate(std::size_t size) {
+  int index = GetIndex(size);
+
+  if (index >= 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto& free_list = free_lists_[index];
+    if (!free_list.empty()) {
+      char* data = free_list.back();
+      free_list.pop_back();
+      return data;
+    }
+  }
+
+  return new char[size];
+}
+
+void BufferPool::Free(char* data, std::size_t size) {
+  int index = GetIndex(size);
+
+  if (index >= 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto& free_list = free_lists_[index];
+    if ((free_list.size() + 1) * size <= kMaxPooledBytes) {
+      free_list.push_back(data);
+      return;
+    }
+  }
+
+  delete[] data;
+}
+
+std::size_t BufferPool::GetFreeCount(std::size_t size) {
+  int index = GetIndex(size);
+  if (index < 0) {
+    return 0;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  return free_lists_[index].size();
+}
+
+// -----------------------------------------------------------------------------
+
+ReadBuffer::ReadBuffer(std::size_t min_size)
+    : size_(BufferPool::RoundUp(min_size)), min_size_(size_) {
+}
+
+ReadBuffer::~ReadBuffer() {
+  Release();
+}
+
+void ReadBuffer::set_min_size(std::size_t min_size) {
+  min_size_ = BufferPool::RoundUp(min_size);
+
+  if (data_ == nullptr || size_ < min_size_) {
+    Release();
+  }
+}
+
+asio::mutable_buffer ReadBuffer::Prepare() {
+  if (filled_ && data_ != nullptr && size_ < kMaxBufferSize) {
+    // The last read filled up the buffer, more data is probably coming.
+    BufferPool::Instance().Free(data_, size_);
+    data_ = nullptr;
+    size_ *= 2;
+  }
+
+  filled_ = false;
+
+  if (data_ == nullptr) {
+    data_ = BufferPool::Instance().Allocate(size_);
+  }
+
+  return asio::buffer(data_, size_);
+}
+
+void ReadBuffer::Commit(std::size_t length) {
+  filled_ = (length == size_);
+}
+
+void ReadBuffer::Release() {
+  if (data_ != nullptr) {
+    BufferPool::Instance().Free(data_, size_);
+    data_ = nullptr;
+  }
+
+  size_ = min_size_;
+  filled_ = false;
+}
+
+}  // namespace webcc
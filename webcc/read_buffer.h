@@ -0,0 +1,109 @@
+#ifndef WEBCC_READ_BUFFER_H_
+#define WEBCC_READ_BUFFER_H_
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "asio/buffer.hpp"
+
+namespace webcc {
+
+// A pool of the read buffers, in size classes of the powers of two from
+// kBufferSize to kMaxBufferSize. The buffers freed are kept in the free list
+// of the size class for reuse, up to kMaxPooledBytes per class.
+class BufferPool {
+public:
+  static BufferPool& Instance();
+
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  // Round the size up to the size class. The sizes beyond kMaxBufferSize are
+  // not pooled and returned as is.
+  static std::size_t RoundUp(std::size_t size);
+
+  // |size| must be a size class returned by RoundUp().
+  char* Allocate(std::size_t size);
+  void Free(char* data, std::size_t size);
+
+  // Number of the buffers in the free list of the size class.
+  std::size_t GetFreeCount(std::size_t size);
+
+private:
+  BufferPool();
+
+  // Index of the size class, or -1 if it's not pooled.
+  static int GetIndex(std::size_t size);
+
+  std::vector<std::vector<char*>> free_lists_;
+
+  std::mutex mutex_;
+};
+
+// -----------------------------------------------------------------------------
+
+// The buffer for reading from a socket, allocated from the BufferPool on
+// demand.
+// It doubles (up to kMaxBufferSize) when a read fills it up, so that a large
+// body takes fewer reads, and should be released back to the pool when the
+// connection goes idle, so that an idle connection doesn't pin a buffer.
+// Usage:
+//   socket.async_read_some(buffer.Prepare(), handler);
+//   ...
+//   buffer.Commit(length);
+//   Parse(buffer.data(), length);
+class ReadBuffer {
+public:
+  // |min_size| is the initial size, which the buffer shrinks to once released.
+  explicit ReadBuffer(std::size_t min_size);
+
+  ~ReadBuffer();
+
+  ReadBuffer(const ReadBuffer&) = delete;
+  ReadBuffer& operator=(const ReadBuffer&) = delete;
+
+  void set_min_size(std::size_t min_size);
+
+  // Get the buffer to read into, allocated or grown if necessary.
+  // The data of the last read is invalidated.
+  asio::mutable_buffer Prepare();
+
+  // |length| bytes have been read into the buffer.
+  void Commit(std::size_t length);
+
+  const char* data() const {
+    return data_;
+  }
+
+  std::size_t size() const {
+    return size_;
+  }
+
+  // Is no buffer held?
+  bool empty() const {
+    return data_ == nullptr;
+  }
+
+  // Is the buffer filled up by the last read?
+  bool filled() const {
+    return filled_;
+  }
+
+  // Give the buffer back to the pool and shrink to the min size.
+  void Release();
+
+private:
+  char* data_ = nullptr;
+
+  // Size of the buffer held, or to allocate next time.
+  std::size_t size_;
+
+  std::size_t min_size_;
+
+  bool filled_ = false;
+};
+
+}  // namespace webcc
+
+#endif  // WEBCC_READ_BUFFER_H_
@@ -2,6 +2,40 @@
 
 namespace webcc {
 
+Request::Request(const Request& rhs)
+    : Message(rhs), method_(rhs.method_), url_(rhs.url_), args_(rhs.args_),
+      ip_(rhs.ip_), queued_time_(rhs.queued_time_), span_(rhs.span_),
+      arena_(rhs.arena_) {
+  query_.Parse(url_.query_view());
+}
+
+Request& Request::operator=(const Request& rhs) {
+  if (&rhs != this) {
+    Message::operator=(rhs);
+    method_ = rhs.method_;
+    url_ = rhs.url_;
+    query_.Parse(url_.query_view());
+    args_ = rhs.args_;
+    ip_ = rhs.ip_;
+    queued_time_ = rhs.queued_time_;
+    span_ = rhs.span_;
+    arena_ = rhs.arena_;
+  }
+  return *this;
+}
+
+void Request::Clear() {
+  Message::Clear();
+
+  method_.clear();
+  url_.Clear();
+  query_.Clear();
+  args_.clear();
+  ip_.clear();
+  queued_time_ = {};
+  span_.reset();
+}
+
 bool Request::IsForm() const {
   return !!std::dynamic_pointer_cast<FormBody>(body_);
 }
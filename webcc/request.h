@@ -1,11 +1,15 @@
 #ifndef WEBCC_REQUEST_H_
 #define WEBCC_REQUEST_H_
 
+#include <chrono>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "webcc/arena.h"
 #include "webcc/message.h"
+#include "webcc/trace.h"
 #include "webcc/url.h"
 
 namespace webcc {
@@ -17,8 +21,15 @@ public:
   explicit Request(const std::string& method) : method_(method) {
   }
 
+  // The query parameters of the copy view its own URL.
+  Request(const Request& rhs);
+  Request& operator=(const Request& rhs);
+
   ~Request() override = default;
 
+  // Clear the request for reuse except the arena.
+  void Clear() override;
+
   const std::string& method() const {
     return method_;
   }
@@ -33,18 +44,28 @@ public:
 
   void set_url(Url&& url) {
     url_ = std::move(url);
+    query_.Parse(url_.query_view());
+  }
+
+  // Parse the URL, reusing the buffer of the current one.
+  void set_url(std::string_view url) {
+    url_.Parse(url);
+    query_.Parse(url_.query_view());
   }
 
-  const std::string& host() const {
+  std::string host() const {
     return url_.host();
   }
 
-  const std::string& port() const {
+  std::string port() const {
     return url_.port();
   }
 
-  UrlQuery query() const {
-    return UrlQuery(url_.query());
+  // The query parameters as views of the URL, parsed once the URL is set.
+  // Use UrlQuery for a copy to modify, e.g.,
+  //   UrlQuery{ std::string{ request->url().query_view() } }
+  const UrlQueryView& query() const {
+    return query_;
   }
 
   const UrlArgs& args() const {
@@ -63,6 +84,34 @@ public:
     ip_ = ip;
   }
 
+  std::chrono::steady_clock::time_point queued_time() const {
+    return queued_time_;
+  }
+
+  void set_queued_time(std::chrono::steady_clock::time_point queued_time) {
+    queued_time_ = queued_time;
+  }
+
+  // The span tracing the request, null if tracing is disabled.
+  const SpanPtr& span() const {
+    return span_;
+  }
+
+  void set_span(SpanPtr span) {
+    span_ = std::move(span);
+  }
+
+  // The arena which the request was allocated from, null if none.
+  // Pass the request to ResponseBuilder to allocate the response from the
+  // same arena.
+  const ArenaPtr& arena() const {
+    return arena_;
+  }
+
+  void set_arena(ArenaPtr arena) {
+    arena_ = std::move(arena);
+  }
+
   // Check if the body is a multi-part form data.
   bool IsForm() const;
 
@@ -78,12 +127,23 @@ private:
 
   Url url_;
 
+  // The query parameters, viewing the query of |url_|.
+  UrlQueryView query_;
+
   // The URL regex matched arguments (usually resource ID's).
   // Used by server only.
   UrlArgs args_;
 
   // Client IP address.
   std::string ip_;
+
+  // The time when the request was put into the queue for the workers.
+  // Used by server only.
+  std::chrono::steady_clock::time_point queued_time_;
+
+  SpanPtr span_;
+
+  ArenaPtr arena_;
 };
 
 using RequestPtr = std::shared_ptr<Request>;
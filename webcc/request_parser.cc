@@ -9,42 +9,69 @@
 
 namespace webcc {
 
-RequestParser::RequestParser() : request_(nullptr) {
+RequestParser::RequestParser() : request_(nullptr), view_matcher_(nullptr) {
 }
 
-void RequestParser::Init(Request* request, ViewMatcher view_matcher) {
-  assert(view_matcher);
+void RequestParser::Init(Request* request, const ViewMatcher* view_matcher) {
+  assert(view_matcher != nullptr && *view_matcher);
 
   Parser::Init(request);
 
   request_ = request;
   view_matcher_ = view_matcher;
+
+  // Reset the multipart state in case the connection is persistent.
+  step_ = kStart;
+  part_.reset();
+  form_parts_.clear();
 }
 
 bool RequestParser::OnHeadersEnd() {
-  bool matched = view_matcher_(request_->method(), request_->url().path(),
-                               &stream_);
+  std::string_view path = request_->url().path_view();
+
+  bool matched = (*view_matcher_)(request_->method(), path, &stream_);
 
   if (!matched) {
-    LOG_WARN("No view matches the request: %s %s", request_->method().c_str(),
-             request_->url().path().c_str());
+    LOG_WARN("No view matches the request: %s %.*s",
+             request_->method().c_str(), static_cast<int>(path.size()),
+             path.data());
   }
 
   return matched;
 }
 
 bool RequestParser::ParseStartLine(const std::string& line) {
-  std::vector<std::string> strs;
-  split(strs, line, ' ', true);
+  // E.g., "GET /path?key=value HTTP/1.1", split in place.
+  std::string_view view{ line };
+
+  std::size_t method_end = view.find(' ');
+  if (method_end == 0 || method_end == std::string_view::npos) {
+    return false;
+  }
+
+  std::size_t target_begin = view.find_first_not_of(' ', method_end);
+  if (target_begin == std::string_view::npos) {
+    return false;
+  }
 
-  if (strs.size() != 3) {
+  std::size_t target_end = view.find(' ', target_begin);
+  if (target_end == std::string_view::npos) {
     return false;
   }
 
-  request_->set_method(std::move(strs[0]));
-  request_->set_url(Url(strs[1]));
+  // HTTP version is ignored, but there should be nothing after it.
+  std::size_t version_begin = view.find_first_not_of(' ', target_end);
+  if (version_begin == std::string_view::npos) {
+    return false;
+  }
+  std::size_t version_end = view.find(' ', version_begin);
+  if (version_end != std::string_view::npos &&
+      view.find_first_not_of(' ', version_end) != std::string_view::npos) {
+    return false;
+  }
 
-  // HTTP version is ignored.
+  request_->set_method(std::string{ view.substr(0, method_end) });
+  request_->set_url(view.substr(target_begin, target_end - target_begin));
 
   return true;
 }
@@ -3,13 +3,15 @@
 
 #include <functional>
 #include <string>
+#include <string_view>
 
 #include "webcc/parser.h"
 
 namespace webcc {
 
+// Match the view by HTTP method and URL path, see Router::MatchView().
 using ViewMatcher =
-    std::function<bool(const std::string&, const std::string&, bool*)>;
+    std::function<bool(const std::string&, std::string_view, bool*)>;
 
 class Request;
 
@@ -19,7 +21,8 @@ public:
 
   ~RequestParser() override = default;
 
-  void Init(Request* request, ViewMatcher view_matcher);
+  // |view_matcher| is not copied, it must outlive the parsing.
+  void Init(Request* request, const ViewMatcher* view_matcher);
 
 private:
   // Override to match the URL against views and check if the matched view
@@ -49,7 +52,7 @@ private:
 
   // A function for matching view once the headers of a request has been
   // received. The parsing will stop and fail if no view can be matched.
-  ViewMatcher view_matcher_;
+  const ViewMatcher* view_matcher_;
 
   // Form data parsing step.
   enum Step {
@@ -1,10 +1,14 @@
 #include "webcc/response.h"
 
+#include <unordered_map>
+
+#include "webcc/date_clock.h"
 #include "webcc/utility.h"
 
 namespace webcc {
 
 static const std::pair<int, const char*> kTable[] = {
+  { Status::kSwitchingProtocols, "Switching Protocols" },
   { Status::kOK, "OK" },
   { Status::kCreated, "Created" },
   { Status::kAccepted, "Accepted" },
@@ -12,36 +16,90 @@ static const std::pair<int, const char*> kTable[] = {
   { Status::kNotModified, "Not Modified" },
   { Status::kBadRequest, "Bad Request" },
   { Status::kNotFound, "Not Found" },
+  { Status::kRequestHeaderFieldsTooLarge, "Request Header Fields Too Large" },
   { Status::kInternalServerError, "Internal Server Error" },
   { Status::kNotImplemented, "Not Implemented" },
   { Status::kServiceUnavailable, "Service Unavailable" },
 };
 
-static const char* GetReason(int status) {
-  for (auto& pair : kTable) {
-    if (pair.first == status) {
-      return pair.second;
+static std::string MakeStartLine(int status, const std::string& reason) {
+  std::string start_line = "HTTP/1.1 ";
+  start_line += std::to_string(status);
+  start_line += " ";
+  start_line += reason;
+  return start_line;
+}
+
+// The start lines of the known statuses, rendered once.
+// Return null if the status is unknown.
+static const std::string* GetStartLine(int status) {
+  static const auto kStartLines = []() {
+    std::unordered_map<int, std::string> start_lines;
+    for (auto& pair : kTable) {
+      start_lines[pair.first] = MakeStartLine(pair.first, pair.second);
     }
-  }
-  return "";
+    return start_lines;
+  }();
+
+  auto it = kStartLines.find(status);
+  return it == kStartLines.end() ? nullptr : &it->second;
 }
 
+// The keys as strings, not to construct one on each lookup.
+static const std::string kServerKey = headers::kServer;
+static const std::string kDateKey = headers::kDate;
+
 void Response::Prepare() {
+  add_server_ = !HasHeader(kServerKey);
+  add_date_ = auto_date_ && !HasHeader(kDateKey);
+
   if (!start_line_.empty()) {
     return;
   }
 
-  start_line_ = "HTTP/1.1 ";
-  start_line_ += std::to_string(status_);
-  start_line_ += " ";
-
   if (reason_.empty()) {
-    start_line_ += GetReason(status_);
+    const std::string* start_line = GetStartLine(status_);
+    start_line_ = start_line != nullptr ? *start_line
+                                        : MakeStartLine(status_, "");
   } else {
-    start_line_ += reason_;
+    start_line_ = MakeStartLine(status_, reason_);
+  }
+}
+
+static const std::string& GetServerHeader() {
+  static const std::string kServerHeader =
+      std::string(headers::kServer) + ": " + utility::UserAgent() + kCRLF;
+  return kServerHeader;
+}
+
+// "Date: " + date + "\r\n".
+static const std::size_t kDateHeaderSize = 6 + DateClock::kSize + 2;
+
+std::size_t Response::GetExtraHeadersSize() const {
+  std::size_t size = 0;
+  if (add_server_) {
+    size += GetServerHeader().size();
+  }
+  if (add_date_) {
+    size += kDateHeaderSize;
+  }
+  return size;
+}
+
+void Response::AppendExtraHeaders(std::string* output) const {
+  if (add_server_) {
+    *output += GetServerHeader();
   }
 
-  SetHeader(headers::kServer, utility::UserAgent());
+  if (add_date_) {
+    char date[DateClock::kSize];
+    DateClock::Instance().Now(date);
+
+    *output += headers::kDate;
+    *output += ": ";
+    output->append(date, DateClock::kSize);
+    *output += kCRLF;
+  }
 }
 
 }  // namespace webcc
@@ -10,7 +10,8 @@ namespace webcc {
 
 class Response : public Message {
 public:
-  explicit Response(Status status = Status::kOK) : status_(status) {
+  explicit Response(Status status = Status::kOK)
+      : status_(status), auto_date_(false) {
   }
 
   ~Response() override = default;
@@ -31,11 +32,34 @@ public:
     reason_ = reason;
   }
 
+  // Add the Date header of the current second on sending unless it has been
+  // set explicitly. The date is rendered right into the header block from
+  // DateClock, without allocating. Set by the server.
+  void set_auto_date(bool auto_date) {
+    auto_date_ = auto_date;
+  }
+
+  bool auto_date() const {
+    return auto_date_;
+  }
+
+  // Prepare for sending. The Server header (and the Date header if auto date
+  // is on) will be added unless they have been set explicitly.
+  // Not called for the responses parsed, which never get these headers.
   void Prepare() override;
 
 private:
+  std::size_t GetExtraHeadersSize() const override;
+  void AppendExtraHeaders(std::string* output) const override;
+
   int status_;  // Status code
   std::string reason_;  // Reason phrase
+
+  bool auto_date_;
+
+  // Add the Server or the Date header on rendering? Decided by Prepare().
+  bool add_server_ = false;
+  bool add_date_ = false;
 };
 
 using ResponsePtr = std::shared_ptr<Response>;
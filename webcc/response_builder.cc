@@ -13,7 +13,7 @@ namespace webcc {
 ResponsePtr ResponseBuilder::operator()() {
   assert(headers_.size() % 2 == 0);
 
-  auto response = std::make_shared<Response>(code_);
+  auto response = MakeShared<Response>(arena(), code_);
 
   for (std::size_t i = 1; i < headers_.size(); i += 2) {
     response->SetHeader(std::move(headers_[i - 1]), std::move(headers_[i]));
@@ -35,14 +35,23 @@ ResponsePtr ResponseBuilder::operator()() {
   } else {
     // Ensure the existing of `Content-Length` header if the body is empty.
     // `Content-Length: 0` is required by most HTTP clients (e.g., Chrome).
-    body_ = std::make_shared<webcc::Body>();
+    body_ = MakeShared<webcc::Body>(arena());
   }
 
-  response->SetBody(body_, true);
+  // A stream body has no `Content-Length`.
+  bool set_length = !std::dynamic_pointer_cast<StreamBody>(body_);
+  response->SetBody(body_, set_length);
 
   return response;
 }
 
+ResponseBuilder& ResponseBuilder::EventStream(EventStreamPtr stream) {
+  body_ = stream;
+  media_type_ = media_types::kTextEventStream;
+  charset_ = charsets::kUtf8;
+  return Header("Cache-Control", "no-cache");
+}
+
 ResponseBuilder& ResponseBuilder::File(const std::filesystem::path& path,
                                        bool infer_media_type,
                                        std::size_t chunk_size) {
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 
+#include "webcc/event_stream.h"
 #include "webcc/request.h"
 #include "webcc/response.h"
 
@@ -14,8 +15,9 @@ public:
   ResponseBuilder() = default;
 
   // NOTE:
-  // Currently, |request| is necessary only when Gzip is enabled and the client
-  // does want to accept Gzip compressed response.
+  // The |request| is necessary when Gzip is enabled and the client does want
+  // to accept Gzip compressed response. It also lets the response be allocated
+  // from the arena of the request (see Request::arena()).
   explicit ResponseBuilder(RequestPtr request) : request_(request) {
   }
 
@@ -83,12 +85,12 @@ public:
   }
 
   ResponseBuilder& Body(const std::string& data) {
-    body_.reset(new StringBody{ data, false });
+    body_ = MakeShared<StringBody>(arena(), data, false);
     return *this;
   }
 
   ResponseBuilder& Body(std::string&& data) {
-    body_.reset(new StringBody{ std::move(data), false });
+    body_ = MakeShared<StringBody>(arena(), std::move(data), false);
     return *this;
   }
 
@@ -98,6 +100,11 @@ public:
                         bool infer_media_type = true,
                         std::size_t chunk_size = 1024);
 
+  // Use an event stream (Server-Sent Events) as body.
+  // The headers are sent once the view returns, and the events are sent
+  // whenever they are written to the stream, until it's closed.
+  ResponseBuilder& EventStream(EventStreamPtr stream);
+
   ResponseBuilder& Header(const std::string& key, const std::string& value) {
     headers_.push_back(key);
     headers_.push_back(value);
@@ -115,6 +122,11 @@ public:
 #endif  // WEBCC_ENABLE_GZIP
 
 private:
+  // The arena of the request, if any.
+  ArenaPtr arena() const {
+    return request_ ? request_->arena() : ArenaPtr{};
+  }
+
   RequestPtr request_;
 
   // Status code.
@@ -13,7 +13,7 @@ bool Router::Route(const std::string& url, ViewPtr view,
 
   // TODO: More error check
 
-  routes_.push_back({ url, {}, view, methods });
+  routes_.push_back({ url, {}, view, methods, NewRouteMetrics(url) });
 
   return true;
 }
@@ -26,7 +26,8 @@ bool Router::Route(const UrlRegex& regex_url, ViewPtr view,
 
   try {
 
-    routes_.push_back({ "", regex_url(), view, methods });
+    routes_.push_back({ "", regex_url(), view, methods,
+                        NewRouteMetrics(regex_url.url()) });
 
   } catch (const std::regex_error& e) {
     LOG_ERRO("Not a valid regular expression: %s", e.what());
@@ -36,8 +37,8 @@ bool Router::Route(const UrlRegex& regex_url, ViewPtr view,
   return true;
 }
 
-ViewPtr Router::FindView(const std::string& method, const std::string& url,
-                         UrlArgs* args) {
+ViewPtr Router::FindView(const std::string& method, std::string_view url,
+                         UrlArgs* args, RouteMetrics** route_metrics) {
   assert(args != nullptr);
 
   for (auto& route : routes_) {
@@ -47,19 +48,26 @@ ViewPtr Router::FindView(const std::string& method, const std::string& url,
     }
 
     if (route.url.empty()) {
-      std::smatch match;
+      std::cmatch match;
 
-      if (std::regex_match(url, match, route.url_regex)) {
+      if (std::regex_match(url.data(), url.data() + url.size(), match,
+                           route.url_regex)) {
         // Any sub-matches?
         // Start from 1 because match[0] is the whole string itself.
         for (size_t i = 1; i < match.size(); ++i) {
           args->push_back(match[i].str());
         }
 
+        if (route_metrics != nullptr && route.metrics) {
+          *route_metrics = route.metrics.get();
+        }
         return route.view;
       }
     } else {
       if (iequals(route.url, url)) {
+        if (route_metrics != nullptr && route.metrics) {
+          *route_metrics = route.metrics.get();
+        }
         return route.view;
       }
     }
@@ -68,7 +76,7 @@ ViewPtr Router::FindView(const std::string& method, const std::string& url,
   return ViewPtr();
 }
 
-bool Router::MatchView(const std::string& method, const std::string& url,
+bool Router::MatchView(const std::string& method, std::string_view url,
                        bool* stream) {
   assert(stream != nullptr);
   *stream = false;
@@ -80,9 +88,10 @@ bool Router::MatchView(const std::string& method, const std::string& url,
     }
 
     if (route.url.empty()) {
-      std::smatch match;
+      std::cmatch match;
 
-      if (std::regex_match(url, match, route.url_regex)) {
+      if (std::regex_match(url.data(), url.data() + url.size(), match,
+                           route.url_regex)) {
         *stream = route.view->Stream(method);
         return true;
       }
@@ -97,4 +106,11 @@ bool Router::MatchView(const std::string& method, const std::string& url,
   return false;
 }
 
+RouteMetricsPtr Router::NewRouteMetrics(const std::string& route) {
+  if (metrics_registry_ == nullptr) {
+    return {};
+  }
+  return std::make_shared<RouteMetrics>(metrics_registry_, route);
+}
+
 }  // namespace webcc
@@ -3,8 +3,10 @@
 
 #include <regex>
 #include <string>
+#include <string_view>
 
 #include "webcc/globals.h"
+#include "webcc/metrics.h"
 #include "webcc/view.h"
 
 namespace webcc {
@@ -25,23 +27,37 @@ public:
              const Strings& methods = { "GET" });
 
   // Find the view by HTTP method and URL (path).
-  ViewPtr FindView(const std::string& method, const std::string& url,
-                   UrlArgs* args);
+  // The metrics of the route matched, if any, are returned via
+  // |route_metrics|, see set_metrics_registry().
+  ViewPtr FindView(const std::string& method, std::string_view url,
+                   UrlArgs* args, RouteMetrics** route_metrics = nullptr);
 
   // Match the view by HTTP method and URL (path).
   // Return if a view is matched or not.
   // If the view asks for data streaming, |stream| will be set to true.
-  bool MatchView(const std::string& method, const std::string& url,
+  bool MatchView(const std::string& method, std::string_view url,
                  bool* stream);
 
+protected:
+  // Create the metrics of the routes added from now on in |registry|, labeled
+  // by the URL (or the regular expression) of the route.
+  void set_metrics_registry(MetricsRegistry* registry) {
+    metrics_registry_ = registry;
+  }
+
 private:
   struct RouteInfo {
     std::string url;
     std::regex url_regex;
     ViewPtr view;
     Strings methods;
+    RouteMetricsPtr metrics;
   };
 
+  RouteMetricsPtr NewRouteMetrics(const std::string& route);
+
+  MetricsRegistry* metrics_registry_ = nullptr;
+
   // Route table.
   std::vector<RouteInfo> routes_;
 };
@@ -1,14 +1,23 @@
 #include "webcc/server.h"
 
 #include <csignal>
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 #include <fstream>
 #include <utility>
 
+#include "asio/executor_work_guard.hpp"
+#include "asio/write.hpp"
+
 #include "webcc/body.h"
+#include "webcc/handoff.h"
 #include "webcc/logger.h"
 #include "webcc/request.h"
 #include "webcc/response.h"
 #include "webcc/utility.h"
+#include "webcc/websocket.h"
 
 namespace sfs = std::filesystem;
 
@@ -16,9 +25,52 @@ using tcp = asio::ip::tcp;
 
 namespace webcc {
 
+namespace {
+
+// Create a response with the given status and an empty body.
+// It's allocated from the arena if given.
+ResponsePtr NewResponse(Status status, const ArenaPtr& arena = {}) {
+  auto response = MakeShared<Response>(arena, status);
+
+  // According to the testing based on HTTPie (and Chrome), the `Content-Length`
+  // header is expected for a response with status like 404 even when the body
+  // is empty.
+  response->SetBody(MakeShared<Body>(arena), true);
+
+  return response;
+}
+
+}  // namespace
+
 Server::Server(std::uint16_t port, const std::filesystem::path& doc_root)
-    : port_(port), doc_root_(doc_root), file_chunk_size_(1024), running_(false),
-      acceptor_(io_context_), signals_(io_context_) {
+    : port_(port), local_port_(0), doc_root_(doc_root), file_chunk_size_(1024),
+      idle_timeout_(kIdleTimeout), header_timeout_(kHeaderTimeout),
+      body_timeout_(kBodyTimeout), max_connections_(0), max_queued_(0),
+      queue_wait_target_(0), retry_after_(kRetryAfter), drain_timeout_(0),
+      auto_date_(false), metrics_(&metrics_registry_),
+      static_metrics_(&metrics_registry_, "static"),
+      unmatched_metrics_(&metrics_registry_, "none"), running_(false),
+      stopping_(false), acceptor_(io_context_),
+#if defined(__linux__)
+      listen_fd_(-1), handoff_acceptor_(io_context_),
+#endif
+      signals_(io_context_) {
+  using namespace std::placeholders;
+  view_matcher_ = std::bind(&Server::MatchViewOrStatic, this, _1, _2, _3);
+
+  set_metrics_registry(&metrics_registry_);
+
+  metrics_registry_.SetGaugeCallback(
+      "webcc_connections_active", "Connections currently open.",
+      [this] { return static_cast<std::int64_t>(pool_.Size()); });
+  metrics_registry_.SetGaugeCallback(
+      "webcc_queue_depth", "Requests waiting in the queue for the workers.",
+      [this] { return static_cast<std::int64_t>(queue_.Size()); });
+  metrics_registry_.SetGaugeCallback(
+      "webcc_requests_in_flight",
+      "Requests queued or being handled by the workers.",
+      [this] { return static_cast<std::int64_t>(limiter_.in_flight()); });
+
   AddSignals();
 }
 
@@ -36,6 +88,7 @@ void Server::Run(std::size_t workers, std::size_t loops) {
     }
 
     running_ = true;
+    stopping_ = false;
     io_context_.restart();
 
     if (!Listen(port_)) {
@@ -43,12 +96,24 @@ void Server::Run(std::size_t workers, std::size_t loops) {
       return;
     }
 
+    std::error_code ec;
+    local_port_ = acceptor_.local_endpoint(ec).port();
+
     LOG_INFO("Server is going to run...");
 
+    limiter_.Reset(workers, max_queued_,
+                   std::chrono::milliseconds(queue_wait_target_));
+
     AsyncWaitSignals();
 
     AsyncAccept();
 
+#if defined(__linux__)
+    if (!handoff_path_.empty()) {
+      ListenHandoff();
+    }
+#endif
+
     // Create worker threads.
     for (std::size_t i = 0; i < workers; ++i) {
       worker_threads_.emplace_back(&Server::WorkerRoutine, this);
@@ -60,6 +125,9 @@ void Server::Run(std::size_t workers, std::size_t loops) {
   // have finished. While the server is running, there is always at least one
   // asynchronous operation outstanding: the asynchronous accept call waiting
   // for new incoming connections.
+  // But the acceptor is closed before draining the connections, the work guard
+  // keeps the loop running for them until io_context::stop() is called.
+  auto work_guard = asio::make_work_guard(io_context_);
 
   LOG_INFO("Loop is running in %u thread(s).", loops);
 
@@ -76,6 +144,13 @@ void Server::Run(std::size_t workers, std::size_t loops) {
       loop_threads[i].join();
     }
   }
+
+  // Close all pending connections, now that no handler of them is running.
+  pool_.Clear();
+
+  if (stop_thread_.joinable()) {
+    stop_thread_.join();
+  }
 }
 
 void Server::Stop() {
@@ -105,11 +180,32 @@ void Server::AsyncWaitSignals() {
         // call will exit.
         LOG_INFO("On signal %d, stopping the server...", signo);
 
-        DoStop();
+        if (stopping_.exchange(true)) {
+          // Being stopped already, e.g., after the hand-off.
+        } else if (drain_timeout_ > 0) {
+          // Don't block the loop which the draining depends on.
+          stop_thread_ = std::thread(&Server::Stop, this);
+        } else {
+          DoStop();
+        }
       });
 }
 
 bool Server::Listen(std::uint16_t port) {
+#if defined(__linux__)
+  if (listen_fd_ < 0 && !handoff_path_.empty()) {
+    listen_fd_ = handoff::TakeOver(handoff_path_);
+    if (listen_fd_ >= 0) {
+      LOG_INFO("Took over the listening socket from %s.",
+               handoff_path_.c_str());
+    }
+  }
+
+  if (listen_fd_ >= 0) {
+    return AssignListenFd();
+  }
+#endif  // defined(__linux__)
+
   std::error_code ec;
 
   tcp::endpoint endpoint(tcp::v4(), port);
@@ -148,6 +244,84 @@ bool Server::Listen(std::uint16_t port) {
   return true;
 }
 
+#if defined(__linux__)
+
+bool Server::AssignListenFd() {
+  int fd = listen_fd_;
+
+  // The acceptor owns the socket from now on.
+  listen_fd_ = -1;
+
+  sockaddr_storage addr{};
+  socklen_t addr_len = sizeof(addr);
+  if (::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &addr_len) != 0) {
+    LOG_ERRO("Invalid listening socket: %d.", fd);
+    ::close(fd);
+    return false;
+  }
+
+  std::error_code ec;
+  acceptor_.assign(addr.ss_family == AF_INET6 ? tcp::v6() : tcp::v4(), fd, ec);
+  if (ec) {
+    LOG_ERRO("Acceptor assign error (%s).", ec.message().c_str());
+    ::close(fd);
+    return false;
+  }
+
+  return true;
+}
+
+void Server::ListenHandoff() {
+  // The path might be left by the old server.
+  ::unlink(handoff_path_.c_str());
+
+  asio::local::stream_protocol::endpoint endpoint(handoff_path_);
+
+  std::error_code ec;
+  handoff_acceptor_.open(endpoint.protocol(), ec);
+  if (!ec) {
+    handoff_acceptor_.bind(endpoint, ec);
+  }
+  if (!ec) {
+    handoff_acceptor_.listen(asio::socket_base::max_listen_connections, ec);
+  }
+
+  if (ec) {
+    LOG_ERRO("Failed to listen on %s (%s), hot restart is disabled.",
+             handoff_path_.c_str(), ec.message().c_str());
+    handoff_acceptor_.close(ec);
+    return;
+  }
+
+  AsyncAcceptHandoff();
+}
+
+void Server::AsyncAcceptHandoff() {
+  handoff_acceptor_.async_accept(
+      [this](std::error_code ec, asio::local::stream_protocol::socket socket) {
+        if (!handoff_acceptor_.is_open() || !acceptor_.is_open()) {
+          return;
+        }
+
+        if (ec || !handoff::SendFd(socket.native_handle(),
+                                   acceptor_.native_handle())) {
+          AsyncAcceptHandoff();
+          return;
+        }
+
+        LOG_INFO("Handed off the listening socket, stopping the server...");
+
+        // The path belongs to the new server now, don't unlink it.
+        handoff_acceptor_.close(ec);
+
+        if (!stopping_.exchange(true)) {
+          stop_thread_ = std::thread(&Server::Stop, this);
+        }
+      });
+}
+
+#endif  // defined(__linux__)
+
 void Server::AsyncAccept() {
   acceptor_.async_accept(
       [this](std::error_code ec, tcp::socket socket) {
@@ -157,15 +331,23 @@ void Server::AsyncAccept() {
           return;
         }
 
-        if (!ec) {
+        if (!ec && max_connections_ > 0 &&
+            pool_.Size() >= max_connections_) {
+          LOG_WARN("Too many connections, reject the new one.");
+          metrics_.connections_rejected->Add();
+          RejectConnection(std::move(socket));
+        } else if (!ec) {
           LOG_INFO("Accepted a connection.");
+          metrics_.connections_total->Add();
 
-          using namespace std::placeholders;
-          auto view_matcher = std::bind(&Server::MatchViewOrStatic, this, _1,
-                                        _2, _3);
+          auto connection = pool_.NewConnection(std::move(socket), &queue_,
+                                                &view_matcher_);
 
-          auto connection = std::make_shared<Connection>(
-              std::move(socket), &pool_, &queue_, std::move(view_matcher));
+          connection->set_timeouts(idle_timeout_, header_timeout_,
+                                   body_timeout_);
+          connection->set_limiter(&limiter_, retry_after_);
+          connection->set_metrics(&metrics_);
+          connection->set_trace_sink(trace_sink_.get());
 
           pool_.Start(connection);
         }
@@ -174,17 +356,59 @@ void Server::AsyncAccept() {
       });
 }
 
+void Server::RejectConnection(tcp::socket socket) {
+  auto data = std::make_shared<std::string>(
+      "HTTP/1.1 503 Service Unavailable\r\n"
+      "Retry-After: " + std::to_string(retry_after_) + "\r\n"
+      "Content-Length: 0\r\n"
+      "Connection: Close\r\n\r\n");
+
+  auto s = std::make_shared<tcp::socket>(std::move(socket));
+
+  asio::async_write(*s, asio::buffer(*data),
+                    [s, data](std::error_code, std::size_t) {
+                      std::error_code ec;
+                      s->shutdown(tcp::socket::shutdown_both, ec);
+                      s->close(ec);
+                    });
+}
+
+void Server::Drain() {
+  LOG_INFO("Draining connections (timeout: %ds)...", drain_timeout_);
+
+  pool_.Drain();
+
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::seconds(drain_timeout_);
+
+  if (pool_.WaitEmpty(deadline)) {
+    LOG_INFO("All connections have been drained.");
+  } else {
+    LOG_WARN("Timed out draining, %u connection(s) left.", pool_.Size());
+  }
+}
+
 void Server::DoStop() {
   // Stop accepting new connections.
   acceptor_.close();
+  local_port_ = 0;
+
+#if defined(__linux__)
+  if (handoff_acceptor_.is_open()) {
+    std::error_code ec;
+    handoff_acceptor_.close(ec);
+    ::unlink(handoff_path_.c_str());
+  }
+#endif
+
+  if (drain_timeout_ > 0 && running_) {
+    Drain();
+  }
 
   // Stop worker threads.
   // This might take some time if the threads are still processing.
   StopWorkers();
 
-  // Close all pending connections.
-  pool_.Clear();
-
   // Finally, stop the event processing loop.
   // This function does not block, but instead simply signals the io_context to
   // stop. All invocations of its run() or run_one() member functions should
@@ -246,32 +470,112 @@ void Server::StopWorkers() {
 }
 
 void Server::Handle(ConnectionPtr connection) {
+  if (connection->IsHttp2()) {
+    // Each request (stream) of an HTTP/2 connection is queued separately.
+    std::uint32_t stream_id = 0;
+    auto request = connection->PopHttp2Request(&stream_id);
+    if (request) {
+      auto queue_wait = std::chrono::steady_clock::now() -
+                        request->queued_time();
+      metrics_.queue_wait->Record(queue_wait);
+      auto response = HandleRequest(request);
+      limiter_.Release(queue_wait);
+      AddDate(response.get());
+
+      if (response->status() == Status::kSwitchingProtocols) {
+        // WebSocket over HTTP/2 (RFC 8441) is not supported.
+        response = NewResponse(Status::kNotImplemented);
+      } else if (auto stream = std::dynamic_pointer_cast<StreamBody>(
+                     response->body())) {
+        // Stream responses are not supported by HTTP/2 yet.
+        stream->Close();
+        response = NewResponse(Status::kNotImplemented);
+      }
+      connection->SendHttp2Response(stream_id, response);
+    }
+    return;
+  }
+
   auto request = connection->request();
+  auto queue_wait = std::chrono::steady_clock::now() - request->queued_time();
+  metrics_.queue_wait->Record(queue_wait);
+
+  const SpanPtr& span = request->span();
+  if (span) {
+    span->AddEvent("dequeued");
+  }
+
+  ViewPtr view;
+  auto response = HandleRequest(request, &view);
+  limiter_.Release(queue_wait);
+  AddDate(response.get());
+
+  if (span) {
+    span->AddEvent("handled");
+    span->SetAttribute("status", std::to_string(response->status()));
+  }
 
-  const Url& url = request->url();
-  LOG_INFO("Request URL path: %s", url.path().c_str());
+  if (response->status() == Status::kSwitchingProtocols) {
+    // The connection will be switched to WebSocket after the response is sent.
+    connection->set_websocket_view(
+        std::dynamic_pointer_cast<WebSocketView>(view));
+  }
+
+  // Release the request before sending the response, so that the connection
+  // could reuse it for the next request once the response is sent.
+  request.reset();
+
+  connection->SendResponse(std::move(response));
+}
+
+void Server::AddDate(Response* response) {
+  if (auto_date_) {
+    response->set_auto_date(true);
+  }
+}
+
+ResponsePtr Server::HandleRequest(RequestPtr request, ViewPtr* matched_view) {
+  auto start = std::chrono::steady_clock::now();
+
+  RouteMetrics* route_metrics = &unmatched_metrics_;
+  auto response = DoHandleRequest(request, matched_view, &route_metrics);
+
+  route_metrics->Record(static_cast<int>(response->status()),
+                        std::chrono::steady_clock::now() - start);
+
+  return response;
+}
+
+ResponsePtr Server::DoHandleRequest(RequestPtr request, ViewPtr* matched_view,
+                                    RouteMetrics** route_metrics) {
+  std::string_view path = request->url().path_view();
+  LOG_INFO("Request URL path: %.*s", static_cast<int>(path.size()),
+           path.data());
 
   UrlArgs args;
-  auto view = FindView(request->method(), url.path(), &args);
+  auto view = FindView(request->method(), path, &args, route_metrics);
 
   if (!view) {
-    LOG_WARN("No view matches the request: %s %s", request->method().c_str(),
-             url.path().c_str());
+    LOG_WARN("No view matches the request: %s %.*s",
+             request->method().c_str(), static_cast<int>(path.size()),
+             path.data());
 
     if (request->method() == methods::kGet) {
       // Try to serve static files for GET request.
       auto response = ServeStatic(request);
       if (!response) {
         // Static file not found.
-        connection->SendResponse(Status::kNotFound);
-      } else {
-        connection->SendResponse(response);
+        return NewResponse(Status::kNotFound, request->arena());
       }
-    } else {
-      connection->SendResponse(Status::kBadRequest);
+      *route_metrics = &static_metrics_;
+      return response;
     }
 
-    return;
+    return NewResponse(Status::kBadRequest, request->arena());
+  }
+
+  if (matched_view != nullptr) {
+    *matched_view = view;
   }
 
   // Save the (regex matched) URL args to request object.
@@ -280,24 +584,23 @@ void Server::Handle(ConnectionPtr connection) {
   // Ask the matched view to process the request.
   ResponsePtr response = view->Handle(request);
 
-  // Send the response back.
-  if (response) {
-    connection->SendResponse(response);
-  } else {
-    connection->SendResponse(Status::kBadRequest);
+  if (!response) {
+    return NewResponse(Status::kBadRequest, request->arena());
   }
+
+  return response;
 }
 
 bool Server::MatchViewOrStatic(const std::string& method,
-                               const std::string& url, bool* stream) {
+                               std::string_view url, bool* stream) {
   if (Router::MatchView(method, url, stream)) {
     return true;
   }
 
   // Try to match a static file.
   if (method == methods::kGet && !doc_root_.empty()) {
-    std::filesystem::path path = doc_root_ / url;
-    if (!sfs::is_directory(path) && sfs::exists(path)) {
+    sfs::path path = utility::GetStaticPath(doc_root_, Url::DecodePath(url));
+    if (!path.empty() && !sfs::is_directory(path) && sfs::exists(path)) {
       return true;
     }
   }
@@ -313,7 +616,11 @@ ResponsePtr Server::ServeStatic(RequestPtr request) {
     return {};
   }
 
-  std::filesystem::path path = doc_root_ / request->url().path();
+  sfs::path path = utility::GetStaticPath(doc_root_, request->url().DecodedPath());
+  if (path.empty()) {
+    LOG_WARN("The URL is out of the doc root.");
+    return {};
+  }
 
   try {
     // NOTE: FileBody might throw Error::kFileError.
@@ -1,6 +1,7 @@
 #ifndef WEBCC_SERVER_H_
 #define WEBCC_SERVER_H_
 
+#include <atomic>
 #include <filesystem>
 #include <string>
 #include <thread>
@@ -10,10 +11,17 @@
 #include "asio/ip/tcp.hpp"
 #include "asio/signal_set.hpp"
 
+#if defined(__linux__)
+#include "asio/local/stream_protocol.hpp"
+#endif
+
+#include "webcc/concurrency_limiter.h"
 #include "webcc/connection.h"
 #include "webcc/connection_pool.h"
+#include "webcc/metrics.h"
 #include "webcc/queue.h"
 #include "webcc/router.h"
+#include "webcc/trace.h"
 #include "webcc/url.h"
 
 namespace webcc {
@@ -33,6 +41,100 @@ public:
     file_chunk_size_ = file_chunk_size;
   }
 
+  // Set the timeout (in seconds) for a keep-alive connection waiting for the
+  // next request. 0 to disable.
+  void set_idle_timeout(int idle_timeout) {
+    idle_timeout_ = idle_timeout;
+  }
+
+  // Set the timeout (in seconds) for receiving the headers of a request,
+  // counted from its first byte. 0 to disable.
+  void set_header_timeout(int header_timeout) {
+    header_timeout_ = header_timeout;
+  }
+
+  // Set the timeout (in seconds) for receiving more body data of a request.
+  // 0 to disable.
+  void set_body_timeout(int body_timeout) {
+    body_timeout_ = body_timeout;
+  }
+
+  // Set the max number of the concurrent connections, 0 for unlimited.
+  // The connections beyond it are replied with 503 (Service Unavailable) and
+  // closed immediately.
+  void set_max_connections(std::size_t max_connections) {
+    max_connections_ = max_connections;
+  }
+
+  // Set the max number of the requests queued or being handled by the
+  // workers, 0 for unlimited.
+  // The requests beyond it are replied with 503 (Service Unavailable).
+  void set_max_queued(std::size_t max_queued) {
+    max_queued_ = max_queued;
+  }
+
+  // Set the target (in milliseconds) of the time a request waits in the queue,
+  // 0 to disable.
+  // Once set, the limit of the requests queued becomes adaptive: it's lowered
+  // when the requests wait longer than the target, and raised again (up to
+  // the max queued, if any) when the workers catch up.
+  void set_queue_wait_target(int queue_wait_target) {
+    queue_wait_target_ = queue_wait_target;
+  }
+
+  // Set the seconds of the Retry-After header of the 503 responses.
+  void set_retry_after(int retry_after) {
+    retry_after_ = retry_after;
+  }
+
+  // Set the timeout (in seconds) for draining the connections on stop, 0 to
+  // close them immediately.
+  // When draining, the server stops accepting, closes the connections idle
+  // between requests, and keeps serving the requests queued or in progress
+  // (with "Connection: Close") until they are all done or the timeout expires.
+  // A new connection is served its first request.
+  void set_drain_timeout(int drain_timeout) {
+    drain_timeout_ = drain_timeout;
+  }
+
+  // Add the Date header to the responses which don't have it, rendered at
+  // most once per second (see DateClock). Default: false.
+  void set_auto_date(bool auto_date) {
+    auto_date_ = auto_date;
+  }
+
+  // The metrics of the server, e.g., to be exported by a MetricsView.
+  // Register your own metrics in it as well if you like.
+  MetricsRegistry& metrics() {
+    return metrics_registry_;
+  }
+
+  // Trace the phases of the requests (HTTP/1.1) into the sink, e.g., a
+  // JsonLinesTraceSink. The `traceparent` header of a request is extracted
+  // to join the trace of the client. Set it before running the server.
+  // Default: null (no tracing).
+  void set_trace_sink(TraceSinkPtr trace_sink) {
+    trace_sink_ = std::move(trace_sink);
+  }
+
+#if defined(__linux__)
+  // Accept on the given listening socket instead of binding the port, e.g.,
+  // a socket inherited from the parent process.
+  void set_listen_fd(int listen_fd) {
+    listen_fd_ = listen_fd;
+  }
+
+  // Set the path of the Unix domain socket for hot restart.
+  // On Run(), the server tries to take over the listening socket from the
+  // server listening on the path (if any), otherwise binds the port as usual.
+  // It then listens on the path itself. Once the socket has been handed off
+  // to a new server, it stops (draining the connections if a drain timeout is
+  // set), while the new server starts to accept on the same socket.
+  void set_handoff_path(const std::string& handoff_path) {
+    handoff_path_ = handoff_path;
+  }
+#endif  // defined(__linux__)
+
   // Start and run the server.
   // This method is blocking so will not return until Stop() is called (from
   // another thread) or a signal like SIGINT is caught.
@@ -49,11 +151,19 @@ public:
 
   // Stop the server.
   // This should be called from another thread since the Run() is blocking.
+  // It blocks until the connections have been drained if a drain timeout is
+  // set.
   void Stop();
 
   // Is the server running?
   bool IsRunning() const;
 
+  // The port the server is listening on, e.g., the one picked by the system
+  // if the server was given port 0. Return 0 if it's not listening yet.
+  std::uint16_t local_port() const {
+    return local_port_;
+  }
+
 private:
   // Register signals which indicate when the server should exit.
   void AddSignals();
@@ -67,6 +177,21 @@ private:
   // Accept connections asynchronously.
   void AsyncAccept();
 
+#if defined(__linux__)
+  // Accept on the given (already listening) socket.
+  bool AssignListenFd();
+
+  // Listen on the handoff path for a new server to take over.
+  void ListenHandoff();
+  void AsyncAcceptHandoff();
+#endif  // defined(__linux__)
+
+  // Reply with 503 (Service Unavailable) and close the connection.
+  void RejectConnection(asio::ip::tcp::socket socket);
+
+  // Wait for the connections to finish the current requests.
+  void Drain();
+
   // Stop acceptor and worker threads, close all pending connections, and
   // finally stop the event loop.
   void DoStop();
@@ -82,12 +207,27 @@ private:
   // then send the response back to the client.
   // The connection will keep alive if it's a persistent connection. When next
   // request comes, this connection will be put back to the queue again.
+  // An HTTP/2 connection is put into the queue once per request (stream), and
+  // this method handles one of the requests each time.
+  // The request is released from the concurrency limiter once handled.
   virtual void Handle(ConnectionPtr connection);
+
+  // Process the request by the matched view or static file.
+  // The matched view, if any, is returned via |matched_view|.
+  // The handling is recorded in the metrics of the route.
+  ResponsePtr HandleRequest(RequestPtr request,
+                            ViewPtr* matched_view = nullptr);
+
+  ResponsePtr DoHandleRequest(RequestPtr request, ViewPtr* matched_view,
+                              RouteMetrics** route_metrics);
+
+  // Let the response add the Date header on sending if it's enabled.
+  void AddDate(Response* response);
  
   // Match the view by HTTP method and URL (path).
   // Return if a view or static file is matched or not.
   // If the view asks for data streaming, |stream| will be set to true.
-  bool MatchViewOrStatic(const std::string& method, const std::string& url,
+  bool MatchViewOrStatic(const std::string& method, std::string_view url,
                          bool* stream);
 
   // Serve static files from the doc root.
@@ -97,6 +237,9 @@ private:
   // Port number.
   std::uint16_t port_;
 
+  // The port listened on, see local_port().
+  std::atomic<std::uint16_t> local_port_;
+
   // The directory with the static files to be served.
   std::filesystem::path doc_root_;
 
@@ -104,9 +247,47 @@ private:
   // static file.
   std::size_t file_chunk_size_;
 
+  // Timeouts (in seconds) for reading the requests.
+  int idle_timeout_;
+  int header_timeout_;
+  int body_timeout_;
+
+  // Limits of the connections and the requests queued.
+  std::size_t max_connections_;
+  std::size_t max_queued_;
+  int queue_wait_target_;
+  int retry_after_;
+
+  // Timeout (in seconds) for draining the connections on stop.
+  int drain_timeout_;
+
+  // Add the Date header automatically?
+  bool auto_date_;
+
+  MetricsRegistry metrics_registry_;
+  ServerMetrics metrics_;
+
+  // The metrics of the requests matching no route, served as static files or
+  // not.
+  RouteMetrics static_metrics_;
+  RouteMetrics unmatched_metrics_;
+
+  TraceSinkPtr trace_sink_;
+
+  // The thread stopping the server on a signal (if it has to drain) or after
+  // the hand-off, so that the loop could keep running.
+  std::thread stop_thread_;
+
+  // Admit the requests into the queue.
+  ConcurrencyLimiter limiter_;
+
   // Is the server running?
   bool running_;
 
+  // Is the server being stopped on a signal or after the hand-off?
+  // The handlers of them might run in different loop threads.
+  std::atomic<bool> stopping_;
+
   // The mutex for guarding the state of the server.
   std::mutex state_mutex_;
 
@@ -116,6 +297,18 @@ private:
   // Acceptor used to listen for incoming connections.
   asio::ip::tcp::acceptor acceptor_;
 
+#if defined(__linux__)
+  // The listening socket to take over, -1 if none.
+  int listen_fd_;
+
+  // Hot restart.
+  std::string handoff_path_;
+  asio::local::stream_protocol::acceptor handoff_acceptor_;
+#endif  // defined(__linux__)
+
+  // Match the views for the request parsers, shared by all the connections.
+  ViewMatcher view_matcher_;
+
   // The connection pool which owns all live connections.
   ConnectionPool pool_;
 
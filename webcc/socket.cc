@@ -12,25 +12,194 @@
 #endif  // defined(_WIN32) || defined(_WIN64)
 #endif  // WEBCC_ENABLE_SSL
 
+#include <algorithm>
+#include <functional>
+#include <memory>
+
 #include "asio/connect.hpp"
 #include "asio/read.hpp"
+#include "asio/steady_timer.hpp"
 #include "asio/write.hpp"
 
 #include "webcc/logger.h"
 
+using asio::ip::tcp;
+
 namespace webcc {
 
 // -----------------------------------------------------------------------------
 
-Socket::Socket(asio::io_context& io_context) : socket_(io_context) {
+namespace {
+
+// Interleave the endpoints by address family, IPv6 first.
+// See RFC 8305 (Happy Eyeballs Version 2), section 4.
+std::vector<tcp::endpoint> SortEndpoints(
+    const SocketBase::Endpoints& endpoints) {
+  std::vector<tcp::endpoint> v6;
+  std::vector<tcp::endpoint> v4;
+
+  for (auto& entry : endpoints) {
+    if (entry.endpoint().address().is_v6()) {
+      v6.push_back(entry.endpoint());
+    } else {
+      v4.push_back(entry.endpoint());
+    }
+  }
+
+  std::vector<tcp::endpoint> sorted;
+  sorted.reserve(v6.size() + v4.size());
+
+  for (std::size_t i = 0; i < std::max(v6.size(), v4.size()); ++i) {
+    if (i < v6.size()) {
+      sorted.push_back(v6[i]);
+    }
+    if (i < v4.size()) {
+      sorted.push_back(v4[i]);
+    }
+  }
+
+  return sorted;
 }
 
-bool Socket::Connect(const std::string& /*host*/, const Endpoints& endpoints) {
-  std::error_code ec;
-  asio::connect(socket_, endpoints, ec);
+// Connect to the endpoints with staggered parallel attempts.
+// A new attempt starts every kConnectAttemptDelay milliseconds, or at once
+// when the previous one fails, until some attempt succeeds. The first
+// connected socket is moved to |socket| and all the others are closed.
+// The io_context is run in the calling thread until all the operations,
+// including the canceled ones, have completed. So it's safe for the handlers
+// to capture the local variables by reference.
+void ConnectEndpoints(asio::io_context& io_context,
+                      const SocketBase::Endpoints& endpoints, int timeout,
+                      tcp::socket* socket, std::error_code* ec) {
+  const std::vector<tcp::endpoint> sorted = SortEndpoints(endpoints);
+
+  if (sorted.empty()) {
+    *ec = asio::error::host_not_found;
+    return;
+  }
 
-  if (ec) {
-    LOG_ERRO("Socket connect error (%s).", ec.message().c_str());
+  std::vector<std::unique_ptr<tcp::socket>> attempts;
+  tcp::socket* winner = nullptr;
+
+  std::size_t next = 0;     // Index of the next endpoint to try
+  std::size_t failed = 0;   // Number of failed attempts
+  std::size_t pending = 0;  // Number of outstanding async operations
+  bool done = false;
+  bool timed_out = false;
+  std::error_code last_ec;
+
+  asio::steady_timer attempt_timer{ io_context };
+  asio::steady_timer deadline_timer{ io_context };
+
+  std::function<void()> start_next = [&]() {
+    if (done || next >= sorted.size()) {
+      return;
+    }
+
+    const tcp::endpoint& endpoint = sorted[next++];
+    LOG_VERB("Connect to endpoint (%s)...",
+             endpoint.address().to_string().c_str());
+
+    attempts.emplace_back(new tcp::socket{ io_context });
+    tcp::socket* attempt = attempts.back().get();
+
+    ++pending;
+    attempt->async_connect(endpoint, [&, attempt](std::error_code inner_ec) {
+      --pending;
+
+      if (done) {
+        return;
+      }
+
+      if (!inner_ec) {
+        winner = attempt;
+        done = true;
+        return;
+      }
+
+      LOG_WARN("Endpoint connect error (%s).", inner_ec.message().c_str());
+      last_ec = inner_ec;
+
+      if (++failed == sorted.size()) {
+        done = true;
+        return;
+      }
+
+      // Don't wait for the delay if the attempt has failed.
+      start_next();
+    });
+
+    if (next < sorted.size()) {
+      // NOTE: Resetting the expiry cancels the previous wait, if any.
+      ++pending;
+      attempt_timer.expires_after(
+          std::chrono::milliseconds(kConnectAttemptDelay));
+      attempt_timer.async_wait([&](std::error_code inner_ec) {
+        --pending;
+        if (!inner_ec) {
+          start_next();
+        }
+      });
+    }
+  };
+
+  ++pending;
+  deadline_timer.expires_after(std::chrono::seconds(timeout));
+  deadline_timer.async_wait([&](std::error_code inner_ec) {
+    --pending;
+    if (!inner_ec && !done) {
+      timed_out = true;
+      done = true;
+    }
+  });
+
+  start_next();
+
+  // Block until some attempt succeeds, all fail or the deadline expires.
+  while (!done && io_context.run_one() > 0) {
+  }
+
+  // Cancel the remaining operations and wait for their handlers.
+  std::error_code ignored_ec;
+  attempt_timer.cancel();
+  deadline_timer.cancel();
+  for (auto& attempt : attempts) {
+    if (attempt.get() != winner) {
+      attempt->close(ignored_ec);
+    }
+  }
+
+  while (pending > 0 && io_context.run_one() > 0) {
+  }
+
+  // The io_context stops when it runs out of work, make it ready for the
+  // following operations.
+  io_context.restart();
+
+  if (winner != nullptr) {
+    *socket = std::move(*winner);
+    ec->clear();
+  } else if (timed_out) {
+    *ec = asio::error::timed_out;
+  } else {
+    *ec = last_ec;
+  }
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------------
+
+Socket::Socket(asio::io_context& io_context)
+    : io_context_(io_context), socket_(io_context) {
+}
+
+bool Socket::Connect(const Endpoints& endpoints, int timeout,
+                     std::error_code* ec) {
+  ConnectEndpoints(io_context_, endpoints, timeout, &socket_, ec);
+
+  if (*ec) {
+    LOG_ERRO("Socket connect error (%s).", ec->message().c_str());
     return false;
   }
 
@@ -42,14 +211,15 @@ bool Socket::Write(const Payload& payload, std::error_code* ec) {
   return !(*ec);
 }
 
-bool Socket::ReadSome(std::vector<char>* buffer, std::size_t* size,
+bool Socket::ReadSome(const asio::mutable_buffer& buffer, std::size_t* size,
                       std::error_code* ec) {
-  *size = socket_.read_some(asio::buffer(*buffer), *ec);
+  *size = socket_.read_some(buffer, *ec);
   return (*size != 0 && !(*ec));
 }
 
-void Socket::AsyncReadSome(ReadHandler&& handler, std::vector<char>* buffer) {
-  socket_.async_read_some(asio::buffer(*buffer), std::move(handler));
+void Socket::AsyncReadSome(ReadHandler&& handler,
+                           const asio::mutable_buffer& buffer) {
+  socket_.async_read_some(buffer, std::move(handler));
 }
 
 bool Socket::Close() {
@@ -127,8 +297,10 @@ static bool UseSystemCertificateStore(SSL_CTX* ssl_ctx) {
 
 namespace ssl = asio::ssl;
 
-SslSocket::SslSocket(asio::io_context& io_context, bool ssl_verify)
-    : ssl_context_(ssl::context::sslv23),
+SslSocket::SslSocket(asio::io_context& io_context, bool ssl_verify,
+                     bool http2)
+    : io_context_(io_context),
+      ssl_context_(ssl::context::sslv23),
       ssl_socket_(io_context, ssl_context_),
       ssl_verify_(ssl_verify) {
 #if (defined(_WIN32) || defined(_WIN64))
@@ -139,18 +311,26 @@ SslSocket::SslSocket(asio::io_context& io_context, bool ssl_verify)
   // Use the default paths for finding CA certificates.
   ssl_context_.set_default_verify_paths();
 #endif  // defined(_WIN32) || defined(_WIN64)
+
+  if (http2) {
+    // The protocol list in wire format (length-prefixed strings).
+    static const unsigned char kAlpnProtocols[] = "\x02h2\x08http/1.1";
+    SSL_CTX_set_alpn_protos(ssl_context_.native_handle(), kAlpnProtocols,
+                            sizeof(kAlpnProtocols) - 1);
+  }
 }
 
-bool SslSocket::Connect(const std::string& host, const Endpoints& endpoints) {
-  std::error_code ec;
-  asio::connect(ssl_socket_.lowest_layer(), endpoints, ec);
+bool SslSocket::Connect(const Endpoints& endpoints, int timeout,
+                        std::error_code* ec) {
+  ConnectEndpoints(io_context_, endpoints, timeout, &ssl_socket_.next_layer(),
+                   ec);
 
-  if (ec) {
-    LOG_ERRO("Socket connect error (%s).", ec.message().c_str());
+  if (*ec) {
+    LOG_ERRO("Socket connect error (%s).", ec->message().c_str());
     return false;
   }
 
-  return Handshake(host);
+  return true;
 }
 
 bool SslSocket::Write(const Payload& payload, std::error_code* ec) {
@@ -158,15 +338,15 @@ bool SslSocket::Write(const Payload& payload, std::error_code* ec) {
   return !(*ec);
 }
 
-bool SslSocket::ReadSome(std::vector<char>* buffer, std::size_t* size,
-                         std::error_code* ec) {
-  *size = ssl_socket_.read_some(asio::buffer(*buffer), *ec);
+bool SslSocket::ReadSome(const asio::mutable_buffer& buffer,
+                         std::size_t* size, std::error_code* ec) {
+  *size = ssl_socket_.read_some(buffer, *ec);
   return (*size != 0 && !(*ec));
 }
 
 void SslSocket::AsyncReadSome(ReadHandler&& handler,
-                              std::vector<char>* buffer) {
-  ssl_socket_.async_read_some(asio::buffer(*buffer), std::move(handler));
+                              const asio::mutable_buffer& buffer) {
+  ssl_socket_.async_read_some(buffer, std::move(handler));
 }
 
 bool SslSocket::Close() {
@@ -175,7 +355,14 @@ bool SslSocket::Close() {
   return !ec;
 }
 
-bool SslSocket::Handshake(const std::string& host) {
+std::string SslSocket::GetAlpnProtocol() {
+  const unsigned char* data = nullptr;
+  unsigned int length = 0;
+  SSL_get0_alpn_selected(ssl_socket_.native_handle(), &data, &length);
+  return std::string(reinterpret_cast<const char*>(data), length);
+}
+
+bool SslSocket::Handshake(const std::string& host, std::error_code* ec) {
   if (ssl_verify_) {
     ssl_socket_.set_verify_mode(ssl::verify_peer);
   } else {
@@ -185,11 +372,10 @@ bool SslSocket::Handshake(const std::string& host) {
   ssl_socket_.set_verify_callback(ssl::rfc2818_verification(host));
 
   // Use sync API directly since we don't need timeout control.
-  std::error_code ec;
-  ssl_socket_.handshake(ssl::stream_base::client, ec);
+  ssl_socket_.handshake(ssl::stream_base::client, *ec);
 
-  if (ec) {
-    LOG_ERRO("Handshake error (%s).", ec.message().c_str());
+  if (*ec) {
+    LOG_ERRO("Handshake error (%s).", ec->message().c_str());
     return false;
   }
 
@@ -25,18 +25,35 @@ public:
   using ReadHandler =
       std::function<void(std::error_code, std::size_t)>;
 
-  // TODO: Remove |host|
-  virtual bool Connect(const std::string& host, const Endpoints& endpoints) = 0;
+  // Connect to one of the endpoints.
+  // Several endpoints (e.g., IPv4 and IPv6 addresses of the same host) are
+  // tried in parallel with staggered starts (Happy Eyeballs), the first one
+  // connected wins. The whole process will fail with asio::error::timed_out
+  // if no connection could be established in |timeout| seconds.
+  virtual bool Connect(const Endpoints& endpoints, int timeout,
+                       std::error_code* ec) = 0;
+
+  // Handshake with the server once connected, e.g., for SSL.
+  // |host| is for the verification of the certificate.
+  virtual bool Handshake(const std::string& /*host*/, std::error_code* /*ec*/) {
+    return true;
+  }
 
   virtual bool Write(const Payload& payload, std::error_code* ec) = 0;
 
-  virtual bool ReadSome(std::vector<char>* buffer, std::size_t* size,
+  virtual bool ReadSome(const asio::mutable_buffer& buffer, std::size_t* size,
                         std::error_code* ec) = 0;
 
   virtual void AsyncReadSome(ReadHandler&& handler,
-                             std::vector<char>* buffer) = 0;
+                             const asio::mutable_buffer& buffer) = 0;
 
   virtual bool Close() = 0;
+
+  // Get the application protocol negotiated by ALPN, e.g., "h2".
+  // Return empty if no protocol has been negotiated.
+  virtual std::string GetAlpnProtocol() {
+    return "";
+  }
 };
 
 // -----------------------------------------------------------------------------
@@ -45,18 +62,22 @@ class Socket : public SocketBase {
 public:
   explicit Socket(asio::io_context& io_context);
 
-  bool Connect(const std::string& host, const Endpoints& endpoints) override;
+  bool Connect(const Endpoints& endpoints, int timeout,
+               std::error_code* ec) override;
 
   bool Write(const Payload& payload, std::error_code* ec) override;
 
-  bool ReadSome(std::vector<char>* buffer, std::size_t* size,
+  bool ReadSome(const asio::mutable_buffer& buffer, std::size_t* size,
                 std::error_code* ec) override;
 
-  void AsyncReadSome(ReadHandler&& handler, std::vector<char>* buffer) override;
+  void AsyncReadSome(ReadHandler&& handler,
+                     const asio::mutable_buffer& buffer) override;
 
   bool Close() override;
 
 private:
+  asio::io_context& io_context_;
+
   asio::ip::tcp::socket socket_;
 };
 
@@ -66,22 +87,29 @@ private:
 
 class SslSocket : public SocketBase {
 public:
-  explicit SslSocket(asio::io_context& io_context,
-                     bool ssl_verify = true);
+  // If |http2| is true, "h2" will be offered by ALPN besides "http/1.1".
+  explicit SslSocket(asio::io_context& io_context, bool ssl_verify = true,
+                     bool http2 = false);
 
-  bool Connect(const std::string& host, const Endpoints& endpoints) override;
+  bool Connect(const Endpoints& endpoints, int timeout,
+               std::error_code* ec) override;
+
+  bool Handshake(const std::string& host, std::error_code* ec) override;
 
   bool Write(const Payload& payload, std::error_code* ec) override;
 
-  bool ReadSome(std::vector<char>* buffer, std::size_t* size,
+  bool ReadSome(const asio::mutable_buffer& buffer, std::size_t* size,
                 std::error_code* ec) override;
 
-  void AsyncReadSome(ReadHandler&& handler, std::vector<char>* buffer) override;
+  void AsyncReadSome(ReadHandler&& handler,
+                     const asio::mutable_buffer& buffer) override;
 
   bool Close() override;
 
+  std::string GetAlpnProtocol() override;
+
 private:
-  bool Handshake(const std::string& host);
+  asio::io_context& io_context_;
 
   asio::ssl::context ssl_context_;
 
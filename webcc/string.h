@@ -5,6 +5,7 @@
 #include <iterator>
 #include <sstream>
 #include <string>
+#include <string_view>
 
 namespace webcc {
 
@@ -26,7 +27,7 @@ inline std::string tolower(std::string s) {
   return s;
 }
 
-inline bool iequals(const std::string& str1, const std::string& str2) {
+inline bool iequals(std::string_view str1, std::string_view str2) {
   if (str1.size() != str2.size()) {
     return false;
   }
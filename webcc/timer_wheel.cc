@@ -0,0 +1,223 @@
+#include "webcc/timer_wheel.h"
+
+#include <utility>
+
+#include "webcc/globals.h"
+
+namespace webcc {
+
+TimerWheel::Timer::~Timer() {
+  if (wheel_ != nullptr) {
+    wheel_->Cancel(this);
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+asio::io_context::id TimerWheel::id;
+
+TimerWheel::TimerWheel(asio::io_context& io_context)
+    : asio::io_context::service(io_context),
+      slots_(kTimerWheelLevels * kTimerWheelSlots, nullptr),
+      tick_timer_(io_context) {
+}
+
+TimerWheel& TimerWheel::Get(const asio::executor& executor) {
+  // The sockets are always created with an io_context.
+  return asio::use_service<TimerWheel>(
+      static_cast<asio::io_context&>(executor.context()));
+}
+
+void TimerWheel::Schedule(Timer* timer, std::chrono::milliseconds timeout,
+                          std::function<void()> handler) {
+  const std::chrono::milliseconds tick{ kTimerWheelTick };
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (shutdown_) {
+    return;
+  }
+
+  if (timer->linked_) {
+    Unlink(timer);
+  }
+
+  timer->wheel_ = this;
+  timer->handler_ = std::move(handler);
+
+  // Round up to the ticks, at least one.
+  std::size_t ticks = 1;
+  if (timeout > tick) {
+    ticks = static_cast<std::size_t>((timeout.count() + tick.count() - 1) /
+                                     tick.count());
+  }
+
+  timer->expire_ = now_ + ticks;
+  Link(timer);
+
+  if (!ticking_) {
+    ticking_ = true;
+    next_tick_ = std::chrono::steady_clock::now() + tick;
+    DoTick();
+  }
+}
+
+void TimerWheel::Cancel(Timer* timer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (timer->linked_) {
+    Unlink(timer);
+  }
+  timer->handler_ = nullptr;
+}
+
+void TimerWheel::shutdown() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  shutdown_ = true;
+
+  for (auto& head : slots_) {
+    for (Timer* timer = head; timer != nullptr; timer = timer->next_) {
+      timer->linked_ = false;
+      timer->handler_ = nullptr;
+    }
+    head = nullptr;
+  }
+  count_ = 0;
+
+  tick_timer_.cancel();
+}
+
+void TimerWheel::Link(Timer* timer) {
+  // The max ticks covered by the wheel.
+  std::uint64_t max_ticks = 1;
+  for (std::size_t i = 0; i < kTimerWheelLevels; ++i) {
+    max_ticks *= kTimerWheelSlots;
+  }
+
+  if (timer->expire_ - now_ >= max_ticks) {
+    timer->expire_ = now_ + max_ticks - 1;
+  }
+
+  // Find the lowest level which covers the expiration.
+  const std::uint64_t ticks = timer->expire_ - now_;
+  std::size_t level = 0;
+  std::uint64_t span = 1;  // Ticks per slot of the level
+  while (ticks >= span * kTimerWheelSlots) {
+    span *= kTimerWheelSlots;
+    ++level;
+  }
+
+  std::size_t index = (timer->expire_ / span) % kTimerWheelSlots;
+  timer->slot_ = level * kTimerWheelSlots + index;
+
+  timer->prev_ = nullptr;
+  timer->next_ = slots_[timer->slot_];
+  if (timer->next_ != nullptr) {
+    timer->next_->prev_ = timer;
+  }
+  slots_[timer->slot_] = timer;
+
+  timer->linked_ = true;
+  ++count_;
+}
+
+void TimerWheel::Unlink(Timer* timer) {
+  if (timer->prev_ != nullptr) {
+    timer->prev_->next_ = timer->next_;
+  } else {
+    slots_[timer->slot_] = timer->next_;
+  }
+
+  if (timer->next_ != nullptr) {
+    timer->next_->prev_ = timer->prev_;
+  }
+
+  timer->prev_ = nullptr;
+  timer->next_ = nullptr;
+  timer->linked_ = false;
+  --count_;
+}
+
+void TimerWheel::Cascade(std::size_t level, std::size_t index) {
+  Timer* timer = slots_[level * kTimerWheelSlots + index];
+
+  while (timer != nullptr) {
+    Timer* next = timer->next_;
+    Unlink(timer);
+    Link(timer);
+    timer = next;
+  }
+}
+
+void TimerWheel::Tick(std::vector<std::function<void()>>* handlers) {
+  ++now_;
+
+  // Cascade the higher levels whose slot has just been reached.
+  std::uint64_t span = 1;
+  std::size_t level = 0;
+  while (level + 1 < kTimerWheelLevels &&
+         (now_ / span) % kTimerWheelSlots == 0) {
+    span *= kTimerWheelSlots;
+    ++level;
+  }
+  for (; level > 0; --level, span /= kTimerWheelSlots) {
+    Cascade(level, (now_ / span) % kTimerWheelSlots);
+  }
+
+  // All the timers left in the slot of level 0 expire now.
+  Timer*& head = slots_[now_ % kTimerWheelSlots];
+  while (head != nullptr) {
+    Timer* timer = head;
+    Unlink(timer);
+    handlers->push_back(std::move(timer->handler_));
+    timer->handler_ = nullptr;
+  }
+}
+
+void TimerWheel::DoTick() {
+  tick_timer_.expires_at(next_tick_);
+  tick_timer_.async_wait(
+      std::bind(&TimerWheel::OnTick, this, std::placeholders::_1));
+}
+
+void TimerWheel::OnTick(std::error_code ec) {
+  if (ec) {
+    return;
+  }
+
+  const std::chrono::milliseconds tick{ kTimerWheelTick };
+
+  // Call the handlers outside the lock, they might schedule timers again.
+  std::vector<std::function<void()>> handlers;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (shutdown_) {
+      return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+
+    // Catch up if some ticks were missed.
+    while (next_tick_ <= now && count_ > 0) {
+      Tick(&handlers);
+      next_tick_ += tick;
+    }
+
+    if (count_ > 0) {
+      DoTick();
+    } else {
+      ticking_ = false;
+    }
+  }
+
+  for (auto& handler : handlers) {
+    if (handler) {
+      handler();
+    }
+  }
+}
+
+}  // namespace webcc
@@ -0,0 +1,121 @@
+#ifndef WEBCC_TIMER_WHEEL_H_
+#define WEBCC_TIMER_WHEEL_H_
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "asio/executor.hpp"
+#include "asio/io_context.hpp"
+#include "asio/steady_timer.hpp"
+
+namespace webcc {
+
+// A hierarchical timer wheel attached to an io_context, for the timeouts of a
+// large number of objects, e.g., server connections and clients.
+// Scheduling and canceling a timer are O(1) without any allocation, while
+// only one asio timer is used for ticking, which is armed only when some
+// timer is pending.
+// The wheel has kTimerWheelLevels levels of kTimerWheelSlots slots. A timer
+// is put into the level by how far it expires, and is moved down level by
+// level (cascading) as the time goes. So a tick only touches the timers which
+// expire in it, plus a cascade every kTimerWheelSlots ticks.
+// Usage:
+//   auto& wheel = asio::use_service<TimerWheel>(io_context);
+//   wheel.Schedule(&timer, std::chrono::seconds(30), handler);
+// The timers are precise to a tick (kTimerWheelTick), and the handlers are
+// called in the threads running the io_context.
+class TimerWheel : public asio::io_context::service {
+public:
+  // A timer embedded in the owner object.
+  // The handler should not keep the owner alive, capture a weak pointer
+  // instead, since the timer is canceled on destruction.
+  class Timer {
+  public:
+    Timer() = default;
+
+    ~Timer();
+
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+  private:
+    friend class TimerWheel;
+
+    // The wheel which the timer was scheduled with.
+    TimerWheel* wheel_ = nullptr;
+
+    // Links of the slot list.
+    bool linked_ = false;
+    std::size_t slot_ = 0;
+    Timer* prev_ = nullptr;
+    Timer* next_ = nullptr;
+
+    // The tick to expire.
+    std::uint64_t expire_ = 0;
+
+    std::function<void()> handler_;
+  };
+
+  static asio::io_context::id id;
+
+  explicit TimerWheel(asio::io_context& io_context);
+
+  ~TimerWheel() override = default;
+
+  // Get the wheel of the io_context which the executor (e.g., of a socket)
+  // belongs to.
+  static TimerWheel& Get(const asio::executor& executor);
+
+  // Schedule the timer to expire after |timeout|.
+  // A pending timer is canceled first.
+  // Could be called from any thread.
+  void Schedule(Timer* timer, std::chrono::milliseconds timeout,
+                std::function<void()> handler);
+
+  // Cancel the timer, the handler won't be called any more unless it's being
+  // called right now.
+  // Could be called from any thread.
+  void Cancel(Timer* timer);
+
+private:
+  void shutdown() override;
+
+  // Put the timer into the slot by its expiration.
+  void Link(Timer* timer);
+  void Unlink(Timer* timer);
+
+  // Move the timers of the slot to the lower levels.
+  void Cascade(std::size_t level, std::size_t index);
+
+  // Advance one tick and collect the handlers of the expired timers.
+  void Tick(std::vector<std::function<void()>>* handlers);
+
+  void DoTick();
+  void OnTick(std::error_code ec);
+
+  // The head of the timer list of each slot, level by level.
+  std::vector<Timer*> slots_;
+
+  // Ticks elapsed.
+  std::uint64_t now_ = 0;
+
+  // Number of the pending timers.
+  std::size_t count_ = 0;
+
+  // The time of the next tick.
+  std::chrono::steady_clock::time_point next_tick_;
+
+  asio::steady_timer tick_timer_;
+  bool ticking_ = false;
+
+  bool shutdown_ = false;
+
+  std::mutex mutex_;
+};
+
+}  // namespace webcc
+
+#endif  // WEBCC_TIMER_WHEEL_H_
@@ -0,0 +1,255 @@
+#include "webcc/trace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+
+#include "webcc/globals.h"
+
+namespace webcc {
+
+namespace {
+
+const char kHexDigits[] = "0123456789abcdef";
+
+// Interval of the background thread of JsonLinesTraceSink to write the spans
+// out.
+const std::chrono::milliseconds kTraceWriteInterval{ 100 };
+
+// Generate a random ID of |length| hex digits, not all zeros.
+std::string NewId(std::size_t length) {
+  thread_local static std::mt19937_64 rg{ std::random_device{}() };
+
+  std::string id;
+  id.reserve(length);
+
+  bool zero = true;
+  while (id.size() < length) {
+    std::uint64_t bits = rg();
+    for (int i = 0; i < 16 && id.size() < length; ++i, bits >>= 4) {
+      id.push_back(kHexDigits[bits & 0xf]);
+      zero = zero && (bits & 0xf) == 0;
+    }
+  }
+
+  if (zero) {
+    id.back() = '1';
+  }
+  return id;
+}
+
+bool IsHex(const std::string& str) {
+  for (char c : str) {
+    if (!(c >= '0' && c <= '9') && !(c >= 'a' && c <= 'f')) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool IsZero(const std::string& str) {
+  return str.find_first_not_of('0') == std::string::npos;
+}
+
+void AppendJsonString(const std::string& str, std::string* output) {
+  output->push_back('"');
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      output->push_back('\\');
+      output->push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buf[8];
+      std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+      output->append(buf);
+    } else {
+      output->push_back(c);
+    }
+  }
+  output->push_back('"');
+}
+
+std::int64_t ToMicroseconds(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+      .count();
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------------
+
+bool TraceContext::Parse(const std::string& traceparent,
+                         TraceContext* context) {
+  // version "-" trace-id "-" parent-id "-" trace-flags
+  // Future versions might append more fields.
+  if (traceparent.size() < 55 || traceparent[2] != '-' ||
+      traceparent[35] != '-' || traceparent[52] != '-' ||
+      (traceparent.size() > 55 && traceparent[55] != '-')) {
+    return false;
+  }
+
+  std::string version = traceparent.substr(0, 2);
+  std::string trace_id = traceparent.substr(3, 32);
+  std::string span_id = traceparent.substr(36, 16);
+  std::string flags = traceparent.substr(53, 2);
+
+  // Version "ff" is invalid, and version 00 has no more fields.
+  if (version == "ff" || (version == "00" && traceparent.size() != 55)) {
+    return false;
+  }
+
+  // All zeros of the IDs are invalid too.
+  if (!IsHex(version) || !IsHex(flags) || !IsHex(trace_id) ||
+      !IsHex(span_id) || IsZero(trace_id) || IsZero(span_id)) {
+    return false;
+  }
+
+  context->trace_id = std::move(trace_id);
+  context->span_id = std::move(span_id);
+  context->sampled = (std::stoi(flags, nullptr, 16) & 0x01) != 0;
+  return true;
+}
+
+std::string TraceContext::ToTraceparent() const {
+  return "00-" + trace_id + "-" + span_id + (sampled ? "-01" : "-00");
+}
+
+// -----------------------------------------------------------------------------
+
+Span::Span(const char* name, const TraceContext& parent)
+    : name_(name), span_id_(NewId(16)), sampled_(true),
+      system_start_(std::chrono::system_clock::now()),
+      steady_start_(std::chrono::steady_clock::now()) {
+  if (parent.valid()) {
+    SetParent(parent);
+  } else {
+    trace_id_ = NewId(32);
+  }
+}
+
+void Span::SetParent(const TraceContext& parent) {
+  trace_id_ = parent.trace_id;
+  parent_id_ = parent.span_id;
+  sampled_ = parent.sampled;
+}
+
+std::string Span::ToJson() const {
+  // The span starts with the first event, which might be earlier than the
+  // creation of the span, e.g., the accepting of the connection.
+  auto start = steady_start_;
+  auto end = steady_start_;
+  for (auto& event : events_) {
+    start = std::min(start, event.second);
+    end = std::max(end, event.second);
+  }
+
+  auto start_us =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          system_start_.time_since_epoch()).count() -
+      ToMicroseconds(steady_start_ - start);
+
+  std::string json;
+  json.reserve(256);
+
+  json.append("{\"name\":");
+  AppendJsonString(name_, &json);
+  json.append(",\"trace_id\":\"" + trace_id_ + "\"");
+  json.append(",\"span_id\":\"" + span_id_ + "\"");
+  if (!parent_id_.empty()) {
+    json.append(",\"parent_id\":\"" + parent_id_ + "\"");
+  }
+  json.append(",\"start_us\":" + std::to_string(start_us));
+  json.append(",\"duration_us\":" +
+              std::to_string(ToMicroseconds(end - start)));
+
+  json.append(",\"attributes\":{");
+  for (std::size_t i = 0; i < attributes_.size(); ++i) {
+    if (i > 0) {
+      json.push_back(',');
+    }
+    AppendJsonString(attributes_[i].first, &json);
+    json.push_back(':');
+    AppendJsonString(attributes_[i].second, &json);
+  }
+  json.append("}");
+
+  json.append(",\"events\":[");
+  for (std::size_t i = 0; i < events_.size(); ++i) {
+    if (i > 0) {
+      json.push_back(',');
+    }
+    json.append("{\"name\":");
+    AppendJsonString(events_[i].first, &json);
+    json.append(",\"us\":" +
+                std::to_string(ToMicroseconds(events_[i].second - start)));
+    json.push_back('}');
+  }
+  json.append("]}");
+
+  return json;
+}
+
+// -----------------------------------------------------------------------------
+
+JsonLinesTraceSink::JsonLinesTraceSink(const std::filesystem::path& path) {
+#if (defined(_WIN32) || defined(_WIN64))
+  file_ = _wfopen(path.wstring().c_str(), L"a");
+#else
+  file_ = std::fopen(path.string().c_str(), "a");
+#endif  // defined(_WIN32) || defined(_WIN64)
+
+  if (file_ == nullptr) {
+    throw Error{ Error::kFileError, "Cannot open the trace file" };
+  }
+
+  thread_ = std::thread(&JsonLinesTraceSink::Run, this);
+}
+
+JsonLinesTraceSink::~JsonLinesTraceSink() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+  cv_.notify_all();
+
+  thread_.join();
+
+  std::fclose(file_);
+}
+
+void JsonLinesTraceSink::Export(const Span& span) {
+  std::string line = span.ToJson();
+  line.push_back('\n');
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  lines_ += line;
+}
+
+void JsonLinesTraceSink::Run() {
+  // Swapped with |lines_|, so that both keep their capacities.
+  std::string batch;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  while (true) {
+    cv_.wait_for(lock, kTraceWriteInterval, [this] { return stopped_; });
+
+    bool stop = stopped_;
+    batch.swap(lines_);
+
+    lock.unlock();
+
+    if (!batch.empty()) {
+      std::fwrite(batch.data(), 1, batch.size(), file_);
+      std::fflush(file_);
+      batch.clear();
+    }
+
+    lock.lock();
+
+    if (stop) {
+      break;
+    }
+  }
+}
+
+}  // namespace webcc
@@ -0,0 +1,154 @@
+#ifndef WEBCC_TRACE_H_
+#define WEBCC_TRACE_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace webcc {
+
+// The trace context propagated by the `traceparent` header.
+// See https://www.w3.org/TR/trace-context/.
+struct TraceContext {
+  // 32 lowercase hex digits, empty if invalid.
+  std::string trace_id;
+
+  // The ID (16 lowercase hex digits) of the span sending the header.
+  std::string span_id;
+
+  bool sampled = true;
+
+  bool valid() const {
+    return !trace_id.empty();
+  }
+
+  // Parse a `traceparent` header, e.g.,
+  //   00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01
+  // Return false if the header is malformed.
+  static bool Parse(const std::string& traceparent, TraceContext* context);
+
+  // Format as a `traceparent` header.
+  std::string ToTraceparent() const;
+};
+
+// -----------------------------------------------------------------------------
+
+// The timestamps of the phases of a request, e.g., "first_byte" and
+// "handled", in the server or the client.
+// A span is updated by one thread at a time (the connection or the worker
+// holding the request), never concurrently.
+class Span {
+public:
+  // Start a span of a new trace, or of the trace of |parent| if it's valid.
+  explicit Span(const char* name, const TraceContext& parent = {});
+
+  Span(const Span&) = delete;
+  Span& operator=(const Span&) = delete;
+
+  // Join the trace of |parent|, e.g., once the headers of the request
+  // carrying it have been parsed.
+  void SetParent(const TraceContext& parent);
+
+  // The context to propagate to the requests sent on behalf of this span.
+  TraceContext context() const {
+    return { trace_id_, span_id_, sampled_ };
+  }
+
+  bool sampled() const {
+    return sampled_;
+  }
+
+  void AddEvent(const char* name) {
+    AddEvent(name, std::chrono::steady_clock::now());
+  }
+
+  void AddEvent(const char* name, std::chrono::steady_clock::time_point time) {
+    events_.emplace_back(name, time);
+  }
+
+  void SetAttribute(const char* key, const std::string& value) {
+    attributes_.emplace_back(key, value);
+  }
+
+  // Format as a line of JSON, with the events in microseconds since the
+  // first one, e.g.,
+  //   {"name":"server","trace_id":"...","span_id":"...","parent_id":"...",
+  //    "start_us":1600000000000000,"duration_us":230,
+  //    "attributes":{"method":"GET"},
+  //    "events":[{"name":"first_byte","us":0},...]}
+  std::string ToJson() const;
+
+private:
+  const char* name_;
+
+  std::string trace_id_;
+  std::string span_id_;
+  std::string parent_id_;
+  bool sampled_;
+
+  // The time of creation, for the wall clock time of the events.
+  std::chrono::system_clock::time_point system_start_;
+  std::chrono::steady_clock::time_point steady_start_;
+
+  std::vector<std::pair<const char*, std::chrono::steady_clock::time_point>>
+      events_;
+
+  std::vector<std::pair<const char*, std::string>> attributes_;
+};
+
+using SpanPtr = std::shared_ptr<Span>;
+
+// -----------------------------------------------------------------------------
+
+// Where the finished spans go, e.g., a file or a tracing backend.
+// Export() is called by the threads of the connections or the clients, it
+// should be thread-safe and return quickly.
+class TraceSink {
+public:
+  virtual ~TraceSink() = default;
+
+  virtual void Export(const Span& span) = 0;
+};
+
+using TraceSinkPtr = std::shared_ptr<TraceSink>;
+
+// Write the spans to a file, one JSON object per line.
+// Export() only appends the line to a buffer, which is written out and
+// flushed by a background thread periodically.
+class JsonLinesTraceSink : public TraceSink {
+public:
+  // The file is opened for appending.
+  // Throw Error(kFileError) if it cannot be opened.
+  explicit JsonLinesTraceSink(const std::filesystem::path& path);
+
+  // Write the spans left before closing the file.
+  ~JsonLinesTraceSink() override;
+
+  void Export(const Span& span) override;
+
+private:
+  // The routine of the background thread.
+  void Run();
+
+  std::FILE* file_;
+
+  // The lines exported but not written yet.
+  std::string lines_;
+  bool stopped_ = false;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+
+  std::thread thread_;
+};
+
+}  // namespace webcc
+
+#endif  // WEBCC_TRACE_H_
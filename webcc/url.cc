@@ -27,7 +27,7 @@ bool HexToDecimal(char hex, int* decimal) {
   return true;
 }
 
-bool Decode(const std::string& encoded, std::string* raw) {
+bool Decode(std::string_view encoded, std::string* raw) {
   for (auto iter = encoded.begin(); iter != encoded.end(); ++iter) {
     if (*iter == '%') {
       if (++iter == encoded.end()) {
@@ -65,12 +65,15 @@ bool Decode(const std::string& encoded, std::string* raw) {
 
 // Unsafe decode.
 // Return the original string on failure.
-std::string DecodeUnsafe(const std::string& encoded) {
+std::string DecodeUnsafe(std::string_view encoded) {
   std::string raw;
-  if (Decode(encoded, &raw)) {
-    return raw;
+  if (encoded.find('%') == std::string_view::npos) {
+    // Nothing to decode.
+    raw = encoded;
+  } else if (!Decode(encoded, &raw)) {
+    raw = encoded;
   }
-  return encoded;
+  return raw;
 }
 
 // Encode all characters which should be encoded.
@@ -165,6 +168,11 @@ inline bool IsQueryChar(int c) {
   return IsPathChar(c) || c == '?';
 }
 
+// Characters of the scheme, i.e., letters, digits, '+', '-' and '.'.
+inline bool IsSchemeChar(int c) {
+  return IsAlNum(c) || c == '+' || c == '-' || c == '.';
+}
+
 }  // namespace
 
 // -----------------------------------------------------------------------------
@@ -193,101 +201,208 @@ std::string Url::EncodeFull(const std::string& utf8_str) {
 
 // -----------------------------------------------------------------------------
 
-Url::Url(const std::string& str, bool encode) {
+Url::Url(std::string_view str, bool encode) {
   if (encode) {
-    Parse(Url::EncodeFull(str));
+    Parse(Url::EncodeFull(std::string{ str }));
   } else {
     Parse(str);
   }
 }
 
+Url::Url(Url&& rhs) noexcept
+    : buffer_(std::move(rhs.buffer_)), scheme_(rhs.scheme_), host_(rhs.host_),
+      port_(rhs.port_), path_(rhs.path_), query_(rhs.query_) {
+  rhs.Clear();
+}
+
+Url& Url::operator=(Url&& rhs) noexcept {
+  if (&rhs != this) {
+    buffer_ = std::move(rhs.buffer_);
+    scheme_ = rhs.scheme_;
+    host_ = rhs.host_;
+    port_ = rhs.port_;
+    path_ = rhs.path_;
+    query_ = rhs.query_;
+    rhs.Clear();
+  }
+  return *this;
+}
+
+std::string Url::DecodePath(std::string_view path) {
+  if (path.find('%') == std::string_view::npos) {
+    return std::string{ path };
+  }
+
+  std::string raw;
+  if (!Decode(path, &raw)) {
+    return std::string{ path };
+  }
+  return raw;
+}
+
+void Url::set_port(const std::string& port) {
+  Assign(scheme_view(), host_view(), port, path_view(), query_view());
+}
+
 void Url::AppendPath(const std::string& piece, bool encode) {
   if (piece.empty() || piece == "/") {
     return;
   }
 
-  if (path_.empty() || path_ == "/") {
-    path_.clear();
+  std::string path{ path_view() };
+
+  if (path.empty() || path == "/") {
+    path.clear();
     if (piece.front() != '/') {
-      path_.push_back('/');
+      path.push_back('/');
     }
-  } else if (path_.back() == '/' && piece.front() == '/') {
-    path_.pop_back();
-  } else if (path_.back() != '/' && piece.front() != '/') {
-    path_.push_back('/');
+  } else if (path.back() == '/' && piece.front() == '/') {
+    path.pop_back();
+  } else if (path.back() != '/' && piece.front() != '/') {
+    path.push_back('/');
   }
 
   if (encode) {
-    path_.append(Url::EncodePath(piece));
+    path.append(Url::EncodePath(piece));
   } else {
-    path_.append(piece);
+    path.append(piece);
   }
+
+  Assign(scheme_view(), host_view(), port_view(), path, query_view());
 }
 
 void Url::AppendQuery(const std::string& key, const std::string& value,
                       bool encode) {
-  if (!query_.empty()) {
-    query_ += "&";
+  std::string query{ query_view() };
+
+  if (!query.empty()) {
+    query += "&";
   }
   if (encode) {
-    query_ += Url::EncodeQuery(key) + "=" + Url::EncodeQuery(value);
+    query += Url::EncodeQuery(key) + "=" + Url::EncodeQuery(value);
   } else {
-    query_ += key + "=" + value;
+    query += key + "=" + value;
   }
+
+  Assign(scheme_view(), host_view(), port_view(), path_view(), query);
 }
 
-void Url::Parse(const std::string& str) {
-  std::string tmp = str;
-  ltrim(tmp);
+void Url::Parse(std::string_view str) {
+  std::size_t begin = str.find_first_not_of("\t ");
+  if (begin == std::string_view::npos) {
+    Clear();
+    return;
+  }
 
-  std::size_t p = std::string::npos;
+  buffer_.assign(str.data() + begin, str.size() - begin);
 
-  p = tmp.find("://");
-  if (p != std::string::npos) {
-    scheme_ = tmp.substr(0, p);
-    tmp = tmp.substr(p + 3);
-  }
+  const std::size_t size = buffer_.size();
+  const char* data = buffer_.data();
 
-  p = tmp.find('/');
-  if (p != std::string::npos) {
-    host_ = tmp.substr(0, p);
+  scheme_ = {};
+  port_ = {};
+  query_ = {};
 
-    tmp = tmp.substr(p);
+  std::size_t i = 0;
 
-    p = tmp.find('?');
-    if (p != std::string::npos) {
-      path_ = tmp.substr(0, p);
-      query_ = tmp.substr(p + 1);
-    } else {
-      path_ = tmp;
-    }
+  // The scheme followed by "://", e.g., "https://".
+  while (i < size && IsSchemeChar(static_cast<unsigned char>(data[i]))) {
+    ++i;
+  }
+  if (i > 0 && buffer_.compare(i, 3, "://") == 0) {
+    scheme_ = { 0, i };
+    i += 3;
   } else {
-    path_ = "";
+    i = 0;
+  }
 
-    p = tmp.find('?');
-    if (p != std::string::npos) {
-      host_ = tmp.substr(0, p);
-      query_ = tmp.substr(p + 1);
-    } else {
-      host_ = tmp;
+  // The host and the port, till the path or the query.
+  // The colon of an IPv6 address (e.g., "[::1]:8080") is not the one of the
+  // port.
+  std::size_t host_begin = i;
+  std::size_t colon = std::string::npos;
+  bool in_brackets = false;
+
+  for (; i < size && data[i] != '/' && data[i] != '?'; ++i) {
+    if (data[i] == '[') {
+      in_brackets = true;
+    } else if (data[i] == ']') {
+      in_brackets = false;
+    } else if (data[i] == ':' && !in_brackets && colon == std::string::npos) {
+      colon = i;
     }
   }
 
-  if (!host_.empty()) {
-    p = host_.find(':');
-    if (p != std::string::npos) {
-      port_ = host_.substr(p + 1);
-      host_ = host_.substr(0, p);
-    }
+  if (colon != std::string::npos) {
+    host_ = { host_begin, colon - host_begin };
+    port_ = { colon + 1, i - colon - 1 };
+  } else {
+    host_ = { host_begin, i - host_begin };
+  }
+
+  // The path, till the query.
+  std::size_t path_begin = i;
+  for (; i < size && data[i] != '?'; ++i) {
+  }
+  path_ = { path_begin, i - path_begin };
+
+  if (i < size) {
+    query_ = { i + 1, size - i - 1 };
   }
 }
 
 void Url::Clear() {
-  scheme_.clear();
-  host_.clear();
-  port_.clear();
-  path_.clear();
-  query_.clear();
+  buffer_.clear();
+
+  scheme_ = {};
+  host_ = {};
+  port_ = {};
+  path_ = {};
+  query_ = {};
+}
+
+void Url::Assign(std::string_view scheme, std::string_view host,
+                 std::string_view port, std::string_view path,
+                 std::string_view query) {
+  // The components might be the views of the current buffer.
+  std::string buffer;
+  buffer.reserve(scheme.size() + host.size() + port.size() + path.size() +
+                 query.size() + 5);
+
+  Range scheme_range;
+  if (!scheme.empty()) {
+    scheme_range = { 0, scheme.size() };
+    buffer.append(scheme);
+    buffer.append("://");
+  }
+
+  Range host_range{ buffer.size(), host.size() };
+  buffer.append(host);
+
+  Range port_range{ buffer.size(), 0 };
+  if (!port.empty()) {
+    buffer.push_back(':');
+    port_range = { buffer.size(), port.size() };
+    buffer.append(port);
+  }
+
+  Range path_range{ buffer.size(), path.size() };
+  buffer.append(path);
+
+  Range query_range{ buffer.size(), 0 };
+  if (!query.empty()) {
+    buffer.push_back('?');
+    query_range = { buffer.size(), query.size() };
+    buffer.append(query);
+  }
+
+  buffer_ = std::move(buffer);
+
+  scheme_ = scheme_range;
+  host_ = host_range;
+  port_ = port_range;
+  path_ = path_range;
+  query_ = query_range;
 }
 
 // -----------------------------------------------------------------------------
@@ -366,4 +481,117 @@ UrlQuery::ConstIterator UrlQuery::Find(const std::string& key) const {
                       [&key](const Parameter& p) { return p.first == key; });
 }
 
+// -----------------------------------------------------------------------------
+
+void UrlQueryView::Parse(std::string_view encoded_str) {
+  Clear();
+
+  str_ = encoded_str;
+
+  // Split into key value pairs separated by '&'.
+  std::size_t i = 0;
+  while (i < str_.size()) {
+    std::size_t j = str_.find('&', i);
+    if (j == std::string_view::npos) {
+      j = str_.size();
+    }
+
+    std::string_view kv = str_.substr(i, j - i);
+    i = j + 1;
+
+    std::size_t pos = kv.find('=');
+    if (pos == std::string_view::npos) {
+      continue;
+    }
+
+    Parameter parameter;
+    parameter.key = kv.substr(0, pos);
+    parameter.value = kv.substr(pos + 1);
+
+    if (parameter.key.find('%') != std::string_view::npos) {
+      parameter.decoded_key = decoded_keys_.size();
+      decoded_keys_.push_back(DecodeUnsafe(parameter.key));
+    }
+
+    parameters_.push_back(parameter);
+  }
+
+  if (parameters_.size() > kMaxLinearSearch) {
+    BuildIndex();
+  }
+}
+
+void UrlQueryView::Clear() {
+  str_ = {};
+  parameters_.clear();
+  decoded_keys_.clear();
+  index_.clear();
+}
+
+std::string UrlQueryView::Get(std::string_view key) const {
+  std::size_t i = Find(key);
+  if (i == kNotFound) {
+    return "";
+  }
+  return DecodeUnsafe(parameters_[i].value);
+}
+
+std::string_view UrlQueryView::GetRaw(std::string_view key) const {
+  std::size_t i = Find(key);
+  if (i == kNotFound) {
+    return {};
+  }
+  return parameters_[i].value;
+}
+
+UrlQuery::Parameter UrlQueryView::Get(std::size_t index) const {
+  assert(index < Size());
+  const Parameter& parameter = parameters_[index];
+  return { std::string{ Key(parameter) }, DecodeUnsafe(parameter.value) };
+}
+
+void UrlQueryView::BuildIndex() {
+  // A power of two of at least twice the size, so the probing is short.
+  std::size_t capacity = 16;
+  while (capacity < parameters_.size() * 2) {
+    capacity *= 2;
+  }
+
+  index_.assign(capacity, 0);
+
+  std::hash<std::string_view> hash;
+  for (std::size_t i = 0; i < parameters_.size(); ++i) {
+    std::string_view key = Key(parameters_[i]);
+
+    std::size_t slot = hash(key) & (capacity - 1);
+    while (index_[slot] != 0 && Key(parameters_[index_[slot] - 1]) != key) {
+      slot = (slot + 1) & (capacity - 1);
+    }
+
+    if (index_[slot] == 0) {
+      index_[slot] = i + 1;
+    }
+  }
+}
+
+std::size_t UrlQueryView::Find(std::string_view key) const {
+  if (index_.empty()) {
+    for (std::size_t i = 0; i < parameters_.size(); ++i) {
+      if (Key(parameters_[i]) == key) {
+        return i;
+      }
+    }
+    return kNotFound;
+  }
+
+  std::size_t mask = index_.size() - 1;
+  for (std::size_t slot = std::hash<std::string_view>{}(key) & mask;
+       index_[slot] != 0; slot = (slot + 1) & mask) {
+    if (Key(parameters_[index_[slot] - 1]) == key) {
+      return index_[slot] - 1;
+    }
+  }
+  return kNotFound;
+}
+
 }  // namespace webcc
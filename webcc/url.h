@@ -3,6 +3,7 @@
 
 #include <regex>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -13,6 +14,9 @@ namespace webcc {
 // -----------------------------------------------------------------------------
 
 // A simple implementation of URL (or URI).
+// The URL is kept in one buffer, and the components are parsed in a single
+// pass as the ranges of it, e.g., "https", "example.com", "8080", "/path" and
+// "key=value" of "https://example.com:8080/path?key=value".
 // TODO: Encoding of path
 class Url {
 public:
@@ -22,38 +26,75 @@ public:
   static std::string EncodeQuery(const std::string& utf8_str);
   static std::string EncodeFull(const std::string& utf8_str);
 
+  // Decode the percent-encoded octets of a path, e.g., "/a b" of "/a%20b".
+  // Return the path as it is if it's not encoded properly.
+  static std::string DecodePath(std::string_view path);
+
 public:
   Url() = default;
 
-  explicit Url(const std::string& str, bool encode = false);
+  explicit Url(std::string_view str, bool encode = false);
+
+  Url(const Url&) = default;
+  Url& operator=(const Url&) = default;
+
+  // The moved-from URL is cleared, so that its views stay in its buffer.
+  Url(Url&& rhs) noexcept;
+  Url& operator=(Url&& rhs) noexcept;
 
-  Url(Url&&) = default;
-  Url& operator=(Url&&) = default;
+  // The components as views of the buffer, which are invalidated once the
+  // URL is changed or destroyed.
 
-  const std::string& scheme() const {
-    return scheme_;
+  std::string_view scheme_view() const {
+    return View(scheme_);
   }
 
-  const std::string& host() const {
-    return host_;
+  std::string_view host_view() const {
+    return View(host_);
   }
 
-  const std::string& port() const {
-    return port_;
+  std::string_view port_view() const {
+    return View(port_);
   }
 
-  const std::string& path() const {
-    return path_;
+  std::string_view path_view() const {
+    return View(path_);
   }
 
-  const std::string& query() const {
-    return query_;
+  std::string_view query_view() const {
+    return View(query_);
   }
 
-  void set_port(const std::string& port) {
-    port_ = port;
+  // The copies of the components, for compatibility.
+
+  std::string scheme() const {
+    return std::string{ scheme_view() };
   }
 
+  std::string host() const {
+    return std::string{ host_view() };
+  }
+
+  std::string port() const {
+    return std::string{ port_view() };
+  }
+
+  std::string path() const {
+    return std::string{ path_view() };
+  }
+
+  std::string query() const {
+    return std::string{ query_view() };
+  }
+
+  // The path decoded, see DecodePath(). The path is kept as it is on parsing,
+  // and decoded on each call of this, so only when necessary.
+  std::string DecodedPath() const {
+    return DecodePath(path_view());
+  }
+
+  void set_port(const std::string& port);
+
   // Append a piece of path.
   void AppendPath(const std::string& piece, bool encode = false);
 
@@ -61,17 +102,35 @@ public:
   void AppendQuery(const std::string& key, const std::string& value,
                    bool encode = false);
 
-private:
-  void Parse(const std::string& str);
+  // Parse |str| as the new URL, reusing the capacity of the buffer.
+  void Parse(std::string_view str);
 
   void Clear();
 
 private:
-  std::string scheme_;
-  std::string host_;
-  std::string port_;
-  std::string path_;
-  std::string query_;
+  // The offset and the size of a component in the buffer.
+  struct Range {
+    std::size_t pos = 0;
+    std::size_t size = 0;
+  };
+
+  std::string_view View(const Range& range) const {
+    return std::string_view{ buffer_.data() + range.pos, range.size };
+  }
+
+  // Rebuild the buffer from the components.
+  void Assign(std::string_view scheme, std::string_view host,
+              std::string_view port, std::string_view path,
+              std::string_view query);
+
+private:
+  std::string buffer_;
+
+  Range scheme_;
+  Range host_;
+  Range port_;
+  Range path_;
+  Range query_;
 };
 
 // -----------------------------------------------------------------------------
@@ -124,6 +183,93 @@ private:
 
 // -----------------------------------------------------------------------------
 
+// Read-only access to the URL query parameters without copying them.
+// The parameters are views of the query string, which must outlive this
+// object, and are decoded only when a decoded copy is asked for.
+class UrlQueryView {
+public:
+  UrlQueryView() = default;
+
+  // The query string should be key-value pairs separated by '&'.
+  explicit UrlQueryView(std::string_view encoded_str) {
+    Parse(encoded_str);
+  }
+
+  // Parse |encoded_str| as the new query, reusing the capacities.
+  void Parse(std::string_view encoded_str);
+
+  void Clear();
+
+  // The query string parsed.
+  std::string_view str() const {
+    return str_;
+  }
+
+  bool Empty() const {
+    return parameters_.empty();
+  }
+
+  std::size_t Size() const {
+    return parameters_.size();
+  }
+
+  bool Has(std::string_view key) const {
+    return Find(key) != kNotFound;
+  }
+
+  // Get a value by key, decoded.
+  // Return empty string if the key doesn't exist.
+  std::string Get(std::string_view key) const;
+
+  // Get a value by key as it is in the query, i.e., not decoded.
+  // Return empty string if the key doesn't exist.
+  std::string_view GetRaw(std::string_view key) const;
+
+  // Get a key-value pair by index, decoded.
+  UrlQuery::Parameter Get(std::size_t index) const;
+
+private:
+  static const std::size_t kNotFound = static_cast<std::size_t>(-1);
+
+  // Up to this number of parameters, a linear search is faster than hashing.
+  static const std::size_t kMaxLinearSearch = 8;
+
+  struct Parameter {
+    std::string_view key;
+    std::string_view value;
+
+    // The index of the decoded key in |decoded_keys_| if the key is encoded.
+    std::size_t decoded_key = kNotFound;
+  };
+
+  std::string_view Key(const Parameter& parameter) const {
+    if (parameter.decoded_key != kNotFound) {
+      return decoded_keys_[parameter.decoded_key];
+    }
+    return parameter.key;
+  }
+
+  // Build the hash index of the keys, the first one wins if duplicate.
+  void BuildIndex();
+
+  // Return the index of the parameter, or kNotFound.
+  std::size_t Find(std::string_view key) const;
+
+private:
+  std::string_view str_;
+
+  std::vector<Parameter> parameters_;
+
+  // The keys with "%XX" decoded, rare in practice.
+  std::vector<std::string> decoded_keys_;
+
+  // Open addressing, each slot is the index of a parameter plus one, or zero
+  // if empty. Only built for more than kMaxLinearSearch parameters.
+  std::vector<std::size_t> index_;
+};
+
+// -----------------------------------------------------------------------------
+
 // Wrapper for URL as regular expression.
 // Used by Server::Route().
 class UrlRegex {
@@ -137,6 +283,10 @@ public:
     return std::regex(url_, flags);
   }
 
+  const std::string& url() const {
+    return url_;
+  }
+
 private:
   std::string url_;
 };
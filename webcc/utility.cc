@@ -1,13 +1,12 @@
 #include "webcc/utility.h"
 
 #include <algorithm>
-#include <ctime>
 #include <filesystem>
 #include <fstream>
-#include <iomanip>  // for put_time
 #include <iostream>
 #include <sstream>
 
+#include "webcc/date_clock.h"
 #include "webcc/string.h"
 #include "webcc/version.h"
 
@@ -20,10 +19,7 @@ const std::string& UserAgent() {
 }
 
 std::string GetTimestamp() {
-  std::time_t t = std::time(nullptr);
-  std::stringstream ss;
-  ss << std::put_time(std::gmtime(&t), "%a, %d %b %Y %H:%M:%S") << " GMT";
-  return ss.str();
+  return DateClock::Instance().Now();
 }
 
 std::size_t TellSize(const std::filesystem::path& path) {
@@ -52,6 +48,25 @@ bool ReadFile(const std::filesystem::path& path, std::string* output) {
   return true;
 }
 
+std::filesystem::path GetStaticPath(const std::filesystem::path& doc_root,
+                                    const std::string& url_path) {
+  std::filesystem::path path = doc_root;
+
+  // The URL path is absolute (e.g., "/index.html"), appending it as it is
+  // would replace the doc root. Append the names one by one instead, without
+  // any root (e.g., "C:" on Windows) or "..".
+  for (const auto& name : std::filesystem::path{ url_path }.relative_path()) {
+    if (name == ".." || name.has_root_path()) {
+      return {};
+    }
+    if (!name.empty() && name != ".") {
+      path /= name;
+    }
+  }
+
+  return path;
+}
+
 void DumpByLine(const std::string& data, std::ostream& os,
                 const std::string& prefix) {
   std::vector<std::string> lines;
@@ -24,6 +24,7 @@ const std::string& UserAgent();
 // Get the timestamp for HTTP Date header field.
 // E.g., Wed, 21 Oct 2015 07:28:00 GMT
 // See: https://tools.ietf.org/html/rfc7231#section-7.1.1.2
+// Rendered at most once per second, see DateClock.
 std::string GetTimestamp();
 
 // Tell the size in bytes of the given file.
@@ -33,6 +34,12 @@ std::size_t TellSize(const std::filesystem::path& path);
 // Read entire file into string.
 bool ReadFile(const std::filesystem::path& path, std::string* output);
 
+// Map the URL path (decoded) of a static file under the doc root, e.g.,
+// "/css/main.css" to "<doc_root>/css/main.css".
+// Return an empty path if the URL tries to get out of the doc root.
+std::filesystem::path GetStaticPath(const std::filesystem::path& doc_root,
+                                    const std::string& url_path);
+
 // Dump the string data line by line to achieve more readability.
 // Also limit the maximum size of the data to be dumped.
 void DumpByLine(const std::string& data, std::ostream& os,
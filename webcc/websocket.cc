@@ -0,0 +1,733 @@
+#include "webcc/websocket.h"
+
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "asio/bind_executor.hpp"
+#include "asio/post.hpp"
+#include "asio/write.hpp"
+
+#include "webcc/base64.h"
+#include "webcc/connection_pool.h"
+#include "webcc/logger.h"
+#include "webcc/string.h"
+
+using asio::ip::tcp;
+
+namespace webcc {
+
+namespace {
+
+// The GUID appended to Sec-WebSocket-Key (RFC 6455 1.3).
+const char* const kAcceptGuid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// Max number of frames gathered into one write.
+const std::size_t kMaxGatherFrames = 16;
+
+inline std::uint32_t RotateLeft(std::uint32_t x, int n) {
+  return (x << n) | (x >> (32 - n));
+}
+
+// SHA-1 (RFC 3174), only used for computing Sec-WebSocket-Accept.
+std::string Sha1(const std::string& input) {
+  std::uint32_t h[5] = {
+    0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+  };
+
+  // Pad the message to a multiple of 64 bytes with the bit length at the end.
+  std::string data = input;
+  data += static_cast<char>(0x80);
+  while (data.size() % 64 != 56) {
+    data += '\0';
+  }
+  std::uint64_t bits = static_cast<std::uint64_t>(input.size()) * 8;
+  for (int i = 7; i >= 0; --i) {
+    data += static_cast<char>((bits >> (i * 8)) & 0xff);
+  }
+
+  for (std::size_t offset = 0; offset < data.size(); offset += 64) {
+    auto p = reinterpret_cast<const std::uint8_t*>(data.data() + offset);
+
+    std::uint32_t w[80];
+    for (int i = 0; i < 16; ++i) {
+      w[i] = (p[i * 4] << 24) | (p[i * 4 + 1] << 16) | (p[i * 4 + 2] << 8) |
+             p[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; ++i) {
+      w[i] = RotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    std::uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+    for (int i = 0; i < 80; ++i) {
+      std::uint32_t f = 0;
+      std::uint32_t k = 0;
+      if (i < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+      } else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      } else if (i < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+
+      std::uint32_t t = RotateLeft(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = RotateLeft(b, 30);
+      b = a;
+      a = t;
+    }
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+
+  std::string digest;
+  for (std::uint32_t v : h) {
+    for (int i = 3; i >= 0; --i) {
+      digest += static_cast<char>((v >> (i * 8)) & 0xff);
+    }
+  }
+  return digest;
+}
+
+// Check if the comma-separated header value contains the token.
+bool HasToken(const std::string& value, const std::string& token) {
+  std::vector<std::string> parts;
+  split(parts, value, ',');
+  for (auto& part : parts) {
+    if (iequals(trim(part), token)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+ResponsePtr NewBadRequest() {
+  auto response = std::make_shared<Response>(Status::kBadRequest);
+  response->SetBody(std::make_shared<Body>(), true);
+  return response;
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------------
+
+namespace websocket {
+
+std::string ComputeAccept(const std::string& key) {
+  return Base64Encode(Sha1(key + kAcceptGuid));
+}
+
+void ApplyMask(char* data, std::size_t length, const std::uint8_t key[4],
+               std::size_t offset) {
+  // The key rotated to |offset| and repeated to 8 bytes, so that the data
+  // could be XORed a word at a time. The word loop has no dependency between
+  // iterations, and the compilers vectorize it well.
+  std::uint8_t key8[8];
+  for (std::size_t i = 0; i < 8; ++i) {
+    key8[i] = key[(offset + i) % 4];
+  }
+
+  std::uint64_t mask;
+  std::memcpy(&mask, key8, 8);
+
+  std::size_t i = 0;
+  for (; i + 8 <= length; i += 8) {
+    std::uint64_t word;
+    std::memcpy(&word, data + i, 8);
+    word ^= mask;
+    std::memcpy(data + i, &word, 8);
+  }
+
+  for (; i < length; ++i) {
+    data[i] ^= key8[i % 8];
+  }
+}
+
+void AppendFrame(Opcode opcode, const char* data, std::size_t length,
+                 bool fin, std::string* output) {
+  output->reserve(output->size() + length + 10);
+
+  output->push_back(static_cast<char>((fin ? 0x80 : 0) | opcode));
+
+  if (length < 126) {
+    output->push_back(static_cast<char>(length));
+  } else if (length <= 0xffff) {
+    output->push_back(static_cast<char>(126));
+    output->push_back(static_cast<char>((length >> 8) & 0xff));
+    output->push_back(static_cast<char>(length & 0xff));
+  } else {
+    output->push_back(static_cast<char>(127));
+    for (int i = 7; i >= 0; --i) {
+      output->push_back(static_cast<char>(
+          (static_cast<std::uint64_t>(length) >> (i * 8)) & 0xff));
+    }
+  }
+
+  output->append(data, length);
+}
+
+bool IsValidUtf8(const char* data, std::size_t length) {
+  auto p = reinterpret_cast<const std::uint8_t*>(data);
+  auto end = p + length;
+
+  while (p < end) {
+    std::uint8_t c = *p;
+
+    if (c < 0x80) {
+      ++p;
+      continue;
+    }
+
+    // The number of continuation bytes and the range of the second byte
+    // (RFC 3629 4), which excludes the overlong encodings, the surrogates
+    // and the code points above U+10FFFF.
+    std::size_t n = 0;
+    std::uint8_t lower = 0x80;
+    std::uint8_t upper = 0xBF;
+
+    if (c >= 0xC2 && c <= 0xDF) {
+      n = 1;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+      n = 2;
+      if (c == 0xE0) {
+        lower = 0xA0;
+      } else if (c == 0xED) {
+        upper = 0x9F;
+      }
+    } else if (c >= 0xF0 && c <= 0xF4) {
+      n = 3;
+      if (c == 0xF0) {
+        lower = 0x90;
+      } else if (c == 0xF4) {
+        upper = 0x8F;
+      }
+    } else {
+      return false;
+    }
+
+    if (static_cast<std::size_t>(end - p) <= n) {
+      return false;
+    }
+
+    if (p[1] < lower || p[1] > upper) {
+      return false;
+    }
+
+    for (std::size_t i = 2; i <= n; ++i) {
+      if ((p[i] & 0xC0) != 0x80) {
+        return false;
+      }
+    }
+
+    p += n + 1;
+  }
+
+  return true;
+}
+
+bool IsValidCloseCode(std::uint16_t code) {
+  if (code >= 3000 && code <= 4999) {
+    return true;
+  }
+
+  // The ones defined by the RFC and registered to IANA so far.
+  return (code >= kNormalClosure && code <= kUnsupportedData) ||
+         (code >= kInvalidPayload && code <= 1014);
+}
+
+}  // namespace websocket
+
+// -----------------------------------------------------------------------------
+
+WebSocketConnection::WebSocketConnection(tcp::socket socket,
+                                         ConnectionPool* pool,
+                                         WebSocketViewPtr view,
+                                         RequestPtr request)
+    : socket_(std::move(socket)), pool_(pool), view_(view),
+      request_(request), strand_(socket_.get_executor()),
+      buffer_(kBufferSize),
+      timer_wheel_(TimerWheel::Get(socket_.get_executor())) {
+}
+
+void WebSocketConnection::Start() {
+  auto self = shared_from_this();
+
+  asio::post(strand_, [self]() {
+    self->view_->Add(self);
+    self->view_->OnOpen(self);
+    self->DoRead();
+  });
+}
+
+void WebSocketConnection::Stop() {
+  closing_ = true;
+
+  std::error_code ec;
+  socket_.shutdown(tcp::socket::shutdown_both, ec);
+  socket_.close(ec);
+
+  // Don't wait for the handlers which might never run since the loop is
+  // going to stop.
+  view_->Remove(shared_from_this());
+}
+
+bool WebSocketConnection::Send(const std::string& message, bool binary) {
+  if (closing_) {
+    return false;
+  }
+
+  std::size_t size = message.size();
+
+  // Back-pressure: reject the message if the client doesn't read fast enough.
+  std::size_t queued = queued_bytes_.fetch_add(size);
+  if (queued > 0 && queued + size > view_->max_queued_bytes()) {
+    queued_bytes_ -= size;
+    LOG_WARN("WebSocket send queue is full (%u bytes).", queued);
+    return false;
+  }
+
+  std::string frame;
+  websocket::AppendFrame(binary ? websocket::kBinary : websocket::kText,
+                         message.data(), size, true, &frame);
+
+  auto self = shared_from_this();
+  asio::post(strand_, [self, frame = std::move(frame), size]() mutable {
+    self->Enqueue(std::move(frame), size);
+  });
+
+  return true;
+}
+
+void WebSocketConnection::Close(std::uint16_t code, const std::string& reason) {
+  auto self = shared_from_this();
+  asio::post(strand_, [self, code, reason]() {
+    self->SendClose(code, reason);
+  });
+}
+
+void WebSocketConnection::DoRead() {
+  if (!buffer_.empty()) {
+    DoReadSome();
+    return;
+  }
+
+  // Wait for the data without holding a buffer since the connection is
+  // mostly idle.
+  auto self = shared_from_this();
+  socket_.async_wait(tcp::socket::wait_read,
+                     asio::bind_executor(strand_, [self](std::error_code ec) {
+                       if (ec) {
+                         self->OnRead(ec, 0);
+                       } else {
+                         self->DoReadSome();
+                       }
+                     }));
+}
+
+void WebSocketConnection::DoReadSome() {
+  socket_.async_read_some(
+      buffer_.Prepare(),
+      asio::bind_executor(strand_, std::bind(&WebSocketConnection::OnRead,
+                                             shared_from_this(),
+                                             std::placeholders::_1,
+                                             std::placeholders::_2)));
+}
+
+void WebSocketConnection::OnRead(std::error_code ec, std::size_t length) {
+  if (ec) {
+    if (ec == asio::error::eof) {
+      LOG_INFO("WebSocket read EOF.");
+    } else if (ec != asio::error::operation_aborted) {
+      LOG_ERRO("WebSocket read error (%s).", ec.message().c_str());
+    }
+
+    if (ec != asio::error::operation_aborted) {
+      Shutdown();
+    }
+    return;
+  }
+
+  buffer_.Commit(length);
+  input_.append(buffer_.data(), length);
+
+  if (!buffer_.filled()) {
+    // No more data for now.
+    buffer_.Release();
+  }
+
+  if (ParseFrames()) {
+    DoRead();
+  }
+}
+
+bool WebSocketConnection::ParseFrames() {
+  std::size_t offset = 0;
+  bool ok = true;
+
+  while (ok && !close_received_) {
+    const std::size_t available = input_.size() - offset;
+    if (available < 2) {
+      break;
+    }
+
+    auto p = reinterpret_cast<const std::uint8_t*>(input_.data() + offset);
+
+    bool fin = (p[0] & 0x80) != 0;
+    std::uint8_t opcode = p[0] & 0x0f;
+    bool masked = (p[1] & 0x80) != 0;
+    std::uint64_t length = p[1] & 0x7f;
+    std::size_t header_size = 2;
+
+    if ((p[0] & 0x70) != 0 || !masked) {
+      // No extension is negotiated, and the frames from the client must be
+      // masked.
+      ok = Fail(websocket::kProtocolError);
+      break;
+    }
+
+    if (length == 126) {
+      header_size += 2;
+    } else if (length == 127) {
+      header_size += 8;
+    }
+    header_size += 4;  // Masking key
+
+    if (available < header_size) {
+      break;
+    }
+
+    if (length == 126) {
+      length = (p[2] << 8) | p[3];
+    } else if (length == 127) {
+      length = 0;
+      for (int i = 0; i < 8; ++i) {
+        length = (length << 8) | p[2 + i];
+      }
+    }
+
+    if (length > view_->max_message_size()) {
+      ok = Fail(websocket::kMessageTooBig);
+      break;
+    }
+
+    if (available - header_size < length) {
+      break;  // Wait for the whole payload
+    }
+
+    std::uint8_t key[4];
+    std::memcpy(key, p + header_size - 4, 4);
+
+    char* payload = &input_[offset + header_size];
+    websocket::ApplyMask(payload, static_cast<std::size_t>(length), key);
+
+    ok = OnFrame(fin, opcode, payload, static_cast<std::size_t>(length));
+
+    offset += header_size + static_cast<std::size_t>(length);
+  }
+
+  input_.erase(0, offset);
+
+  return ok && !close_received_;
+}
+
+bool WebSocketConnection::OnFrame(bool fin, std::uint8_t opcode, char* payload,
+                                  std::size_t length) {
+  if ((opcode & 0x08) != 0) {
+    // Control frames must not be fragmented.
+    if (!fin || length > 125) {
+      return Fail(websocket::kProtocolError);
+    }
+    return OnControlFrame(opcode, payload, length);
+  }
+
+  if (opcode == websocket::kContinuation) {
+    if (!message_started_) {
+      return Fail(websocket::kProtocolError);
+    }
+  } else if (opcode == websocket::kText || opcode == websocket::kBinary) {
+    if (message_started_) {
+      return Fail(websocket::kProtocolError);
+    }
+    message_started_ = true;
+    message_binary_ = (opcode == websocket::kBinary);
+  } else {
+    return Fail(websocket::kProtocolError);
+  }
+
+  if (message_.size() + length > view_->max_message_size()) {
+    return Fail(websocket::kMessageTooBig);
+  }
+
+  message_.append(payload, length);
+
+  if (fin) {
+    message_started_ = false;
+
+    if (!message_binary_ &&
+        !websocket::IsValidUtf8(message_.data(), message_.size())) {
+      return Fail(websocket::kInvalidPayload);
+    }
+
+    std::string message = std::move(message_);
+    message_.clear();
+    view_->OnMessage(shared_from_this(), std::move(message), message_binary_);
+  }
+
+  return true;
+}
+
+bool WebSocketConnection::OnControlFrame(std::uint8_t opcode,
+                                         const char* payload,
+                                         std::size_t length) {
+  switch (opcode) {
+    case websocket::kPing: {
+      std::string frame;
+      websocket::AppendFrame(websocket::kPong, payload, length, true, &frame);
+      Enqueue(std::move(frame), 0);
+      return true;
+    }
+
+    case websocket::kPong:
+      return true;
+
+    case websocket::kClose: {
+      if (length == 1) {
+        return Fail(websocket::kProtocolError);
+      }
+
+      close_received_ = true;
+
+      std::uint16_t code = websocket::kNoStatusReceived;
+      if (length >= 2) {
+        code = static_cast<std::uint16_t>(
+            (static_cast<std::uint8_t>(payload[0]) << 8) |
+            static_cast<std::uint8_t>(payload[1]));
+
+        // Don't echo a status code not allowed on the wire, and the reason
+        // must be UTF-8.
+        if (!websocket::IsValidCloseCode(code) ||
+            !websocket::IsValidUtf8(payload + 2, length - 2)) {
+          return Fail(websocket::kProtocolError);
+        }
+      }
+      close_code_ = code;
+
+      LOG_INFO("WebSocket Close frame received (%u).", code);
+
+      if (close_sent_) {
+        // The closing handshake has completed.
+        Shutdown();
+      } else {
+        // Echo the status code and close the socket once it has been sent.
+        SendClose(code == websocket::kNoStatusReceived
+                      ? static_cast<std::uint16_t>(websocket::kNormalClosure)
+                      : code,
+                  "");
+      }
+      return false;
+    }
+
+    default:
+      return Fail(websocket::kProtocolError);
+  }
+}
+
+bool WebSocketConnection::Fail(std::uint16_t code) {
+  LOG_WARN("WebSocket connection failed (%u).", code);
+  close_code_ = code;
+  close_received_ = true;  // Don't read any more
+  SendClose(code, "");
+  return false;
+}
+
+void WebSocketConnection::SendClose(std::uint16_t code,
+                                    const std::string& reason) {
+  if (close_sent_ || shutdown_) {
+    return;
+  }
+
+  closing_ = true;
+
+  std::string payload;
+  payload += static_cast<char>((code >> 8) & 0xff);
+  payload += static_cast<char>(code & 0xff);
+  payload += reason.substr(0, 123);
+
+  std::string frame;
+  websocket::AppendFrame(websocket::kClose, payload.data(), payload.size(),
+                         true, &frame);
+  Enqueue(std::move(frame), 0);
+
+  // No more frames after the Close frame.
+  close_sent_ = true;
+
+  if (!close_received_) {
+    // Don't wait for the Close frame of the client forever.
+    std::weak_ptr<WebSocketConnection> weak_self = shared_from_this();
+    timer_wheel_.Schedule(
+        &close_timer_, std::chrono::seconds(websocket::kCloseTimeout),
+        [weak_self]() {
+          if (auto self = weak_self.lock()) {
+            asio::post(self->strand_, [self]() {
+              LOG_WARN("WebSocket closing handshake timed out.");
+              self->Shutdown();
+            });
+          }
+        });
+  }
+}
+
+void WebSocketConnection::Enqueue(std::string&& frame, std::size_t size) {
+  if (shutdown_ || close_sent_) {
+    queued_bytes_ -= size;
+    return;
+  }
+
+  frames_.push_back(Frame{ std::move(frame), size });
+  DoWrite();
+}
+
+void WebSocketConnection::DoWrite() {
+  if (writing_ > 0 || frames_.empty()) {
+    return;
+  }
+
+  // Gather the queued frames into one write.
+  std::vector<asio::const_buffer> buffers;
+  for (auto& frame : frames_) {
+    buffers.push_back(asio::buffer(frame.data));
+    if (buffers.size() == kMaxGatherFrames) {
+      break;
+    }
+  }
+  writing_ = buffers.size();
+
+  asio::async_write(
+      socket_, buffers,
+      asio::bind_executor(strand_, std::bind(&WebSocketConnection::OnWrite,
+                                             shared_from_this(),
+                                             std::placeholders::_1,
+                                             std::placeholders::_2)));
+}
+
+void WebSocketConnection::OnWrite(std::error_code ec,
+                                  std::size_t /*length*/) {
+  if (ec) {
+    if (ec != asio::error::operation_aborted) {
+      LOG_ERRO("WebSocket write error (%s).", ec.message().c_str());
+      Shutdown();
+    }
+    return;
+  }
+
+  for (; writing_ > 0; --writing_) {
+    queued_bytes_ -= frames_.front().size;
+    frames_.pop_front();
+  }
+
+  if (frames_.empty() && close_sent_ && close_received_) {
+    Shutdown();
+    return;
+  }
+
+  DoWrite();
+}
+
+void WebSocketConnection::Shutdown() {
+  if (shutdown_) {
+    return;
+  }
+
+  shutdown_ = true;
+  closing_ = true;
+
+  timer_wheel_.Cancel(&close_timer_);
+
+  auto self = shared_from_this();
+
+  view_->Remove(self);
+  view_->OnClose(self, close_code_);
+
+  // Close the socket and release the connection.
+  pool_->Close(self);
+}
+
+// -----------------------------------------------------------------------------
+
+ResponsePtr WebSocketView::Handle(RequestPtr request) {
+  if (request->method() != methods::kGet ||
+      !iequals(request->GetHeader("Upgrade"), "websocket") ||
+      !HasToken(request->GetHeader(headers::kConnection), "Upgrade")) {
+    LOG_WARN("Not a WebSocket handshake request.");
+    return NewBadRequest();
+  }
+
+  if (request->GetHeader("Sec-WebSocket-Version") != "13") {
+    LOG_WARN("Unsupported WebSocket version.");
+    auto response = NewBadRequest();
+    response->SetHeader("Sec-WebSocket-Version", "13");
+    return response;
+  }
+
+  const std::string& key = request->GetHeader("Sec-WebSocket-Key");
+  if (key.empty()) {
+    LOG_WARN("Sec-WebSocket-Key is missing.");
+    return NewBadRequest();
+  }
+
+  if (!OnHandshake(request)) {
+    return NewBadRequest();
+  }
+
+  // No Content-Length for a 1xx response.
+  auto response = std::make_shared<Response>(Status::kSwitchingProtocols);
+  response->SetHeader("Upgrade", "websocket");
+  response->SetHeader(headers::kConnection, "Upgrade");
+  response->SetHeader("Sec-WebSocket-Accept", websocket::ComputeAccept(key));
+  return response;
+}
+
+std::size_t WebSocketView::Broadcast(const std::string& message, bool binary) {
+  std::vector<WebSocketConnectionPtr> connections;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    connections.assign(connections_.begin(), connections_.end());
+  }
+
+  std::size_t count = 0;
+  for (auto& connection : connections) {
+    if (connection->Send(message, binary)) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+std::size_t WebSocketView::GetConnectionCount() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return connections_.size();
+}
+
+void WebSocketView::Add(WebSocketConnectionPtr connection) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  connections_.insert(connection);
+}
+
+void WebSocketView::Remove(WebSocketConnectionPtr connection) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  connections_.erase(connection);
+}
+
+}  // namespace webcc
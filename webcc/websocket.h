@@ -0,0 +1,295 @@
+#ifndef WEBCC_WEBSOCKET_H_
+#define WEBCC_WEBSOCKET_H_
+
+// The WebSocket protocol (server side).
+// See RFC 6455: https://tools.ietf.org/html/rfc6455
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include "asio/executor.hpp"
+#include "asio/ip/tcp.hpp"
+#include "asio/strand.hpp"
+
+#include "webcc/read_buffer.h"
+#include "webcc/request.h"
+#include "webcc/response.h"
+#include "webcc/timer_wheel.h"
+#include "webcc/view.h"
+
+namespace webcc {
+
+namespace websocket {
+
+enum Opcode : std::uint8_t {
+  kContinuation = 0x0,
+  kText = 0x1,
+  kBinary = 0x2,
+  kClose = 0x8,
+  kPing = 0x9,
+  kPong = 0xa,
+};
+
+// Status codes of the Close frame (RFC 6455 7.4.1).
+enum CloseCode : std::uint16_t {
+  kNormalClosure = 1000,
+  kGoingAway = 1001,
+  kProtocolError = 1002,
+  kUnsupportedData = 1003,
+  kNoStatusReceived = 1005,
+  kAbnormalClosure = 1006,
+  kInvalidPayload = 1007,
+  kPolicyViolation = 1008,
+  kMessageTooBig = 1009,
+  kInternalError = 1011,
+};
+
+// The max size of a (reassembled) message received.
+const std::size_t kMaxMessageSize = 16 * 1024 * 1024;
+
+// The max bytes of the messages queued but not sent of a connection.
+// Send() fails once the queue exceeds it, i.e., the back-pressure.
+const std::size_t kMaxQueuedBytes = 4 * 1024 * 1024;
+
+// Seconds to wait for the peer to answer our Close frame.
+const int kCloseTimeout = 5;
+
+// Compute the value of Sec-WebSocket-Accept from Sec-WebSocket-Key.
+std::string ComputeAccept(const std::string& key);
+
+// XOR the data with the masking key.
+// |offset| is the position of |data| in the whole payload, so that a payload
+// could be (un)masked piece by piece.
+void ApplyMask(char* data, std::size_t length, const std::uint8_t key[4],
+               std::size_t offset = 0);
+
+// Append a frame to |output|. Frames sent by the server are never masked.
+void AppendFrame(Opcode opcode, const char* data, std::size_t length,
+                 bool fin, std::string* output);
+
+// Check if the data is well-formed UTF-8 (RFC 3629), i.e., no overlong
+// encodings, surrogates or code points above U+10FFFF.
+bool IsValidUtf8(const char* data, std::size_t length);
+
+// Check if the status code could be sent in a Close frame (RFC 6455 7.4),
+// i.e., not a reserved one like 1005, 1006 and 1015, and in the ranges
+// defined by the RFC (1000-2999) or for the libraries and applications
+// (3000-4999).
+bool IsValidCloseCode(std::uint16_t code);
+
+}  // namespace websocket
+
+// -----------------------------------------------------------------------------
+
+class WebSocketConnection;
+class WebSocketView;
+class ConnectionPool;
+
+using WebSocketConnectionPtr = std::shared_ptr<WebSocketConnection>;
+using WebSocketViewPtr = std::shared_ptr<WebSocketView>;
+
+// A connection switched to WebSocket after the opening handshake.
+// It takes over the socket of the HTTP connection and runs in the loop
+// threads, no worker thread is occupied.
+class WebSocketConnection
+    : public std::enable_shared_from_this<WebSocketConnection> {
+public:
+  WebSocketConnection(asio::ip::tcp::socket socket, ConnectionPool* pool,
+                      WebSocketViewPtr view, RequestPtr request);
+
+  ~WebSocketConnection() = default;
+
+  WebSocketConnection(const WebSocketConnection&) = delete;
+  WebSocketConnection& operator=(const WebSocketConnection&) = delete;
+
+  // The request of the opening handshake.
+  RequestPtr request() const {
+    return request_;
+  }
+
+  // Bytes of the messages queued but not sent yet.
+  std::size_t queued_bytes() const {
+    return queued_bytes_;
+  }
+
+  // Start to read frames from the client.
+  void Start();
+
+  // Close the socket immediately without the closing handshake.
+  // Called when the server is about to stop.
+  void Stop();
+
+  // Queue a message to send.
+  // Return false if the connection is closing or the send queue is full.
+  // A message is always accepted when the queue is empty no matter how large
+  // it is.
+  // Could be called from any thread.
+  bool Send(const std::string& message, bool binary = false);
+
+  // Start the closing handshake.
+  // Could be called from any thread.
+  void Close(std::uint16_t code = websocket::kNormalClosure,
+             const std::string& reason = "");
+
+private:
+  // The following methods are all called in the strand.
+
+  void DoRead();
+  void DoReadSome();
+  void OnRead(std::error_code ec, std::size_t length);
+
+  // Parse the frames in the input buffer.
+  // Return false if the connection should not read any more.
+  bool ParseFrames();
+
+  bool OnFrame(bool fin, std::uint8_t opcode, char* payload,
+               std::size_t length);
+  bool OnControlFrame(std::uint8_t opcode, const char* payload,
+                      std::size_t length);
+
+  // Send a Close frame and close the socket once it has been sent.
+  bool Fail(std::uint16_t code);
+
+  void SendClose(std::uint16_t code, const std::string& reason);
+
+  void Enqueue(std::string&& frame, std::size_t size);
+
+  void DoWrite();
+  void OnWrite(std::error_code ec, std::size_t length);
+
+  // Close the socket and notify the view.
+  void Shutdown();
+
+  struct Frame {
+    std::string data;
+
+    // Size of the message counted in the queued bytes, 0 for control frames.
+    std::size_t size;
+  };
+
+  asio::ip::tcp::socket socket_;
+
+  ConnectionPool* pool_;
+
+  WebSocketViewPtr view_;
+
+  RequestPtr request_;
+
+  asio::strand<asio::executor> strand_;
+
+  // The buffer for incoming data, released when no more data is coming.
+  ReadBuffer buffer_;
+
+  // Data received but not parsed.
+  std::string input_;
+
+  // The fragmented message being received.
+  std::string message_;
+  bool message_binary_ = false;
+  bool message_started_ = false;
+
+  // Frames to send.
+  std::deque<Frame> frames_;
+
+  // Number of frames being written.
+  std::size_t writing_ = 0;
+
+  std::atomic<std::size_t> queued_bytes_{ 0 };
+
+  // No more messages could be sent.
+  std::atomic<bool> closing_{ false };
+
+  // The Close frame has been sent or received.
+  bool close_sent_ = false;
+  bool close_received_ = false;
+
+  // The status code to report with WebSocketView::OnClose().
+  std::uint16_t close_code_ = websocket::kAbnormalClosure;
+
+  bool shutdown_ = false;
+
+  TimerWheel& timer_wheel_;
+  TimerWheel::Timer close_timer_;
+};
+
+// -----------------------------------------------------------------------------
+
+// A view accepting the WebSocket opening handshake.
+// Route it as a normal view (with the GET method), e.g.,
+//   server.Route("/chat", std::make_shared<ChatView>());
+// Once the 101 response has been sent, the connection is switched to a
+// WebSocketConnection and the messages are delivered to OnMessage().
+// NOTE: The callbacks are invoked in the loop threads. Don't block in them,
+// and hand over the heavy work to other threads if necessary.
+class WebSocketView : public View,
+                      public std::enable_shared_from_this<WebSocketView> {
+public:
+  WebSocketView() = default;
+
+  // Validate the opening handshake and return the 101 response.
+  ResponsePtr Handle(RequestPtr request) override;
+
+  // Send a message to all the open connections of this view.
+  // Return the number of connections which have queued the message.
+  std::size_t Broadcast(const std::string& message, bool binary = false);
+
+  // Number of the open connections.
+  std::size_t GetConnectionCount();
+
+  void set_max_message_size(std::size_t max_message_size) {
+    max_message_size_ = max_message_size;
+  }
+
+  std::size_t max_message_size() const {
+    return max_message_size_;
+  }
+
+  void set_max_queued_bytes(std::size_t max_queued_bytes) {
+    max_queued_bytes_ = max_queued_bytes;
+  }
+
+  std::size_t max_queued_bytes() const {
+    return max_queued_bytes_;
+  }
+
+protected:
+  // Return false to reject the handshake (e.g., authentication failed).
+  virtual bool OnHandshake(RequestPtr /*request*/) {
+    return true;
+  }
+
+  // The connection has been established.
+  virtual void OnOpen(WebSocketConnectionPtr /*connection*/) {
+  }
+
+  // A complete (reassembled) message has been received.
+  virtual void OnMessage(WebSocketConnectionPtr connection,
+                         std::string&& message, bool binary) = 0;
+
+  // The connection has been closed, |code| is the status code of the Close
+  // frame, or 1006 (Abnormal Closure) if no Close frame was received.
+  virtual void OnClose(WebSocketConnectionPtr /*connection*/,
+                       std::uint16_t /*code*/) {
+  }
+
+private:
+  friend class WebSocketConnection;
+
+  void Add(WebSocketConnectionPtr connection);
+  void Remove(WebSocketConnectionPtr connection);
+
+  std::size_t max_message_size_ = websocket::kMaxMessageSize;
+  std::size_t max_queued_bytes_ = websocket::kMaxQueuedBytes;
+
+  std::set<WebSocketConnectionPtr> connections_;
+  std::mutex mutex_;
+};
+
+}  // namespace webcc
+
+#endif  // WEBCC_WEBSOCKET_H_